@@ -25,6 +25,7 @@
 #include "Image.h"
 #include "TacentView.h"
 #include "Preferences.h"
+#include "EditJob.h"
 #include "Version.cmake.h"
 using namespace tMath;
 
@@ -330,7 +331,7 @@ void Viewer::DoLevelsModal(bool levelsPressed)
 		popupOpen = true;
 
 		// This gets called whenever the levels dialog gets opened.
-		CurrImage->AdjustmentBegin();
+		CurrImage->AdjustmentBegin(true);
 		CurrImage->AdjustGetDefaults(brightness, contrast, levelsBlack, levelsMid, levelsWhite, levelsOutBlack, levelsOutWhite);
 		okPressed = false;
 	}
@@ -340,14 +341,29 @@ void Viewer::DoLevelsModal(bool levelsPressed)
 	{
 		if (popupOpen)
 		{
-			// This gets called whenever the levels dialog gets closed.
+			// This gets called whenever the levels dialog gets closed. Big pictures were only previewed so the
+			// adjustment is applied at full resolution as a background edit, which pushes its own undo step.
+			std::function<void(tImage::tPicture*)> adjust;
+			bool adjustAllFrames = true;
+			CurrImage->Unbind();
 			if (!okPressed)
-			{
-				CurrImage->Unbind();
 				CurrImage->AdjustRestoreOriginal();
-				CurrImage->Bind();
-			}
+			else if (CurrImage->TakeAdjustPending(adjust, adjustAllFrames))
+				CurrImage->AdjustRestoreOriginal(true);
 			CurrImage->AdjustmentEnd();
+			CurrImage->Bind();
+
+			if (adjust)
+			{
+				int currFrame = CurrImage->FrameNum;
+				auto op = [=](tImage::tPicture& picture, int frameNum, WorkPool::Progress& progress)
+				{
+					if (!adjustAllFrames && (frameNum != currFrame))
+						return;
+					Image::ApplyAdjustmentBanded(picture, adjust, &progress);
+				};
+				EditJob::Start(CurrImage, "Levels", op, [] { Gutil::SetWindowTitle(); });
+			}
 		}
 		popupOpen = false;
 		return;
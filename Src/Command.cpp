@@ -25,7 +25,10 @@
 #include "Command.h"
 #include "CommandHelp.h"
 #include "CommandOps.h"
+#include "SelfTest.h"
+#include "StreamTIFF.h"
 #include "TacentView.h"
+#include "WorkPool.h"
 
 
 namespace Command
@@ -48,8 +51,10 @@ namespace Command
 	tCmdLine::tOption OptionInKTX			("Load parameters for KTX files",	"inKTX",				1	);
 	tCmdLine::tOption OptionInPKM			("Load parameters for PKM files",	"inPKM",				1	);
 	tCmdLine::tOption OptionInPNG			("Load parameters for PNG files",	"inPNG",				1	);
+	tCmdLine::tOption OptionMaxPixels		("Max input megapixels",			"maxpixels",			1	);
 
 	tCmdLine::tOption OptionOperation		("Operation",						"op",					1	);
+	tCmdLine::tOption OptionEditFrames		("Max frames edited at once",		"editframes",			1	);
 	tCmdLine::tOption OptionPostOperation	("Post operation",					"po",					1	);
 
 	tCmdLine::tOption OptionOutTypes		("Output file type(s)",				"out",			'o',	1	);
@@ -67,6 +72,9 @@ namespace Command
 	tCmdLine::tOption OptionAutoName		("Autogenerate output file names",	"autoname",		'a'			);
 	tCmdLine::tOption OptionEarlyExit		("Early exit / no skipping",		"earlyexit",	'e'			);
 	tCmdLine::tOption OptionSkipUnchanged	("Don't save unchanged files",		"skipunchanged",'k'			);
+	tCmdLine::tOption OptionPlan			("Estimate memory and time only",	"plan",					0	);
+	tCmdLine::tOption OptionSelfTest		("Run the built-in checks",			"selftest",				0	);
+	tCmdLine::tOption OptionStream			("Edit tiff files out of core",		"stream",				0	);
 
 	void BeginConsoleOutput();
 	void EndConsoleOutput();
@@ -79,6 +87,13 @@ namespace Command
 		~ConsoleOutputScoped()			{ EndConsoleOutput(); }
 	};
 
+	// The work pool threads must be joined on every way out of Process.
+	struct WorkPoolScoped
+	{
+		WorkPoolScoped()				{ Viewer::WorkPool::Init(); }
+		~WorkPoolScoped()				{ Viewer::WorkPool::Shutdown(); }
+	};
+
 	struct ParamValuePair : public tLink<ParamValuePair>
 	{
 		tString Param;
@@ -122,6 +137,16 @@ namespace Command
 
 	tString DetermineOutputFilename(const tString& inName, tSystem::tFileType outType);
 
+	// Dry run for --plan. Probes every input header and walks the operations to report output dimensions, peak
+	// memory, pixels processed, and projected time. Nothing is loaded or saved.
+	int ProcessPlan();
+	tString FormatBytes(int64 numBytes);
+
+	// Out-of-core processing for --stream. Each tiff is decoded into a memory-mapped tile store next to its outputs,
+	// the operations are applied to the store, and the result is written back out as a tiff. Only operations that
+	// support streaming may be used.
+	int ProcessStream();
+
 	tImage::tImageAPNG::SaveParams	SaveParamsAPNG;
 	tImage::tImageBMP::SaveParams	SaveParamsBMP;
 	tImage::tImageGIF::SaveParams	SaveParamsGIF;
@@ -131,6 +156,7 @@ namespace Command
 	tImage::tImageTGA::SaveParams	SaveParamsTGA;
 	tImage::tImageTIFF::SaveParams	SaveParamsTIFF;
 	tImage::tImageWEBP::SaveParams	SaveParamsWEBP;
+	float SaveSpatialBudgetGIF = 0.0f;
 
 	tImage::tImageASTC::LoadParams	LoadParamsASTC;
 	tImage::tImageDDS::LoadParams	LoadParamsDDS;
@@ -1001,7 +1027,10 @@ void Command::SetImageSaveParameters(Viewer::Image& image, tSystem::tFileType fi
 	{
 		case tSystem::tFileType::APNG: image.SaveParamsAPNG = SaveParamsAPNG; break;
 		case tSystem::tFileType::BMP:  image.SaveParamsBMP  = SaveParamsBMP;  break;
-		case tSystem::tFileType::GIF:  image.SaveParamsGIF  = SaveParamsGIF;  break;
+		case tSystem::tFileType::GIF:
+			image.SaveParamsGIF = SaveParamsGIF;
+			image.SaveSpatialBudgetGIF = SaveSpatialBudgetGIF;
+			break;
 		case tSystem::tFileType::JPG:  image.SaveParamsJPG  = SaveParamsJPG;  break;
 		case tSystem::tFileType::PNG:  image.SaveParamsPNG  = SaveParamsPNG;  break;
 		case tSystem::tFileType::QOI:  image.SaveParamsQOI  = SaveParamsQOI;  break;
@@ -1126,6 +1155,10 @@ void Command::ParseSaveParametersGIF()
 			case tHash::tHashCT("samp"):
 				SaveParamsGIF.SampleFactor = (value == "*") ? 1 : value.AsInt32();
 				break;
+
+			case tHash::tHashCT("budg"):
+				SaveSpatialBudgetGIF = (value == "*") ? 0.0f : tMath::tClampMin(value.AsFloat(), 0.0f);
+				break;
 		}
 	}
 }
@@ -1336,9 +1369,245 @@ tString Command::DetermineOutputFilename(const tString& inName, tSystem::tFileTy
 }
 
 
+tString Command::FormatBytes(int64 numBytes)
+{
+	tString str;
+	double bytes = double(numBytes);
+	if (bytes < 1024.0)
+		tsPrintf(str, "%d B", int(numBytes));
+	else if (bytes < 1024.0*1024.0)
+		tsPrintf(str, "%.1f KB", bytes/1024.0);
+	else if (bytes < 1024.0*1024.0*1024.0)
+		tsPrintf(str, "%.1f MB", bytes/(1024.0*1024.0));
+	else
+		tsPrintf(str, "%.2f GB", bytes/(1024.0*1024.0*1024.0));
+	return str;
+}
+
+
+int Command::ProcessPlan()
+{
+	// Index 0 is the load, the operations follow, and the last entry is the save.
+	int numOps = Operations.Count();
+	PlanCost* opTotals = new PlanCost[numOps+2];
+	int64 maxPeakBytes = 0;
+	double totalSeconds = 0.0;
+	bool somethingFailed = false;
+
+	tPrintfNorm("Plan | %d images. %d operations. %d post operations. %d output types.\n", Images.Count(), numOps, PostOperations.Count(), OutTypes.Count());
+	tPrintfNorm("%-32s %-11s %6s  %-11s %10s %9s\n", "Image", "Input", "Frames", "Output", "Peak Mem", "Time");
+	for (Viewer::Image* image = Images.First(); image; image = image->Next())
+	{
+		tString inNameShort = tSystem::tGetFileName(image->Filename);
+		bool loadParamsFromConfig = false;
+		if (image->Probe(0, loadParamsFromConfig) != Viewer::Image::ProbeResult::Success)
+		{
+			tPrintfNorm("%-32s Unreadable header.\n", inNameShort.Chr());
+			somethingFailed = true;
+			continue;
+		}
+
+		PlanState state;
+		state.Width = image->Cached_PrimaryWidth;
+		state.Height = image->Cached_PrimaryHeight;
+		state.NumFrames = tMath::tMax(image->Cached_NumFrames, 1);
+		state.NumPixels = image->Cached_NumPixels;
+
+		// The decoder holds the file contents (or a decoded copy of them) while the pictures are created.
+		state.UpdatePeak(int64(image->FileSizeB));
+		double imageSeconds = double(state.NumPixels) / (PlanRate::Decode * 1000000.0);
+		opTotals[0].Pixels += state.NumPixels;
+		opTotals[0].Seconds += imageSeconds;
+
+		tString inDims;
+		tsPrintf(inDims, "%dx%d", state.Width, state.Height);
+
+		int opIndex = 1;
+		for (Operation* operation = Operations.First(); operation; operation = operation->Next(), opIndex++)
+		{
+			if (!operation->Valid)
+				continue;
+			PlanCost cost = operation->Plan(state);
+			opTotals[opIndex].Pixels += cost.Pixels;
+			opTotals[opIndex].Seconds += cost.Seconds;
+			imageSeconds += cost.Seconds;
+		}
+
+		// Multi-frame output types save every picture. The others only save the current one.
+		for (tSystem::tFileTypes::tFileTypeItem* typeItem = OutTypes.First(); typeItem; typeItem = typeItem->Next())
+		{
+			bool multiFrame = Viewer::FileTypes_SaveMultiFrame.Contains(typeItem->FileType);
+			int64 savePixels = multiFrame ? state.NumPixels : int64(state.Width)*int64(state.Height);
+			state.UpdatePeak(state.GetFrameBytes());
+			opTotals[numOps+1].Pixels += savePixels;
+			opTotals[numOps+1].Seconds += double(savePixels) / (PlanRate::Encode * 1000000.0);
+			imageSeconds += double(savePixels) / (PlanRate::Encode * 1000000.0);
+		}
+
+		tString outDims;
+		tsPrintf(outDims, "%s%dx%d", state.Exact ? "" : "<=", state.Width, state.Height);
+		tPrintfNorm
+		(
+			"%-32s %-11s %6d  %-11s %10s %8.2fs\n",
+			inNameShort.Chr(), inDims.Chr(), state.NumFrames, outDims.Chr(), FormatBytes(state.PeakBytes).Chr(), imageSeconds
+		);
+
+		maxPeakBytes = tMath::tMax(maxPeakBytes, state.PeakBytes);
+		totalSeconds += imageSeconds;
+	}
+
+	tPrintfNorm("\n%-16s %16s %9s\n", "Step", "Pixels", "Time");
+	for (int o = 0; o < numOps+2; o++)
+	{
+		const char* stepName = "load";
+		if (o == numOps+1)
+		{
+			stepName = "save";
+		}
+		else if (o > 0)
+		{
+			Operation* operation = Operations.First();
+			for (int i = 1; i < o; i++)
+				operation = operation->Next();
+			stepName = operation->GetName();
+		}
+		tPrintfNorm("%-16s %16|64d %8.2fs\n", stepName, opTotals[o].Pixels, opTotals[o].Seconds);
+	}
+	delete[] opTotals;
+
+	// Post operations run once over all the input images.
+	if (!PostOperations.IsEmpty() && (Images.Count() >= 2))
+	{
+		for (PostOperation* postop = PostOperations.First(); postop; postop = postop->Next())
+		{
+			if (!postop->Valid)
+				continue;
+
+			int64 postPeakBytes = 0;
+			PlanCost cost = postop->Plan(Images, postPeakBytes);
+			tPrintfNorm("%-16s %16|64d %8.2fs  Peak Mem %s\n", postop->GetName(), cost.Pixels, cost.Seconds, FormatBytes(postPeakBytes).Chr());
+			maxPeakBytes = tMath::tMax(maxPeakBytes, postPeakBytes);
+			totalSeconds += cost.Seconds;
+		}
+	}
+
+	tPrintfNorm("\nPlan | Peak memory per job: %s. Projected single-core time: %.2fs.\n", FormatBytes(maxPeakBytes).Chr(), totalSeconds);
+	return somethingFailed ? Viewer::ErrorCode_CLI_FailImageLoad : Viewer::ErrorCode_Success;
+}
+
+
+int Command::ProcessStream()
+{
+	for (Operation* operation = Operations.First(); operation; operation = operation->Next())
+	{
+		if (operation->Valid && !operation->CanStream())
+		{
+			tPrintfNorm("Warning: The %s operation can't be used with --stream.\n", operation->GetName());
+			return Viewer::ErrorCode_CLI_FailImageProcess;
+		}
+	}
+	if (!PostOperations.IsEmpty())
+		tPrintfNorm("Warning: Post operations are not run with --stream.\n");
+
+	bool somethingFailed = false;
+	for (Viewer::Image* image = Images.First(); image; image = image->Next())
+	{
+		tString inNameShort = tSystem::tGetFileName(image->Filename);
+		if (image->Filetype != tSystem::tFileType::TIFF)
+		{
+			tPrintfNorm("Warning: %s is not a tiff. Only tiff files can be streamed. Skipping.\n", inNameShort.Chr());
+			somethingFailed = true;
+			if (OptionEarlyExit)
+				return Viewer::ErrorCode_CLI_FailImageLoad;
+			continue;
+		}
+
+		// The scratch files go where the output does since there has to be room there for the result anyway.
+		tString scratchDir = tSystem::tGetDir(DetermineOutputFilename(image->Filename, tSystem::tFileType::TIFF));
+		Viewer::TileStore* store = Viewer::StreamTIFF::Load(image->Filename, scratchDir);
+		if (!store)
+		{
+			tPrintfNorm("Warning: Failed stream load: %s. Skipping.\n", inNameShort.Chr());
+			somethingFailed = true;
+			if (OptionEarlyExit)
+				return Viewer::ErrorCode_CLI_FailImageLoad;
+			continue;
+		}
+
+		tPrintfNorm("Processing: %s\n", inNameShort.Chr());
+		bool processed = true;
+		for (Operation* operation = Operations.First(); operation && processed; operation = operation->Next())
+		{
+			if (!operation->Valid)
+				continue;
+
+			Viewer::TileStore* result = operation->ApplyStream(*store, scratchDir);
+			if (result && (result != store))
+			{
+				delete store;
+				store = result;
+			}
+			processed = (result != nullptr);
+		}
+		if (!processed)
+		{
+			delete store;
+			somethingFailed = true;
+			if (OptionEarlyExit)
+				return Viewer::ErrorCode_CLI_FailImageProcess;
+			continue;
+		}
+
+		for (tSystem::tFileTypes::tFileTypeItem* typeItem = OutTypes.First(); typeItem; typeItem = typeItem->Next())
+		{
+			tSystem::tFileType outType = typeItem->FileType;
+			if (outType != tSystem::tFileType::TIFF)
+			{
+				tPrintfNorm("Warning: Only tiff files are saved with --stream. Skipping %s output.\n", tSystem::tGetFileTypeName(outType).Chr());
+				somethingFailed = true;
+				continue;
+			}
+
+			tString outFilename = DetermineOutputFilename(image->Filename, outType);
+			tString outNameShort = tSystem::tGetFileName(outFilename);
+			if (!OptionOverwrite && tSystem::tFileExists(outFilename))
+			{
+				tPrintfNorm("Warning: %s exists. No overwrite.\n", outNameShort.Chr());
+				somethingFailed = true;
+				if (OptionEarlyExit)
+				{
+					delete store;
+					return Viewer::ErrorCode_CLI_FailEarlyExit;
+				}
+				continue;
+			}
+
+			if (Viewer::StreamTIFF::Save(*store, outFilename))
+			{
+				tPrintfNorm("Saved File: %s\n", outNameShort.Chr());
+			}
+			else
+			{
+				tPrintfNorm("Warning: Failed save: %s\n", outNameShort.Chr());
+				somethingFailed = true;
+				if (OptionEarlyExit)
+				{
+					delete store;
+					return Viewer::ErrorCode_CLI_FailImageSave;
+				}
+			}
+		}
+		delete store;
+	}
+
+	return somethingFailed ? Viewer::ErrorCode_CLI_FailUnknown : Viewer::ErrorCode_Success;
+}
+
+
 int Command::Process()
 {
 	ConsoleOutputScoped scopedConsoleOutput;
+	WorkPoolScoped scopedWorkPool;
 
 	// Default is normal (1) verbosity.
 	int verbLevel = 1;
@@ -1404,6 +1673,9 @@ int Command::Process()
 		return Viewer::ErrorCode_Success;
 	}
 
+	if (OptionSelfTest)
+		return Viewer::SelfTest::Run() ? Viewer::ErrorCode_Success : Viewer::ErrorCode_CLI_FailSelfTest;
+
 	// Determine what input types will be processed when specifying a directory.
 	DetermineInputTypes();
 	DetermineInputLoadParameters();
@@ -1425,17 +1697,60 @@ int Command::Process()
 	DetermineOutputNameParameters();
 	DetermineOutputSaveParameters();
 
+	// Before planning as it sets how many frames are edited at once.
+	if (OptionEditFrames)
+	{
+		int maxEditFrames = OptionEditFrames.Arg1().AsInt();
+		if (maxEditFrames >= 0)
+			Viewer::Image::MaxEditFrames = maxEditFrames;
+		else
+			tPrintfNorm("Warning: Invalid --editframes value. Ignoring.\n");
+	}
+
+	if (OptionPlan)
+		return ProcessPlan();
+
+	if (OptionStream)
+		return ProcessStream();
+
 	// Process standard operations.
 	// We do the images one at a time to save memory. That is, we only need to load one image in at a time
 	// and can unload them when done.
 	bool somethingFailed = false;
+	int64 maxPixels = 0;
+	if (OptionMaxPixels)
+	{
+		double maxMegaPixels = OptionMaxPixels.Arg1().AsDouble();
+		if (maxMegaPixels > 0.0)
+			maxPixels = int64(maxMegaPixels * 1000000.0);
+		else
+			tPrintfNorm("Warning: Invalid --maxpixels value. Ignoring.\n");
+	}
+
 	for (Viewer::Image* image = Images.First(); image; image = image->Next())
 	{
 		// We do not read the config file when using the CLI. All parameters need to com from the command-line.
 		bool loadParamsFromConfig = false;
-		image->Load(loadParamsFromConfig);
-
 		tString inNameShort = tSystem::tGetFileName(image->Filename);
+
+		// The budget check only reads the file header so oversize images never get decoded. If the header can't be
+		// parsed we can't tell how big the image is so it is rejected too.
+		Viewer::Image::ProbeResult probe = maxPixels ? image->Probe(maxPixels, loadParamsFromConfig) : Viewer::Image::ProbeResult::Success;
+		if (probe != Viewer::Image::ProbeResult::Success)
+		{
+			if (probe == Viewer::Image::ProbeResult::Failed)
+				tPrintfNorm("Warning: %s header unreadable. Pixel budget can't be checked. Skipping.\n", inNameShort.Chr());
+			else if (image->Cached_NumFrames <= 0)
+				tPrintfNorm("Warning: %s frame count unknown. Pixel budget can't be checked. Skipping.\n", inNameShort.Chr());
+			else
+				tPrintfNorm("Warning: %s exceeds pixel budget (%|64d > %|64d). Skipping.\n", inNameShort.Chr(), image->Cached_NumPixels, maxPixels);
+			somethingFailed = true;
+			if (OptionEarlyExit)
+				return Viewer::ErrorCode_CLI_FailImageLoad;
+			continue;
+		}
+
+		image->Load(loadParamsFromConfig);
 		if (!image->IsLoaded())
 		{
 			tPrintfNorm("Warning: Failed load: %s. Skipping.\n", inNameShort.Chr());
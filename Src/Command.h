@@ -46,6 +46,7 @@ namespace Command
 	extern tImage::tImageTGA::SaveParams  SaveParamsTGA;
 	extern tImage::tImageTIFF::SaveParams SaveParamsTIFF;
 	extern tImage::tImageWEBP::SaveParams SaveParamsWEBP;
+	extern float SaveSpatialBudgetGIF;
 
 	void SetImageSaveParameters(Viewer::Image&, tSystem::tFileType);
 }
@@ -447,14 +447,16 @@ There is no requirement it be a power-of or divisible-by 2.
 u8"Quantize using ScolorQ Algorithm",
 u8"tacentview -ca --op quantize[spc,16,true,3,8.0] -o qoi --outQOI bpp=24,spc=srgb",
 u8R"EXAMPLE(
-Similar to ^Quantize using Wu Algorithm^ except using the ScolorQ spatial
+Similar to ^Quantize using Wu Algorithm^ except using the ScolorQ style spatial
 quantization algorithm. When using this algorithm the 4th argument (3) is the
 filter-size and must be 1, 3, or 5. ScolorQ supports dithering -- the 5th
 argument (from 0.0 to 30.0) represents the amount of dither. A value of 0.1 is
 essentially no dither, while 20+ is a lot. If dither is set to 0.0 a good value
 is computed for you based on the image size and number of requested colours.
-ScolorQ is a good choice for small palette sizes (here we chose 16) but can be
-quite slow for larger images or palette sizes bigger than 30.
+ScolorQ is a good choice for small palette sizes (here we chose 16). It is the
+slowest method, so an optional 6th argument gives a time budget in seconds per
+frame, after which the result so far is kept. The budget is turned into a fixed
+number of refining passes, so the output is the same on any machine.
 )EXAMPLE"
 },
 
@@ -886,6 +888,13 @@ specify multiple types with a comma-separated list. For example, '-i jpg,png'
 is the same as '-i jpg -i png'. If you specify only unsupported or invalid
 types a warning is printed and tga images will be processed.
 
+Use --maxpixels to skip input images that are too large. The argument is in
+megapixels (may be fractional) and is compared against the total number of
+pixels over all frames, mipmaps, and faces. Only the file header is read to
+make the decision, except for gif and animated webp files which are walked to
+count their frames. Images whose header or frame count can't be read are also
+skipped. A skipped image counts as a failed load.
+
 %s
 %s
 )INPUTIMAGES010", intypes.Chr(), inexts.Chr()
@@ -1021,6 +1030,11 @@ with --op zap[a,b] which would do the same thing as --op zap[a,b,*,*]. If the
 operation has all optional arguments you may include an empty arg list with []
 or leave it out. Eg. zap[a*,b*] may be called with --op zap[] or just --op zap.
 
+The frames of multi-frame images are edited at the same time, one per core. Use
+--editframes to limit how many frames are edited at once. Each frame being
+edited may need its own working copy so a lower limit uses less memory. The
+default of 0 means one per core.
+
 --op pixel[x,y,col,chan*]
   Sets the pixel at (x,y) to the colour supplied. The chan argument lets you
   optionally select which pixel colour channels should be modified. You may
@@ -1167,15 +1181,17 @@ or leave it out. Eg. zap[a*,b*] may be called with --op zap[] or just --op zap.
         quality so this is not the default. Use resize mode when it is
         desireable to preserve the image size.
   upft: Upsample filter. See below for filter names. Default is bilinear*.
-        Upsampling is used to create a larger image before rotation to give
-        much better results. It is also valid to enter 'none' in which case no
-        scaling-up of the image is performed. In this case all original pixel
-        colours are preserved by using nearest neighbour colours. This is fast
-        and a good choice for pixel-art and sprites.
-  dnft: Downsample filter. Only used if up-filter is not none. This filter is
-        used to restore image size after rotation. Specifying none* here uses
-        a special down-sample method that produces sharper results. Using box
-        filter here is also a good choice. See below for valid filter names.
+        With the default down-filter each pixel is sampled once from the
+        source using this filter. Bilinear and box use the nearest 2x2 pixels
+        and the bicubics and lanczos use 4x4. It is also valid to enter 'none'
+        in which case all original pixel colours are preserved by using
+        nearest neighbour colours. This is fast and a good choice for
+        pixel-art and sprites.
+  dnft: Downsample filter. Only used if up-filter is not none. Specifying
+        none* samples once as described above, which is sharp and fast. Any
+        other filter upsamples the image 2X with the up-filter, rotates it,
+        and uses this filter to restore the size. This is smoother but much
+        slower. Box works well here. See below for valid filter names.
   fill: Fill colour. Only used if mode was fill. Specify the colour using a
         hexadecimal in the form #RRGGBBAA, a single integer spread to RGBA, or
         a predefined name: black*, white, grey, red, green, blue, yellow, cyan,
@@ -1237,7 +1253,7 @@ R"OPERATIONS020(
   chan: The channels the brightness adjustment should be made to. Choices are
         RGB*, R, G, B, and A. Lower-case also works.
 
---op quantize[algo,ncol,xact*,fsam*,dith*]
+--op quantize[algo,ncol,xact*,fsam*,dith*,budg*]
   Quantize the image to a reduced set of colours using various methods. Specify
   the algorithm, number of colours, and any optional parameters. Quantization
   is based on the colour (RGB) components. The alpha channel, if present, is
@@ -1248,8 +1264,9 @@ R"OPERATIONS020(
         wu*: The Xiaolin Wu algorithm. Fast and good quality.
         neu: NeuQuant algorithm. Learning neural-net. The original high-quality
              quantization method.
-        spc: Scolorq algorithm. Spatial quantiation. Slow but good quality for
-             low numbers of colours (< 32). Only algo to offer dithering.
+        spc: Spatial quantization (scolorq style). The slowest but good
+             quality for low numbers of colours (< 32). Only algo to offer
+             dithering. Large images are solved coarse-to-fine on all cores.
   ncol: Number of colours that will be present in image afterwards. Must be
         between 2 and 256* (both inclusive).
   xact: Boolean exact. Default is true*. See below for valid boolean arguments.
@@ -1257,14 +1274,19 @@ R"OPERATIONS020(
         the requested, then the image will look identical after processing. If
         exact is false, all pixels get run through the chosen algorithm.
   fsam: FilterSize or SampleFactor. Only applies to spatial and neu algorithms.
-        For scolorq this is the filter-size and must be 1, 3*, or 5.
+        For spatial this is the filter-size and must be 1, 3*, or 5.
         For neu quant this is the sample-factor from 1* to 30. Smaller values
         are better quality -- more faithful representation of the original.
-  dith: Dither amount. Only applies to scolorq. Values from 0.0 to 30.0.
+  dith: Dither amount. Only applies to spatial. Values from 0.0 to 30.0.
         The default is 0.0* which means auto-determine the dither amount based
         on the image dimensions and number of colours. Otherwise, a value of
         0.1 results in essentially no dither, and at around 20.0 there is
         significant dithering.
+  budg: Time budget in seconds per frame. Only applies to spatial. Once used
+        up no more refining passes are made and the result so far is kept. The
+        budget is turned into a fixed number of passes using typical single
+        core timings, so the output does not depend on machine speed or load.
+        The default is 0.0* which means no limit.
 
 --op channel[mode*,chan*,col*]
   Channel operations affect components of all pixels. The supported modes
@@ -1511,7 +1533,7 @@ with save parameters:
         one fewer colour can be represented.
   qan:  Quantization method for palette generation. Possible values:
         fix   - Use a fixed colour palette for the chosen bpp. Low quality.
-        spc   - Use spatial scolorq algorithm. Slow. Good for 5 bpp or lower.
+        spc   - Use spatial algorithm. Slowest. Good for 5 bpp or lower.
         neu   - Use neuquant algorithm. Good for 64 colours or more.
         wu*   - Use XiaolinWu algorithm. Good for 64 colours or more.
   loop: Times to loop for animated GIFs. Choose 0* to loop forever. 
@@ -1526,6 +1548,9 @@ with save parameters:
         amount. A dither value of 0.1 results in no dithering. 2.0 results in
         significant dithering.
   filt: Filter size. Only applies to spatial quantization. Must be 1, 3*, 5.
+  budg: Time budget in seconds per frame. Only applies to spatial
+        quantization. Spent as a fixed number of refining passes so the output
+        does not depend on machine speed. 0.0* means no limit.
   samp: Sample factor. Range is [1,30]. Only applies to neu quantization. 1*
         means whole image learning. 10 means 1/10 of image only. Max value 30
         is fastest.
@@ -1574,6 +1599,61 @@ with save parameters:
 	);
 	tPrintf
 	(
+R"PLAN010(
+PLAN
+----
+Use --plan to estimate the cost of a batch before running it. Only the header
+of each input image is read. The operations and post operations are walked to
+compute the output dimensions without loading any pixel data. For each image
+the input and output dimensions, the number of frames, the estimated peak
+memory, and the projected time are printed. This is followed by the total
+pixels and time for each step (load, each operation, save) and for each post
+operation. Nothing is loaded or saved. Times assume a single core and are
+rough. Output dimensions after deborder depend on the pixels and are printed
+as an upper bound. Peak memory counts the frames of one image being edited at
+the same time, one per core or as set by --editframes. It is per job, so
+multiply by the number of concurrent jobs when choosing a machine size.
+)PLAN010"
+	);
+	tPrintf
+	(
+R"STREAM010(
+STREAM
+------
+Use --stream to edit tiff files too big to load as one picture. Each input is
+decoded a strip or tile at a time into a memory-mapped scratch file in the
+output directory, so memory use stays small no matter how big the image is.
+The operations are applied to the scratch file and the result is written as an
+uncompressed RGBA tiff, or a BigTIFF if it is over 4GB. Only crop and flip may
+be used, and only tiff output (-o tif). Post operations are not run. The first
+page is read. It must be 8 bits per channel grey, grey-alpha, RGB, or RGBA,
+with no compression, PackBits, or LZW. Other files fail to load. There must be
+room on disk for the scratch file of each step plus the output.
+)STREAM010"
+	);
+	tPrintf
+	(
+R"SELFTEST010(
+SELF TEST
+---------
+Use --selftest to run the built-in checks and exit. No input images are needed
+and nothing is written. The vectorized pixel kernels (SSE4 and AVX2, when the
+CPU supports them) are run on the same random buffers as the scalar ones and
+the results must match byte for byte. Header parsing and memory sizes are
+checked against synthetic inputs with more than 2^31 pixels. Nothing that
+large is allocated. The resampler and rotator are run on small fixed images
+with every filter, and must give the same pixels at every kernel level and
+thread count. The spatial quantizer must keep alpha, use no more colours than
+asked for, and give the same pixels on any number of threads, with or without
+a budget. The codec that spills undo history to scratch files must give back
+exactly the pixels it was given and reject a truncated stream. Swizzles,
+quarter turns, flips, and anchored pastes are undone and redone and must give
+back the exact pixels, and a region step that no longer fits is dropped. A
+line is printed for each check. The exit code is non-zero if any check fails.
+)SELFTEST010"
+	);
+	tPrintf
+	(
 R"EXITCODE010(
 EXIT CODE
 ---------
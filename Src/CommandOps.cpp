@@ -16,6 +16,7 @@
 // AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 // PERFORMANCE OF THIS SOFTWARE.
 
+#include <vector>
 #include <System/tTime.h>
 #include <Image/tImageGIF.h>
 #include <Image/tImageWEBP.h>
@@ -26,6 +27,9 @@
 #include "MultiFrame.h"
 #include "OpenSaveDialogs.h"
 #include "TacentView.h"
+#include "Resampler.h"
+#include "Rotator.h"
+#include "SpatialQuantizer.h"
 
 
 namespace Command
@@ -39,6 +43,12 @@ namespace Command
 	// Parses chanStr as a set of channels. The string may contain the characters RGBA in any order and in upper or
 	// lower case. If none of these characters are set, channels is left unmodified and false is returned.
 	bool ParseChannels(comp_t& channels, const tString& chanStr);
+
+	// Plan helpers. PlanInPlace is for operations that do not change the dimensions. If frameNumber is >= 0 only a
+	// single picture is processed. PlanCrop is for all crop-like operations where every picture gets copied into a
+	// new newW x newH buffer.
+	PlanCost PlanInPlace(PlanState&, double megaPixelsPerSecond, int frameNumber = -1, int64 transientBytes = 0);
+	PlanCost PlanCrop(PlanState&, int newW, int newH);
 }
 
 
@@ -96,6 +106,29 @@ bool Command::ParseChannels(comp_t& channels, const tString& chanStr)
 }
 
 
+Command::PlanCost Command::PlanInPlace(PlanState& state, double megaPixelsPerSecond, int frameNumber, int64 transientBytes)
+{
+	state.UpdatePeak(transientBytes);
+	PlanCost cost;
+	cost.Pixels = (frameNumber >= 0) ? int64(state.Width)*int64(state.Height) : state.NumPixels;
+	cost.Seconds = double(cost.Pixels) / (megaPixelsPerSecond * 1000000.0);
+	return cost;
+}
+
+
+Command::PlanCost Command::PlanCrop(PlanState& state, int newW, int newH)
+{
+	state.UpdatePeak(state.GetEditingBytes(int64(newW)*int64(newH)*int64(sizeof(tPixel4b))));
+	state.SetDimensions(newW, newH);
+	state.UpdatePeak();
+
+	PlanCost cost;
+	cost.Pixels = state.NumPixels;
+	cost.Seconds = double(state.NumPixels) / (PlanRate::Copy * 1000000.0);
+	return cost;
+}
+
+
 Command::OperationPixel::OperationPixel(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -154,6 +187,15 @@ bool Command::OperationPixel::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationPixel::Plan(PlanState& state) const
+{
+	state.UpdatePeak();
+	PlanCost cost;
+	cost.Pixels = 1;
+	return cost;
+}
+
+
 Command::OperationResize::OperationResize(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -243,6 +285,40 @@ bool Command::OperationResize::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationResize::Plan(PlanState& state) const
+{
+	PlanCost cost;
+	if ((state.Width <= 0) || (state.Height <= 0))
+		return cost;
+
+	float aspect = float(state.Width) / float(state.Height);
+	int dstW = Width;
+	int dstH = Height;
+	if (dstW <= 0)
+		dstW = int( float(dstH) * aspect );
+	else if (dstH <= 0)
+		dstH = int( float(dstW) / aspect );
+
+	tMath::tiClamp(dstW, 4, Viewer::Image::MaxDim);
+	tMath::tiClamp(dstH, 4, Viewer::Image::MaxDim);
+	if ((state.Width == dstW) && (state.Height == dstH))
+		return cost;
+
+	// Each picture is resampled into a new buffer before the old one is freed. The resampler's own buffers are alive
+	// at the same time.
+	int64 srcPixels = state.NumPixels;
+	int64 frameBytes = int64(dstW)*int64(dstH)*int64(sizeof(tPixel4b));
+	frameBytes += Viewer::Resampler::GetWorkingBytes(state.Width, state.Height, dstW, dstH, ResampleFilter);
+	state.UpdatePeak(state.GetEditingBytes(frameBytes));
+	state.SetDimensions(dstW, dstH);
+	state.UpdatePeak();
+
+	cost.Pixels = srcPixels + state.NumPixels;
+	cost.Seconds = double(state.NumPixels) / (PlanRate::Resample * 1000000.0);
+	return cost;
+}
+
+
 Command::OperationCanvas::OperationCanvas(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -365,6 +441,29 @@ bool Command::OperationCanvas::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationCanvas::Plan(PlanState& state) const
+{
+	PlanCost cost;
+	if ((state.Width <= 0) || (state.Height <= 0))
+		return cost;
+
+	float aspect = float(state.Width) / float(state.Height);
+	int dstW = Width;
+	int dstH = Height;
+	if (dstW <= 0)
+		dstW = int( float(dstH) * aspect );
+	else if (dstH <= 0)
+		dstH = int( float(dstW) / aspect );
+
+	tMath::tiClamp(dstW, 4, Viewer::Image::MaxDim);
+	tMath::tiClamp(dstH, 4, Viewer::Image::MaxDim);
+	if ((state.Width == dstW) && (state.Height == dstH))
+		return cost;
+
+	return PlanCrop(state, dstW, dstH);
+}
+
+
 Command::OperationAspect::OperationAspect(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -499,6 +598,39 @@ bool Command::OperationAspect::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationAspect::Plan(PlanState& state) const
+{
+	PlanCost cost;
+	if ((state.Width <= 0) || (state.Height <= 0))
+		return cost;
+
+	int dstH = state.Height;
+	int dstW = state.Width;
+	float srcAspect = float(state.Width)/float(state.Height);
+	float dstAspect = float(Num)/float(Den);
+	switch (Mode)
+	{
+		case AspectMode::Crop:
+			if (dstAspect > srcAspect)
+				dstH = tMath::tFloatToInt(float(dstW) / dstAspect);
+			else if (dstAspect < srcAspect)
+				dstW = tMath::tFloatToInt(float(dstH) * dstAspect);
+			break;
+
+		case AspectMode::Letterbox:
+			if (dstAspect > srcAspect)
+				dstW = tMath::tFloatToInt(float(dstH) * dstAspect);
+			else if (dstAspect < srcAspect)
+				dstH = tMath::tFloatToInt(float(dstW) / dstAspect);
+	}
+
+	if ((state.Width == dstW) && (state.Height == dstH))
+		return cost;
+
+	return PlanCrop(state, dstW, dstH);
+}
+
+
 Command::OperationDeborder::OperationDeborder(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -541,6 +673,20 @@ bool Command::OperationDeborder::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationDeborder::Plan(PlanState& state) const
+{
+	// The border size depends on the pixels so we assume the worst case of no border. The scan and the copy are
+	// still counted.
+	state.Exact = false;
+	state.UpdatePeak(state.GetEditingBytes(state.GetFrameBytes()));
+
+	PlanCost cost;
+	cost.Pixels = state.NumPixels*2;
+	cost.Seconds = double(state.NumPixels) / (PlanRate::Scan * 1000000.0) + double(state.NumPixels) / (PlanRate::Copy * 1000000.0);
+	return cost;
+}
+
+
 Command::OperationCrop::OperationCrop(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -635,6 +781,78 @@ bool Command::OperationCrop::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationCrop::Plan(PlanState& state) const
+{
+	int newW = WidthOrMaxX;
+	int newH = HeightOrMaxY;
+	if (Mode == CropMode::Absolute)
+	{
+		newW = WidthOrMaxX+1 - OriginX;
+		newH = HeightOrMaxY+1 - OriginY;
+	}
+	if ((newW <= 0) || (newH <= 0))
+		return PlanCost();
+
+	return PlanCrop(state, newW, newH);
+}
+
+
+Viewer::TileStore* Command::OperationCrop::ApplyStream(Viewer::TileStore& store, const tString& scratchDir)
+{
+	tAssert(Valid);
+
+	int newW = WidthOrMaxX;
+	int newH = HeightOrMaxY;
+	if (Mode == CropMode::Absolute)
+	{
+		newW = WidthOrMaxX+1 - OriginX;
+		newH = HeightOrMaxY+1 - OriginY;
+	}
+	if ((newW <= 0) || (newH <= 0))
+		return nullptr;
+
+	tPrintfFull("Crop | Stream Crop[w:%d h:%d x:%d y:%d fill:%02x,%02x,%02x,%02x]\n", newW, newH, OriginX, OriginY, FillColour.R, FillColour.G, FillColour.B, FillColour.A);
+	Viewer::TileStore* cropped = new Viewer::TileStore(newW, newH, store.GetTileSize(), scratchDir);
+	if (!cropped->IsValid())
+	{
+		delete cropped;
+		return nullptr;
+	}
+
+	// Same as tPicture::Crop. The origin is where the new bottom-left pixel comes from and anything outside the
+	// source is filled. Each destination tile is built a row at a time from whatever part of the source it covers.
+	int srcW = store.GetWidth();
+	int srcH = store.GetHeight();
+	int tileSize = cropped->GetTileSize();
+	for (int tileY = 0; tileY < cropped->GetNumTilesY(); tileY++)
+	{
+		for (int tileX = 0; tileX < cropped->GetNumTilesX(); tileX++)
+		{
+			tPixel4b* tile = cropped->GetTile(tileX, tileY);
+			int tileW = cropped->GetTileWidth(tileX);
+			int tileH = cropped->GetTileHeight(tileY);
+			int srcX0 = tMath::tMax(tileX*tileSize + OriginX, 0);
+			int srcX1 = tMath::tMin(tileX*tileSize + tileW + OriginX, srcW);
+			int inX0 = srcX0 - OriginX - tileX*tileSize;
+			int inX1 = srcX1 - OriginX - tileX*tileSize;
+			for (int row = 0; row < tileH; row++)
+			{
+				tPixel4b* dst = tile + row*tileW;
+				int srcY = tileY*tileSize + row + OriginY;
+				bool inside = (srcY >= 0) && (srcY < srcH) && (srcX1 > srcX0);
+				for (int x = 0; x < tileW; x++)
+					if (!inside || (x < inX0) || (x >= inX1))
+						dst[x] = FillColour;
+				if (inside)
+					store.ReadRegion(srcX0, srcY, srcX1 - srcX0, 1, dst + inX0);
+			}
+		}
+	}
+
+	return cropped;
+}
+
+
 Command::OperationFlip::OperationFlip(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -678,6 +896,49 @@ bool Command::OperationFlip::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationFlip::Plan(PlanState& state) const
+{
+	return PlanInPlace(state, PlanRate::Copy, -1, state.GetEditingBytes(state.GetFrameBytes()));
+}
+
+
+Viewer::TileStore* Command::OperationFlip::ApplyStream(Viewer::TileStore& store, const tString& scratchDir)
+{
+	tAssert(Valid);
+
+	bool horizontal = (Mode == FlipMode::Horizontal);
+	tPrintfFull("Flip | Stream Flip[horizontal:%B]\n", horizontal);
+
+	// Done in place a row at a time. Vertical flips swap a row from each end.
+	int width = store.GetWidth();
+	int height = store.GetHeight();
+	std::vector<tPixel4b> rowA(width);
+	std::vector<tPixel4b> rowB(width);
+	if (horizontal)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			store.ReadRegion(0, y, width, 1, rowA.data());
+			for (int x = 0; x < width; x++)
+				rowB[x] = rowA[width-1-x];
+			store.WriteRegion(0, y, width, 1, rowB.data());
+		}
+	}
+	else
+	{
+		for (int y = 0; y < height/2; y++)
+		{
+			store.ReadRegion(0, y, width, 1, rowA.data());
+			store.ReadRegion(0, height-1-y, width, 1, rowB.data());
+			store.WriteRegion(0, y, width, 1, rowB.data());
+			store.WriteRegion(0, height-1-y, width, 1, rowA.data());
+		}
+	}
+
+	return &store;
+}
+
+
 Command::OperationRotate::OperationRotate(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -886,6 +1147,101 @@ bool Command::OperationRotate::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationRotate::Plan(PlanState& state) const
+{
+	PlanCost cost;
+	switch (Exact)
+	{
+		case ExactMode::Zero:
+			return cost;
+
+		case ExactMode::ACW90:
+		case ExactMode::CW90:
+			state.UpdatePeak(state.GetEditingBytes(state.GetFrameBytes()));
+			cost.Pixels = state.NumPixels*2;
+			cost.Seconds = double(state.NumPixels) / (PlanRate::Copy * 1000000.0);
+			state.SetDimensions(state.Height, state.Width);
+			return cost;
+
+		case ExactMode::R180:
+			state.UpdatePeak(state.GetEditingBytes(state.GetFrameBytes()));
+			cost.Pixels = state.NumPixels*4;
+			cost.Seconds = 2.0 * double(state.NumPixels) / (PlanRate::Copy * 1000000.0);
+			return cost;
+
+		case ExactMode::Off:
+		default:
+			break;
+	};
+
+	int origW = state.Width;
+	int origH = state.Height;
+	if ((origW <= 0) || (origH <= 0))
+		return cost;
+
+	// Bounding box of the rotated picture.
+	int rotW = 0;
+	int rotH = 0;
+	Viewer::Rotator::GetRotatedSize(rotW, rotH, origW, origH, Angle);
+
+	// Without a down-filter each pixel is sampled once from a bordered copy of the source. With both filters the
+	// source is upsampled 2X in each dimension before rotating.
+	bool direct = (FilterUp == tImage::tResampleFilter::None) || (FilterDown == tImage::tResampleFilter::None);
+	int64 rotBytes = int64(rotW)*int64(rotH)*int64(sizeof(tPixel4b));
+	int64 transient = direct ? (state.GetFrameBytes() + rotBytes) : 4*(state.GetFrameBytes() + rotBytes);
+	state.UpdatePeak(state.GetEditingBytes(transient));
+	int64 srcPixels = state.NumPixels;
+	state.SetDimensions(rotW, rotH);
+	cost.Pixels = srcPixels + state.NumPixels;
+	cost.Seconds = double(state.NumPixels) / ((direct ? PlanRate::RotateDirect : PlanRate::Rotate) * 1000000.0);
+
+	if ((Mode == RotateMode::Crop) || (Mode == RotateMode::Resize))
+	{
+		// Same reduced size computation as Apply.
+		bool aspectFlip = ((origW > origH) && (rotW < rotH)) || ((origW < origH) && (rotW > rotH));
+		if (aspectFlip)
+		{
+			int tmp = origW;
+			origW = origH;
+			origH = tmp;
+		}
+
+		int dx = rotW - origW;
+		int dy = rotH - origH;
+		int newW = origW - dx;
+		int newH = origH - dy;
+		if (dx > origW/2)
+		{
+			newW = origW - origW/2;
+			newH = (newW*origH)/origW;
+		}
+		else if (dy > origH/2)
+		{
+			newH = origH - origH/2;
+			newW = (newH*origW)/origH;
+		}
+
+		PlanCost cropCost = PlanCrop(state, tMath::tMax(newW, 1), tMath::tMax(newH, 1));
+		cost.Pixels += cropCost.Pixels;
+		cost.Seconds += cropCost.Seconds;
+	}
+
+	if (Mode == RotateMode::Resize)
+	{
+		tImage::tResampleFilter filter = (FilterUp != tImage::tResampleFilter::None) ? FilterUp : tImage::tResampleFilter::Nearest;
+		int64 frameBytes = int64(origW)*int64(origH)*int64(sizeof(tPixel4b));
+		frameBytes += Viewer::Resampler::GetWorkingBytes(state.Width, state.Height, origW, origH, filter);
+		state.UpdatePeak(state.GetEditingBytes(frameBytes));
+		cost.Pixels += state.NumPixels;
+		state.SetDimensions(origW, origH);
+		cost.Pixels += state.NumPixels;
+		cost.Seconds += double(state.NumPixels) / (PlanRate::Resample * 1000000.0);
+	}
+
+	return cost;
+}
+
+
 Command::OperationLevels::OperationLevels(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -1043,6 +1399,16 @@ bool Command::OperationLevels::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationLevels::Plan(PlanState& state) const
+{
+	if ((BlackPoint == 0.0f) && (MidPoint == 0.5f) && (WhitePoint == 1.0) && (OutBlackPoint == 0.0f) && (OutWhitePoint == 1.0f))
+		return PlanCost();
+
+	// AdjustmentBegin keeps a copy of every picture.
+	return PlanInPlace(state, PlanRate::Adjust, FrameNumber, state.GetWorkingBytes());
+}
+
+
 Command::OperationContrast::OperationContrast(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -1148,6 +1514,15 @@ bool Command::OperationContrast::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationContrast::Plan(PlanState& state) const
+{
+	if (Contrast == 0.5f)
+		return PlanCost();
+
+	return PlanInPlace(state, PlanRate::Adjust, FrameNumber, state.GetWorkingBytes());
+}
+
+
 Command::OperationBrightness::OperationBrightness(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -1253,6 +1628,15 @@ bool Command::OperationBrightness::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationBrightness::Plan(PlanState& state) const
+{
+	if (Brightness == 0.5f)
+		return PlanCost();
+
+	return PlanInPlace(state, PlanRate::Adjust, FrameNumber, state.GetWorkingBytes());
+}
+
+
 Command::OperationQuantize::OperationQuantize(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -1346,6 +1730,23 @@ Command::OperationQuantize::OperationQuantize(const tString& argsStr)
 		}
 	}
 
+	// Time budget. Seconds per frame.
+	if (numArgs >= 6)
+	{
+		currArg = currArg->Next();
+		tString budgetStr = *currArg;
+		switch (Method)
+		{
+			case tImage::tQuantize::Method::Spatial:
+				if (budgetStr == "*")
+					Budget = 0.0f;
+				else
+					Budget = budgetStr.AsFloat();
+				tMath::tiClampMin(Budget, 0.0f);
+				break;
+		}
+	}
+
 	Valid = true;
 }
 
@@ -1362,8 +1763,8 @@ bool Command::OperationQuantize::Apply(Viewer::Image& image)
 			break;
 
 		case tImage::tQuantize::Method::Spatial:
-			tPrintfFull("Quantize | QuantizeSpatial[numcolours:%d exact:%B dith:%f filt:%d]\n", NumColours, CheckExact, Dither, SampFilt);
-			image.QuantizeSpatial(NumColours, CheckExact, Dither, SampFilt);
+			tPrintfFull("Quantize | QuantizeSpatial[numcolours:%d exact:%B dith:%f filt:%d budg:%f]\n", NumColours, CheckExact, Dither, SampFilt, Budget);
+			image.QuantizeSpatial(NumColours, CheckExact, Dither, SampFilt, Budget);
 			break;
 
 		case tImage::tQuantize::Method::Neu:
@@ -1381,6 +1782,37 @@ bool Command::OperationQuantize::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationQuantize::Plan(PlanState& state) const
+{
+	// The index buffer and palette for each picture are alive while it is being quantized.
+	PlanCost cost = PlanInPlace(state, PlanRate::QuantizeFast, -1, state.GetEditingBytes(state.GetFrameBytes()));
+
+	// The spatial and neu timings match the GUI estimates (ComputeApproxQuantizeDuration). The spatial estimate is
+	// single-core like the other plan rates, is capped by the budget, and is made per frame.
+	double pixels = double(state.NumPixels);
+	switch (Method)
+	{
+		case tImage::tQuantize::Method::Spatial:
+		{
+			Viewer::SpatialQuantizer::Params params;
+			params.NumColours	= NumColours;
+			params.DitherLevel	= Dither;
+			params.FilterSize	= SampFilt;
+			params.TimeBudget	= Budget;
+			float frameSeconds = Viewer::SpatialQuantizer::EstimateDuration(state.Width, state.Height, params, 1);
+			cost.Seconds = double(frameSeconds)*double(state.NumFrames);
+			break;
+		}
+
+		case tImage::tQuantize::Method::Neu:
+			cost.Seconds = (3.0*pixels*double(NumColours)) / (1024.0*1024.0*256.0);
+			break;
+	}
+
+	return cost;
+}
+
+
 Command::OperationChannel::OperationChannel(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -1488,6 +1920,12 @@ bool Command::OperationChannel::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationChannel::Plan(PlanState& state) const
+{
+	return PlanInPlace(state, PlanRate::Scan);
+}
+
+
 Command::OperationSwizzle::OperationSwizzle(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -1543,6 +1981,12 @@ bool Command::OperationSwizzle::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationSwizzle::Plan(PlanState& state) const
+{
+	return PlanInPlace(state, PlanRate::Copy);
+}
+
+
 Command::OperationExtract::OperationExtract(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -1648,6 +2092,22 @@ bool Command::OperationExtract::Apply(Viewer::Image& image)
 }
 
 
+Command::PlanCost Command::OperationExtract::Plan(PlanState& state) const
+{
+	// Each extracted frame is encoded once per output type.
+	int numExtracted = 0;
+	for (int frameNum = 0; frameNum < state.NumFrames; frameNum++)
+		if (FrameSet.Contains(frameNum))
+			numExtracted++;
+
+	state.UpdatePeak(state.GetFrameBytes());
+	PlanCost cost;
+	cost.Pixels = int64(numExtracted) * int64(state.Width) * int64(state.Height) * int64(Command::OutTypes.Count());
+	cost.Seconds = double(cost.Pixels) / (PlanRate::Encode * 1000000.0);
+	return cost;
+}
+
+
 // Post operations follow.
 
 
@@ -1854,8 +2314,17 @@ bool Command::PostOperationCombine::Apply(tList<Viewer::Image>& images)
 		{
 			case tSystem::tFileType::GIF:
 			{
-				tImage::tImageGIF gif(frames, allowStealFrames);
-				success = gif.Save(outFile, SaveParamsGIF);
+				// The spatial quantizer changes the frames, so with other types still to save it gets copies.
+				tImage::tImageGIF::SaveParams params(SaveParamsGIF);
+				tList<tImage::tFrame> copies;
+				bool copy = !allowStealFrames && (params.Method == tImage::tQuantize::Method::Spatial);
+				if (copy)
+					for (tImage::tFrame* frame = frames.First(); frame; frame = frame->Next())
+						copies.Append(new tImage::tFrame(frame->Pixels, frame->Width, frame->Height, frame->Duration));
+				tList<tImage::tFrame>& gifFrames = copy ? copies : frames;
+				Viewer::SpatialQuantizer::PrepareGIF(gifFrames, params, SaveSpatialBudgetGIF);
+				tImage::tImageGIF gif(gifFrames, allowStealFrames || copy);
+				success = gif.Save(outFile, params);
 				break;
 			}
 
@@ -1898,6 +2367,28 @@ bool Command::PostOperationCombine::Apply(tList<Viewer::Image>& images)
 }
 
 
+Command::PlanCost Command::PostOperationCombine::Plan(const tList<Viewer::Image>& images, int64& peakBytes) const
+{
+	// Every input picture is loaded in turn and its pixels are kept for the output frames.
+	PlanCost cost;
+	int64 framesBytes = 0;
+	for (const Viewer::Image* img = images.First(); img; img = img->Next())
+	{
+		int64 area = int64(img->Cached_PrimaryWidth) * int64(img->Cached_PrimaryHeight);
+		int64 loadBytes = tMath::tMax(img->Cached_NumPixels, area) * int64(sizeof(tPixel4b));
+		peakBytes = tMath::tMax(peakBytes, framesBytes + loadBytes + int64(img->FileSizeB));
+		framesBytes += area * int64(sizeof(tPixel4b));
+		cost.Pixels += tMath::tMax(img->Cached_NumPixels, area);
+		cost.Seconds += double(tMath::tMax(img->Cached_NumPixels, area)) / (PlanRate::Decode * 1000000.0);
+	}
+
+	int64 outPixels = framesBytes / int64(sizeof(tPixel4b));
+	cost.Pixels += outPixels * int64(Command::OutTypes.Count());
+	cost.Seconds += double(outPixels * int64(Command::OutTypes.Count())) / (PlanRate::Encode * 1000000.0);
+	return cost;
+}
+
+
 Command::PostOperationContact::PostOperationContact(const tString& argsStr)
 {
 	tList<tStringItem> args;
@@ -1961,29 +2452,10 @@ Command::PostOperationContact::PostOperationContact(const tString& argsStr)
 }
 
 
-bool Command::PostOperationContact::Apply(tList<Viewer::Image>& images)
+void Command::PostOperationContact::GetColumnsRows(int numImages, int& cols, int& rows) const
 {
-	tAssert(Valid);
-	bool anyOutTypesSupportSave = false;
-	for (tSystem::tFileTypes::tFileTypeItem* typeItem = OutTypes.First(); typeItem; typeItem = typeItem->Next())
-	{
-		tSystem::tFileType outType = typeItem->FileType;
-		if (Viewer::FileTypes_Save.Contains(outType))
-		{
-			anyOutTypesSupportSave = true;
-			break;
-		}
-	}
-	if (!anyOutTypesSupportSave)
-	{
-		tPrintfNorm("Contact | No output filetypes support save.\n");
-		return false;
-	}
-
-	// If columns or rows (or both) are 0 we need to compute them based on the total number of images.
-	int numImages = images.GetNumItems();
-	int rows = Rows;
-	int cols = Columns;
+	rows = Rows;
+	cols = Columns;
 	if ((cols <= 0) && (rows <= 0))
 	{
 		float root = tMath::tSqrt(float(numImages));
@@ -2008,6 +2480,33 @@ bool Command::PostOperationContact::Apply(tList<Viewer::Image>& images)
 			rows++;
 		tAssert(cols*rows >= numImages);
 	}
+}
+
+
+bool Command::PostOperationContact::Apply(tList<Viewer::Image>& images)
+{
+	tAssert(Valid);
+	bool anyOutTypesSupportSave = false;
+	for (tSystem::tFileTypes::tFileTypeItem* typeItem = OutTypes.First(); typeItem; typeItem = typeItem->Next())
+	{
+		tSystem::tFileType outType = typeItem->FileType;
+		if (Viewer::FileTypes_Save.Contains(outType))
+		{
+			anyOutTypesSupportSave = true;
+			break;
+		}
+	}
+	if (!anyOutTypesSupportSave)
+	{
+		tPrintfNorm("Contact | No output filetypes support save.\n");
+		return false;
+	}
+
+	// If columns or rows (or both) are 0 we need to compute them based on the total number of images.
+	int numImages = images.GetNumItems();
+	int rows = 0;
+	int cols = 0;
+	GetColumnsRows(numImages, cols, rows);
 
 	if (cols*rows < numImages)
 		tPrintfFull("Warning: %dx%d contact pages is not enough for %d images.\n", cols, rows, numImages);
@@ -2168,8 +2667,13 @@ bool Command::PostOperationContact::Apply(tList<Viewer::Image>& images)
 
 			case tSystem::tFileType::GIF:
 			{
-				tImage::tImageGIF gif(outPic, allowStealFrames);
-				success = gif.Save(outFile, SaveParamsGIF);
+				// The spatial quantizer works on a copy so any other types still to save get the sheet unchanged.
+				tImage::tImageGIF::SaveParams params(SaveParamsGIF);
+				tList<tImage::tFrame> frames;
+				frames.Append(new tImage::tFrame(outPic.GetPixels(), outPic.GetWidth(), outPic.GetHeight(), outPic.Duration));
+				Viewer::SpatialQuantizer::PrepareGIF(frames, params, SaveSpatialBudgetGIF);
+				tImage::tImageGIF gif(frames, true);
+				success = gif.Save(outFile, params);
 				break;
 			}
 
@@ -2227,3 +2731,31 @@ bool Command::PostOperationContact::Apply(tList<Viewer::Image>& images)
 
 	return !somethingFailed;
 }
+
+
+Command::PlanCost Command::PostOperationContact::Plan(const tList<Viewer::Image>& images, int64& peakBytes) const
+{
+	PlanCost cost;
+	const Viewer::Image* firstImage = images.First();
+	if (!firstImage)
+		return cost;
+
+	int cols = 0;
+	int rows = 0;
+	GetColumnsRows(images.GetNumItems(), cols, rows);
+	int64 outPixels = int64(firstImage->Cached_PrimaryWidth) * int64(firstImage->Cached_PrimaryHeight) * int64(cols) * int64(rows);
+
+	// The contact sheet stays allocated while each input is loaded and copied into it.
+	for (const Viewer::Image* img = images.First(); img; img = img->Next())
+	{
+		int64 area = int64(img->Cached_PrimaryWidth) * int64(img->Cached_PrimaryHeight);
+		int64 loadPixels = tMath::tMax(img->Cached_NumPixels, area);
+		peakBytes = tMath::tMax(peakBytes, (outPixels + loadPixels)*int64(sizeof(tPixel4b)) + int64(img->FileSizeB));
+		cost.Pixels += loadPixels + area;
+		cost.Seconds += double(loadPixels) / (PlanRate::Decode * 1000000.0) + double(area) / (PlanRate::Copy * 1000000.0);
+	}
+
+	cost.Pixels += outPixels * int64(Command::OutTypes.Count());
+	cost.Seconds += double(outPixels * int64(Command::OutTypes.Count())) / (PlanRate::Encode * 1000000.0);
+	return cost;
+}
@@ -21,14 +21,76 @@
 #include <Image/tPicture.h>
 #include <Image/tQuantize.h>
 #include "Image.h"
+#include "TileStore.h"
 namespace Command
 {
 
 
+// Used by --plan to walk the operations without loading any pixel data. Starts out with the probed input image and
+// each operation updates it to what Apply would produce.
+struct PlanState
+{
+	int Width											= 0;
+	int Height											= 0;
+	int NumFrames										= 1;
+	int64 NumPixels										= 0;		// Over all frames.
+	int64 PeakBytes										= 0;
+	bool Exact											= true;		// False if a result depends on pixel content.
+
+	int64 GetFrameBytes() const							{ return int64(Width)*int64(Height)*int64(sizeof(tPixel4b)); }
+	int64 GetWorkingBytes() const						{ return NumPixels*int64(sizeof(tPixel4b)); }
+
+	// Call with any extra bytes an operation allocates while the current working set is still alive.
+	void UpdatePeak(int64 transientBytes = 0)			{ PeakBytes = tMath::tMax(PeakBytes, GetWorkingBytes() + transientBytes); }
+
+	// Frames are edited at the same time, as many as Image::MaxEditFrames allows or one per work pool thread. Each has
+	// its own transient buffers, so per-frame bytes are multiplied by this.
+	int GetFramesAtOnce() const							{ return tMath::tMax(tMath::tMin(NumFrames, (Viewer::Image::MaxEditFrames > 0) ? Viewer::Image::MaxEditFrames : Viewer::WorkPool::GetNumThreads()), 1); }
+	int64 GetEditingBytes(int64 bytesPerFrame) const	{ return bytesPerFrame*int64(GetFramesAtOnce()); }
+
+	// All frames are resampled/cropped to the same dimensions.
+	void SetDimensions(int width, int height)			{ Width = width; Height = height; NumPixels = int64(width)*int64(height)*int64(NumFrames); }
+};
+
+
+struct PlanCost
+{
+	int64 Pixels										= 0;		// Pixels read or written.
+	double Seconds										= 0.0;
+};
+
+
+// Single-core throughput in megapixels per second used by --plan. These are rough figures for 8-bit RGBA pictures in
+// release builds. They are good enough for choosing a machine size and job concurrency, not for exact prediction.
+namespace PlanRate
+{
+	constexpr double Decode								= 60.0;		// Average over the common input types.
+	constexpr double Encode								= 30.0;		// Per output type.
+	constexpr double Copy								= 400.0;	// Crop, canvas, aspect, flip, swizzle.
+	constexpr double Scan								= 300.0;	// Deborder, channel.
+	constexpr double Resample							= 40.0;		// Per destination pixel.
+	constexpr double Rotate								= 12.0;		// Per destination pixel, includes up/down filtering.
+	constexpr double RotateDirect						= 40.0;		// Per destination pixel, sampled once. Bilinear.
+	constexpr double Adjust								= 80.0;		// Levels, contrast, brightness.
+	constexpr double QuantizeFast						= 25.0;		// Fixed and Wu.
+}
+
+
 // Normal operations that are applied to single images.
 struct Operation : public tLink<Operation>
 {
 	virtual bool Apply(Viewer::Image&)					= 0;
+
+	// Updates the state to what Apply would produce and returns the estimated cost. Does not touch any pixels.
+	virtual PlanCost Plan(PlanState&) const				= 0;
+
+	// Out-of-core version of Apply used by --stream. The store holds a single picture. Returns the result, which is
+	// either the same store edited in place or a new one made in scratchDir, or null on failure. Only operations that
+	// can work a band of rows at a time override these.
+	virtual bool CanStream() const						{ return false; }
+	virtual Viewer::TileStore* ApplyStream(Viewer::TileStore&, const tString& scratchDir)							{ return nullptr; }
+
+	virtual const char* GetName() const					= 0;
 	virtual ~Operation()								{ }
 	bool Valid											= false;
 };
@@ -43,6 +105,8 @@ struct OperationPixel : public Operation
 	comp_t Channels										= tCompBit_RGBA;							// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "pixel"; }
 };
 
 
@@ -55,6 +119,8 @@ struct OperationResize : public Operation
 	tImage::tResampleEdgeMode EdgeMode					= tImage::tResampleEdgeMode::Clamp;			// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "resize"; }
 };
 
 
@@ -69,6 +135,8 @@ struct OperationCanvas : public Operation
 	int AnchorY											= -1;										// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "canvas"; }
 };
 
 
@@ -85,6 +153,8 @@ struct OperationAspect : public Operation
 	int AnchorY											= -1;										// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "aspect"; }
 };
 
 
@@ -96,6 +166,8 @@ struct OperationDeborder : public Operation
 	comp_t Channels										= tCompBit_RGBA;								// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "deborder"; }
 };
 
 
@@ -111,6 +183,10 @@ struct OperationCrop : public Operation
 	tColour4b FillColour								= tColour4b::transparent;					// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	bool CanStream() const override						{ return true; }
+	Viewer::TileStore* ApplyStream(Viewer::TileStore&, const tString& scratchDir) override;
+	const char* GetName() const override				{ return "crop"; }
 };
 
 
@@ -121,6 +197,10 @@ struct OperationFlip : public Operation
 	FlipMode Mode										= FlipMode::Horizontal;						// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	bool CanStream() const override						{ return true; }
+	Viewer::TileStore* ApplyStream(Viewer::TileStore&, const tString& scratchDir) override;
+	const char* GetName() const override				{ return "flip"; }
 };
 
 
@@ -138,12 +218,14 @@ struct OperationRotate : public Operation
 	// UpFilter		DownFilter		Description
 	// None			NA				No up/down scaling. Preserves colours. Nearest Neighbour. Fast. Good for pixel art.
 	// Valid		Valid			Up/down scaling. Smooth. Good results with up=bilinear, down=box.
-	// Valid		None			Up/down scaling. Use alternate (sharper) downscaling scheme (possibe pad + 2X ScaleHalf).
+	// Valid		None			Each pixel sampled once with the up filter (bilinear or bicubic). Sharp and fast.
 	tImage::tResampleFilter FilterUp					= tImage::tResampleFilter::Bilinear;		// Optional.
 	tImage::tResampleFilter FilterDown					= tImage::tResampleFilter::None;			// Optional.
 	tColour4b FillColour								= tColour4b::black;							// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "rotate"; }
 };
 
 
@@ -160,6 +242,8 @@ struct OperationLevels : public Operation
 	bool PowerMidGamma									= true;
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "levels"; }
 };
 
 
@@ -171,6 +255,8 @@ struct OperationContrast : public Operation
 	Viewer::Image::AdjChan Channels						= Viewer::Image::AdjChan::RGB;
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "contrast"; }
 };
 
 
@@ -182,6 +268,8 @@ struct OperationBrightness : public Operation
 	Viewer::Image::AdjChan Channels						= Viewer::Image::AdjChan::RGB;
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "brightness"; }
 };
 
 
@@ -193,8 +281,11 @@ struct OperationQuantize : public Operation
 	bool CheckExact										= true;							// Optional.
 	int SampFilt										= 0;							// Optional. 0 is invalid.
 	double Dither										= 0.0;							// Optional, 0.0 is auto.
+	float Budget										= 0.0f;							// Optional, 0.0 is no limit.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "quantize"; }
 };
 
 
@@ -222,6 +313,8 @@ struct OperationChannel : public Operation
 	tColour4b Colour									= tColour4b::black;				// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "channel"; }
 };
 
 
@@ -235,6 +328,8 @@ struct OperationSwizzle : public Operation
 	tComp SwizzleA										= tComp::A;						// Optional.
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "swizzle"; }
 
 private:
 	tComp CharToComp(char);
@@ -250,6 +345,8 @@ struct OperationExtract : public Operation
 	tString BaseName;
 
 	bool Apply(Viewer::Image&) override;
+	PlanCost Plan(PlanState&) const override;
+	const char* GetName() const override				{ return "extract"; }
 };
 
 
@@ -257,6 +354,9 @@ struct OperationExtract : public Operation
 struct PostOperation : public tLink<PostOperation>
 {
 	virtual bool Apply(tList<Viewer::Image>&)			= 0;
+
+	// The images must have been probed. Updates peakBytes if the post operation needs more than it.
+	virtual PlanCost Plan(const tList<Viewer::Image>&, int64& peakBytes) const = 0;
 	virtual const char* GetName() const					= 0;
 	virtual ~PostOperation()							{ }
 	bool Valid											= false;
@@ -278,6 +378,7 @@ struct PostOperationCombine : public PostOperation
 
 	float GetFrameDuration(int frameNum) const;			// In seconds. Defaults to 33.0f/1000.0f.
 	bool Apply(tList<Viewer::Image>& images) override;
+	PlanCost Plan(const tList<Viewer::Image>& images, int64& peakBytes) const override;
 	const char* GetName() const override				{ return "combine"; }
 };
 
@@ -292,7 +393,10 @@ struct PostOperationContact : public PostOperation
 	tString SubFolder;									// Relative to the current dir.
 	tString BaseName;
 
+	// If Columns or Rows (or both) are 0 they are computed from the number of images.
+	void GetColumnsRows(int numImages, int& cols, int& rows) const;
 	bool Apply(tList<Viewer::Image>& images) override;
+	PlanCost Plan(const tList<Viewer::Image>& images, int64& peakBytes) const override;
 	const char* GetName() const override				{ return "contact"; }
 };
 
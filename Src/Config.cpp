@@ -395,6 +395,7 @@ void Config::ProfileData::Reset(Viewer::Profile profile, uint32 categories)
 		SaveFileGifDitherLevel		= 0.0f;
 		SaveFileGifFilterSize		= 1;
 		SaveFileGifSampleFactor		= 1;
+		SaveFileGifSpatialBudget	= 0.0f;
 		SaveFileWebpDurOverride		= -1;
 		SaveFileGifDurOverride		= -1;
 		SaveFileApngDurOverride		= -1;
@@ -461,11 +462,15 @@ void Config::ProfileData::Reset(Viewer::Profile profile, uint32 categories)
 	if (categories & Category_System)
 	{
 		MaxImageMemMB				= 2048;
+		MaxTextureMemMB				= 1024;
+		MaxUndoMemMB				= 1024;
 		MaxCacheFiles				= 8192;
 		MaxUndoSteps				= 16;
+		MaxEditFrames				= 0;
 		StrictLoading				= false;
 		MetaDataOrientLoading		= true;
 		DetectAPNGInsidePNG			= true;
+		KeepBlockCompressed			= false;
 		MipmapFilter				= int(tImage::tResampleFilter::Bilinear);
 		MipmapChaining				= true;
 		MonitorGamma				= tMath::fDefaultGamma;
@@ -590,6 +595,7 @@ void Config::ProfileData::Load(tExpression expr)
 			ReadItem(SaveFileGifDitherLevel);
 			ReadItem(SaveFileGifFilterSize);
 			ReadItem(SaveFileGifSampleFactor);
+			ReadItem(SaveFileGifSpatialBudget);
 
 			ReadItem(SaveFileWebpDurOverride);
 			ReadItem(SaveFileGifDurOverride);
@@ -631,11 +637,15 @@ void Config::ProfileData::Load(tExpression expr)
 			ReadItem(ResizeAspectUserDen);
 			ReadItem(ResizeAspectMode);
 			ReadItem(MaxImageMemMB);
+			ReadItem(MaxTextureMemMB);
+			ReadItem(MaxUndoMemMB);
 			ReadItem(MaxCacheFiles);
 			ReadItem(MaxUndoSteps);
+			ReadItem(MaxEditFrames);
 			ReadItem(StrictLoading);
 			ReadItem(MetaDataOrientLoading);
 			ReadItem(DetectAPNGInsidePNG);
+			ReadItem(KeepBlockCompressed);
 			ReadItem(MipmapFilter);
 			ReadItem(MipmapChaining);
 			ReadItem(AutoPropertyWindow);
@@ -677,8 +687,11 @@ void Config::ProfileData::Load(tExpression expr)
 	tiClamp		(ResizeAspectUserDen, 1, 99);
 	tiClamp		(ResizeAspectMode, 0, 1);
 	tiClampMin	(MaxImageMemMB, 256);
+	tiClampMin	(MaxTextureMemMB, 128);
+	tiClampMin	(MaxUndoMemMB, 64);
 	tiClampMin	(MaxCacheFiles, 200);	
 	tiClamp		(MaxUndoSteps, 1, 32);
+	tiClamp		(MaxEditFrames, 0, 256);
 	tiClamp		(MipmapFilter, 0, int(tImage::tResampleFilter::NumFilters));						// None allowed.
 
 	tiClamp		(SaveAllSizeMode, 0, int(SizeModeEnum::NumModes)-1);
@@ -696,6 +709,7 @@ void Config::ProfileData::Load(tExpression expr)
 	tiClampMin	(SaveFileGifDitherLevel, 0.0f);
 	tiClamp		(SaveFileGifFilterSize, 0, 2);
 	tiClamp		(SaveFileGifSampleFactor, 1, 10);
+	tiClampMin	(SaveFileGifSpatialBudget, 0.0f);
 
 	tiClampMin	(SaveFileWebpDurOverride, -1);
 	tiClampMin	(SaveFileGifDurOverride, -1);
@@ -792,6 +806,7 @@ bool Config::ProfileData::Save(tExprWriter& writer) const
 	WriteItem(SaveFileGifDitherLevel);
 	WriteItem(SaveFileGifFilterSize);
 	WriteItem(SaveFileGifSampleFactor);
+	WriteItem(SaveFileGifSpatialBudget);
 
 	WriteItem(SaveFileWebpDurOverride);
 	WriteItem(SaveFileGifDurOverride);
@@ -831,11 +846,15 @@ bool Config::ProfileData::Save(tExprWriter& writer) const
 	WriteItem(ResizeAspectUserDen);
 	WriteItem(ResizeAspectMode);
 	WriteItem(MaxImageMemMB);
+	WriteItem(MaxTextureMemMB);
+	WriteItem(MaxUndoMemMB);
 	WriteItem(MaxCacheFiles);
 	WriteItem(MaxUndoSteps);
+	WriteItem(MaxEditFrames);
 	WriteItem(StrictLoading);
 	WriteItem(MetaDataOrientLoading);
 	WriteItem(DetectAPNGInsidePNG);
+	WriteItem(KeepBlockCompressed);
 	WriteItem(MipmapFilter);
 	WriteItem(MipmapChaining);
 	WriteItem(AutoPropertyWindow);
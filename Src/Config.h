@@ -243,6 +243,7 @@ struct ProfileData
 	float	SaveFileGifDitherLevel;							// E [0.0f, inf]
 	int		SaveFileGifFilterSize;							// E [0, 2] Maps to 1, 3, 5.
 	int		SaveFileGifSampleFactor;						// E [1, 10]
+	float	SaveFileGifSpatialBudget;						// E [0.0f, inf]. In seconds per frame. 0 means no limit.
 
 	int		SaveFileWebpDurOverride;						// E [-1, inf]. In ms.
 	int		SaveFileGifDurOverride;							// E [-1, inf]. In 1/100 seconds.
@@ -301,12 +302,16 @@ struct ProfileData
 	float GetResizeAspectRatioFloat() const					{ tImage::tAspectRatio aspect = GetResizeAspectRatio(); return (aspect == tImage::tAspectRatio::User) ? float(ResizeAspectUserNum) / float(ResizeAspectUserDen) : tImage::tGetAspectRatioFloat(aspect); }
 	int ResizeAspectMode;									// 0 = Crop Mode. 1 = Letterbox Mode.
 
-	int MaxImageMemMB;										// Max image mem before unloading images.
+	int MaxImageMemMB;										// Max image mem (pictures and alt pictures) before unloading images.
+	int MaxTextureMemMB;									// Max VRAM for image textures before unbinding least recently used.
+	int MaxUndoMemMB;										// Max undo mem over all images before dropping oldest steps.
 	int MaxCacheFiles;										// Max number of cache files before removing oldest.
 	int MaxUndoSteps;
+	int MaxEditFrames;										// Max frames edited at the same time. Zero for one per core.
 	bool StrictLoading;										// No attempt to display ill-formed images.
 	bool MetaDataOrientLoading;								// Reorient images on load if Exif or other meta-data contains orientation information.
 	bool DetectAPNGInsidePNG;								// Look for APNG data (animated) hidden inside a regular PNG file.
+	bool KeepBlockCompressed;								// Keep BCn dds/ktx/pvr files compressed in memory and VRAM. Decode only when pixels are needed.
 	int MipmapFilter;										// Matches tImage::tResampleFilter. Use None for no mipmaps.
 	bool MipmapChaining;									// True for faster mipmap generation. False for a lot slower and slightly better results.
 	bool AutoPropertyWindow;								// Auto display property editor window for supported file types.
@@ -19,6 +19,7 @@
 #include "TacentView.h"
 #include "GuiUtil.h"
 #include "Image.h"
+#include "Resampler.h"
 namespace Viewer { extern void DoFillColourInterface(const char* = nullptr, bool = false); }
 using namespace tStd;
 using namespace tMath;
@@ -45,12 +46,24 @@ bool Viewer::AnyImageNeedsResize(int frameWidth, int frameHeight)
 	bool anyImageNeedsResize = false;
 	for (Image* checkImg = Images.First(); checkImg; checkImg = checkImg->Next())
 	{
-		if (!checkImg->IsLoaded())
-			checkImg->Load();
-		if (!checkImg->IsLoaded())
-			continue;
-		
-		if ((checkImg->GetWidth() != frameWidth) || (checkImg->GetHeight() != frameHeight))
+		// Probing only reads the header. We only fall back to a full load if the header couldn't be parsed.
+		int width = 0; int height = 0;
+		if (!checkImg->IsLoaded() && (checkImg->Probe() == Image::ProbeResult::Success))
+		{
+			width = checkImg->Cached_PrimaryWidth;
+			height = checkImg->Cached_PrimaryHeight;
+		}
+		else
+		{
+			if (!checkImg->IsLoaded())
+				checkImg->Load();
+			if (!checkImg->IsLoaded())
+				continue;
+			width = checkImg->GetWidth();
+			height = checkImg->GetHeight();
+		}
+
+		if ((width != frameWidth) || (height != frameHeight))
 		{
 			anyImageNeedsResize = true;
 			break;
@@ -364,7 +377,7 @@ void Viewer::SaveContactSheetTo
 		if ((currImg->GetWidth() != frameWidth) || (currImg->GetHeight() != frameHeight))
 		{
 			resampled.Set(*currPic);
-			resampled.Resample(frameWidth, frameHeight, tImage::tResampleFilter(profile.ResampleFilterContactFrame), tImage::tResampleEdgeMode(profile.ResampleEdgeModeContactFrame));
+			Resampler::Resample(resampled, frameWidth, frameHeight, tImage::tResampleFilter(profile.ResampleFilterContactFrame), tImage::tResampleEdgeMode(profile.ResampleEdgeModeContactFrame));
 		}
 		else
 		{
@@ -402,7 +415,7 @@ void Viewer::SaveContactSheetTo
 	else
 	{
 		tImage::tPicture finalResampled(outPic);
-		finalResampled.Resample(finalWidth, finalHeight, tImage::tResampleFilter(profile.ResampleFilterContactFinal), tImage::tResampleEdgeMode(profile.ResampleEdgeModeContactFinal));
+		Resampler::Resample(finalResampled, finalWidth, finalHeight, tImage::tResampleFilter(profile.ResampleFilterContactFinal), tImage::tResampleEdgeMode(profile.ResampleEdgeModeContactFinal));
 		SavePictureAs(finalResampled, outFile, saveFileType, true);
 	}
 
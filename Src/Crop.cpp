@@ -22,6 +22,7 @@
 #include "Crop.h"
 #include "TacentView.h"
 #include "Image.h"
+#include "Renderer.h"
 using namespace tMath;
 
 
@@ -674,27 +675,22 @@ void Viewer::CropWidget::DrawMatt(const tVector4& imext, const tVector2& uvoffse
 	tVector2 tr;
 	ConvertImagePosToScreenPos(tr, maxX, maxY, imext, uvoffset);	
 
-	glColor4f(ColourClear.x, ColourClear.y, ColourClear.z, 0.75f);
-
-	// Imagine a picture frame with mitre cuts at each corner.
-	glBegin(GL_QUAD_STRIP);
-	glVertex2f(imext.L, imext.B);
-	glVertex2f(bl.x, bl.y);
-	glVertex2f(imext.R, imext.B);
-	glVertex2f(tr.x, bl.y);
-	glVertex2f(imext.R, imext.T);
-	glVertex2f(tr.x, tr.y);
-	glVertex2f(imext.L, imext.T);
-	glVertex2f(bl.x, tr.y);
-	glVertex2f(imext.L, imext.B);
-	glVertex2f(bl.x, bl.y);
-	glEnd();
+	tColour4f col(ColourClear.x, ColourClear.y, ColourClear.z, 0.75f);
+
+	// Imagine a picture frame with mitre cuts at each corner. Each side is a trapezoid made of two triangles.
+	tVector2 outer[4] = { tVector2(imext.L, imext.B), tVector2(imext.R, imext.B), tVector2(imext.R, imext.T), tVector2(imext.L, imext.T) };
+	tVector2 inner[4] = { tVector2(bl.x, bl.y), tVector2(tr.x, bl.y), tVector2(tr.x, tr.y), tVector2(bl.x, tr.y) };
+	for (int side = 0; side < 4; side++)
+	{
+		int next = (side + 1) % 4;
+		Renderer::DrawTriangle(outer[side].x, outer[side].y, inner[side].x, inner[side].y, outer[next].x, outer[next].y, col);
+		Renderer::DrawTriangle(inner[side].x, inner[side].y, inner[next].x, inner[next].y, outer[next].x, outer[next].y, col);
+	}
 }
 
 
 void Viewer::CropWidget::DrawLines()
 {
-	glColor4fv(tColour4f::white.E);
 	float l = (LineL.GetScreenVal());
 	float r = (LineR.GetScreenVal()) - 1.0f;
 	float b = (LineB.GetScreenVal());
@@ -702,34 +698,13 @@ void Viewer::CropWidget::DrawLines()
 	float v = (LineV.GetScreenVal());
 	float h = (LineH.GetScreenVal());
 	bool anyPressed = LineL.Pressed || LineR.Pressed || LineB.Pressed || LineT.Pressed || LineV.Pressed || LineH.Pressed;
-	glBegin(GL_LINES);
-
-	glColor4fv((!anyPressed && LineB.Hovered) || LineB.Pressed ? CropHovCol.E : CropCol.E);
-	glVertex2f(l,	b);
-	glVertex2f(r,	b);
-
-	glColor4fv((!anyPressed && LineR.Hovered) || LineR.Pressed ? CropHovCol.E : CropCol.E);
-	glVertex2f(r,	b);
-	glVertex2f(r,	t);
 
-	glColor4fv((!anyPressed && LineT.Hovered) || LineT.Pressed ? CropHovCol.E : CropCol.E);
-	glVertex2f(r,	t);
-	glVertex2f(l,	t);
-
-	glColor4fv((!anyPressed && LineL.Hovered) || LineL.Pressed ? CropHovCol.E : CropCol.E);
-	glVertex2f(l,	t);
-	glVertex2f(l,	b);
-
-	glColor4fv((!anyPressed && LineV.Hovered) || LineV.Pressed ? CropHovCol.E : CropCol.E);
-	glVertex2f(v,	t);
-	glVertex2f(v,	b);
-
-	glColor4fv((!anyPressed && LineH.Hovered) || LineH.Pressed ? CropHovCol.E : CropCol.E);
-	glVertex2f(l,	h);
-	glVertex2f(r,	h);
-
-	glColor4fv(tColour4f::white.E);
-	glEnd();
+	Renderer::DrawLine(l, b, r, b, (!anyPressed && LineB.Hovered) || LineB.Pressed ? CropHovCol : CropCol);
+	Renderer::DrawLine(r, b, r, t, (!anyPressed && LineR.Hovered) || LineR.Pressed ? CropHovCol : CropCol);
+	Renderer::DrawLine(r, t, l, t, (!anyPressed && LineT.Hovered) || LineT.Pressed ? CropHovCol : CropCol);
+	Renderer::DrawLine(l, t, l, b, (!anyPressed && LineL.Hovered) || LineL.Pressed ? CropHovCol : CropCol);
+	Renderer::DrawLine(v, t, v, b, (!anyPressed && LineV.Hovered) || LineV.Pressed ? CropHovCol : CropCol);
+	Renderer::DrawLine(l, h, r, h, (!anyPressed && LineH.Hovered) || LineH.Pressed ? CropHovCol : CropCol);
 }
 
 
@@ -743,100 +718,61 @@ void Viewer::CropWidget::DrawHandles()
 	float v = (b+t)/2.0f;
 	bool anyPressed = LineL.Pressed || LineR.Pressed || LineB.Pressed || LineT.Pressed;
 	tColour4f col;
-	glBegin(GL_QUADS);
 
 	// TL
 	col		= CropCol;
 	if		(LastSelectedHandle == Anchor::TL)														col = CropSelCol;
 	else if	((!anyPressed && LineL.Hovered && LineT.Hovered) || (LineL.Pressed && LineT.Pressed))	col = CropHovCol;
-	glColor4fv(col.E);
-	glVertex2f(l-4,		t-4);
-	glVertex2f(l+4,		t-4);
-	glVertex2f(l+4,		t+4);
-	glVertex2f(l-4,		t+4);
+	Renderer::DrawQuad(l-4, t-4, l+4, t+4, col);
 
 	// TM
 	col		= CropCol;
 	if		(LastSelectedHandle == Anchor::TM)														col = CropSelCol;
 	else if ((!anyPressed && LineT.Hovered && !LineL.Hovered && !LineR.Hovered) || LineT.Pressed)	col = CropHovCol;
-	glColor4fv(col.E);
-	glVertex2f(h-4,		t-4);
-	glVertex2f(h+4,		t-4);
-	glVertex2f(h+4,		t+4);
-	glVertex2f(h-4,		t+4);
+	Renderer::DrawQuad(h-4, t-4, h+4, t+4, col);
 
 	// TR
 	col		= CropCol;
 	if		(LastSelectedHandle == Anchor::TR)														col = CropSelCol;
 	else if	((!anyPressed && LineR.Hovered && LineT.Hovered) || (LineR.Pressed && LineT.Pressed))	col = CropHovCol;
-	glColor4fv(col.E);
-	glVertex2f(r-4,		t-4);
-	glVertex2f(r+4,		t-4);
-	glVertex2f(r+4,		t+4);
-	glVertex2f(r-4,		t+4);
+	Renderer::DrawQuad(r-4, t-4, r+4, t+4, col);
 
 	// ML
 	col		= CropCol;
 	if		(LastSelectedHandle == Anchor::ML)														col = CropSelCol;
 	else if	((!anyPressed && LineL.Hovered && !LineT.Hovered && !LineB.Hovered) || LineL.Pressed)	col = CropHovCol;
-	glColor4fv(col.E);
-	glVertex2f(l-4,		v-4);
-	glVertex2f(l+4,		v-4);
-	glVertex2f(l+4,		v+4);
-	glVertex2f(l-4,		v+4);
+	Renderer::DrawQuad(l-4, v-4, l+4, v+4, col);
 
 	// MR
 	col		= CropCol;
 	if		(LastSelectedHandle == Anchor::MR)														col = CropSelCol;
 	else if	((!anyPressed && LineR.Hovered && !LineT.Hovered && !LineB.Hovered) || LineR.Pressed)	col = CropHovCol;
-	glColor4fv(col.E);
-	glVertex2f(r-4,		v-4);
-	glVertex2f(r+4,		v-4);
-	glVertex2f(r+4,		v+4);
-	glVertex2f(r-4,		v+4);
+	Renderer::DrawQuad(r-4, v-4, r+4, v+4, col);
 
 	// BL
 	col		= CropCol;
 	if		(LastSelectedHandle == Anchor::BL)														col = CropSelCol;
 	else if ((!anyPressed && LineL.Hovered && LineB.Hovered) || (LineL.Pressed && LineB.Pressed))	col = CropHovCol;
-	glColor4fv(col.E);
-	glVertex2f(l-4,		b-4);
-	glVertex2f(l+4,		b-4);
-	glVertex2f(l+4,		b+4);
-	glVertex2f(l-4,		b+4);
+	Renderer::DrawQuad(l-4, b-4, l+4, b+4, col);
 
 	// BM
 	col		= CropCol;
 	if		(LastSelectedHandle == Anchor::BM)														col = CropSelCol;
 	else if ((!anyPressed && LineB.Hovered && !LineL.Hovered && !LineR.Hovered) || LineB.Pressed)	col = CropHovCol;
-	glColor4fv(col.E);
-	glVertex2f(h-4,		b-4);
-	glVertex2f(h+4,		b-4);
-	glVertex2f(h+4,		b+4);
-	glVertex2f(h-4,		b+4);
+	Renderer::DrawQuad(h-4, b-4, h+4, b+4, col);
 
 	// BR
 	col		= CropCol;
 	if		(LastSelectedHandle == Anchor::BR)														col = CropSelCol;
 	else if	((!anyPressed && LineR.Hovered && LineB.Hovered) || (LineR.Pressed && LineB.Pressed))	col = CropHovCol;
-	glColor4fv(col.E);
-	glVertex2f(r-4,		b-4);
-	glVertex2f(r+4,		b-4);
-	glVertex2f(r+4,		b+4);
-	glVertex2f(r-4,		b+4);
+	Renderer::DrawQuad(r-4, b-4, r+4, b+4, col);
 
 	// MM
 	col		= CropCol;
 	if		(LastSelectedHandle == Anchor::MM)														col = CropSelCol;
 	else if	((!anyPressed && LineV.Hovered && LineH.Hovered) || (LineV.Pressed && LineH.Pressed))	col = CropHovCol;
-	glColor4fv(col.E);
-	glVertex2f(h-4,		v-4);
-	glVertex2f(h+4,		v-4);
-	glVertex2f(h+4,		v+4);
-	glVertex2f(h-4,		v+4);
-
-	glColor4fv(tColour4f::white.E);
-	glEnd();
+	Renderer::DrawQuad(h-4, v-4, h+4, v+4, col);
+
 }
 
 
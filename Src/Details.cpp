@@ -162,7 +162,7 @@ void Viewer::ShowImageDetailsOverlay(bool* popen, float x, float y, float w, flo
 					case Image::ImgInfo::OpacityEnum::Varies:	ImGui::Text("Opaque: Varies");	Gutil::ToolTip("Varies means there is more than one frame/mipmap/page/side\nand they don't all match. This is likely not what you want\nbut is reasonable for, say, pages in a tiff.");	break;
 				}
 				ImGui::Text("Frames: %d", CurrImage->GetNumFrames());
-				tString sizeStr; tsPrintf(sizeStr, "File Size: %'d", info.FileSizeBytes);
+				tString sizeStr; tsPrintf(sizeStr, "File Size: %'|64d", info.FileSizeBytes);
 				ImGui::Text(sizeStr.Chr());
 				ImGui::Text("Cursor: (%d, %d)", cursorX, cursorY);
 				ImGui::Text("Pan: (%d, %d)", GetPanX(), GetPanY());
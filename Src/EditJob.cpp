@@ -0,0 +1,265 @@
+// EditJob.cpp
+//
+// Runs long image edits like quantize, rotate, and resample off the UI thread. The pictures of the image are copied
+// when the edit starts and the copies are edited on worker threads, one frame per thread at a time. A modal shows
+// progress and lets the edit be cancelled. When it finishes the copies replace the pictures of the image in one go
+// and the old pictures become the undo step, so the image is never seen half edited.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <System/tMachine.h>
+#include <Math/tVector2.h>
+#include "imgui.h"
+#include "EditJob.h"
+#include "Image.h"
+#include "GuiUtil.h"
+#include "TacentView.h"
+using namespace tImage;
+
+
+namespace Viewer
+{
+	namespace EditJob
+	{
+		struct Job
+		{
+			Image* Target											= nullptr;
+			tString Description;
+			Operation Op;
+			Completion OnComplete;
+			std::chrono::steady_clock::time_point StartTime;
+
+			// The copies being edited. Each frame is only touched by the worker that took its index. The progress and
+			// done flags have one entry per frame.
+			std::vector<tPicture*> Frames;
+			std::unique_ptr<WorkPool::Progress[]> Progress;
+			std::unique_ptr<std::atomic<bool>[]> FrameDone;
+			std::vector<std::thread> Workers;
+			std::atomic<int> NextFrame								= 0;
+			std::atomic<int> FramesDone								= 0;
+			std::atomic<int> WorkersRunning							= 0;
+			std::atomic<bool> Cancelled								= false;
+		};
+
+		// Main thread only. Cancelled jobs keep their workers until the frame they are on is done.
+		Job* Current												= nullptr;
+		std::vector<Job*> Abandoned;
+
+		void WorkerFunction(Job*);
+		bool IsFinished(const Job*);
+		void Free(Job*);
+	}
+}
+
+
+void Viewer::EditJob::WorkerFunction(Job* job)
+{
+	for (int f = job->NextFrame++; (f < int(job->Frames.size())) && !job->Cancelled; f = job->NextFrame++)
+	{
+		job->Op(*job->Frames[f], f, job->Progress[f]);
+		job->FrameDone[f] = true;
+		job->FramesDone++;
+		WakeMainLoop();
+	}
+
+	job->WorkersRunning--;
+	WakeMainLoop();
+}
+
+
+bool Viewer::EditJob::IsFinished(const Job* job)
+{
+	return job->WorkersRunning == 0;
+}
+
+
+void Viewer::EditJob::Free(Job* job)
+{
+	for (std::thread& worker : job->Workers)
+		worker.join();
+	for (tPicture* frame : job->Frames)
+		delete frame;
+	delete job;
+}
+
+
+void Viewer::EditJob::Shutdown()
+{
+	Cancel();
+	for (Job* job : Abandoned)
+		Free(job);
+	Abandoned.clear();
+}
+
+
+bool Viewer::EditJob::Start(Image* image, const tString& desc, const Operation& op, const Completion& onComplete)
+{
+	if (Current || !image)
+		return false;
+
+	tList<tPicture> copies;
+	image->CopyPictures(copies);
+	if (copies.IsEmpty())
+		return false;
+
+	Job* job			= new Job;
+	job->Target			= image;
+	job->Description	= desc;
+	job->Op				= op;
+	job->OnComplete		= onComplete;
+	job->StartTime		= std::chrono::steady_clock::now();
+	while (tPicture* copy = copies.Remove())
+		job->Frames.push_back(copy);
+	job->Progress.reset(new WorkPool::Progress[job->Frames.size()]);
+	job->FrameDone.reset(new std::atomic<bool>[job->Frames.size()]);
+	for (int f = 0; f < int(job->Frames.size()); f++)
+		job->FrameDone[f] = false;
+	image->Pin();
+
+	// A single frame gets a single worker. The operations on one picture are not split further here. The frame limit
+	// bounds how many working copies the edits make at once.
+	int numWorkers = tMath::tMin(tSystem::tGetNumCores(), int(job->Frames.size()));
+	if (Image::MaxEditFrames > 0)
+		numWorkers = tMath::tMin(numWorkers, Image::MaxEditFrames);
+	job->WorkersRunning = numWorkers;
+	for (int w = 0; w < numWorkers; w++)
+		job->Workers.emplace_back(WorkerFunction, job);
+
+	Current = job;
+	return true;
+}
+
+
+bool Viewer::EditJob::IsRunning()
+{
+	return Current != nullptr;
+}
+
+
+float Viewer::EditJob::GetProgress()
+{
+	if (!Current)
+		return 0.0f;
+
+	// A frame whose operation does not report counts as done once it returns.
+	int numFrames = int(Current->Frames.size());
+	float done = 0.0f;
+	for (int f = 0; f < numFrames; f++)
+		done += Current->FrameDone[f] ? 1.0f : Current->Progress[f].GetFraction();
+	return tMath::tMin(done / float(numFrames), 1.0f);
+}
+
+
+void Viewer::EditJob::Cancel()
+{
+	if (!Current)
+		return;
+
+	Current->Cancelled = true;
+	for (int f = 0; f < int(Current->Frames.size()); f++)
+		Current->Progress[f].Cancel();
+	if (Current->Target)
+		Current->Target->Unpin();
+	Current->Target = nullptr;
+	Abandoned.push_back(Current);
+	Current = nullptr;
+}
+
+
+void Viewer::EditJob::Forget(const Image* image)
+{
+	// The image is mid destruction so its pin no longer matters.
+	if (!Current || (Current->Target != image))
+		return;
+
+	Current->Target = nullptr;
+	Cancel();
+}
+
+
+bool Viewer::EditJob::Update()
+{
+	for (int j = 0; j < int(Abandoned.size()); j++)
+	{
+		if (!IsFinished(Abandoned[j]))
+			continue;
+		Free(Abandoned[j]);
+		Abandoned.erase(Abandoned.begin() + j--);
+	}
+
+	if (!Current || !IsFinished(Current))
+		return false;
+
+	Job* job = Current;
+	Current = nullptr;
+
+	// A forced unload, like a reload from disk, leaves nothing for the result to replace. A destroyed image cancels
+	// the edit so the target is always still alive here.
+	bool found = job->Target->IsLoaded();
+	job->Target->Unpin();
+	if (found)
+	{
+		tList<tPicture> result;
+		for (tPicture*& frame : job->Frames)
+		{
+			result.Append(frame);
+			frame = nullptr;
+		}
+
+		job->Target->Unbind();
+		job->Target->ReplacePictures(job->Description, result);
+		job->Target->Bind();
+		if (job->OnComplete)
+			job->OnComplete();
+	}
+
+	Free(job);
+	return found;
+}
+
+
+void Viewer::EditJob::DoProgressModal()
+{
+	// The popup is still submitted for the frame after the edit finishes so it can close itself.
+	const char* label = "Working";
+	if (Current && !ImGui::IsPopupOpen(label))
+		ImGui::OpenPopup(label);
+
+	if (!ImGui::BeginPopupModal(label, nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoScrollbar))
+		return;
+
+	if (Current)
+	{
+		float buttonWidth	= Gutil::GetUIParamScaled(76.0f, 2.5f);
+		float barWidth		= Gutil::GetUIParamScaled(258.0f, 2.5f);
+		float elapsed		= std::chrono::duration<float>(std::chrono::steady_clock::now() - Current->StartTime).count();
+		int numFrames		= int(Current->Frames.size());
+
+		ImGui::Text("%s", Current->Description.Chr());
+		if (numFrames > 1)
+			ImGui::Text("Frame %d of %d", tMath::tMin(int(Current->FramesDone) + 1, numFrames), numFrames);
+		ImGui::Text("Elapsed %.1fs", elapsed);
+		ImGui::ProgressBar(GetProgress(), tVector2(barWidth, 0.0f));
+
+		ImGui::NewLine();
+		if (Gutil::Button("Cancel", tVector2(buttonWidth, 0.0f)))
+			Cancel();
+	}
+
+	if (!Current)
+		ImGui::CloseCurrentPopup();
+	ImGui::EndPopup();
+}
@@ -0,0 +1,65 @@
+// EditJob.h
+//
+// Runs long image edits like quantize, rotate, and resample off the UI thread. The pictures of the image are copied
+// when the edit starts and the copies are edited on worker threads, one frame per thread at a time. A modal shows
+// progress and lets the edit be cancelled. When it finishes the copies replace the pictures of the image in one go
+// and the old pictures become the undo step, so the image is never seen half edited.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <functional>
+#include <Foundation/tString.h>
+#include <Image/tPicture.h>
+#include "WorkPool.h"
+namespace Viewer { class Image; }
+
+
+namespace Viewer
+{
+	namespace EditJob
+	{
+		// Edits a single frame. Called on a worker thread with a private copy of the frame, so it must not touch the
+		// image or anything else shared. Frames of the same image may be edited at the same time. Each frame has its
+		// own progress. Operations that can should report rows through it and stop once it is cancelled. Operations
+		// that don't count as done when they return.
+		typedef std::function<void(tImage::tPicture&, int frameNum, WorkPool::Progress&)> Operation;
+
+		// Called on the main thread once the result has replaced the pictures of the image.
+		typedef std::function<void()> Completion;
+
+		// Call once from the main thread at shutdown. Waits for any running edit and discards it.
+		void Shutdown();
+
+		// Starts editing every frame of the image. Only one edit runs at a time. Returns false if one is already
+		// running or the image has no pictures. The image is pinned until the edit finishes or is cancelled so the
+		// memory manager does not unload it. If it is unloaded or destroyed anyway the result is discarded.
+		bool Start(Image*, const tString& desc, const Operation&, const Completion& = nullptr);
+
+		bool IsRunning();
+		float GetProgress();						// Fraction of the work done over all frames.
+
+		// Never blocks. Frames not yet started are skipped and the result is discarded. Frames being edited are
+		// told to stop and are cleaned up by Update once their operations return.
+		void Cancel();
+
+		// Called by the image destructor. Cancels the edit if the image is its target so nothing is done to the
+		// image once it is gone.
+		void Forget(const Image*);
+
+		// Call once per frame from the main thread. Swaps in a finished result and cleans up cancelled edits.
+		// Returns true if an image changed.
+		bool Update();
+
+		// Shows the progress modal while an edit is running.
+		void DoProgressModal();
+	}
+}
@@ -22,8 +22,18 @@
 #include <System/tMachine.h>
 #include <System/tChunk.h>
 #include <Math/tRandom.h>
+#include <Image/tPixelUtil.h>
 #include "Image.h"
 #include "Config.h"
+#include "MetaIndex.h"
+#include "ImageHeader.h"
+#include "TacentView.h"
+#include "WorkPool.h"
+#include "PixelKernels.h"
+#include "Resampler.h"
+#include "Rotator.h"
+#include "SpatialQuantizer.h"
+#include "EditJob.h"
 using namespace tStd;
 using namespace tSystem;
 using namespace tImage;
@@ -31,6 +41,7 @@ using namespace tMath;
 using namespace Viewer;
 int Image::ThumbnailNumThreadsRunning = 0;
 tString Image::ThumbCacheDir;
+int Image::MaxEditFrames = 0;
 static tMath::tRandom::tGeneratorMersenneTwister ShuffleGenerator((uint64)tSystem::tGetTimeUTC());
 
 
@@ -94,8 +105,12 @@ Image::~Image()
 		tiClampMin(ThumbnailNumThreadsRunning, 0);
 	}
 
+	// An edit of this image would otherwise swap its result into whatever image is allocated here next.
+	EditJob::Forget(this);
+
 	// Free GPU image mem and texture IDs.
 	Unload(true);
+	MemoryManager::Remove(this);
 }
 
 
@@ -158,11 +173,58 @@ bool Image::Load(const tString& filename, bool loadParamsFromConfig)
 }
 
 
+Image::ProbeResult Image::Probe(int64 maxPixels, bool loadParamsFromConfig)
+{
+	if (Filetype == tFileType::Unknown)
+		return ProbeResult::Failed;
+
+	Config::ProfileData& profile = Config::GetProfileData();
+	bool exifOrient = loadParamsFromConfig ? profile.MetaDataOrientLoading : (LoadParams_JPG.Flags & tImageJPG::LoadFlag_ExifOrient);
+	// With a budget we need the real frame count so gif and animated webp files get walked.
+	ImageHeader::Info header;
+	bool countFrames = (maxPixels > 0);
+	if (!ImageHeader::Read(header, Filename, Filetype, exifOrient, countFrames))
+		return ProbeResult::Failed;
+
+	// An apng inside a png file only loads as animated if detection is on. See Load.
+	bool detectAPNGInsidePNG = loadParamsFromConfig ? profile.DetectAPNGInsidePNG : LoadParams_DetectAPNGInsidePNG;
+	if ((Filetype == tFileType::PNG) && !detectAPNGInsidePNG && (header.NumFrames > 1))
+	{
+		header.NumFrames = 1;
+		header.NumPixels = int64(header.Width) * int64(header.Height);
+	}
+
+	Cached_PrimaryWidth		= header.Width;
+	Cached_PrimaryHeight	= header.Height;
+	Cached_PrimaryArea		= int64(header.Width) * int64(header.Height);
+	Cached_PixelFormat		= header.PixelFormat;
+	Cached_NumFrames		= header.NumFrames;
+	Cached_NumPixels		= header.NumPixels;
+	if (header.MetaData.IsValid() && !Cached_MetaData.IsValid())
+		Cached_MetaData		= header.MetaData;
+
+	// A loaded image already has the real info.
+	if (!IsLoaded())
+	{
+		Info.SrcPixelFormat		= header.PixelFormat;
+		Info.SrcColourProfile	= header.ColourProfile;
+		Info.FileSizeBytes		= int64(FileSizeB);
+	}
+
+	// If the frame count couldn't be determined we can't prove the image fits so it is treated as over budget.
+	if ((maxPixels > 0) && ((header.NumFrames <= 0) || (header.NumPixels > maxPixels)))
+		return ProbeResult::OverBudget;
+
+	return ProbeResult::Success;
+}
+
+
 bool Image::Load(bool loadParamsFromConfig)
 {
 	if (IsLoaded() && !Dirty)
 	{
 		LoadedTime = tSystem::tGetTime();
+		MemoryManager::Touch(this);
 		return true;
 	}
 
@@ -187,6 +249,7 @@ bool Image::Load(bool loadParamsFromConfig)
 	Info.SrcColourProfile	= tColourProfile::Unspecified;
 	Info.AlphaMode			= tAlphaMode::Unspecified;
 	Info.ChannelType		= tChannelType::Unspecified;
+	FramesCompactable		= false;
 	bool success = false;
 
 	switch (loadingFiletype)
@@ -209,6 +272,7 @@ bool Image::Load(bool loadParamsFromConfig)
 				tPicture* picture = new tPicture(frame, true);
 				Pictures.Append(picture);
 			}
+			FramesCompactable = true;
 			success = true;
 			break;
 		}
@@ -250,6 +314,7 @@ bool Image::Load(bool loadParamsFromConfig)
 				tPicture* picture = new tPicture(frame, true);
 				Pictures.Append(picture);
 			}
+			FramesCompactable = true;
 			success = true;
 			break;
 		}
@@ -273,6 +338,7 @@ bool Image::Load(bool loadParamsFromConfig)
 				tPicture* picture = new tPicture(frame, true);
 				Pictures.Append(picture);
 			}
+			FramesCompactable = true;
 			success = true;
 			break;
 		}
@@ -440,6 +506,7 @@ bool Image::Load(bool loadParamsFromConfig)
 				tPicture* picture = new tPicture(frame, true);
 				Pictures.Append(picture);
 			}
+			FramesCompactable = true;
 			success = true;
 			break;
 		}
@@ -464,6 +531,7 @@ bool Image::Load(bool loadParamsFromConfig)
 				tPicture* picture = new tPicture(frame, true);
 				Pictures.Append(picture);
 			}
+			FramesCompactable = true;
 			success = true;
 			break;
 		}
@@ -479,10 +547,19 @@ bool Image::Load(bool loadParamsFromConfig)
 					params.Flags &= ~tImageDDS::LoadFlag_StrictLoading;
 			}
 
+			// Block formats are first loaded undecoded. If they can't be kept that way we load again and decode.
 			tImageDDS dds;
-			bool ok = dds.Load(Filename, params);
-			if (!ok || !dds.IsValid())
-				break;
+			tImageDDS::LoadParams blockParams(params);
+			blockParams.Flags &= ~tImageDDS::LoadFlag_Decode;
+			bool blocks =
+				profile.KeepBlockCompressed && dds.Load(Filename, blockParams) && dds.IsValid() &&
+				PopulateBlockFrames(dds, dds.RowsReversed());
+			if (!blocks)
+			{
+				bool ok = dds.Load(Filename, params);
+				if (!ok || !dds.IsValid())
+					break;
+			}
 
 			Info.SrcPixelFormat		= dds.GetPixelFormatSrc();
 			Info.SrcColourProfile	= dds.GetColourProfileSrc();
@@ -490,7 +567,8 @@ bool Image::Load(bool loadParamsFromConfig)
 			Info.ChannelType		= dds.GetChannelType();
 
 			// Appends to the Pictures list and may populate the alternate image.
-			MultiSurfacePopulatePictures(dds);
+			if (!blocks)
+				MultiSurfacePopulatePictures(dds);
 			success = true;
 			break;
 		}
@@ -512,9 +590,17 @@ bool Image::Load(bool loadParamsFromConfig)
 			}
 
 			tImagePVR pvr;
-			bool ok = pvr.Load(Filename, params);
-			if (!ok || !pvr.IsValid())
-				break;
+			tImagePVR::LoadParams blockParams(params);
+			blockParams.Flags &= ~tImagePVR::LoadFlag_Decode;
+			bool blocks =
+				profile.KeepBlockCompressed && pvr.Load(Filename, blockParams) && pvr.IsValid() &&
+				PopulateBlockFrames(pvr, pvr.RowsReversed());
+			if (!blocks)
+			{
+				bool ok = pvr.Load(Filename, params);
+				if (!ok || !pvr.IsValid())
+					break;
+			}
 
 			Info.SrcPixelFormat		= pvr.GetPixelFormatSrc();
 			Info.SrcColourProfile	= pvr.GetColourProfileSrc();
@@ -522,7 +608,8 @@ bool Image::Load(bool loadParamsFromConfig)
 			Info.ChannelType		= pvr.GetChannelType();
 
 			// Appends to the Pictures list and may populate the alternate image.
-			MultiSurfacePopulatePictures(pvr);
+			if (!blocks)
+				MultiSurfacePopulatePictures(pvr);
 			success = true;
 			break;
 		}
@@ -531,9 +618,17 @@ bool Image::Load(bool loadParamsFromConfig)
 		case tSystem::tFileType::KTX2:
 		{
 			tImageKTX ktx;
-			bool ok = ktx.Load(Filename, LoadParams_KTX);
-			if (!ok || !ktx.IsValid())
-				break;
+			tImageKTX::LoadParams blockParams(LoadParams_KTX);
+			blockParams.Flags &= ~tImageKTX::LoadFlag_Decode;
+			bool blocks =
+				profile.KeepBlockCompressed && ktx.Load(Filename, blockParams) && ktx.IsValid() &&
+				PopulateBlockFrames(ktx, ktx.RowsReversed());
+			if (!blocks)
+			{
+				bool ok = ktx.Load(Filename, LoadParams_KTX);
+				if (!ok || !ktx.IsValid())
+					break;
+			}
 
 			Info.SrcPixelFormat		= ktx.GetPixelFormatSrc();
 			Info.SrcColourProfile	= ktx.GetColourProfileSrc();
@@ -541,7 +636,8 @@ bool Image::Load(bool loadParamsFromConfig)
 			Info.ChannelType		= ktx.GetChannelType();
 
 			// Appends to the Pictures list and may populate the alternate image.
-			MultiSurfacePopulatePictures(ktx);
+			if (!blocks)
+				MultiSurfacePopulatePictures(ktx);
 			success = true;
 			break;
 		}
@@ -599,6 +695,7 @@ bool Image::Load(bool loadParamsFromConfig)
 		}
 	}
 
+	RebuildFrameTable();
 	if (!success)
 		return false;
 
@@ -608,6 +705,9 @@ bool Image::Load(bool loadParamsFromConfig)
 	bool foundOpaque = false; bool foundTransparent = false;
 	for (tPicture* pic = Pictures.First(); pic; pic = pic->Next())
 	{
+		// Pictures still in block form have no pixels to check. If none do the opacity is reported as varying.
+		if (!pic->IsValid())
+			continue;
 		if (pic->IsOpaque())
 			foundOpaque = true;
 		else
@@ -619,15 +719,18 @@ bool Image::Load(bool loadParamsFromConfig)
 	else if (foundTransparent && !foundOpaque)
 		Info.Opacity = ImgInfo::OpacityEnum::False;
 
-	Info.FileSizeBytes		= tSystem::tGetFileSize(Filename);
+	tFileInfo fileInfo;
+	Info.FileSizeBytes		= tGetFileInfo(fileInfo, Filename) ? int64(fileInfo.FileSize) : int64(FileSizeB);
 	Info.MemSizeBytes		= GetMemSizeBytes();
 	ClearDirty();
+	MemoryManager::Touch(this);
 	return true;
 }
 
 
 bool Image::Save(const tString& outFile, tFileType fileType, bool useConfigSaveParams, bool onlyCurrentPic) const
 {
+	ExpandAllFrames();
 	Config::ProfileData& profile = Config::GetProfileData();
 	bool success = false;
 	switch (fileType)
@@ -730,7 +833,6 @@ bool Image::Save(const tString& outFile, tFileType fileType, bool useConfigSaveP
 				}
 			}
 
-			tImageGIF gif(frames, true);
 			tImageGIF::SaveParams params(SaveParamsGIF);
 			if (useConfigSaveParams)
 			{
@@ -743,6 +845,11 @@ bool Image::Save(const tString& outFile, tFileType fileType, bool useConfigSaveP
 				params.FilterSize				= (profile.SaveFileGifFilterSize * 2) + 1;
 				params.SampleFactor				= profile.SaveFileGifSampleFactor;
 			}
+
+			// The frames are copies so the spatial quantizer can work on them before the GIF takes them.
+			float budget = useConfigSaveParams ? profile.SaveFileGifSpatialBudget : SaveSpatialBudgetGIF;
+			SpatialQuantizer::PrepareGIF(frames, params, budget);
+			tImageGIF gif(frames, true);
 			success = gif.Save(outFile, params);
 			break;
 		}
@@ -941,17 +1048,40 @@ bool Image::Save(const tString& outFile, tFileType fileType, bool useConfigSaveP
 }
 
 
-int Image::GetMemSizeBytes() const
+int64 Image::GetPictureMemSizeBytes() const
 {
-	int numBytes = 0;
-	for (tPicture* pic = Pictures.First(); pic; pic = pic->Next())
-		numBytes += pic->GetNumPixels() * sizeof(tPixel4b);
+	int64 numBytes = 0;
+	for (int f = 0; f < int(FrameTable.size()); f++)
+	{
+		const tPicture* pic = FrameTable[f];
+		if (CompactFrames[f])
+			numBytes += CompactFrames[f]->GetMemSizeBytes();
+		else if (BlockFrames[f])
+			numBytes += int64(BlockFrames[f]->GetDataSize());
+		else
+			numBytes += ComputePictureMemSizeBytes(pic->GetWidth(), pic->GetHeight());
+	}
+
+	// The reduced levels of a tiled picture are derived from the picture and freed with the tiles.
+	if (Tiles)
+		numBytes += Tiles->GetPyramidBytes();
 
-	numBytes += AltPicture.IsValid() ? AltPicture.GetNumPixels()*sizeof(tPixel4b) : 0;
 	return numBytes;
 }
 
 
+int64 Image::GetAltPictureMemSizeBytes() const
+{
+	return AltPicture.IsValid() ? ComputePictureMemSizeBytes(AltPicture.GetWidth(), AltPicture.GetHeight()) : 0;
+}
+
+
+int64 Image::GetMemSizeBytes() const
+{
+	return GetPictureMemSizeBytes() + GetAltPictureMemSizeBytes();
+}
+
+
 void Image::MultiSurfacePopulatePictures(const tBaseImage& img)
 {
 	if (img.IsCubemap())
@@ -993,6 +1123,36 @@ void Image::MultiSurfacePopulatePictures(const tBaseImage& img)
 }
 
 
+bool Image::PopulateBlockFrames(const tBaseImage& img, bool rowsReversed)
+{
+	// Cubemaps and the side-by-side mipmap view are assembled from decoded pixels, so cubemaps are always decoded
+	// and mipmapped files only get the alternate view when this option is off. Textures are drawn with the first row
+	// at the bottom, so the blocks are only usable if the loader could reverse them.
+	if (!rowsReversed || img.IsCubemap())
+		return false;
+
+	teList<tLayer> layers;
+	img.GetLayers(layers);
+	if (layers.IsEmpty())
+		return false;
+
+	// HDR formats need the load parameters applied while decoding, so only LDR formats OpenGL can sample are kept.
+	tPixelFormat pixelFormat = layers.First()->PixelFormat;
+	GLint srcFormat, dstFormat; GLenum srcType; bool compressed;
+	GetGLFormatInfo(srcFormat, srcType, dstFormat, compressed, pixelFormat);
+	if (!compressed || (dstFormat == GL_INVALID_VALUE) || tIsHDRFormat(pixelFormat))
+		return false;
+
+	// The tImage owns its layers so we copy them. RebuildFrameTable pairs them up with the pictures.
+	for (tLayer* layer = layers.First(); layer; layer = layer->Next())
+	{
+		BlockLayers.Append(new tLayer(*layer));
+		Pictures.Append(new tPicture);
+	}
+	return true;
+}
+
+
 void Image::MultiSurfaceCreateAltCubemapPicture(const teList<tLayer> layers[tFaceIndex::tFaceIndex_NumFaces])
 {
 	tAssert(!layers[0].IsEmpty());
@@ -1064,8 +1224,8 @@ bool Image::Unload(bool force)
 	if (!IsLoaded())
 		return true;
 
-	// Not allowed to unload if dirty (modified).
-	if (Dirty && !force)
+	// Not allowed to unload if dirty (modified) or if an edit is on the way.
+	if ((Dirty || IsPinned()) && !force)
 		return false;
 
 	Unbind();
@@ -1073,18 +1233,288 @@ bool Image::Unload(bool force)
 	AltPictureEnabled = false;
 	AltPictureTyp = AltPictureType::None;
 	Pictures.Clear();
+	BlockLayers.Clear();
+	RebuildFrameTable();
+	FramesCompactable = false;
 	Info.MemSizeBytes = 0;
 
 	LoadedTime = -1.0f;
+	MemoryManager::Account(this);
+	return true;
+}
+
+
+void Image::RebuildFrameTable()
+{
+	// Any compact frames belonged to the old pictures.
+	ClearCompactFrames();
+
+	FrameTable.clear();
+	FrameTable.reserve(Pictures.Count());
+	for (tPicture* pic = Pictures.First(); pic; pic = pic->Next())
+		FrameTable.push_back(pic);
+
+	CompactFrames.assign(FrameTable.size(), nullptr);
+	FrameIncompressible.assign(FrameTable.size(), false);
+	FrameTextureBytes.assign(FrameTable.size(), 0);
+	FrameQualityJobs.assign(FrameTable.size(), nullptr);
+	CompactCursor = 0;
+
+	// Block layers only pair up with the pictures they were loaded with. Anything else rebuilding the table will
+	// have decoded them first.
+	BlockFrames.assign(FrameTable.size(), nullptr);
+	if (BlockLayers.GetNumItems() == int(FrameTable.size()))
+	{
+		int frameNum = 0;
+		for (tLayer* layer = BlockLayers.First(); layer; layer = layer->Next())
+			BlockFrames[frameNum++] = layer;
+	}
+	else
+	{
+		BlockLayers.Clear();
+	}
+}
+
+
+tPicture* Image::GetFramePic(int frameNum) const
+{
+	if ((frameNum < 0) || (frameNum >= int(FrameTable.size())))
+		return nullptr;
+
+	if (CompactFrames[frameNum] || BlockFrames[frameNum])
+		ExpandFrameAt(frameNum);
+
+	return FrameTable[frameNum];
+}
+
+
+tPixel4b* Image::CompactFrame::Expand() const
+{
+	int numPixels = Width*Height;
+	tPixel4b* pixels = new tPixel4b[numPixels];
+	for (int p = 0; p < numPixels; p++)
+		pixels[p] = Palette[Indices[p]];
+
+	return pixels;
+}
+
+
+int64 Image::CompactFrame::GetMemSizeBytes() const
+{
+	return int64(Width) * int64(Height) + int64(sizeof(CompactFrame));
+}
+
+
+bool Image::IsInFrameWindow(int frameNum, int windowAhead, int windowBehind) const
+{
+	// Distances are measured in the play direction and wrap because animations loop.
+	int numFrames = int(FrameTable.size());
+	int forward	= (frameNum - FrameNum + numFrames) % numFrames;
+	int back	= (FrameNum - frameNum + numFrames) % numFrames;
+	int ahead	= FramePlayRev ? back : forward;
+	int behind	= FramePlayRev ? forward : back;
+	return (ahead <= windowAhead) || (behind <= windowBehind);
+}
+
+
+bool Image::CompactFrameAt(int frameNum)
+{
+	// Bound frames may have a mipmap job reading their pixels. The texture ring keeps them inside the window anyway.
+	if (CompactFrames[frameNum] || FrameIncompressible[frameNum] || (FrameTable[frameNum]->TextureID != 0))
+		return false;
+
+	tPicture* pic = FrameTable[frameNum];
+	if (!pic->IsValid())
+		return false;
+
+	int width = pic->GetWidth();
+	int height = pic->GetHeight();
+	int numPixels = width*height;
+	const tPixel4b* pixels = pic->GetPixels();
+
+	// Small open-addressed hash from colour to palette index. Four times the palette size keeps the probes short.
+	const int hashSize = 1024;
+	uint32 hashKeys[hashSize];
+	int hashVals[hashSize];
+	for (int h = 0; h < hashSize; h++)
+		hashVals[h] = -1;
+
+	CompactFrame* compact = new CompactFrame;
+	compact->Width = width;
+	compact->Height = height;
+	compact->Indices = new uint8[numPixels];
+	for (int p = 0; p < numPixels; p++)
+	{
+		uint32 colour = pixels[p].BP;
+		int h = int((colour * 2654435761u) >> 22);
+		while ((hashVals[h] != -1) && (hashKeys[h] != colour))
+			h = (h + 1) & (hashSize - 1);
+
+		if (hashVals[h] == -1)
+		{
+			if (compact->NumColours >= 256)
+			{
+				delete compact;
+				FrameIncompressible[frameNum] = true;
+				return false;
+			}
+			hashKeys[h] = colour;
+			hashVals[h] = compact->NumColours;
+			compact->Palette[compact->NumColours++] = pixels[p];
+		}
+		compact->Indices[p] = uint8(hashVals[h]);
+	}
+
+	// The picture keeps its duration and texture ID. Only the pixels are released.
+	delete[] pic->StealPixels();
+	CompactFrames[frameNum] = compact;
 	return true;
 }
 
 
+void Image::ExpandFrameAt(int frameNum) const
+{
+	if (BlockFrames[frameNum])
+		DecodeBlockFrameAt(frameNum);
+
+	CompactFrame* compact = CompactFrames[frameNum];
+	if (!compact)
+		return;
+
+	// Set may reset the other members so we preserve the ones we care about.
+	tPicture* pic = FrameTable[frameNum];
+	float duration = pic->Duration;
+	uint textureID = pic->TextureID;
+	pic->Set(compact->Width, compact->Height, compact->Expand(), false);
+	pic->Duration = duration;
+	pic->TextureID = textureID;
+
+	delete compact;
+	CompactFrames[frameNum] = nullptr;
+}
+
+
+void Image::DecodeBlockFrameAt(int frameNum) const
+{
+	tLayer* layer = BlockFrames[frameNum];
+	if (!layer)
+		return;
+
+	// Only LDR formats are kept as blocks so the decode always produces 8-bit pixels.
+	tPixel4b* pixels = nullptr;
+	tPixel4f* pixelsHDR = nullptr;
+	DecodeResult result = DecodePixelData
+	(
+		layer->PixelFormat, layer->Data, layer->GetDataSize(), layer->Width, layer->Height,
+		pixels, pixelsHDR
+	);
+	delete[] pixelsHDR;
+	int numPixels = layer->Width * layer->Height;
+	if ((result != DecodeResult::Success) || !pixels)
+	{
+		delete[] pixels;
+		pixels = new tPixel4b[numPixels];
+		for (int p = 0; p < numPixels; p++)
+			pixels[p] = tPixel4b::black;
+	}
+
+	// Same as expanding a compact frame. The texture made from the blocks is still correct so it is kept.
+	tPicture* pic = FrameTable[frameNum];
+	float duration = pic->Duration;
+	uint textureID = pic->TextureID;
+	pic->Set(layer->Width, layer->Height, pixels, false);
+	pic->Duration = duration;
+	pic->TextureID = textureID;
+
+	BlockFrames[frameNum] = nullptr;
+	delete BlockLayers.Remove(layer);
+}
+
+
+tColour4b Image::GetBlockFramePixel(int frameNum, int x, int y) const
+{
+	// Decodes just the block the pixel is in so the colour under the cursor doesn't force the whole frame to decode.
+	const tLayer* layer = BlockFrames[frameNum];
+	tPixelFormat pixelFormat = layer->PixelFormat;
+	int blockW = tGetBlockWidth(pixelFormat);
+	int blockH = tGetBlockHeight(pixelFormat);
+	int bytesPerBlock = tGetBytesPerBlock(pixelFormat);
+	int blocksW = tGetNumBlocks(blockW, layer->Width);
+	tiClamp(x, 0, layer->Width-1);
+	tiClamp(y, 0, layer->Height-1);
+	int blockX = x / blockW;
+	int blockY = y / blockH;
+	const uint8* block = layer->Data + (int64(blockY)*blocksW + blockX)*bytesPerBlock;
+
+	tPixel4b* pixels = nullptr;
+	tPixel4f* pixelsHDR = nullptr;
+	DecodeResult result = DecodePixelData(pixelFormat, block, bytesPerBlock, blockW, blockH, pixels, pixelsHDR);
+	tColour4b colour = tColour4b::black;
+	if ((result == DecodeResult::Success) && pixels)
+		colour = pixels[(y - blockY*blockH)*blockW + (x - blockX*blockW)];
+
+	delete[] pixels;
+	delete[] pixelsHDR;
+	return colour;
+}
+
+
+void Image::ExpandAllFrames() const
+{
+	for (int f = 0; f < int(CompactFrames.size()); f++)
+		ExpandFrameAt(f);
+}
+
+
+void Image::ClearCompactFrames()
+{
+	for (CompactFrame* compact : CompactFrames)
+		delete compact;
+	CompactFrames.clear();
+	FrameIncompressible.clear();
+}
+
+
+bool Image::UpdateFrameWindow()
+{
+	UpdateQualityMipmaps();
+	int numFrames = int(FrameTable.size());
+	bool texturesPending = UsesTextureRing() ? UpdateTextureRing() : false;
+	if (!FramesCompactable || Adjusting || (numFrames < FrameWindowMinFrames))
+		return texturesPending;
+
+	// Frames about to be shown are expanded before their deadline so playback never waits on them.
+	int dir = FramePlayRev ? -1 : 1;
+	for (int i = 0; i <= FrameWindowAhead; i++)
+	{
+		int frameNum = (FrameNum + dir*i + numFrames) % numFrames;
+		ExpandFrameAt(frameNum);
+	}
+
+	// Compacting is spread over many updates so the UI never stalls. We keep a cursor so each call picks up where the
+	// last one left off.
+	int budget = FrameCompactPerUpdate;
+	for (int n = 0; (n < numFrames) && (budget > 0); n++)
+	{
+		int frameNum = CompactCursor;
+		CompactCursor = (CompactCursor + 1) % numFrames;
+		if (!IsInFrameWindow(frameNum, FrameWindowAhead, FrameWindowBehind) && CompactFrameAt(frameNum))
+			budget--;
+	}
+
+	return texturesPending || (budget == 0);
+}
+
+
 bool Image::IsOpaque() const
 {
 	if (AltPicture.IsValid() && AltPictureEnabled)
 		return AltPicture.IsOpaque();
 
+	// Not worth decoding to find out. Drawing the background behind an opaque texture is harmless.
+	if (GetFrameSlot(FrameNum) && BlockFrames[FrameNum])
+		return false;
+
 	tPicture* picture = GetCurrentPic();
 	if (picture && picture->IsValid())
 		return picture->IsOpaque();
@@ -1098,6 +1528,9 @@ int Image::GetWidth() const
 	if (AltPicture.IsValid() && AltPictureEnabled)
 		return AltPicture.GetWidth();
 
+	if (GetFrameSlot(FrameNum) && BlockFrames[FrameNum])
+		return BlockFrames[FrameNum]->Width;
+
 	tPicture* picture = GetCurrentPic();
 	if (picture && picture->IsValid())
 		return picture->GetWidth();
@@ -1111,6 +1544,9 @@ int Image::GetHeight() const
 	if (AltPicture.IsValid() && AltPictureEnabled)
 		return AltPicture.GetHeight();
 
+	if (GetFrameSlot(FrameNum) && BlockFrames[FrameNum])
+		return BlockFrames[FrameNum]->Height;
+
 	tPicture* picture = GetCurrentPic();
 	if (picture && picture->IsValid())
 		return picture->GetHeight();
@@ -1119,16 +1555,10 @@ int Image::GetHeight() const
 }
 
 
-int Image::GetArea() const
+int64 Image::GetArea() const
 {
-	if (AltPicture.IsValid() && AltPictureEnabled)
-		return AltPicture.GetArea();
-
-	tPicture* picture = GetCurrentPic();
-	if (picture && picture->IsValid())
-		return picture->GetArea();
-
-	return 0;
+	// Computed here rather than with tPicture::GetArea since a MaxDim x MaxDim picture does not fit in an int.
+	return int64(GetWidth()) * int64(GetHeight());
 }
 
 
@@ -1137,6 +1567,9 @@ tColour4b Image::GetPixel(int x, int y) const
 	if (AltPicture.IsValid() && AltPictureEnabled)
 		return AltPicture.GetPixel(x, y);
 
+	if (GetFrameSlot(FrameNum) && BlockFrames[FrameNum])
+		return GetBlockFramePixel(FrameNum, x, y);
+
 	tPicture* picture = GetCurrentPic();
 	if (picture && picture->IsValid())
 		return picture->GetPixel(x, y);
@@ -1150,9 +1583,8 @@ tColour4b Image::GetPixel(int x, int y) const
 void Image::Rotate90(bool antiClockWise)
 {
 	tString desc; tsPrintf(desc, "Rotate 90 %s", antiClockWise ? "ACW" : "CW");
-	PushUndo(desc);
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Rotate90(antiClockWise);
+	PushUndoOperation(desc, antiClockWise ? Undo::Operation::Rotate90ACW : Undo::Operation::Rotate90CW);
+	ForEachPicture([&](tPicture& picture) { picture.Rotate90(antiClockWise); });
 
 	Dirty = true;
 }
@@ -1165,8 +1597,7 @@ bool Image::Rotate(float angle, const tColour4b& fill, tResampleFilter upFilter,
 
 	tString desc; tsPrintf(desc, "Rotate %.1f", tRadToDeg(angle));
 	PushUndo(desc);
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->RotateCenter(angle, fill, upFilter, downFilter);
+	ForEachPicture([&](tPicture& picture) { Rotator::RotateCenter(picture, angle, fill, upFilter, downFilter); });
 
 	Dirty = true;
 	return true;
@@ -1177,19 +1608,22 @@ void Image::QuantizeFixed(int numColours, bool checkExact)
 {
 	tString desc; tsPrintf(desc, "Quantize %d", numColours);
 	PushUndo(desc);
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->QuantizeFixed(numColours, checkExact);
+	ForEachPicture([&](tPicture& picture) { picture.QuantizeFixed(numColours, checkExact); });
 
 	Dirty = true;
 }
 
 
-void Image::QuantizeSpatial(int numColours, bool checkExact, double ditherLevel, int filterSize)
+void Image::QuantizeSpatial(int numColours, bool checkExact, double ditherLevel, int filterSize, float timeBudget)
 {
 	tString desc; tsPrintf(desc, "Quantize %d", numColours);
 	PushUndo(desc);
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->QuantizeSpatial(numColours, checkExact, ditherLevel, filterSize);
+	SpatialQuantizer::Params params;
+	params.NumColours	= numColours;
+	params.DitherLevel	= ditherLevel;
+	params.FilterSize	= filterSize;
+	params.TimeBudget	= timeBudget;
+	ForEachPicture([&](tPicture& picture) { SpatialQuantizer::Quantize(picture, params, checkExact); });
 
 	Dirty = true;
 }
@@ -1199,6 +1633,7 @@ void Image::QuantizeNeu(int numColours, bool checkExact, int sampleFactor)
 {
 	tString desc; tsPrintf(desc, "Quantize %d", numColours);
 	PushUndo(desc);
+	// NeuQuant learns into a single network so the pictures are quantized one at a time.
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
 		picture->QuantizeNeu(numColours, checkExact, sampleFactor);
 
@@ -1210,14 +1645,13 @@ void Image::QuantizeWu(int numColours, bool checkExact)
 {
 	tString desc; tsPrintf(desc, "Quantize %d", numColours);
 	PushUndo(desc);
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->QuantizeWu(numColours, checkExact);
+	ForEachPicture([&](tPicture& picture) { picture.QuantizeWu(numColours, checkExact); });
 
 	Dirty = true;
 }
 
 
-bool Image::AdjustmentBegin()
+bool Image::AdjustmentBegin(bool preview)
 {
 	if (!IsLoaded())
 		return false;
@@ -1226,58 +1660,125 @@ bool Image::AdjustmentBegin()
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
 		picture->AdjustmentBegin();
 
+	// The proxy keeps the aspect ratio. It gets its own original pixels so it can be restored like the frames.
+	tPicture* currPic = GetCurrentPic();
+	if (preview && currPic && (int64(currPic->GetWidth())*currPic->GetHeight() > int64(AdjustProxyMaxDim)*AdjustProxyMaxDim))
+	{
+		float scale = float(AdjustProxyMaxDim) / float(tMax(currPic->GetWidth(), currPic->GetHeight()));
+		int proxyW = tMax(int(float(currPic->GetWidth())*scale), 1);
+		int proxyH = tMax(int(float(currPic->GetHeight())*scale), 1);
+		AdjustProxy.Set(*currPic);
+		Resampler::Resample(AdjustProxy, proxyW, proxyH, tResampleFilter::Box);
+		AdjustProxy.AdjustmentBegin();
+	}
+
+	AdjustPixelsOriginal = true;
+	AdjustDirtyOriginal = Dirty;
+	Adjusting = true;
 	return true;
 }
 
 
-void Image::AdjustBrightness(float brightness, AdjChan channels, bool allFrames)
+void Image::ApplyAdjustment(const std::function<void(tPicture*)>& adjust, bool allFrames)
 {
-	if (allFrames)
+	if (AdjustProxy.IsValid())
 	{
-		for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-			picture->AdjustBrightness(brightness, ComponentBits(channels));
+		adjust(&AdjustProxy);
+		AdjustPending = adjust;
+		AdjustPendingAllFrames = allFrames;
+		Dirty = true;
+		return;
 	}
-	else
+
+	// Banding works on the current pixels so it can only be used while they are still the originals. After that the
+	// adjustment must be made by the picture itself from the original pixels it kept.
+	bool banded = AdjustPixelsOriginal;
+	AdjustPixelsOriginal = false;
+	auto edit = [&](tPicture& picture)
 	{
-		tPicture* picture = GetCurrentPic();
-		if (picture)
-			picture->AdjustBrightness(brightness, ComponentBits(channels));
-	}
+		if (banded)
+			ApplyAdjustmentBanded(picture, adjust);
+		else
+			adjust(&picture);
+	};
+
+	if (allFrames)
+		ForEachPicture(edit);
+	else if (tPicture* currPic = GetCurrentPic())
+		edit(*currPic);
 	Dirty = true;
 }
 
 
+void Image::ApplyAdjustmentBanded(tPicture& picture, const std::function<void(tPicture*)>& adjust, WorkPool::Progress* progress)
+{
+	WorkPool::ForBands
+	(
+		picture,
+		[&adjust](tPicture& band)
+		{
+			band.AdjustmentBegin();
+			adjust(&band);
+			band.AdjustmentEnd();
+		},
+		progress
+	);
+}
+
+
+void Image::ForEachPicture(const std::function<void(tPicture&)>& edit)
+{
+	std::vector<tPicture*> pictures;
+	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
+		pictures.push_back(picture);
+
+	WorkPool::ParallelFor
+	(
+		int(pictures.size()), 1,
+		[&](int begin, int end)
+		{
+			for (int p = begin; p < end; p++)
+				edit(*pictures[p]);
+		},
+		MaxEditFrames
+	);
+}
+
+
+bool Image::TakeAdjustPending(std::function<void(tPicture*)>& adjust, bool& allFrames)
+{
+	if (!AdjustPending)
+		return false;
+
+	adjust = AdjustPending;
+	allFrames = AdjustPendingAllFrames;
+	AdjustPending = nullptr;
+	return true;
+}
+
+
+void Image::AdjustBrightness(float brightness, AdjChan channels, bool allFrames)
+{
+	comp_t comps = ComponentBits(channels);
+	ApplyAdjustment([=](tPicture* picture) { picture->AdjustBrightness(brightness, comps); }, allFrames);
+}
+
+
 void Image::AdjustContrast(float contrast, AdjChan channels, bool allFrames)
 {
-	if (allFrames)
-	{
-		for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-			picture->AdjustContrast(contrast, ComponentBits(channels));
-	}
-	else
-	{
-		tPicture* picture = GetCurrentPic();
-		if (picture)
-			picture->AdjustContrast(contrast, ComponentBits(channels));
-	}
-	Dirty = true;
+	comp_t comps = ComponentBits(channels);
+	ApplyAdjustment([=](tPicture* picture) { picture->AdjustContrast(contrast, comps); }, allFrames);
 }
 
 
 void Image::AdjustLevels(float blackPoint, float midPoint, float whitePoint, float blackOut, float whiteOut, bool powerMidGamma, AdjChan channels, bool allFrames)
 {
-	if (allFrames)
-	{
-		for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-			picture->AdjustLevels(blackPoint, midPoint, whitePoint, blackOut, whiteOut, powerMidGamma, ComponentBits(channels));
-	}
-	else
-	{
-		tPicture* picture = GetCurrentPic();
-		if (picture)
-			picture->AdjustLevels(blackPoint, midPoint, whitePoint, blackOut, whiteOut, powerMidGamma, ComponentBits(channels));
-	}
-	Dirty = true;
+	comp_t comps = ComponentBits(channels);
+	ApplyAdjustment
+	(
+		[=](tPicture* picture) { picture->AdjustLevels(blackPoint, midPoint, whitePoint, blackOut, whiteOut, powerMidGamma, comps); },
+		allFrames
+	);
 }
 
 
@@ -1289,7 +1790,13 @@ void Image::AdjustRestoreOriginal(bool popUndo)
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
 		picture->AdjustRestoreOriginal();
 
-	Dirty = false;
+	if (AdjustProxy.IsValid())
+		AdjustProxy.AdjustRestoreOriginal();
+	AdjustPending = nullptr;
+	AdjustPixelsOriginal = true;
+
+	// Edits made before the adjustment started are still unsaved.
+	Dirty = AdjustDirtyOriginal;
 }
 
 
@@ -1306,19 +1813,80 @@ void Image::AdjustGetDefaults(float& brightness, float& contrast, float& blackPo
 
 bool Image::AdjustmentEnd()
 {
+	// The full-resolution pixels are still the originals while previewing. Frames are shared between the work pool
+	// threads and a single frame has its rows shared instead.
+	if (AdjustPending)
+	{
+		std::vector<tPicture*> targets;
+		if (AdjustPendingAllFrames)
+		{
+			for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
+				targets.push_back(picture);
+		}
+		else if (tPicture* picture = GetCurrentPic())
+		{
+			targets.push_back(picture);
+		}
+
+		WorkPool::ParallelFor
+		(
+			int(targets.size()), 1,
+			[&](int begin, int end)
+			{
+				for (int t = begin; t < end; t++)
+					ApplyAdjustmentBanded(*targets[t], AdjustPending);
+			},
+			MaxEditFrames
+		);
+		AdjustPending = nullptr;
+	}
+
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
 		picture->AdjustmentEnd();
 
+	if (AdjustProxy.IsValid())
+	{
+		AdjustProxy.AdjustmentEnd();
+		AdjustProxy.Clear();
+	}
+
+	Adjusting = false;
 	return true;
 }
 
 
+void Image::CopyPictures(tList<tPicture>& copies) const
+{
+	ExpandAllFrames();
+	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
+	{
+		tPicture* copy = new tPicture(*picture);
+		copy->TextureID = 0;
+		copies.Append(copy);
+	}
+}
+
+
+void Image::ReplacePictures(const tString& desc, tList<tPicture>& pictures)
+{
+	ExpandAllFrames();
+	if (UndoEnabled)
+		UndoStack.Push(Undo::Step_PictureList::Steal(desc, Dirty, Pictures));
+	Pictures.Clear();
+
+	while (!pictures.IsEmpty())
+		Pictures.Append(pictures.Remove());
+	RebuildFrameTable();
+	tiClamp(FrameNum, 0, GetNumPictures()-1);
+	Dirty = true;
+}
+
+
 void Image::Flip(bool horizontal)
 {
 	tString desc; tsPrintf(desc, "Flip %s", horizontal ? "Horiz" : "Vert");
-	PushUndo(desc);
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Flip(horizontal);
+	PushUndoOperation(desc, horizontal ? Undo::Operation::FlipHorizontal : Undo::Operation::FlipVertical);
+	ForEachPicture([&](tPicture& picture) { picture.Flip(horizontal); });
 
 	Dirty = true;
 }
@@ -1340,8 +1908,7 @@ bool Image::Crop(int newWidth, int newHeight, int originX, int originY, const tC
 
 	tString desc; tsPrintf(desc, "Crop %d %d", newWidth, newHeight);
 	PushUndo(desc);
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Crop(newWidth, newHeight, originX, originY, fillColour);
+	ForEachPicture([&](tPicture& picture) { picture.Crop(newWidth, newHeight, originX, originY, fillColour); });
 
 	Dirty = true;
 	return true;
@@ -1364,8 +1931,7 @@ bool Image::Crop(int newWidth, int newHeight, tPicture::Anchor anchor, const tCo
 
 	tString desc; tsPrintf(desc, "Crop %d %d", newWidth, newHeight);
 	PushUndo(desc);
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Crop(newWidth, newHeight, anchor, fillColour);
+	ForEachPicture([&](tPicture& picture) { picture.Crop(newWidth, newHeight, anchor, fillColour); });
 
 	Dirty = true;
 	return true;
@@ -1375,7 +1941,8 @@ bool Image::Crop(int newWidth, int newHeight, tPicture::Anchor anchor, const tCo
 bool Image::Paste(int regionW, int regionH, const tColour4b* regionPixels, int originX, int originY, comp_t channels)
 {
 	tString desc; tsPrintf(desc, "Paste %d %d", regionW, regionH);
-	PushUndo(desc);
+	std::vector<Undo::Step_Region::Rect> rects(Pictures.Count(), { originX, originY, regionW, regionH });
+	PushUndoRegion(desc, rects);
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
 		picture->CopyRegion(regionW, regionH, regionPixels, originX, originY, channels);
 
@@ -1387,7 +1954,10 @@ bool Image::Paste(int regionW, int regionH, const tColour4b* regionPixels, int o
 bool Image::Paste(int regionW, int regionH, const tColour4b* regionPixels, tImage::tPicture::Anchor anchor, comp_t channels)
 {
 	tString desc; tsPrintf(desc, "Paste %d %d", regionW, regionH);
-	PushUndo(desc);
+	std::vector<Undo::Step_Region::Rect> rects;
+	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
+		rects.push_back(GetPasteRect(picture->GetWidth(), picture->GetHeight(), regionW, regionH, anchor));
+	PushUndoRegion(desc, rects);
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
 		picture->CopyRegion(regionW, regionH, regionPixels, anchor, channels);
 
@@ -1396,6 +1966,31 @@ bool Image::Paste(int regionW, int regionH, const tColour4b* regionPixels, tImag
 }
 
 
+Undo::Step_Region::Rect Image::GetPasteRect(int picW, int picH, int regionW, int regionH, tPicture::Anchor anchor)
+{
+	Undo::Step_Region::Rect rect { 0, 0, regionW + 2, regionH + 2 };
+	switch (anchor)
+	{
+		case tPicture::Anchor::LeftTop:		case tPicture::Anchor::LeftMiddle:		case tPicture::Anchor::LeftBottom:
+			rect.X = -1;						break;
+		case tPicture::Anchor::MiddleTop:	case tPicture::Anchor::MiddleMiddle:	case tPicture::Anchor::MiddleBottom:
+			rect.X = picW/2 - regionW/2 - 1;	break;
+		default:
+			rect.X = picW - regionW - 1;		break;
+	}
+	switch (anchor)
+	{
+		case tPicture::Anchor::LeftBottom:	case tPicture::Anchor::MiddleBottom:	case tPicture::Anchor::RightBottom:
+			rect.Y = -1;						break;
+		case tPicture::Anchor::LeftMiddle:	case tPicture::Anchor::MiddleMiddle:	case tPicture::Anchor::RightMiddle:
+			rect.Y = picH/2 - regionH/2 - 1;	break;
+		default:
+			rect.Y = picH - regionH - 1;		break;
+	}
+	return rect;
+}
+
+
 bool Image::Deborder(const tColour4b& borderColour, comp_t channels)
 {
 	bool atLeastOneHasBorders = false;
@@ -1411,8 +2006,7 @@ bool Image::Deborder(const tColour4b& borderColour, comp_t channels)
 		return false;
 
 	PushUndo("Crop Borders");
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Deborder(borderColour, channels);
+	ForEachPicture([&](tPicture& picture) { picture.Deborder(borderColour, channels); });
 
 	Dirty = true;
 	return true;
@@ -1435,8 +2029,7 @@ bool Image::Resample(int newWidth, int newHeight, tImage::tResampleFilter filter
 
 	tString desc; tsPrintf(desc, "Resample %d %d", newWidth, newHeight);
 	PushUndo(desc);
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Resample(newWidth, newHeight, filter, edgeMode);
+	ForEachPicture([&](tPicture& picture) { Resampler::Resample(picture, newWidth, newHeight, filter, edgeMode); });
 
 	Dirty = true;
 	return true;
@@ -1448,7 +2041,12 @@ void Image::SetPixelColour(int x, int y, const tColour4b& colour, bool pushUndo,
 	if (pushUndo)
 	{
 		tString desc; tsPrintf(desc, "Pixel Colour (%d,%d)", x, y);
-		PushUndo(desc);
+		std::vector<Undo::Step_Region::Rect> rects(Pictures.Count(), { x, y, 1, 1 });
+		PushUndoRegion(desc, rects);
+	}
+	else
+	{
+		ExpandAllFrames();
 	}
 
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
@@ -1468,7 +2066,7 @@ void Image::SetAllPixels(const tColour4b& colour, comp_t channels)
 	PushUndo(desc);
 
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->SetAll(colour, channels);
+		WorkPool::ForPixels(*picture, [&](tPixel4b* pixels, int64 count) { PixelKernels::SetChannels(pixels, count, colour, channels); });
 
 	Dirty = true;
 }
@@ -1483,7 +2081,7 @@ void Image::Spread(tComp channel)
 	PushUndo(desc);
 
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Spread(channel);
+		WorkPool::ForPixels(*picture, [&](tPixel4b* pixels, int64 count) { PixelKernels::Spread(pixels, count, channel); });
 
 	Dirty = true;
 }
@@ -1500,11 +2098,17 @@ void Image::Swizzle(tComp R, tComp G, tComp B, tComp A)
 		tString(tGetComponentName(B)) +
 		tString(tGetComponentName(A));
 
+	// Only swizzles that permute the channels can be undone without a copy.
 	tString desc; tsPrintf(desc, "Swizzle %s", channelsStr.Chr());
-	PushUndo(desc);
+	ExpandAllFrames();
+	Undo::Step* step = Undo::Step_Operation::CreateSwizzle(desc, Dirty, R, G, B, A);
+	if (step)
+		PushUndo(step);
+	else
+		PushUndo(desc);
 
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Swizzle(R, G, B, A);
+		WorkPool::ForPixels(*picture, [&](tPixel4b* pixels, int64 count) { PixelKernels::Swizzle(pixels, count, R, G, B, A); });
 
 	Dirty = true;
 }
@@ -1523,7 +2127,7 @@ void Image::Intensity(comp_t channels)
 	PushUndo(desc);
 
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Intensity(channels);
+		WorkPool::ForBands(*picture, [&](tPicture& band) { band.Intensity(channels); });
 
 	Dirty = true;
 }
@@ -1535,7 +2139,7 @@ void Image::AlphaBlendColour(const tColour4b& colour, comp_t channels, int final
 	PushUndo(desc);
 
 	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->AlphaBlendColour(colour, channels, finalAlpha);
+		WorkPool::ForBands(*picture, [&](tPicture& band) { band.AlphaBlendColour(colour, channels, finalAlpha); });
 
 	Dirty = true;
 }
@@ -1562,11 +2166,10 @@ void Image::SetFrameDuration(float duration, bool allFrames)
 }
 
 
-uint64 Image::Bind()
+uint64 Image::Bind(bool allowAsync)
 {
 	// We bind in a particular order starting with alternate picture if enabled and valid and
 	// then current picture. In all cases if the texture ID is already valid, we use it right away and early exit.
-	Config::ProfileData& profile = Config::GetProfileData();
 	if (AltPictureEnabled && AltPicture.IsValid())
 	{
 		if (TexIDAlt != 0)
@@ -1580,12 +2183,37 @@ uint64 Image::Bind()
 			return 0;
 
 		tList<tLayer> layers;
-		AltPicture.GenerateLayers(layers, tResampleFilter(profile.MipmapFilter), tResampleEdgeMode::Clamp, profile.MipmapChaining);
-		BindLayers(layers, TexIDAlt);
+		Mipmap::GenerateFastLayers(layers, AltPicture, Mipmap::IsEnabled());
+		TextureBytes += BindLayers(layers, TexIDAlt);
+		if ((layers.GetNumItems() > 1) && Mipmap::WantsQuality())
+			AltQualityJob = Mipmap::RequestQuality(&AltPicture);
+		MemoryManager::Account(this);
 		return TexIDAlt;
 	}
 
-	tPicture* currPic = GetCurrentPic();
+	// While previewing an adjustment the reduced copy is drawn in place of the current frame. It is only shown
+	// while the levels dialog is open so it does not get a quality mip chain.
+	if (AdjustProxy.IsValid())
+	{
+		if (TexIDProxy != 0)
+		{
+			glBindTexture(GL_TEXTURE_2D, TexIDProxy);
+			return TexIDProxy;
+		}
+
+		glGenTextures(1, &TexIDProxy);
+		if (TexIDProxy == 0)
+			return 0;
+
+		tList<tLayer> layers;
+		Mipmap::GenerateFastLayers(layers, AdjustProxy, Mipmap::IsEnabled());
+		TextureBytes += BindLayers(layers, TexIDProxy);
+		MemoryManager::Account(this);
+		return TexIDProxy;
+	}
+
+	// The frame slot is used so binding never decodes a frame held in block form.
+	tPicture* currPic = GetFrameSlot(FrameNum);
 	if (currPic && (currPic->TextureID != 0))
 	{
 		glBindTexture(GL_TEXTURE_2D, currPic->TextureID);
@@ -1597,28 +2225,334 @@ uint64 Image::Bind()
 
 	tiClamp(FrameNum, 0, GetNumPictures()-1);
 
+	// Nothing is uploaded here for huge pictures. DrawTiles uploads only the tiles it needs. Tiles are cut from
+	// decoded pixels so a block-compressed picture that is too big is decoded first.
+	if ((FrameTable.size() == 1) && BlockFrames[0] && TiledPicture::IsNeeded(BlockFrames[0]->Width, BlockFrames[0]->Height))
+		DecodeBlockFrameAt(0);
+	if ((FrameTable.size() == 1) && !CompactFrames[0])
+	{
+		tPicture* picture = FrameTable[0];
+		if (!Tiles && TiledPicture::IsNeeded(picture->GetWidth(), picture->GetHeight()))
+			Tiles = new TiledPicture(picture, ThumbCacheDir);
+		if (Tiles)
+			return 0;
+	}
+
+	// A large picture is handed to the loader thread. A synchronous bind while its upload is still in progress
+	// cancels it and uploads right away instead.
+	if (UploadJob && !allowAsync)
+	{
+		TextureUpload::Cancel(UploadJob);
+		UploadJob = nullptr;
+	}
+	else if (UploadJob || (allowAsync && UsesAsyncUpload()))
+	{
+		if (!UploadJob)
+			UploadJob = TextureUpload::Submit(FrameTable[FrameNum]);
+
+		uint texID = 0;
+		int64 numBytes = 0;
+		if (!TextureUpload::Collect(UploadJob, texID, numBytes))
+			return 0;
+
+		// If the loader thread failed we fall through and try on this thread.
+		UploadJob = nullptr;
+		if (texID != 0)
+		{
+			FrameTable[FrameNum]->TextureID = texID;
+			FrameTextureBytes[FrameNum] = numBytes;
+			TextureBytes += numBytes;
+			if (Mipmap::WantsQuality())
+				FrameQualityJobs[FrameNum] = Mipmap::RequestQuality(FrameTable[FrameNum]);
+			glBindTexture(GL_TEXTURE_2D, texID);
+			MemoryManager::Account(this);
+			return texID;
+		}
+	}
+
+	// Long animations only upload the current frame here. UpdateTextureRing streams in the frames around it.
+	if (UsesTextureRing())
+	{
+		BindFrame(FrameNum);
+		MemoryManager::Account(this);
+		currPic = GetFrameSlot(FrameNum);
+		return currPic ? currPic->TextureID : 0;
+	}
+
+	// The mip chains of all the decoded frames are built in parallel first. Uploading has to stay on this thread.
+	int numFrames = GetNumPictures();
+	std::vector<tPicture*> sources(numFrames, nullptr);
+	std::vector<tList<tLayer>> frameLayers(numFrames);
+	for (int frameNum = 0; frameNum < numFrames; frameNum++)
+	{
+		tPicture* picture = FrameTable[frameNum];
+		if ((picture->TextureID == 0) && !CompactFrames[frameNum] && picture->IsValid())
+			sources[frameNum] = picture;
+	}
+	Mipmap::GenerateFastLayers(numFrames, sources.data(), frameLayers.data(), Mipmap::IsEnabled());
+
 	// We do this in reverse order so that the last image we bind is the highest resolution image.
 	// This is more efficient when it comes to drawing the image since the lowest mip is likely not
 	// the one we're going to be viewing right after binding.
-	for (tPicture* picture = Pictures.Last(); picture; picture = picture->Prev())
+	for (int frameNum = numFrames-1; frameNum >= 0; frameNum--)
 	{
-		if (!picture->IsValid())
+		if (sources[frameNum])
+			UploadFrame(frameNum, frameLayers[frameNum], true);
+		else
+			BindFrame(frameNum);
+	}
+
+	MemoryManager::Account(this);
+	currPic = GetFrameSlot(FrameNum);
+	return currPic ? currPic->TextureID : 0;
+}
+
+
+void Image::BindFrame(int frameNum)
+{
+	tPicture* picture = FrameTable[frameNum];
+	if (picture->TextureID != 0)
+	{
+		glBindTexture(GL_TEXTURE_2D, picture->TextureID);
+		return;
+	}
+
+	if (BlockFrames[frameNum])
+	{
+		BindBlockFrame(frameNum);
+		return;
+	}
+
+	// Compact frames are expanded into a temporary picture just for the upload.
+	tPicture expanded;
+	tPicture* src = picture;
+	if (CompactFrames[frameNum])
+	{
+		const CompactFrame* compact = CompactFrames[frameNum];
+		expanded.Set(compact->Width, compact->Height, compact->Expand(), false);
+		src = &expanded;
+	}
+
+	if (!src->IsValid())
+		return;
+
+	// An expanded compact frame is temporary so no background job may read from it.
+	tList<tLayer> layers;
+	Mipmap::GenerateFastLayers(layers, *src, Mipmap::IsEnabled());
+	UploadFrame(frameNum, layers, src == picture);
+}
+
+
+void Image::BindBlockFrame(int frameNum)
+{
+	// The frames after this one are its lower mip levels when the file has them. With mipmapping on they are
+	// uploaded as this texture's chain. The max level keeps the texture complete if the chain stops early.
+	int numFrames = int(FrameTable.size());
+	int numLevels = 1;
+	while (Mipmap::IsEnabled() && (frameNum+numLevels < numFrames))
+	{
+		const tLayer* prev = BlockFrames[frameNum+numLevels-1];
+		const tLayer* next = BlockFrames[frameNum+numLevels];
+		if (!next || (next->Width != tMax(prev->Width/2, 1)) || (next->Height != tMax(prev->Height/2, 1)))
+			break;
+		numLevels++;
+	}
+
+	GLint srcFormat, dstFormat; GLenum srcType; bool compressed;
+	GetGLFormatInfo(srcFormat, srcType, dstFormat, compressed, BlockFrames[frameNum]->PixelFormat);
+	tAssert(compressed);
+
+	tPicture* picture = FrameTable[frameNum];
+	glGenTextures(1, &picture->TextureID);
+	glBindTexture(GL_TEXTURE_2D, picture->TextureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (numLevels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels-1);
+
+	int64 numBytes = 0;
+	for (int level = 0; level < numLevels; level++)
+	{
+		const tLayer* layer = BlockFrames[frameNum+level];
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, dstFormat, layer->Width, layer->Height, 0, layer->GetDataSize(), layer->Data);
+		numBytes += int64(layer->GetDataSize());
+	}
+
+	FrameTextureBytes[frameNum] = numBytes;
+	TextureBytes += numBytes;
+}
+
+
+void Image::UploadFrame(int frameNum, const tList<tLayer>& layers, bool allowQuality)
+{
+	tPicture* picture = FrameTable[frameNum];
+	tAssert(picture->TextureID == 0);
+	glGenTextures(1, &picture->TextureID);
+	FrameTextureBytes[frameNum] = BindLayers(layers, picture->TextureID);
+	TextureBytes += FrameTextureBytes[frameNum];
+
+	if (allowQuality && (layers.GetNumItems() > 1) && Mipmap::WantsQuality())
+		FrameQualityJobs[frameNum] = Mipmap::RequestQuality(picture);
+}
+
+
+void Image::UpdateQualityMipmaps()
+{
+	tList<tLayer> mips;
+	if (AltQualityJob && Mipmap::CollectQuality(AltQualityJob, mips))
+	{
+		AltQualityJob = nullptr;
+		ReplaceMipmaps(mips, TexIDAlt);
+		mips.Clear();
+	}
+
+	int numFrames = int(FrameQualityJobs.size());
+	for (int frameNum = 0; frameNum < numFrames; frameNum++)
+	{
+		Mipmap::QualityJob* job = FrameQualityJobs[frameNum];
+		if (!job || !Mipmap::CollectQuality(job, mips))
 			continue;
 
-		tAssert(picture->TextureID == 0);
-		glGenTextures(1, &picture->TextureID);
+		FrameQualityJobs[frameNum] = nullptr;
+		ReplaceMipmaps(mips, FrameTable[frameNum]->TextureID);
+		mips.Clear();
+	}
+}
+
 
-		tList<tLayer> layers;
-		picture->GenerateLayers(layers, tResampleFilter(profile.MipmapFilter), tResampleEdgeMode::Clamp, profile.MipmapChaining);
-		BindLayers(layers, picture->TextureID);
+void Image::ReplaceMipmaps(const tList<tLayer>& mips, uint texID)
+{
+	// The levels are the same sizes as the box-filtered ones they replace so the byte count does not change.
+	if (texID == 0)
+		return;
+
+	glBindTexture(GL_TEXTURE_2D, texID);
+	int mipmapLevel = 1;
+	for (tLayer* mip = mips.First(); mip; mip = mip->Next(), mipmapLevel++)
+		glTexSubImage2D(GL_TEXTURE_2D, mipmapLevel, 0, 0, mip->Width, mip->Height, GL_RGBA, GL_UNSIGNED_BYTE, mip->Data);
+}
+
+
+void Image::UnbindFrame(int frameNum)
+{
+	tPicture* picture = FrameTable[frameNum];
+	if (picture->TextureID == 0)
+		return;
+
+	if (FrameQualityJobs[frameNum])
+	{
+		Mipmap::CancelQuality(FrameQualityJobs[frameNum]);
+		FrameQualityJobs[frameNum] = nullptr;
 	}
-	currPic = GetCurrentPic();
-	return currPic ? currPic->TextureID : 0;
+
+	glDeleteTextures(1, &picture->TextureID);
+	picture->TextureID = 0;
+	TextureBytes -= FrameTextureBytes[frameNum];
+	FrameTextureBytes[frameNum] = 0;
+}
+
+
+bool Image::DrawTiles
+(
+	float left, float right, float bottom, float top, float viewW, float viewH,
+	const Renderer::ChannelFilter& filter, bool coarseOnly
+)
+{
+	if (!Tiles)
+		return false;
+
+	return Tiles->Draw(left, right, bottom, top, viewW, viewH, filter, coarseOnly);
+}
+
+
+bool Image::UsesAsyncUpload() const
+{
+	// Only single pictures for now. Compact frames would need expanding and the pixels must stay put while the
+	// loader thread reads them.
+	if (!TextureUpload::IsAvailable() || (FrameTable.size() != 1) || CompactFrames[0])
+		return false;
+
+	const tPicture* picture = FrameTable[0];
+	return int64(picture->GetWidth()) * int64(picture->GetHeight()) >= TextureUpload::MinAsyncArea;
+}
+
+
+bool Image::UsesTextureRing() const
+{
+	return FramesCompactable && (int(FrameTable.size()) > TextureRingAhead + TextureRingBehind + 1);
+}
+
+
+bool Image::UpdateTextureRing()
+{
+	// Nothing to stream if the current frame was never bound or has been unbound.
+	tPicture* currPic = FrameTable[FrameNum];
+	if (currPic->TextureID == 0)
+		return false;
+
+	int numFrames = int(FrameTable.size());
+	bool changed = false;
+	for (int f = 0; f < numFrames; f++)
+	{
+		if ((FrameTable[f]->TextureID != 0) && !IsInFrameWindow(f, TextureRingAhead, TextureRingBehind))
+		{
+			UnbindFrame(f);
+			changed = true;
+		}
+	}
+
+	// Nearest frames first, ahead of the playhead before behind it, so each frame is uploaded well before it is due.
+	int dir = FramePlayRev ? -1 : 1;
+	int budget = TextureUploadsPerUpdate;
+	bool pending = false;
+	for (int i = 1; i <= TextureRingAhead + TextureRingBehind; i++)
+	{
+		int offset = (i <= TextureRingAhead) ? dir*i : -dir*(i - TextureRingAhead);
+		int frameNum = (FrameNum + offset + numFrames) % numFrames;
+		if (FrameTable[frameNum]->TextureID != 0)
+			continue;
+
+		if (budget == 0)
+		{
+			pending = true;
+			break;
+		}
+		BindFrame(frameNum);
+		budget--;
+		changed = true;
+	}
+
+	// BindFrame leaves the last uploaded texture bound.
+	glBindTexture(GL_TEXTURE_2D, currPic->TextureID);
+	if (changed)
+		MemoryManager::Account(this);
+
+	return pending;
 }
 
 
 void Image::Unbind()
 {
+	if (UploadJob)
+	{
+		TextureUpload::Cancel(UploadJob);
+		UploadJob = nullptr;
+	}
+
+	delete Tiles;
+	Tiles = nullptr;
+
+	for (Mipmap::QualityJob*& job : FrameQualityJobs)
+	{
+		if (job)
+			Mipmap::CancelQuality(job);
+		job = nullptr;
+	}
+	if (AltQualityJob)
+	{
+		Mipmap::CancelQuality(AltQualityJob);
+		AltQualityJob = nullptr;
+	}
+
 	for (tPicture* pic = Pictures.First(); pic; pic = pic->Next())
 	{
 		if (pic->TextureID != 0)
@@ -1627,29 +2561,37 @@ void Image::Unbind()
 			pic->TextureID = 0;
 		}
 	}
+	FrameTextureBytes.assign(FrameTable.size(), 0);
 
 	if (TexIDAlt != 0)
 	{
 		glDeleteTextures(1, &TexIDAlt);
 		TexIDAlt = 0;
 	}
+	if (TexIDProxy != 0)
+	{
+		glDeleteTextures(1, &TexIDProxy);
+		TexIDProxy = 0;
+	}
+	TextureBytes = 0;
+	MemoryManager::Account(this);
 }
 
 
-void Image::BindLayers(const tList<tLayer>& layers, uint texID)
+int64 Image::BindLayers(const tList<tLayer>& layers, uint texID)
 {
 	if (layers.IsEmpty())
-		return;
+		return 0;
 
 	// Since all layers are the same pixel format we first check if we support loading the format and early exit if we don't.
-	// Note that ATM we are decoding all DDS files to RGBA, so they are not compressed.
+	// Note that block-compressed files are normally decoded to RGBA. BindBlockFrame uploads those kept as blocks.
 	GLint srcFormat, dstFormat; GLenum srcType; bool compressed;
 	tPixelFormat pixelFormat = layers.First()->PixelFormat;
 	GetGLFormatInfo(srcFormat, srcType, dstFormat, compressed, pixelFormat);
 	if (compressed  && (dstFormat == GL_INVALID_VALUE))
-		return;
+		return 0;
 	if (!compressed && ((srcFormat == GL_INVALID_VALUE) || (srcType == GL_INVALID_ENUM) || (dstFormat == GL_INVALID_VALUE)))
-		return;
+		return 0;
 
 	glBindTexture(GL_TEXTURE_2D, texID);
 	//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -1665,6 +2607,10 @@ void Image::BindLayers(const tList<tLayer>& layers, uint texID)
 		// If we're not mipmapping anyway, we might as well avoid bleeding that we get with GL_LINEAR.
 		// glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
+	int64 numBytes = 0;
+	for (tLayer* layer = layers.First(); layer; layer = layer->Next())
+		numBytes += int64(layer->GetDataSize());
+
 	int mipmapLevel = 0;
 	if (compressed) for (tLayer* layer = layers.First(); layer; layer = layer->Next(), mipmapLevel++)
 		// For each layer (non-mipmapped formats will only have one) we need to submit the texture data.
@@ -1679,6 +2625,8 @@ void Image::BindLayers(const tList<tLayer>& layers, uint texID)
 		// internalFormal GL_RGBA8 will be stored as BGRA so if the source isn't BGRA then some swizzling takes
 		// place. This is why PixelFormat_B8G8R8A8 is quite efficient for example.
 		glTexImage2D(GL_TEXTURE_2D, mipmapLevel, dstFormat, layer->Width, layer->Height, 0, srcFormat, srcType, layer->Data);
+
+	return numBytes;
 }
 
 
@@ -1805,9 +2753,9 @@ uint64 Image::BindThumbnail()
 		if (TexIDThumbnail == 0)
 			return 0;
 
-		Config::ProfileData& profile = Config::GetProfileData();
+		// Thumbnails are small and drawn near their native size so the fast chain is kept.
 		tList<tLayer> layers;
-		ThumbnailPicture.GenerateLayers(layers, tResampleFilter(profile.MipmapFilter), tResampleEdgeMode::Clamp, profile.MipmapChaining);
+		Mipmap::GenerateFastLayers(layers, ThumbnailPicture, Mipmap::IsEnabled(), 1);
 		BindLayers(layers, TexIDThumbnail);
 		return TexIDThumbnail;
 	}
@@ -1868,7 +2816,10 @@ void Image::GenerateThumbnail()
 			}
 		}
 		if (loaded)
+		{
+			MetaIndex::Store(*this);
 			return;
+		}
 	}
 
 	Image thumbLoader;
@@ -1892,9 +2843,11 @@ void Image::GenerateThumbnail()
 	int srcH = srcPic->GetHeight();
 	Cached_PrimaryWidth		= srcW;
 	Cached_PrimaryHeight	= srcH;
-	Cached_PrimaryArea		= srcW * srcH;
+	Cached_PrimaryArea		= int64(srcW) * int64(srcH);
 
+	Cached_PixelFormat		= thumbLoader.Info.SrcPixelFormat;
 	Cached_MetaData			= thumbLoader.Cached_MetaData;
+	MetaIndex::Store(*this);
 
 	// We make the thumbnail keep its aspect ratio.
 	float scaleX = float(ThumbWidth)  / float(srcW);
@@ -1913,7 +2866,7 @@ void Image::GenerateThumbnail()
 	tAssert((iw == ThumbWidth) || (ih == ThumbHeight));
 
 	// Create an image that is big (or small) enough to exactly match either the width or height without ruining the aspect.
-	srcPic->Resample(iw, ih, tResampleFilter::Bilinear);
+	Resampler::Resample(*srcPic, iw, ih, tResampleFilter::Bilinear);
 
 	// Center-crop the image to what we need. Cropping to a bigger size adds transparent pixels.
 	srcPic->Crop(ThumbWidth, ThumbHeight);
@@ -1925,8 +2878,9 @@ void Image::GenerateThumbnail()
 	writer.Begin(ThumbChunkInfoID);
 	writer.Write(Cached_PrimaryWidth);
 	writer.Write(Cached_PrimaryHeight);
+	// The area used to be an int followed by a zero pad. On little-endian machines the int64 has the same layout
+	// so existing cache files remain valid.
 	writer.Write(Cached_PrimaryArea);
-	writer.Write(0x00000000);
 	writer.End();
 
 	// Only save meta-data chunk if it's valid.
@@ -1958,6 +2912,9 @@ void Image::RequestThumbnail()
 		{
 			GenerateThumbnailBridge(this);
 			ThumbnailThreadFlag.clear();
+
+			// The main loop may be idle. It needs to run to pick up the thumbnail and start the next request.
+			WakeMainLoop();
 		}
 	);
 }
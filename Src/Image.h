@@ -15,6 +15,8 @@
 #pragma once
 #include <thread>
 #include <atomic>
+#include <vector>
+#include <functional>
 #include <glad/glad.h>
 #include <Foundation/tList.h>
 #include <Foundation/tString.h>
@@ -44,6 +46,11 @@
 #include <Image/tImageKTX.h>
 #include "Config.h"
 #include "Undo.h"
+#include "MemoryManager.h"
+#include "TextureUpload.h"
+#include "Mipmap.h"
+#include "TiledPicture.h"
+#include "WorkPool.h"
 namespace tImage { class tLayer; }
 namespace Viewer
 {
@@ -76,6 +83,12 @@ public:
 	void Play();
 	void Stop();
 	void UpdatePlaying(float dt);
+
+	// Call once per frame for the current image. Long animations only keep the frames near the playhead fully
+	// decoded and bound. This expands and uploads the frames about to be shown and compacts or unbinds a few of those
+	// far from the playhead. It also swaps in any finished high quality mipmaps. Returns true if there is more work
+	// to do.
+	bool UpdateFrameWindow();
 	bool FrameDurationPreviewEnabled	= false;
 	float FrameDurationPreview			= 1.0f/30.0f;
 	float FrameCurrCountdown			= 0.0f;
@@ -88,6 +101,13 @@ public:
 	bool Load(bool loadParamsFromConfig = true);																		// Load into main memory.
 	bool IsLoaded() const																								{ return (Pictures.Count() > 0); }
 
+	// Parses only the file header. Fills in the Info pixel format, colour profile, and file size (if not loaded), and
+	// the Cached_ primary dimensions, pixel format, and number of frames. No pixel memory is allocated. If maxPixels
+	// is > 0 and the total number of pixels a full load would decode is larger, or the number of frames can't be
+	// determined, OverBudget is returned. This lets callers reject decompression bombs before calling Load.
+	enum class ProbeResult { Success, Failed, OverBudget };
+	ProbeResult Probe(int64 maxPixels = 0, bool loadParamsFromConfig = true);
+
 	// These are structs used for specifying parameters when saving. Different image types support different
 	// features and therefore each needs a unique set of parameters. When calling Save you can optionally ask for these
 	// structures to be used to grab the parameters from. If they are not used, then the settings in the config
@@ -102,6 +122,10 @@ public:
 	tImage::tImageTIFF::SaveParams SaveParamsTIFF;
 	tImage::tImageWEBP::SaveParams SaveParamsWEBP;
 
+	// Seconds per frame the spatial quantizer may take when a GIF is saved with the spatial method. 0 means no limit.
+	// Like the structs above it is only used when the config is not.
+	float SaveSpatialBudgetGIF = 0.0f;
+
 	// Not all fileTypes are supported for save. Handles single and multi-frame images. If useConfigSaveParams is true
 	// any paramteres used for saving that are stored in the viewer config file will override the setting in the save
 	// param structures above. Parameters not in the config will use whatever is in the structs. If useConfigSaveParams
@@ -116,26 +140,52 @@ public:
 	bool Unload(bool force = false);
 	float GetLoadedTime() const																							{ return LoadedTime; }
 
+	// Memory accounting used by the memory manager. Picture bytes do not include the alt picture.
+	int64 GetPictureMemSizeBytes() const;
+	int64 GetAltPictureMemSizeBytes() const;
+	static int64 ComputePictureMemSizeBytes(int width, int height)														{ return int64(width) * int64(height) * int64(sizeof(tPixel4b)); }
+	int64 GetUndoMemSizeBytes() const																					{ return UndoStack.GetMemSizeBytes(); }
+	int64 GetTextureMemSizeBytes() const																				{ return TextureBytes + (Tiles ? Tiles->GetTextureBytes() : 0); }
+	int64 DropOldestUndo()																								{ return UndoStack.DropOldest(); }
+	int64 SpillOldestUndo(int64 bytesWanted)																			{ return UndoStack.Spill(bytesWanted); }
+	bool UpdateUndoSpill()																								{ return UndoStack.UpdateSpill(); }
+	bool IsUndoSpilling() const																							{ return UndoStack.IsSpilling(); }
+	MemoryManager::Record MemRecord;
+
 	// Bind to a texture ID and load into VRAM. If already in VRAM, it makes the texture current. Since some ImGui
 	// functions require a texture ID as parameter, this function return the ID. If the alt image is enabled, the bound
-	// texture and ID will be the alt image's. Returns 0 (invalid id) if there was a problem.
-	uint64 Bind();
+	// texture and ID will be the alt image's. Returns 0 (invalid id) if there was a problem. With allowAsync a large
+	// picture is handed to the loader thread and 0 is returned until its texture is ready. Call again each frame.
+	uint64 Bind(bool allowAsync = false);
 	void Unbind();
+
+	// Pictures bigger than the GPU texture limit have no single texture. Bind sets them up for tiled drawing and
+	// returns 0. Draw them with DrawTiles instead, which returns true if visible tiles are still being uploaded.
+	bool IsTiled() const																								{ return Tiles != nullptr; }
+	bool DrawTiles
+	(
+		float left, float right, float bottom, float top, float viewW, float viewH,
+		const Renderer::ChannelFilter&, bool coarseOnly
+	);
 	int GetWidth() const;
 	int GetHeight() const;
-	int GetArea() const;
+	int64 GetArea() const;
 	static const int MaxDim					/* Max width or height. */													= 65536;
 	tColour4b GetPixel(int x, int y) const;
 
 	// Some images can store multiple complete images inside a single file (multiple frames).
-	// The primary one is the first one.
-	tImage::tPicture* GetPrimaryPic() const																				{ return Pictures.First(); }
-	tImage::tPicture* GetFirstPic() const																				{ return Pictures.First(); }
-	tImage::tPicture* GetCurrentPic() const																				{ tImage::tPicture* pic = Pictures.First(); for (int i = 0; i < FrameNum; i++) pic = pic ? pic->Next() : nullptr; return pic; }
+	// The primary one is the first one. These all make sure the returned picture has its pixels.
+	tImage::tPicture* GetPrimaryPic() const																				{ return GetFramePic(0); }
+	tImage::tPicture* GetFirstPic() const																				{ return GetFramePic(0); }
+	tImage::tPicture* GetCurrentPic() const																				{ return GetFramePic(FrameNum); }
+	tImage::tPicture* GetFramePic(int frameNum) const;
 	const tList<tImage::tPicture>& GetPictures() const																	{ return Pictures; }
 
 	// Functions that edit and cause dirty flag to be set. Functions that return a bool will return false if the image
 	// is unmodified and the dirty flag is untouched. Functions that are void should be assumed to modify the image.
+	// The frames of multi-frame images are edited at the same time on the work pool, no more than MaxEditFrames at
+	// once. Each frame being edited may need a working copy, so a low limit bounds peak memory. Zero means no limit.
+	static int MaxEditFrames;
 	void Rotate90(bool antiClockWise);
 	bool Rotate(float angle, const tColour4b& fill, tImage::tResampleFilter upFilter, tImage::tResampleFilter downFilter);
 
@@ -146,7 +196,8 @@ public:
 
 	// Similar to above but uses spatial quantization to generate the palette. If ditherLevel is 0.0 it will compute a
 	// good dither amount for you based on the image dimensions and number of colours. Filter size must be 1, 3, or 5.
-	void QuantizeSpatial(int numColours, bool checkExact = true, double ditherLevel = 0.0, int filterSize = 3);
+	// The time budget is in seconds per frame, with 0 meaning no limit. See SpatialQuantizer.h.
+	void QuantizeSpatial(int numColours, bool checkExact = true, double ditherLevel = 0.0, int filterSize = 3, float timeBudget = 0.0f);
 
 	// Similar to above but uses neuquant algorighm to generate the palette. With a sampling factor of 1 the entire
 	// image is used in the learning phase. With a factor of 10, a pseudo-random subset of 1/10 of the pixels are used
@@ -156,7 +207,22 @@ public:
 	// Similar to above but uses Wu algorighm to generate the palette.
 	void QuantizeWu(int numColours, bool checkExact = true);
 
-	bool AdjustmentBegin();
+	// With preview set, adjustments of big pictures are made to a reduced copy of the current frame while adjusting
+	// and Bind shows the copy instead of the frame. Only the last adjustment made is applied to the full-resolution
+	// pictures, once, when AdjustmentEnd is called. AdjustRestoreOriginal discards it.
+	bool AdjustmentBegin(bool preview = false);
+	bool IsAdjustPreviewing() const																						{ return AdjustProxy.IsValid(); }
+
+	// Hands over the previewed adjustment so it can be applied in the background instead of by AdjustmentEnd.
+	// Returns false if there is none. The adjustment needs AdjustmentBegin to have been called on the picture.
+	bool TakeAdjustPending(std::function<void(tImage::tPicture*)>& adjust, bool& allFrames);
+
+	// Applies an adjustment to the current pixels of a picture as if they were its original pixels. The rows are
+	// split between the work pool threads. The picture does not need AdjustmentBegin to have been called.
+	static void ApplyAdjustmentBanded
+	(
+		tImage::tPicture&, const std::function<void(tImage::tPicture*)>& adjust, WorkPool::Progress* = nullptr
+	);
 	enum class AdjChan { RGB, R, G, B, A };	// Adjustment is to individual RGBA channels or RGB/Intensity (default).
 	static comp_t ComponentBits(AdjChan);	// Converts to tChannels.
 
@@ -176,11 +242,27 @@ public:
 	void AdjustGetDefaults(float& brightness, float& contrast, float& blackPoint, float& midPoint, float& whitePoint, float& blackOut, float& whiteOut) const;
 	bool AdjustmentEnd();
 
+	// Edits that run in the background work on copies of the pictures. The copies are fully decoded and have no
+	// texture. ReplacePictures swaps in the edited copies, leaving the list empty, and the old pictures become the
+	// undo step without being copied again. Unbind first.
+	void CopyPictures(tList<tImage::tPicture>& copies) const;
+	void ReplacePictures(const tString& desc, tList<tImage::tPicture>& pictures);
+
+	// A pinned image is the target of a background edit. Like a dirty image it is only unloaded when forced, so the
+	// memory manager leaves it alone until the result is in. Pins nest.
+	void Pin()																											{ Pins++; }
+	void Unpin()																										{ tAssert(Pins > 0); Pins--; }
+	bool IsPinned() const																								{ return Pins > 0; }
+
 	void Flip(bool horizontal);
 	bool Crop(int newWidth, int newHeight, int originX, int originY, const tColour4b& fillColour = tColour4b::black);
 	bool Crop(int newWidth, int newHeight, tImage::tPicture::Anchor, const tColour4b& fillColour = tColour4b::black);
 	bool Paste(int regionW, int regionH, const tColour4b* regionPixels, int originX, int originY, comp_t channels = tCompBit_RGBA);
 	bool Paste(int regionW, int regionH, const tColour4b* regionPixels, tImage::tPicture::Anchor, comp_t channels = tCompBit_RGBA);
+
+	// The rect an anchored paste writes to in a picture of the given size, for its undo step. It is widened by a pixel
+	// on each side so it covers the pasted area however the anchor rounds, and is not clipped to the picture.
+	static Undo::Step_Region::Rect GetPasteRect(int picW, int picH, int regionW, int regionH, tImage::tPicture::Anchor);
 	bool Deborder(const tColour4b& borderColour, comp_t channels = tCompBit_RGBA);
 	bool Resample(int newWidth, int newHeight, tImage::tResampleFilter filter, tImage::tResampleEdgeMode edgeMode);
 	void SetPixelColour(int x, int y, const tColour4b&, bool pushUndo, bool supressDirty = false);
@@ -214,8 +296,8 @@ public:
 	void SetFrameDuration(float duration, bool allFrames = false);
 
 	// Undo and redo functions.
-	void Undo()																											{ UndoStack.Undo(Pictures, Dirty); }
-	void Redo()																											{ UndoStack.Redo(Pictures, Dirty); }
+	void Undo()																											{ ExpandAllFrames(); UndoStack.Undo(Pictures, Dirty); RebuildFrameTable(); }
+	void Redo()																											{ ExpandAllFrames(); UndoStack.Redo(Pictures, Dirty); RebuildFrameTable(); }
 	bool IsUndoAvailable() const																						{ return UndoStack.UndoAvailable(); }
 	bool IsRedoAvailable() const																						{ return UndoStack.RedoAvailable(); }
 	tString GetUndoDesc() const																							{ tString desc; tsPrintf(desc, "[%s]", UndoStack.GetUndoDesc().Chr()); return desc; }
@@ -235,8 +317,8 @@ public:
 
 		enum class OpacityEnum { False, True, Varies };	// Varies is for when there is more than one picture in the image (animated, mipmaps, etc) and they are not set all the same.
 		OpacityEnum Opacity								= OpacityEnum::False;
-		int FileSizeBytes								= 0;
-		int MemSizeBytes								= 0;
+		int64 FileSizeBytes								= 0;
+		int64 MemSizeBytes								= 0;
 	};
 
 	bool IsAltMipmapsPictureAvail() const																				{ return (AltPictureTyp == AltPictureType::MipmapSideBySide); }
@@ -267,11 +349,14 @@ public:
 	uint64 FileSizeB;									// Valid before load.
 	uint32 ShuffleValue;								// Valid before load.
 
-	// Members starting with "Cached" are stored in the cache/thumbnail file and are valid
-	// once the thumbnail is loaded. Used for sorting without having to do a full load.
+	// Members starting with "Cached" are stored in the cache/thumbnail file and the directory meta-index. They are
+	// valid once the thumbnail is loaded or the index entry is read. Used for sorting without having to do a full load.
 	int Cached_PrimaryWidth		= 0;						
 	int Cached_PrimaryHeight	= 0;
-	int Cached_PrimaryArea		= 0;
+	int64 Cached_PrimaryArea	= 0;
+	tImage::tPixelFormat Cached_PixelFormat = tImage::tPixelFormat::Invalid;
+	int Cached_NumFrames		= 0;					// Zero if unknown. Only set by Probe.
+	int64 Cached_NumPixels		= 0;					// Over all frames. Only set by Probe.
 	tImage::tMetaData Cached_MetaData;
 
 	const static uint32 ThumbChunkInfoID;
@@ -293,14 +378,85 @@ public:
 
 private:
 	bool UndoEnabled = true;
-	void PushUndo(const tString& desc)																					{ if (UndoEnabled) UndoStack.Push(Pictures, desc, Dirty); }
+	void PushUndo(const tString& desc)																					{ ExpandAllFrames(); if (UndoEnabled) UndoStack.Push(Pictures, desc, Dirty); }
+	void PushUndo(Undo::Step* step)																						{ if (UndoEnabled) UndoStack.Push(step); else delete step; }
 	void PopUndo()																										{ if (UndoEnabled) UndoStack.Pop(); }
 
+	// Edits that touch a bounded region, or are exactly invertible, push smaller steps than the full copy PushUndo
+	// makes. Both expand all frames first, just like PushUndo.
+	void PushUndoRegion(const tString& desc, const std::vector<Undo::Step_Region::Rect>& rects)						{ ExpandAllFrames(); if (UndoEnabled) UndoStack.Push(new Undo::Step_Region(desc, Dirty, Pictures, rects)); }
+	void PushUndoOperation(const tString& desc, Undo::Operation op)														{ ExpandAllFrames(); PushUndo(new Undo::Step_Operation(desc, Dirty, op)); }
+
 	// There are multiple pictures for a few reasons. Images with multiple frames (gifs, exrs, tiffs, webps etc) store
 	// the individual frames as separate pictures in the list, dds files may store a cubemap and the 6 sides are stored
 	// in the picture list, and dds files may contain mipmaps, also stored in the list.
 	tList<tImage::tPicture> Pictures;
 
+	// Indexed by frame number so frame lookup during playback and scrubbing is constant time. Must be rebuilt with
+	// RebuildFrameTable whenever pictures are added to or removed from the list.
+	std::vector<tImage::tPicture*> FrameTable;
+	void RebuildFrameTable();
+
+	// Frames of long animations that are away from the playhead are held in this palettized form if they have 256 or
+	// fewer colours. It is lossless and a quarter of the size. The tPicture stays in the list, but without pixels,
+	// so it keeps its duration and texture ID. Anything that reads pixels from arbitrary frames must go through
+	// GetFramePic or call ExpandAllFrames first. Editing (via PushUndo) and saving expand everything.
+	struct CompactFrame
+	{
+		~CompactFrame()																									{ delete[] Indices; }
+		tPixel4b* Expand() const;																						// Returns a new[] buffer.
+		int64 GetMemSizeBytes() const;
+
+		int Width							= 0;
+		int Height							= 0;
+		int NumColours						= 0;
+		tPixel4b Palette[256];
+		uint8* Indices						= nullptr;
+	};
+	static const int FrameWindowMinFrames																				= 32;
+	static const int FrameWindowAhead																					= 8;
+	static const int FrameWindowBehind																					= 2;
+	static const int FrameCompactPerUpdate																				= 4;
+
+	bool FramesCompactable				= false;		// Only animation frames. Not mipmaps or cubemap faces.
+	bool Adjusting						= false;		// tPicture keeps the original pixels while adjusting.
+
+	// The proxy is only made for pictures with more pixels than a square of this size. Small enough that adjusting
+	// it is interactive and big enough to look sharp when fitted to a large monitor.
+	static const int AdjustProxyMaxDim																					= 2048;
+	tImage::tPicture AdjustProxy;
+	std::function<void(tImage::tPicture*)> AdjustPending;	// The last adjustment while previewing.
+	bool AdjustPendingAllFrames			= true;
+	bool AdjustPixelsOriginal			= false;		// No adjustment has changed the pixels since they were saved.
+	bool AdjustDirtyOriginal			= false;		// Whether there were unsaved changes before adjusting.
+	void ApplyAdjustment(const std::function<void(tImage::tPicture*)>& adjust, bool allFrames);
+
+	// Calls edit for every picture. Pictures are shared between the work pool threads and each edit may only touch
+	// the picture it is given.
+	void ForEachPicture(const std::function<void(tImage::tPicture&)>& edit);
+	int CompactCursor					= 0;
+	mutable std::vector<CompactFrame*> CompactFrames;	// Parallel to FrameTable. Null if the frame is decoded.
+	std::vector<bool> FrameIncompressible;				// Has more than 256 colours. No point trying again.
+	bool IsInFrameWindow(int frameNum, int windowAhead, int windowBehind) const;
+	bool CompactFrameAt(int frameNum);
+	void ExpandFrameAt(int frameNum) const;
+	void ExpandAllFrames() const;
+	void ClearCompactFrames();
+
+	// With the KeepBlockCompressed profile option, dds, ktx and pvr files in a block format OpenGL can sample are
+	// kept in their native form rather than decoded to RGBA. As with compact frames the pictures stay in the list
+	// without pixels. The texture is uploaded straight from the blocks and a frame is only decoded when something
+	// asks for its pixels through GetFramePic, which includes editing and saving. GetPixel decodes a single block.
+	mutable tList<tImage::tLayer> BlockLayers;			// One per picture, in order, while any are undecoded.
+	mutable std::vector<tImage::tLayer*> BlockFrames;	// Parallel to FrameTable. Null if the frame is decoded.
+	bool PopulateBlockFrames(const tImage::tBaseImage&, bool rowsReversed);		// Returns false if it must be decoded.
+	void DecodeBlockFrameAt(int frameNum) const;
+	tColour4b GetBlockFramePixel(int frameNum, int x, int y) const;
+	void BindBlockFrame(int frameNum);
+
+	// Unlike GetFramePic these never expand or decode. The picture may have no pixels.
+	tImage::tPicture* GetFrameSlot(int frameNum) const																	{ return ((frameNum >= 0) && (frameNum < int(FrameTable.size()))) ? FrameTable[frameNum] : nullptr; }
+
 	// The 'alternative' picture is valid when there is another valid way of displaying the image.
 	// Specifically for cubemaps and dds files with mipmaps this offers an alternative view.
 	bool AltPictureEnabled = false;
@@ -327,10 +483,34 @@ private:
 
 	// Zero is invalid and means texture has never been bound and loaded into VRAM.
 	uint TexIDAlt			= 0;
+	uint TexIDProxy			= 0;
 	uint TexIDThumbnail		= 0;
+	int64 TextureBytes		= 0;						// VRAM used by all bound textures except the thumbnail.
+
+	// Long animations only keep textures for a ring of frames around the playhead. The ring is smaller than the
+	// decoded-frame window so every frame in it can be uploaded straight from a decoded picture.
+	static const int TextureRingAhead																					= 6;
+	static const int TextureRingBehind																					= 2;
+	static const int TextureUploadsPerUpdate																			= 2;
+	std::vector<int64> FrameTextureBytes;				// Parallel to FrameTable. Zero if the frame is not bound.
+	TextureUpload::Job* UploadJob		= nullptr;		// Upload of the current frame in progress on the loader thread.
+	bool UsesAsyncUpload() const;
+
+	// Textures are first uploaded with a fast box-filtered mip chain. If the profile asks for a better filter these
+	// jobs build it in the background and UpdateQualityMipmaps swaps it in.
+	std::vector<Mipmap::QualityJob*> FrameQualityJobs;	// Parallel to FrameTable.
+	Mipmap::QualityJob* AltQualityJob	= nullptr;
+	TiledPicture* Tiles					= nullptr;		// Only for single pictures over the texture size limit.
+	void UploadFrame(int frameNum, const tList<tImage::tLayer>&, bool allowQuality);
+	void UpdateQualityMipmaps();
+	void ReplaceMipmaps(const tList<tImage::tLayer>& mips, uint texID);
+	bool UsesTextureRing() const;
+	bool UpdateTextureRing();							// Returns true if frames in the ring are still unbound.
+	void BindFrame(int frameNum);
+	void UnbindFrame(int frameNum);
 
 	// Returns the approx main mem size of this image. Considers the Pictures list and the AltPicture.
-	int GetMemSizeBytes() const;
+	int64 GetMemSizeBytes() const;
 
 	// This function can handle DDS, PVR, and KTX images and populate the pictures list as well as create the
 	// alternate image if necessary.
@@ -339,10 +519,11 @@ private:
 	void MultiSurfaceCreateAltMipmapPicture(const teList<tImage::tLayer>&);
 
 	void GetGLFormatInfo(GLint& srcFormat, GLenum& srcType, GLint& dstFormat, bool& compressed, tImage::tPixelFormat);
-	void BindLayers(const tList<tImage::tLayer>&, uint texID);
+	int64 BindLayers(const tList<tImage::tLayer>&, uint texID);		// Returns the number of bytes uploaded.
 
 	float LoadedTime = -1.0f;
 	bool Dirty = false;
+	int Pins = 0;
 
 	// Undo / Redo
 	Undo::Stack UndoStack;
@@ -0,0 +1,1015 @@
+// ImageHeader.cpp
+//
+// Header-only parsing of all the image types the viewer can load. Only the start of the file (or for tiff, the IFD
+// chain) is read. No pixel data is decoded or allocated. Used for sorting, planning, and rejecting images that are
+// too large before they are loaded.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <cstdio>
+#include <Foundation/tStandard.h>
+#include <Foundation/tFundamentals.h>
+#include <System/tFile.h>
+#include "ImageHeader.h"
+#include "Image.h"
+using namespace tStd;
+using namespace tSystem;
+using namespace tImage;
+using namespace tMath;
+
+
+namespace Viewer
+{
+	namespace ImageHeader
+	{
+		bool ReadJPG(Info&, const uint8* data, int numBytes, bool exifOrient);
+		bool ReadPNG(Info&, const uint8* data, int numBytes);
+		bool ReadBMP(Info&, const uint8* data, int numBytes);
+		bool ReadGIF(Info&, const uint8* data, int numBytes);
+		bool ReadQOI(Info&, const uint8* data, int numBytes);
+		bool ReadTGA(Info&, const uint8* data, int numBytes);
+		bool ReadWEBP(Info&, const uint8* data, int numBytes);
+		bool ReadICO(Info&, const uint8* data, int numBytes);
+		bool ReadHDR(Info&, const uint8* data, int numBytes);
+		bool ReadEXR(Info&, const uint8* data, int numBytes);
+		bool ReadDDS(Info&, const uint8* data, int numBytes);
+		bool ReadPVR(Info&, const uint8* data, int numBytes);
+		bool ReadKTX(Info&, const uint8* data, int numBytes);
+		bool ReadKTX2(Info&, const uint8* data, int numBytes);
+		bool ReadASTC(Info&, const uint8* data, int numBytes);
+		bool ReadPKM(Info&, const uint8* data, int numBytes);
+
+		// Tiff files may store the IFDs anywhere so this one reads from the file directly.
+		bool ReadTIFF(Info&, const tString& filename);
+
+		// These walk every block (or chunk) of the file to count the frames. Return 0 if the file is malformed.
+		int CountFramesGIF(const tString& filename);
+		int CountFramesWEBP(const tString& filename);
+
+		// Forward-only buffered reader for walking files made of many small blocks.
+		class BlockReader
+		{
+		public:
+			BlockReader(tFileHandle file)												: File(file) { }
+			bool ReadByte(uint8& byte)													{ if ((Pos >= Count) && !Fill()) return false; byte = Buffer[Pos++]; return true; }
+			bool Skip(int numBytes);
+
+		private:
+			bool Fill()																	{ Pos = 0; Count = tReadFile(File, Buffer, BufferSize); return Count > 0; }
+			static const int BufferSize													= 64*1024;
+			tFileHandle File;
+			uint8 Buffer[BufferSize];
+			int Pos																		= 0;
+			int Count																	= 0;
+		};
+
+		// Sum of pixels over numMips levels for numFaces faces.
+		int64 ComputeMipChainPixels(int width, int height, int numMips, int numFaces);
+
+		// Index of the ASTC block size in tPixelFormat order. Returns -1 if not a valid block size.
+		int GetASTCBlockIndex(int blockW, int blockH);
+
+		// Length of a null-terminated string that may not be terminated before maxLen. Returns maxLen in that case.
+		inline int GetStrlen(const uint8* s, int maxLen)	{ int len = 0; while ((len < maxLen) && s[len]) len++; return len; }
+
+		inline uint32 GetBE16(const uint8* d)				{ return (uint32(d[0]) << 8) | uint32(d[1]); }
+		inline uint32 GetBE32(const uint8* d)				{ return (uint32(d[0]) << 24) | (uint32(d[1]) << 16) | (uint32(d[2]) << 8) | uint32(d[3]); }
+		inline uint32 GetLE16(const uint8* d)				{ return uint32(d[0]) | (uint32(d[1]) << 8); }
+		inline uint32 GetLE24(const uint8* d)				{ return uint32(d[0]) | (uint32(d[1]) << 8) | (uint32(d[2]) << 16); }
+		inline uint32 GetLE32(const uint8* d)				{ return uint32(d[0]) | (uint32(d[1]) << 8) | (uint32(d[2]) << 16) | (uint32(d[3]) << 24); }
+	}
+}
+
+
+bool Viewer::ImageHeader::Read(Info& info, const tString& filename, tFileType fileType, bool exifOrient, bool countFrames)
+{
+	info = Info();
+	if (fileType == tFileType::TIFF)
+		return ReadTIFF(info, filename);
+
+	// How much of the file we need. Jpg and exr headers are variable length and come before the pixel data. For the
+	// jpg the SOF marker and exif meta-data come after the app segments. For png we look for an acTL chunk.
+	int numBytes = 0;
+	switch (fileType)
+	{
+		case tFileType::JPG:
+			numBytes = 256*1024;
+			break;
+
+		case tFileType::PNG:
+		case tFileType::APNG:
+		case tFileType::EXR:
+			numBytes = 64*1024;
+			break;
+
+		case tFileType::HDR:
+			numBytes = 4*1024;
+			break;
+
+		case tFileType::BMP:
+		case tFileType::GIF:
+		case tFileType::QOI:
+		case tFileType::TGA:
+		case tFileType::WEBP:
+		case tFileType::ICO:
+		case tFileType::DDS:
+		case tFileType::PVR:
+		case tFileType::KTX:
+		case tFileType::KTX2:
+		case tFileType::ASTC:
+		case tFileType::PKM:
+			numBytes = 256;
+			break;
+
+		default:
+			return false;
+	}
+
+	uint8* data = tLoadFileHead(filename, numBytes);
+	if (!data)
+		return false;
+
+	bool ok = Read(info, data, numBytes, fileType, exifOrient);
+	delete[] data;
+	if (!ok)
+		return false;
+
+	// Every frame of a gif or webp is composited onto the full canvas by the loader.
+	if (countFrames && (info.NumFrames == 0))
+	{
+		if (fileType == tFileType::GIF)
+			info.NumFrames = CountFramesGIF(filename);
+		else if (fileType == tFileType::WEBP)
+			info.NumFrames = CountFramesWEBP(filename);
+		info.NumPixels = int64(info.Width) * int64(info.Height) * int64(tMax(info.NumFrames, 1));
+	}
+
+	return true;
+}
+
+
+bool Viewer::ImageHeader::Read(Info& info, const uint8* data, int numBytes, tFileType fileType, bool exifOrient)
+{
+	info = Info();
+	bool ok = false;
+	switch (fileType)
+	{
+		case tFileType::JPG:	ok = ReadJPG(info, data, numBytes, exifOrient);	break;
+		case tFileType::PNG:
+		case tFileType::APNG:	ok = ReadPNG(info, data, numBytes);				break;
+		case tFileType::BMP:	ok = ReadBMP(info, data, numBytes);				break;
+		case tFileType::GIF:	ok = ReadGIF(info, data, numBytes);				break;
+		case tFileType::QOI:	ok = ReadQOI(info, data, numBytes);				break;
+		case tFileType::TGA:	ok = ReadTGA(info, data, numBytes);				break;
+		case tFileType::WEBP:	ok = ReadWEBP(info, data, numBytes);			break;
+		case tFileType::ICO:	ok = ReadICO(info, data, numBytes);				break;
+		case tFileType::HDR:	ok = ReadHDR(info, data, numBytes);				break;
+		case tFileType::EXR:	ok = ReadEXR(info, data, numBytes);				break;
+		case tFileType::DDS:	ok = ReadDDS(info, data, numBytes);				break;
+		case tFileType::PVR:	ok = ReadPVR(info, data, numBytes);				break;
+		case tFileType::KTX:	ok = ReadKTX(info, data, numBytes);				break;
+		case tFileType::KTX2:	ok = ReadKTX2(info, data, numBytes);			break;
+		case tFileType::ASTC:	ok = ReadASTC(info, data, numBytes);			break;
+		case tFileType::PKM:	ok = ReadPKM(info, data, numBytes);				break;
+		default:																break;
+	}
+
+	if (!ok || (info.Width <= 0) || (info.Height <= 0) || (info.Width > Image::MaxDim) || (info.Height > Image::MaxDim))
+	{
+		info = Info();
+		return false;
+	}
+
+	// Readers for multi-surface types fill in NumPixels themselves since the surfaces are not all the same size.
+	if (info.NumPixels <= 0)
+		info.NumPixels = int64(info.Width) * int64(info.Height) * int64(tMax(info.NumFrames, 1));
+
+	return true;
+}
+
+
+int64 Viewer::ImageHeader::ComputeMipChainPixels(int width, int height, int numMips, int numFaces)
+{
+	int64 numPixels = 0;
+	for (int mip = 0; mip < numMips; mip++)
+	{
+		numPixels += int64(width) * int64(height);
+		width = tMax(width/2, 1);
+		height = tMax(height/2, 1);
+	}
+	return numPixels * int64(numFaces);
+}
+
+
+int Viewer::ImageHeader::GetASTCBlockIndex(int blockW, int blockH)
+{
+	// Same order as the ASTC pixel formats.
+	const int blockDims[][2] =
+	{
+		{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+		{ 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 }
+	};
+	for (int b = 0; b < tNumElements(blockDims); b++)
+		if ((blockDims[b][0] == blockW) && (blockDims[b][1] == blockH))
+			return b;
+	return -1;
+}
+
+
+bool Viewer::ImageHeader::ReadJPG(Info& info, const uint8* data, int numBytes, bool exifOrient)
+{
+	if ((numBytes < 4) || (data[0] != 0xFF) || (data[1] != 0xD8))
+		return false;
+
+	int pos = 2;
+	bool found = false;
+	while (pos+4 <= numBytes)
+	{
+		if (data[pos] != 0xFF)
+			return false;
+		uint8 marker = data[pos+1];
+		if (marker == 0xFF)
+		{
+			pos++;
+			continue;
+		}
+
+		// Standalone markers have no length.
+		if ((marker == 0x01) || ((marker >= 0xD0) && (marker <= 0xD7)))
+		{
+			pos += 2;
+			continue;
+		}
+
+		// Start of scan. No more headers after this.
+		if (marker == 0xDA)
+			break;
+
+		int segLen = GetBE16(data+pos+2);
+
+		// SOF0 to SOF15 except DHT (C4), JPG (C8), and DAC (CC).
+		bool isSOF = (marker >= 0xC0) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC);
+		if (isSOF && (pos+10 <= numBytes))
+		{
+			info.Height			= GetBE16(data+pos+5);
+			info.Width			= GetBE16(data+pos+7);
+			int numComps		= data[pos+9];
+			info.PixelFormat	= (numComps >= 3) ? tPixelFormat::R8G8B8 : tPixelFormat::Invalid;
+			found = true;
+			break;
+		}
+		pos += 2 + segLen;
+	}
+
+	// The meta-data parser finds the exif segment itself. It only needs the start of the file.
+	info.MetaData.Set(data, numBytes);
+	if (!found)
+		return false;
+
+	info.NumFrames = 1;
+	info.ColourProfile = tColourProfile::sRGB;
+
+	// Match what a full load gives us if the loader is going to apply the exif orientation.
+	const tMetaDatum& orient = info.MetaData[tMetaTag::Orientation];
+	if (exifOrient && orient.IsSet() && (orient.Uint32 >= 5) && (orient.Uint32 <= 8))
+	{
+		int width = info.Width;
+		info.Width = info.Height;
+		info.Height = width;
+	}
+
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadPNG(Info& info, const uint8* data, int numBytes)
+{
+	const uint8 sig[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+	if ((numBytes < 33) || tMemcmp(data, sig, 8) || tMemcmp(data+12, "IHDR", 4))
+		return false;
+
+	info.Width			= GetBE32(data+16);
+	info.Height			= GetBE32(data+20);
+	int bitDepth		= data[24];
+	int colourType		= data[25];
+	switch (colourType)
+	{
+		case 2:		info.PixelFormat = (bitDepth == 16) ? tPixelFormat::R16G16B16 : tPixelFormat::R8G8B8;			break;
+		case 6:		info.PixelFormat = (bitDepth == 16) ? tPixelFormat::R16G16B16A16 : tPixelFormat::R8G8B8A8;		break;
+		case 3:		info.PixelFormat = tPixelFormat(int(tPixelFormat::FirstPalette) + bitDepth - 1);				break;
+		default:	info.PixelFormat = tPixelFormat::Invalid;														break;
+	}
+	info.ColourProfile = tColourProfile::sRGB;
+	info.NumFrames = 1;
+
+	// An acTL chunk must come before the first IDAT if the png is animated. The caller decides whether an apng inside
+	// a png file is actually loaded as animated.
+	int pos = 33;
+	while (pos+12 <= numBytes)
+	{
+		uint32 chunkLen = GetBE32(data+pos);
+		const uint8* chunkType = data+pos+4;
+		if (!tMemcmp(chunkType, "IDAT", 4))
+			break;
+		if (!tMemcmp(chunkType, "acTL", 4))
+		{
+			// The count is unsigned. Clamp before converting so huge counts don't wrap to 1 or negative.
+			info.NumFrames = int(tClamp(GetBE32(data+pos+8), uint32(1), uint32(0x7FFFFFFF)));
+			break;
+		}
+		if (chunkLen > uint32(numBytes))
+			break;
+		pos += 12 + int(chunkLen);
+	}
+
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadBMP(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 30) || (data[0] != 'B') || (data[1] != 'M'))
+		return false;
+
+	// Height may be negative for top-down bitmaps.
+	info.Width			= int32(GetLE32(data+18));
+	info.Height			= tAbs(int32(GetLE32(data+22)));
+	int bpp				= GetLE16(data+28);
+	switch (bpp)
+	{
+		case 32:	info.PixelFormat = tPixelFormat::B8G8R8A8;										break;
+		case 24:	info.PixelFormat = tPixelFormat::B8G8R8;										break;
+		case 1: case 4: case 8:
+					info.PixelFormat = tPixelFormat(int(tPixelFormat::FirstPalette) + bpp - 1);		break;
+		default:	info.PixelFormat = tPixelFormat::Invalid;										break;
+	}
+	info.ColourProfile = tColourProfile::sRGB;
+	info.NumFrames = 1;
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadGIF(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 11) || tMemcmp(data, "GIF8", 4))
+		return false;
+
+	// The number of frames is not known without walking every block in the file.
+	info.Width			= GetLE16(data+6);
+	info.Height			= GetLE16(data+8);
+	int paletteBits		= (data[10] & 0x07) + 1;
+	info.PixelFormat	= tPixelFormat(int(tPixelFormat::FirstPalette) + paletteBits - 1);
+	info.ColourProfile	= tColourProfile::sRGB;
+	return true;
+}
+
+
+int Viewer::ImageHeader::CountFramesGIF(const tString& filename)
+{
+	tFileHandle file = tOpenFile(filename.Chr(), "rb");
+	if (!file)
+		return 0;
+
+	// Skip the header, logical screen descriptor, and global colour table if present.
+	BlockReader* reader = new BlockReader(file);
+	uint8 screen[13];
+	bool ok = true;
+	for (int b = 0; (b < 13) && ok; b++)
+		ok = reader->ReadByte(screen[b]);
+	if (!ok || tMemcmp(screen, "GIF8", 4))
+	{
+		delete reader;
+		tCloseFile(file);
+		return 0;
+	}
+	if (screen[10] & 0x80)
+		ok = reader->Skip(3 * (1 << ((screen[10] & 0x07) + 1)));
+
+	// Every image descriptor is a frame. Extensions and image data are runs of length-prefixed sub-blocks ending in a
+	// zero length. A file truncated after some whole frames still loads those so we count them.
+	int numFrames = 0;
+	uint8 introducer = 0;
+	while (ok && reader->ReadByte(introducer) && (introducer != 0x3B))
+	{
+		uint8 label = 0;
+		if (introducer == 0x21)
+		{
+			ok = reader->ReadByte(label);
+		}
+		else if (introducer == 0x2C)
+		{
+			uint8 descriptor[9];
+			for (int b = 0; (b < 9) && ok; b++)
+				ok = reader->ReadByte(descriptor[b]);
+			if (ok && (descriptor[8] & 0x80))
+				ok = reader->Skip(3 * (1 << ((descriptor[8] & 0x07) + 1)));
+
+			// Lzw minimum code size.
+			ok = ok && reader->ReadByte(label);
+		}
+		else
+		{
+			break;
+		}
+
+		uint8 subBlockSize = 0;
+		while (ok && (ok = reader->ReadByte(subBlockSize)) && subBlockSize)
+			ok = reader->Skip(subBlockSize);
+
+		if (ok && (introducer == 0x2C) && (numFrames < 0x7FFFFFFF))
+			numFrames++;
+	}
+
+	delete reader;
+	tCloseFile(file);
+	return numFrames;
+}
+
+
+bool Viewer::ImageHeader::BlockReader::Skip(int numBytes)
+{
+	while (numBytes > 0)
+	{
+		if ((Pos >= Count) && !Fill())
+			return false;
+		int step = tMin(numBytes, Count-Pos);
+		Pos += step;
+		numBytes -= step;
+	}
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadQOI(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 14) || tMemcmp(data, "qoif", 4))
+		return false;
+
+	info.Width			= GetBE32(data+4);
+	info.Height			= GetBE32(data+8);
+	info.PixelFormat	= (data[12] == 4) ? tPixelFormat::R8G8B8A8 : tPixelFormat::R8G8B8;
+	info.ColourProfile	= (data[13] == 1) ? tColourProfile::lRGB : tColourProfile::sRGB;
+	info.NumFrames		= 1;
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadTGA(Info& info, const uint8* data, int numBytes)
+{
+	// Tga files have no magic number. We check the image type is one we know about.
+	if (numBytes < 18)
+		return false;
+	int imageType = data[2];
+	if ((imageType != 1) && (imageType != 2) && (imageType != 3) && (imageType != 9) && (imageType != 10) && (imageType != 11))
+		return false;
+
+	info.Width			= GetLE16(data+12);
+	info.Height			= GetLE16(data+14);
+	int bpp				= data[16];
+	switch (bpp)
+	{
+		case 32:	info.PixelFormat = tPixelFormat::B8G8R8A8;		break;
+		case 24:	info.PixelFormat = tPixelFormat::B8G8R8;		break;
+		default:	info.PixelFormat = tPixelFormat::Invalid;		break;
+	}
+	info.ColourProfile	= tColourProfile::sRGB;
+	info.NumFrames		= 1;
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadWEBP(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 30) || tMemcmp(data, "RIFF", 4) || tMemcmp(data+8, "WEBP", 4))
+		return false;
+
+	info.ColourProfile = tColourProfile::sRGB;
+	const uint8* chunk = data+12;
+	if (!tMemcmp(chunk, "VP8 ", 4))
+	{
+		info.Width			= GetLE16(data+26) & 0x3FFF;
+		info.Height			= GetLE16(data+28) & 0x3FFF;
+		info.PixelFormat	= tPixelFormat::R8G8B8;
+		info.NumFrames		= 1;
+		return true;
+	}
+
+	if (!tMemcmp(chunk, "VP8L", 4))
+	{
+		if (data[20] != 0x2F)
+			return false;
+		uint32 bits			= GetLE32(data+21);
+		info.Width			= (bits & 0x3FFF) + 1;
+		info.Height			= ((bits >> 14) & 0x3FFF) + 1;
+		info.PixelFormat	= ((bits >> 28) & 1) ? tPixelFormat::R8G8B8A8 : tPixelFormat::R8G8B8;
+		info.NumFrames		= 1;
+		return true;
+	}
+
+	if (!tMemcmp(chunk, "VP8X", 4))
+	{
+		// For animated webps the frame count needs a walk of the ANMF chunks. We leave it unknown.
+		uint8 flags			= data[20];
+		info.Width			= GetLE24(data+24) + 1;
+		info.Height			= GetLE24(data+27) + 1;
+		info.PixelFormat	= (flags & 0x10) ? tPixelFormat::R8G8B8A8 : tPixelFormat::R8G8B8;
+		info.NumFrames		= (flags & 0x02) ? 0 : 1;
+		return true;
+	}
+
+	return false;
+}
+
+
+int Viewer::ImageHeader::CountFramesWEBP(const tString& filename)
+{
+	tFileHandle file = tOpenFile(filename.Chr(), "rb");
+	if (!file)
+		return 0;
+
+	uint8 riff[12];
+	if ((tReadFile(file, riff, 12) != 12) || tMemcmp(riff, "RIFF", 4) || tMemcmp(riff+8, "WEBP", 4))
+	{
+		tCloseFile(file);
+		return 0;
+	}
+
+	// Each ANMF chunk is a frame. Chunk payloads are padded to an even size. The seek offset is an int so files
+	// bigger than that are reported as malformed.
+	int64 riffEnd = int64(GetLE32(riff+4)) + 8;
+	int64 offset = 12;
+	int numFrames = 0;
+	while (offset+8 <= riffEnd)
+	{
+		uint8 chunk[8];
+		if ((offset > 0x7FFFFFFF) || !tFileSeek(file, int(offset)) || (tReadFile(file, chunk, 8) != 8))
+		{
+			numFrames = 0;
+			break;
+		}
+
+		if (!tMemcmp(chunk, "ANMF", 4) && (numFrames < 0x7FFFFFFF))
+			numFrames++;
+		uint32 chunkSize = GetLE32(chunk+4);
+		offset += 8 + int64(chunkSize) + int64(chunkSize & 1);
+	}
+
+	tCloseFile(file);
+	return numFrames;
+}
+
+
+bool Viewer::ImageHeader::ReadICO(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 22) || (GetLE16(data) != 0) || (GetLE16(data+2) != 1))
+		return false;
+
+	// Each directory entry is 16 bytes. A zero width or height means 256.
+	int numImages = GetLE16(data+4);
+	if (numImages <= 0)
+		return false;
+
+	const uint8* entry	= data+6;
+	info.Width			= entry[0] ? entry[0] : 256;
+	info.Height			= entry[1] ? entry[1] : 256;
+	int bpp				= GetLE16(entry+6);
+	info.PixelFormat	= (bpp == 32) ? tPixelFormat::B8G8R8A8 : tPixelFormat::Invalid;
+	info.ColourProfile	= tColourProfile::sRGB;
+	info.NumFrames		= numImages;
+
+	int64 numPixels = 0;
+	for (int i = 0; (i < numImages) && (6+16*(i+1) <= numBytes); i++)
+	{
+		const uint8* e = data+6+16*i;
+		numPixels += int64(e[0] ? e[0] : 256) * int64(e[1] ? e[1] : 256);
+	}
+	info.NumPixels = numPixels;
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadHDR(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 11) || (tMemcmp(data, "#?RADIANCE", 10) && tMemcmp(data, "#?RGBE", 6)))
+		return false;
+
+	// The header is a set of text lines terminated by an empty line. The resolution line follows it and is of the
+	// form "-Y height +X width". The axes may be swapped or signed differently for other orientations.
+	int pos = 0;
+	bool emptyLine = false;
+	while ((pos < numBytes) && !emptyLine)
+	{
+		int lineStart = pos;
+		while ((pos < numBytes) && (data[pos] != '\n'))
+			pos++;
+		emptyLine = (pos == lineStart);
+		pos++;
+	}
+	if (!emptyLine || (pos >= numBytes))
+		return false;
+
+	char resLine[64];
+	int len = 0;
+	while ((pos < numBytes) && (data[pos] != '\n') && (len < 63))
+		resLine[len++] = char(data[pos++]);
+	resLine[len] = '\0';
+
+	char axis0 = 0, axis1 = 0;
+	char sign0 = 0, sign1 = 0;
+	int size0 = 0, size1 = 0;
+	if (sscanf(resLine, "%c%c %d %c%c %d", &sign0, &axis0, &size0, &sign1, &axis1, &size1) != 6)
+		return false;
+
+	info.Width			= (axis0 == 'Y') ? size1 : size0;
+	info.Height			= (axis0 == 'Y') ? size0 : size1;
+	info.ColourProfile	= tColourProfile::HDRa;
+	info.NumFrames		= 1;
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadEXR(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 8) || (GetLE32(data) != 0x01312F76))
+		return false;
+
+	// Each part header is a list of attributes (name, type, size, value) terminated by a null byte. Multi-part files
+	// have a list of headers terminated by an empty header. We get the dimensions from the first part.
+	uint32 version = GetLE32(data+4);
+	bool multiPart = (version & 0x1000) ? true : false;
+	int numParts = 0;
+	int pos = 8;
+	while (pos < numBytes)
+	{
+		// An empty header ends the multi-part header list.
+		if (data[pos] == 0)
+			break;
+
+		while ((pos < numBytes) && (data[pos] != 0))
+		{
+			const char* name = (const char*)(data+pos);
+			int nameLen = GetStrlen(data+pos, numBytes-pos);
+			int typePos = pos + nameLen + 1;
+			int typeLen = GetStrlen(data+typePos, numBytes-typePos);
+			int valuePos = typePos + typeLen + 1 + 4;
+			if (valuePos > numBytes)
+				return false;
+			int valueSize = int32(GetLE32(data + valuePos - 4));
+			if ((valueSize < 0) || (valuePos + valueSize > numBytes))
+				return false;
+
+			const uint8* value = data + valuePos;
+			if ((numParts == 0) && !tStrcmp(name, "dataWindow") && (valueSize == 16))
+			{
+				int xMin = int32(GetLE32(value+0));
+				int yMin = int32(GetLE32(value+4));
+				int xMax = int32(GetLE32(value+8));
+				int yMax = int32(GetLE32(value+12));
+				info.Width = xMax - xMin + 1;
+				info.Height = yMax - yMin + 1;
+			}
+			else if ((numParts == 0) && !tStrcmp(name, "channels") && (valueSize > 4))
+			{
+				// First channel's pixel type. 0 is uint, 1 is half, and 2 is float.
+				int chanNameLen = GetStrlen(value, valueSize);
+				if (chanNameLen + 5 <= valueSize)
+				{
+					uint32 pixelType = GetLE32(value + chanNameLen + 1);
+					if (pixelType == 1)			info.PixelFormat = tPixelFormat::R16G16B16A16f;
+					else if (pixelType == 2)	info.PixelFormat = tPixelFormat::R32G32B32A32f;
+				}
+			}
+			pos = valuePos + valueSize;
+		}
+		pos++;
+		numParts++;
+		if (!multiPart)
+			break;
+	}
+
+	info.ColourProfile	= tColourProfile::HDRa;
+	info.NumFrames		= tMax(numParts, 1);
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadDDS(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 128) || tMemcmp(data, "DDS ", 4) || (GetLE32(data+4) != 124))
+		return false;
+
+	uint32 flags		= GetLE32(data+8);
+	info.Height			= GetLE32(data+12);
+	info.Width			= GetLE32(data+16);
+	int numMips			= (flags & 0x00020000) ? tMax(int(GetLE32(data+28)), 1) : 1;
+	uint32 pfFlags		= GetLE32(data+80);
+	const uint8* fourCC	= data+84;
+	uint32 rgbBitCount	= GetLE32(data+88);
+	uint32 redMask		= GetLE32(data+92);
+	uint32 caps2		= GetLE32(data+112);
+	bool cubemap		= (caps2 & 0x00000200) ? true : false;
+	info.ColourProfile	= tColourProfile::sRGB;
+
+	if (pfFlags & 0x00000004)
+	{
+		if		(!tMemcmp(fourCC, "DXT1", 4))									info.PixelFormat = tPixelFormat::BC1DXT1;
+		else if	(!tMemcmp(fourCC, "DXT2", 4) || !tMemcmp(fourCC, "DXT3", 4))	info.PixelFormat = tPixelFormat::BC2DXT2DXT3;
+		else if	(!tMemcmp(fourCC, "DXT4", 4) || !tMemcmp(fourCC, "DXT5", 4))	info.PixelFormat = tPixelFormat::BC3DXT4DXT5;
+		else if	(!tMemcmp(fourCC, "DX10", 4) && (numBytes >= 148))
+		{
+			// DXGI format values.
+			uint32 dxgiFormat = GetLE32(data+128);
+			switch (dxgiFormat)
+			{
+				case 28: case 29:	info.PixelFormat = tPixelFormat::R8G8B8A8;			break;
+				case 87: case 91:	info.PixelFormat = tPixelFormat::B8G8R8A8;			break;
+				case 71: case 72:	info.PixelFormat = tPixelFormat::BC1DXT1;			break;
+				case 74: case 75:	info.PixelFormat = tPixelFormat::BC2DXT2DXT3;		break;
+				case 77: case 78:	info.PixelFormat = tPixelFormat::BC3DXT4DXT5;		break;
+				case 98: case 99:	info.PixelFormat = tPixelFormat::BC7;				break;
+				case 96:
+					info.PixelFormat = tPixelFormat::BC6S;
+					info.ColourProfile = tColourProfile::HDRa;
+					break;
+			}
+			if (GetLE32(data+136) & 0x00000004)
+				cubemap = true;
+		}
+	}
+	else if (rgbBitCount == 32)
+	{
+		info.PixelFormat = (redMask == 0x00FF0000) ? tPixelFormat::B8G8R8A8 : tPixelFormat::R8G8B8A8;
+	}
+	else if (rgbBitCount == 24)
+	{
+		info.PixelFormat = (redMask == 0x00FF0000) ? tPixelFormat::B8G8R8 : tPixelFormat::R8G8B8;
+	}
+
+	int numFaces		= cubemap ? 6 : 1;
+	info.NumFrames		= numMips * numFaces;
+	info.NumPixels		= ComputeMipChainPixels(info.Width, info.Height, numMips, numFaces);
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadPVR(Info& info, const uint8* data, int numBytes)
+{
+	if (numBytes < 52)
+		return false;
+
+	// V3 headers start with the version. Legacy V2 headers start with the header size and have a magic further in.
+	if (GetLE32(data) == 0x03525650)
+	{
+		uint32 colourSpace	= GetLE32(data+16);
+		info.Height			= GetLE32(data+24);
+		info.Width			= GetLE32(data+28);
+		int numFaces		= tMax(int(GetLE32(data+40)), 1);
+		int numMips			= tMax(int(GetLE32(data+44)), 1);
+		info.ColourProfile	= (colourSpace == 1) ? tColourProfile::sRGB : tColourProfile::lRGB;
+
+		// Only the first surface of an array is displayed so the number of surfaces at offset 36 is not used.
+		info.NumFrames		= numMips * numFaces;
+		info.NumPixels		= ComputeMipChainPixels(info.Width, info.Height, numMips, numFaces);
+		return true;
+	}
+
+	if ((GetLE32(data) == 52) && !tMemcmp(data+44, "PVR!", 4))
+	{
+		info.Height			= GetLE32(data+4);
+		info.Width			= GetLE32(data+8);
+		int numMips			= int(GetLE32(data+12)) + 1;
+		info.ColourProfile	= tColourProfile::sRGB;
+		info.NumFrames		= numMips;
+		info.NumPixels		= ComputeMipChainPixels(info.Width, info.Height, numMips, 1);
+		return true;
+	}
+
+	return false;
+}
+
+
+bool Viewer::ImageHeader::ReadKTX(Info& info, const uint8* data, int numBytes)
+{
+	const uint8 ident[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	if ((numBytes < 64) || tMemcmp(data, ident, 12) || (GetLE32(data+12) != 0x04030201))
+		return false;
+
+	uint32 glInternalFormat	= GetLE32(data+28);
+	info.Width				= GetLE32(data+36);
+	info.Height				= tMax(int(GetLE32(data+40)), 1);
+	int numFaces			= tMax(int(GetLE32(data+52)), 1);
+	int numMips				= tMax(int(GetLE32(data+56)), 1);
+
+	info.ColourProfile = tColourProfile::lRGB;
+	switch (glInternalFormat)
+	{
+		case 0x8051:	info.PixelFormat = tPixelFormat::R8G8B8;			break;
+		case 0x8058:	info.PixelFormat = tPixelFormat::R8G8B8A8;			break;
+		case 0x83F0:	info.PixelFormat = tPixelFormat::BC1DXT1;			break;
+		case 0x83F1:	info.PixelFormat = tPixelFormat::BC1DXT1A;			break;
+		case 0x83F2:	info.PixelFormat = tPixelFormat::BC2DXT2DXT3;		break;
+		case 0x83F3:	info.PixelFormat = tPixelFormat::BC3DXT4DXT5;		break;
+		case 0x8E8C:	info.PixelFormat = tPixelFormat::BC7;				break;
+		case 0x8E8D:
+			info.PixelFormat = tPixelFormat::BC7;
+			info.ColourProfile = tColourProfile::sRGB;
+			break;
+		case 0x8E8E:
+			info.PixelFormat = tPixelFormat::BC6S;
+			info.ColourProfile = tColourProfile::HDRa;
+			break;
+		default:
+			// ASTC linear is 0x93B0 to 0x93BD and sRGB is 0x93D0 to 0x93DD. Same block order as the pixel formats.
+			if ((glInternalFormat >= 0x93B0) && (glInternalFormat <= 0x93BD))
+				info.PixelFormat = tPixelFormat(int(tPixelFormat::FirstASTC) + int(glInternalFormat - 0x93B0));
+			else if ((glInternalFormat >= 0x93D0) && (glInternalFormat <= 0x93DD))
+			{
+				info.PixelFormat = tPixelFormat(int(tPixelFormat::FirstASTC) + int(glInternalFormat - 0x93D0));
+				info.ColourProfile = tColourProfile::sRGB;
+			}
+			break;
+	}
+
+	info.NumFrames		= numMips * numFaces;
+	info.NumPixels		= ComputeMipChainPixels(info.Width, info.Height, numMips, numFaces);
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadKTX2(Info& info, const uint8* data, int numBytes)
+{
+	const uint8 ident[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	if ((numBytes < 48) || tMemcmp(data, ident, 12))
+		return false;
+
+	uint32 vkFormat		= GetLE32(data+12);
+	info.Width			= GetLE32(data+20);
+	info.Height			= tMax(int(GetLE32(data+24)), 1);
+	int numFaces		= tMax(int(GetLE32(data+36)), 1);
+	int numMips			= tMax(int(GetLE32(data+40)), 1);
+
+	// Vulkan format values. The sRGB variant is always one more than the unorm one.
+	info.ColourProfile = tColourProfile::lRGB;
+	switch (vkFormat)
+	{
+		case 23: case 29:	info.PixelFormat = tPixelFormat::R8G8B8;			break;
+		case 37: case 43:	info.PixelFormat = tPixelFormat::R8G8B8A8;			break;
+		case 44: case 50:	info.PixelFormat = tPixelFormat::B8G8R8A8;			break;
+		case 131: case 132:	info.PixelFormat = tPixelFormat::BC1DXT1;			break;
+		case 133: case 134:	info.PixelFormat = tPixelFormat::BC1DXT1A;			break;
+		case 135: case 136:	info.PixelFormat = tPixelFormat::BC2DXT2DXT3;		break;
+		case 137: case 138:	info.PixelFormat = tPixelFormat::BC3DXT4DXT5;		break;
+		case 145: case 146:	info.PixelFormat = tPixelFormat::BC7;				break;
+		case 144:
+			info.PixelFormat = tPixelFormat::BC6S;
+			info.ColourProfile = tColourProfile::HDRa;
+			break;
+		default:
+			// ASTC is 157 to 184 in unorm/srgb pairs in the same block order as the pixel formats.
+			if ((vkFormat >= 157) && (vkFormat <= 184))
+				info.PixelFormat = tPixelFormat(int(tPixelFormat::FirstASTC) + int(vkFormat - 157)/2);
+			break;
+	}
+	switch (vkFormat)
+	{
+		case 29: case 43: case 50: case 132: case 134: case 136: case 138: case 146:
+			info.ColourProfile = tColourProfile::sRGB;
+			break;
+		default:
+			if ((vkFormat >= 157) && (vkFormat <= 184) && ((vkFormat - 157) & 1))
+				info.ColourProfile = tColourProfile::sRGB;
+			break;
+	}
+
+	info.NumFrames		= numMips * numFaces;
+	info.NumPixels		= ComputeMipChainPixels(info.Width, info.Height, numMips, numFaces);
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadASTC(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 16) || (GetLE32(data) != 0x5CA1AB13))
+		return false;
+
+	int blockIndex		= GetASTCBlockIndex(data[4], data[5]);
+	info.Width			= GetLE24(data+7);
+	info.Height			= GetLE24(data+10);
+	info.PixelFormat	= (blockIndex >= 0) ? tPixelFormat(int(tPixelFormat::FirstASTC) + blockIndex) : tPixelFormat::Invalid;
+	info.NumFrames		= 1;
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadPKM(Info& info, const uint8* data, int numBytes)
+{
+	if ((numBytes < 16) || tMemcmp(data, "PKM ", 4))
+		return false;
+
+	// The extended dimensions are rounded up to the block size. We want the original ones.
+	uint32 format		= GetBE16(data+6);
+	info.Width			= GetBE16(data+12);
+	info.Height			= GetBE16(data+14);
+	switch (format)
+	{
+		case 0:		info.PixelFormat = tPixelFormat::ETC1;			break;
+		case 1:		info.PixelFormat = tPixelFormat::ETC2RGB;		break;
+		case 3:		info.PixelFormat = tPixelFormat::ETC2RGBA;		break;
+		case 4:		info.PixelFormat = tPixelFormat::ETC2RGBA1;		break;
+		default:	info.PixelFormat = tPixelFormat::Invalid;		break;
+	}
+	info.NumFrames		= 1;
+	return true;
+}
+
+
+bool Viewer::ImageHeader::ReadTIFF(Info& info, const tString& filename)
+{
+	tFileHandle file = tOpenFile(filename.Chr(), "rb");
+	if (!file)
+		return false;
+
+	uint8 header[8];
+	if ((tReadFile(file, header, 8) != 8) || (tMemcmp(header, "II*\0", 4) && tMemcmp(header, "MM\0*", 4)))
+	{
+		tCloseFile(file);
+		return false;
+	}
+
+	bool le = (header[0] == 'I');
+	auto get16 = [le](const uint8* d) -> uint32 { return le ? GetLE16(d) : GetBE16(d); };
+	auto get32 = [le](const uint8* d) -> uint32 { return le ? GetLE32(d) : GetBE32(d); };
+
+	// Walk the IFD chain. Each IFD is a page (frame). The cap stops malformed files that loop.
+	const int maxPages = 4096;
+	int64 numPixels = 0;
+	int numPages = 0;
+	uint32 ifdOffset = get32(header+4);
+	while (ifdOffset && (numPages < maxPages))
+	{
+		uint8 countBytes[2];
+		if (!tFileSeek(file, int(ifdOffset)) || (tReadFile(file, countBytes, 2) != 2))
+			break;
+
+		int numEntries = get16(countBytes);
+		int ifdSize = numEntries*12 + 4;
+		uint8* ifd = new uint8[ifdSize];
+		if (tReadFile(file, ifd, ifdSize) != ifdSize)
+		{
+			delete[] ifd;
+			break;
+		}
+
+		int width = 0, height = 0, samplesPerPixel = 1, bitsPerSample = 8;
+		for (int e = 0; e < numEntries; e++)
+		{
+			const uint8* entry = ifd + e*12;
+			uint32 tag = get16(entry);
+			uint32 type = get16(entry+2);
+			uint32 count = get32(entry+4);
+
+			// Type 3 is SHORT and the value is left-justified in the 4 byte field. If there is more than one value the
+			// field is an offset. For bits-per-sample that means one value per sample and we just use the default.
+			uint32 value = (type == 3) ? get16(entry+8) : get32(entry+8);
+			switch (tag)
+			{
+				case 256:	width = int(value);								break;
+				case 257:	height = int(value);							break;
+				case 258:	if (count == 1) bitsPerSample = int(value);		break;
+				case 277:	samplesPerPixel = int(value);					break;
+			}
+		}
+		ifdOffset = get32(ifd + numEntries*12);
+		delete[] ifd;
+
+		if (numPages == 0)
+		{
+			info.Width = width;
+			info.Height = height;
+			if (bitsPerSample == 8)
+				info.PixelFormat = (samplesPerPixel == 4) ? tPixelFormat::R8G8B8A8 : (samplesPerPixel == 3) ? tPixelFormat::R8G8B8 : tPixelFormat::Invalid;
+		}
+		numPixels += int64(width) * int64(height);
+		numPages++;
+	}
+	tCloseFile(file);
+
+	if ((info.Width <= 0) || (info.Height <= 0) || (info.Width > Image::MaxDim) || (info.Height > Image::MaxDim))
+	{
+		info = Info();
+		return false;
+	}
+
+	info.ColourProfile	= tColourProfile::sRGB;
+	info.NumFrames		= numPages;
+	info.NumPixels		= numPixels;
+	return true;
+}
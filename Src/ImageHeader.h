@@ -0,0 +1,56 @@
+// ImageHeader.h
+//
+// Header-only parsing of all the image types the viewer can load. Only the start of the file (or for tiff, the IFD
+// chain) is read. No pixel data is decoded or allocated. Used for sorting, planning, and rejecting images that are
+// too large before they are loaded.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tString.h>
+#include <System/tFile.h>
+#include <Image/tPixelFormat.h>
+#include <Image/tMetaData.h>
+
+
+namespace Viewer
+{
+	namespace ImageHeader
+	{
+		struct Info
+		{
+			int Width									= 0;	// Of the primary picture.
+			int Height									= 0;
+
+			// The number of pictures a full load would create. For mipmapped and cubemap types this is every mip of
+			// every face. Zero means unknown without parsing the whole file (animated gif and webp). See countFrames.
+			int NumFrames								= 0;
+
+			// Total pixels over all pictures. Falls back to the primary picture if NumFrames is unknown.
+			int64 NumPixels								= 0;
+
+			// May be Invalid even on success. Some container formats need the full loader's tables.
+			tImage::tPixelFormat PixelFormat			= tImage::tPixelFormat::Invalid;
+			tColourProfile ColourProfile				= tColourProfile::Unspecified;
+			tImage::tMetaData MetaData;							// Only jpg files.
+		};
+
+		// Returns true if the width and height were read. If exifOrient is true, jpg files with a rotating exif
+		// orientation have their width and height swapped to match what the loader produces. If countFrames is true,
+		// gif and animated webp files are walked block by block to fill in NumFrames. This reads the whole file. If the
+		// walk fails NumFrames is left at zero.
+		bool Read(Info&, const tString& filename, tSystem::tFileType, bool exifOrient = false, bool countFrames = false);
+
+		// Same as above for a header already in memory. numBytes may be less than the whole file. Tiff files are not
+		// supported and gif and webp frames are never counted since both need more than the start of the file.
+		bool Read(Info&, const uint8* data, int numBytes, tSystem::tFileType, bool exifOrient = false);
+	}
+}
@@ -0,0 +1,300 @@
+// MemoryManager.cpp
+//
+// Keeps track of the memory held by loaded images and unloads the least recently used ones when over budget. Picture
+// memory, alt-picture memory, undo memory, and GPU texture memory are tracked separately. Each image carries its own
+// intrusive LRU links so touching, accounting, and removing an image are all constant time. Eviction only happens in
+// Update, which the main loop calls every frame, so navigating between images never has to wait for it.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <vector>
+#include <System/tPrint.h>
+#include <System/tFile.h>
+#include "MemoryManager.h"
+#include "Image.h"
+#include "Config.h"
+#include "UndoSpill.h"
+using namespace tSystem;
+
+
+namespace Viewer
+{
+	namespace MemoryManager
+	{
+		void Link(Image*);
+		void Unlink(Image*);
+		void EvictTextures(Image* currImage, int64 budget);
+		void EvictUndo(Image* currImage, int64 budget);
+		int64 SpillUndo(int64 budget);
+		void UpdateSpills();
+		void RemoveSpilling(Image*);
+		void EvictPictures(Image* currImage, int64 budget);
+
+		// Head is the most recently used image. Tail is the least recently used.
+		Image* Head = nullptr;
+		Image* Tail = nullptr;
+		Usage Totals;
+
+		// Images with undo steps being written to scratch files. Only these are polled for finished spills. Usually
+		// empty and never more than a few.
+		std::vector<Image*> Spilling;
+	}
+}
+
+
+void Viewer::MemoryManager::Link(Image* image)
+{
+	Record& rec = image->MemRecord;
+	tAssert(!rec.Listed);
+	rec.Prev = nullptr;
+	rec.Next = Head;
+	if (Head)
+		Head->MemRecord.Prev = image;
+	else
+		Tail = image;
+	Head = image;
+	rec.Listed = true;
+	Totals.NumImages++;
+}
+
+
+void Viewer::MemoryManager::Unlink(Image* image)
+{
+	Record& rec = image->MemRecord;
+	if (!rec.Listed)
+		return;
+
+	if (rec.Prev)
+		rec.Prev->MemRecord.Next = rec.Next;
+	else
+		Head = rec.Next;
+
+	if (rec.Next)
+		rec.Next->MemRecord.Prev = rec.Prev;
+	else
+		Tail = rec.Prev;
+
+	rec.Prev = nullptr;
+	rec.Next = nullptr;
+	rec.Listed = false;
+	Totals.NumImages--;
+}
+
+
+void Viewer::MemoryManager::Account(Image* image)
+{
+	if (!image)
+		return;
+
+	Record& rec = image->MemRecord;
+	Totals.PictureBytes		-= rec.PictureBytes;
+	Totals.AltPictureBytes	-= rec.AltPictureBytes;
+	Totals.UndoBytes		-= rec.UndoBytes;
+	Totals.TextureBytes		-= rec.TextureBytes;
+
+	rec.PictureBytes		= image->GetPictureMemSizeBytes();
+	rec.AltPictureBytes		= image->GetAltPictureMemSizeBytes();
+	rec.UndoBytes			= image->GetUndoMemSizeBytes();
+	rec.TextureBytes		= image->GetTextureMemSizeBytes();
+
+	Totals.PictureBytes		+= rec.PictureBytes;
+	Totals.AltPictureBytes	+= rec.AltPictureBytes;
+	Totals.UndoBytes		+= rec.UndoBytes;
+	Totals.TextureBytes		+= rec.TextureBytes;
+
+	bool holdsMemory = (rec.PictureBytes + rec.AltPictureBytes + rec.UndoBytes + rec.TextureBytes) > 0;
+	if (holdsMemory && !rec.Listed)
+		Link(image);
+	else if (!holdsMemory && rec.Listed)
+		Unlink(image);
+}
+
+
+void Viewer::MemoryManager::Touch(Image* image)
+{
+	if (!image)
+		return;
+
+	// Moving to the head is just an unlink and relink. Account will link it if it holds any memory.
+	Unlink(image);
+	Account(image);
+}
+
+
+void Viewer::MemoryManager::Remove(Image* image)
+{
+	if (!image)
+		return;
+
+	Record& rec = image->MemRecord;
+	Totals.PictureBytes		-= rec.PictureBytes;
+	Totals.AltPictureBytes	-= rec.AltPictureBytes;
+	Totals.UndoBytes		-= rec.UndoBytes;
+	Totals.TextureBytes		-= rec.TextureBytes;
+	rec.PictureBytes		= 0;
+	rec.AltPictureBytes		= 0;
+	rec.UndoBytes			= 0;
+	rec.TextureBytes		= 0;
+	Unlink(image);
+	RemoveSpilling(image);
+}
+
+
+void Viewer::MemoryManager::EvictTextures(Image* currImage, int64 budget)
+{
+	Image* image = Tail;
+	while (image && (Totals.TextureBytes > budget))
+	{
+		Image* prev = image->MemRecord.Prev;
+		if ((image != currImage) && (image->MemRecord.TextureBytes > 0))
+		{
+			tPrintf("Unbinding %s freeing %|64d texture Bytes\n", tGetFileName(image->Filename).Chr(), image->MemRecord.TextureBytes);
+			image->Unbind();
+			Account(image);
+		}
+		image = prev;
+	}
+}
+
+
+void Viewer::MemoryManager::EvictUndo(Image* currImage, int64 budget)
+{
+	Image* image = Tail;
+	while (image && (Totals.UndoBytes > budget))
+	{
+		Image* prev = image->MemRecord.Prev;
+		if (image != currImage)
+		{
+			int64 freed = 0;
+			while ((image->GetUndoMemSizeBytes() > 0) && (Totals.UndoBytes - freed > budget))
+				freed += image->DropOldestUndo();
+
+			if (freed > 0)
+			{
+				tPrintf("Dropped undo steps of %s freeing %|64d Bytes\n", tGetFileName(image->Filename).Chr(), freed);
+				Account(image);
+			}
+		}
+		image = prev;
+	}
+}
+
+
+int64 Viewer::MemoryManager::SpillUndo(int64 budget)
+{
+	// Nothing is lost by spilling so the current image takes part too. Its most recent step is always kept. Spills
+	// already in flight count towards the excess so the same bytes are not asked for every frame.
+	int64 excess = Totals.UndoBytes - budget;
+	int64 inFlight = 0;
+	for (Image* image = Tail; image && (inFlight < excess); image = image->MemRecord.Prev)
+	{
+		int64 imageInFlight = image->SpillOldestUndo(excess - inFlight);
+		if ((imageInFlight > 0) && !image->MemRecord.Spilling)
+		{
+			image->MemRecord.Spilling = true;
+			Spilling.push_back(image);
+		}
+		inFlight += imageInFlight;
+	}
+	return inFlight;
+}
+
+
+void Viewer::MemoryManager::UpdateSpills()
+{
+	// Images whose spills all finished, or whose spilling steps were deleted, leave the list.
+	for (int i = 0; i < int(Spilling.size()); )
+	{
+		Image* image = Spilling[i];
+		if (image->UpdateUndoSpill())
+			Account(image);
+
+		if (image->IsUndoSpilling())
+		{
+			i++;
+			continue;
+		}
+		image->MemRecord.Spilling = false;
+		Spilling[i] = Spilling.back();
+		Spilling.pop_back();
+	}
+}
+
+
+void Viewer::MemoryManager::RemoveSpilling(Image* image)
+{
+	if (!image->MemRecord.Spilling)
+		return;
+
+	for (int i = 0; i < int(Spilling.size()); i++)
+	{
+		if (Spilling[i] != image)
+			continue;
+		Spilling[i] = Spilling.back();
+		Spilling.pop_back();
+		break;
+	}
+	image->MemRecord.Spilling = false;
+}
+
+
+void Viewer::MemoryManager::EvictPictures(Image* currImage, int64 budget)
+{
+	Image* image = Tail;
+	while (image && (Totals.PictureBytes + Totals.AltPictureBytes > budget))
+	{
+		// Unloading removes the image from the list if it no longer holds memory, so get prev first.
+		Image* prev = image->MemRecord.Prev;
+		if ((image != currImage) && image->IsLoaded() && !image->IsDirty() && !image->IsPinned())
+		{
+			int64 freed = image->MemRecord.PictureBytes + image->MemRecord.AltPictureBytes;
+			tPrintf("Unloading %s freeing %|64d Bytes\n", tGetFileName(image->Filename).Chr(), freed);
+			image->Unload();
+		}
+		image = prev;
+	}
+}
+
+
+void Viewer::MemoryManager::Update(Image* currImage)
+{
+	// The current image is the only one that gets edited so its undo and texture use may have changed.
+	Account(currImage);
+
+	// Undo spills finish on a background thread. Only images that started one need checking.
+	UpdateSpills();
+
+	Config::ProfileData& profile = Config::GetProfileData();
+	int64 pictureBudget	= int64(profile.MaxImageMemMB) * 1024 * 1024;
+	int64 undoBudget	= int64(profile.MaxUndoMemMB) * 1024 * 1024;
+	int64 textureBudget	= int64(profile.MaxTextureMemMB) * 1024 * 1024;
+
+	// Cheapest to restore first. Textures can be rebound from the pictures, undo steps are spilled to scratch files
+	// or, if that is not possible, dropped as lost history, and pictures need a reload from disk.
+	if (Totals.TextureBytes > textureBudget)
+		EvictTextures(currImage, textureBudget);
+
+	// Whatever can't be spilled is dropped as before. Spills in flight will free their bytes in a later frame.
+	int64 undoInFlight = 0;
+	if ((Totals.UndoBytes > undoBudget) && UndoSpill::IsAvailable())
+		undoInFlight = SpillUndo(undoBudget);
+	if (Totals.UndoBytes - undoInFlight > undoBudget)
+		EvictUndo(currImage, undoBudget + undoInFlight);
+
+	if (Totals.PictureBytes + Totals.AltPictureBytes > pictureBudget)
+		EvictPictures(currImage, pictureBudget);
+}
+
+
+const Viewer::MemoryManager::Usage& Viewer::MemoryManager::GetUsage()
+{
+	return Totals;
+}
@@ -0,0 +1,69 @@
+// MemoryManager.h
+//
+// Keeps track of the memory held by loaded images and unloads the least recently used ones when over budget. Picture
+// memory, alt-picture memory, undo memory, and GPU texture memory are tracked separately. Each image carries its own
+// intrusive LRU links so touching, accounting, and removing an image are all constant time. Eviction only happens in
+// Update, which the main loop calls every frame, so navigating between images never has to wait for it.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tStandard.h>
+namespace Viewer { class Image; }
+
+
+namespace Viewer
+{
+	namespace MemoryManager
+	{
+		// Every image has one of these. Only the memory manager should modify it.
+		struct Record
+		{
+			Image* Prev									= nullptr;	// Towards most recently used.
+			Image* Next									= nullptr;	// Towards least recently used.
+			bool Listed									= false;
+			bool Spilling								= false;	// In the list of images with undo spills in flight.
+
+			// The values last accounted for. The totals are the sums of these over all listed images.
+			int64 PictureBytes							= 0;
+			int64 AltPictureBytes						= 0;
+			int64 UndoBytes								= 0;
+			int64 TextureBytes							= 0;
+		};
+
+		struct Usage
+		{
+			int64 PictureBytes							= 0;
+			int64 AltPictureBytes						= 0;
+			int64 UndoBytes								= 0;
+			int64 TextureBytes							= 0;
+			int NumImages								= 0;		// Images holding any memory.
+		};
+
+		// Marks the image as most recently used and re-accounts its memory. Call whenever an image is loaded or
+		// becomes current.
+		void Touch(Image*);
+
+		// Re-reads the memory held by the image and updates the totals without changing its LRU position. Images that
+		// no longer hold any memory are removed from the LRU list.
+		void Account(Image*);
+
+		// Removes the image from the LRU list and the totals. Safe to call on images that are not listed.
+		void Remove(Image*);
+
+		// Call once per frame from the main thread. Evicts least recently used memory until each category is within
+		// its budget from the config. The current image is never evicted and dirty or pinned images are never
+		// unloaded.
+		void Update(Image* currImage);
+
+		const Usage& GetUsage();
+	}
+}
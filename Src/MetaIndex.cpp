@@ -0,0 +1,398 @@
+// MetaIndex.cpp
+//
+// A persistent per-directory index of image properties that are expensive to get at. For each file it stores the
+// header dimensions, the source pixel format, and the parsed meta-data. Entries are validated by file size and
+// modification time. When a folder is opened the index is read and any images that have not changed get their
+// Cached_ members filled in immediately. Files not in the index are given to a background thread that only parses
+// the file header. This means all cached sort keys are available without waiting for thumbnail generation.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <Foundation/tHash.h>
+#include <System/tFile.h>
+#include <System/tChunk.h>
+#include <Image/tMetaData.h>
+#include "MetaIndex.h"
+#include "ImageHeader.h"
+#include "Image.h"
+#include "Config.h"
+#include "TacentView.h"
+using namespace tStd;
+using namespace tSystem;
+using namespace tImage;
+using namespace tMath;
+
+
+namespace Viewer
+{
+	namespace MetaIndex
+	{
+		struct Entry : public tLink<Entry>
+		{
+			tString Name;										// Filename without the directory.
+			uint64 FileSize										= 0;
+			int64 ModTime										= 0;
+			int Width											= 0;	// Zero if the header could not be parsed.
+			int Height											= 0;
+			tPixelFormat PixelFormat							= tPixelFormat::Invalid;
+			tMetaData MetaData;
+		};
+
+		// Scan items are created on the main thread. The scan thread fills in Result and moves the item to the
+		// ScanResults list. Img is only ever dereferenced on the main thread.
+		struct ScanItem : public tLink<ScanItem>
+		{
+			Image* Img											= nullptr;
+			Entry Result;
+		};
+
+		const uint32 ChunkID_Header								= 0x0B000100;
+		const uint32 ChunkID_Name								= 0x0B000101;
+		const uint32 ChunkID_Info								= 0x0B000102;
+		const int IndexVersion									= 1;
+
+		// The mutex protects Entries, EntryMap, IndexDirty, and ScanResults. IndexDir and IndexFile are only
+		// modified by the main thread while the scan thread is not running.
+		std::mutex Mutex;
+		tString IndexDir;
+		tString IndexFile;
+		bool IndexDirty											= false;
+		tList<Entry> Entries;
+		std::unordered_map<std::string, Entry*> EntryMap;
+
+		tList<ScanItem> ScanItems;								// Owned by the scan thread while it is running.
+		tList<ScanItem> ScanResults;
+		std::thread ScanThread;
+		std::atomic<bool> ScanCancel							= false;
+		std::atomic<bool> ScanRunning							= false;
+
+		tString GetIndexFile(const tString& dir);
+		void ReadIndex(tList<Entry>& entries);
+		void WriteIndex();
+		Entry* FindEntry(const tString& name);					// Mutex must be held.
+		Entry* FindOrAddEntry(const tString& name);				// Mutex must be held.
+		void ApplyEntry(Image&, const Entry&);
+		void ScanFunction();
+	}
+}
+
+
+tString Viewer::MetaIndex::GetIndexFile(const tString& dir)
+{
+	tuint256 hash = 0;
+	hash = tHash::tHashData256((uint8*)&IndexVersion, sizeof(IndexVersion));
+	hash = tHash::tHashString256(dir, hash);
+	tString indexFile;
+	tsPrintf(indexFile, "%s%032|256X.bin", Image::ThumbCacheDir.Chr(), hash);
+	return indexFile;
+}
+
+
+void Viewer::MetaIndex::Open(const tString& dir, tList<Image>& images)
+{
+	Close();
+	if (dir.IsEmpty() || Image::ThumbCacheDir.IsEmpty())
+		return;
+
+	IndexDir = dir;
+	IndexFile = GetIndexFile(dir);
+
+	tList<Entry> loaded;
+	ReadIndex(loaded);
+	std::unordered_map<std::string, Entry*> loadedMap;
+	for (Entry* entry = loaded.First(); entry; entry = entry->Next())
+		loadedMap[entry->Name.Chr()] = entry;
+
+	// Entries that still match a file are moved into the live index. Anything left over is stale and not kept.
+	std::lock_guard<std::mutex> lock(Mutex);
+	for (Image* img = images.First(); img; img = img->Next())
+	{
+		tString name = tGetFileName(img->Filename);
+		auto found = loadedMap.find(name.Chr());
+		Entry* entry = (found != loadedMap.end()) ? found->second : nullptr;
+		if (entry && (entry->FileSize == img->FileSizeB) && (entry->ModTime == int64(img->FileModTime)))
+		{
+			loaded.Remove(entry);
+			loadedMap.erase(found);
+			Entries.Append(entry);
+			EntryMap[entry->Name.Chr()] = entry;
+			ApplyEntry(*img, *entry);
+			continue;
+		}
+
+		ScanItem* item = new ScanItem;
+		item->Img = img;
+		item->Result.Name = name;
+		item->Result.FileSize = img->FileSizeB;
+		item->Result.ModTime = int64(img->FileModTime);
+		ScanItems.Append(item);
+	}
+
+	if (!loaded.IsEmpty())
+		IndexDirty = true;
+	loaded.Empty();
+
+	if (ScanItems.IsEmpty())
+		return;
+
+	ScanCancel = false;
+	ScanRunning = true;
+	ScanThread = std::thread(ScanFunction);
+}
+
+
+int Viewer::MetaIndex::Update()
+{
+	tList<ScanItem> results;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		while (ScanItem* item = ScanResults.Remove())
+			results.Append(item);
+	}
+
+	int numUpdated = 0;
+	while (ScanItem* item = results.Remove())
+	{
+		// If a thumbnail worker got to the image first it will have set the (more accurate) cached values.
+		Image* img = item->Img;
+		if (!img->IsThumbnailWorkerActive() && (img->Cached_PrimaryWidth == 0) && (item->Result.Width > 0))
+		{
+			ApplyEntry(*img, item->Result);
+			numUpdated++;
+		}
+		delete item;
+	}
+
+	return numUpdated;
+}
+
+
+void Viewer::MetaIndex::Store(const Image& img)
+{
+	if (img.Cached_PrimaryWidth <= 0)
+		return;
+
+	tString dir = tGetDir(img.Filename);
+	tString name = tGetFileName(img.Filename);
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (IndexFile.IsEmpty() || !dir.IsEqualCI(IndexDir))
+		return;
+
+	Entry* entry = FindOrAddEntry(name);
+	bool unchanged =
+		(entry->FileSize == img.FileSizeB) && (entry->ModTime == int64(img.FileModTime)) &&
+		(entry->Width == img.Cached_PrimaryWidth) && (entry->Height == img.Cached_PrimaryHeight) &&
+		(entry->MetaData.IsValid() == img.Cached_MetaData.IsValid()) &&
+		((img.Cached_PixelFormat == tPixelFormat::Invalid) || (entry->PixelFormat == img.Cached_PixelFormat));
+	if (unchanged)
+		return;
+
+	entry->FileSize		= img.FileSizeB;
+	entry->ModTime		= int64(img.FileModTime);
+	entry->Width		= img.Cached_PrimaryWidth;
+	entry->Height		= img.Cached_PrimaryHeight;
+	entry->MetaData		= img.Cached_MetaData;
+
+	// The thumbnail cache does not store the pixel format so we don't clobber a good one from the header scan.
+	if (img.Cached_PixelFormat != tPixelFormat::Invalid)
+		entry->PixelFormat = img.Cached_PixelFormat;
+	IndexDirty = true;
+}
+
+
+void Viewer::MetaIndex::Close()
+{
+	if (ScanThread.joinable())
+	{
+		ScanCancel = true;
+		ScanThread.join();
+	}
+	ScanCancel = false;
+	ScanRunning = false;
+	ScanItems.Empty();
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	ScanResults.Empty();
+	if (IndexDirty && IndexFile.IsValid())
+		WriteIndex();
+
+	EntryMap.clear();
+	Entries.Empty();
+	IndexDirty = false;
+	IndexDir.Clear();
+	IndexFile.Clear();
+}
+
+
+bool Viewer::MetaIndex::IsScanning()
+{
+	return ScanRunning;
+}
+
+
+void Viewer::MetaIndex::ReadIndex(tList<Entry>& entries)
+{
+	if (!tFileExists(IndexFile))
+		return;
+
+	tChunkReader reader(IndexFile);
+	Entry* entry = nullptr;
+	bool versionOk = false;
+	for (tChunk ch = reader.First(); ch.IsValid(); ch = ch.Next())
+	{
+		switch (ch.ID())
+		{
+			case ChunkID_Header:
+			{
+				int version = 0;
+				ch.GetItem(version);
+				versionOk = (version == IndexVersion);
+				break;
+			}
+
+			case ChunkID_Name:
+				if (!versionOk)
+					return;
+				entry = new Entry;
+				entry->Name = (const char*)ch.GetData();
+				entries.Append(entry);
+				break;
+
+			case ChunkID_Info:
+			{
+				if (!entry)
+					break;
+				int pixelFormat = int(tPixelFormat::Invalid);
+				ch.GetItem(entry->FileSize);
+				ch.GetItem(entry->ModTime);
+				ch.GetItem(entry->Width);
+				ch.GetItem(entry->Height);
+				ch.GetItem(pixelFormat);
+				entry->PixelFormat = tPixelFormat(pixelFormat);
+				break;
+			}
+
+			case tChunkID::Image_MetaData:
+				if (!entry)
+					break;
+				entry->MetaData.Clear();
+				entry->MetaData.Load(ch);
+				break;
+		}
+	}
+}
+
+
+void Viewer::MetaIndex::WriteIndex()
+{
+	tChunkWriter writer(IndexFile);
+	writer.Begin(ChunkID_Header);
+	writer.Write(IndexVersion);
+	writer.End();
+
+	for (Entry* entry = Entries.First(); entry; entry = entry->Next())
+	{
+		// The terminating null is written so the name can be read straight out of the chunk.
+		writer.Begin(ChunkID_Name);
+		writer.Write(entry->Name.Chr(), entry->Name.Length()+1);
+		writer.End();
+
+		writer.Begin(ChunkID_Info);
+		writer.Write(entry->FileSize);
+		writer.Write(entry->ModTime);
+		writer.Write(entry->Width);
+		writer.Write(entry->Height);
+		writer.Write(int(entry->PixelFormat));
+		writer.End();
+
+		if (entry->MetaData.IsValid())
+			entry->MetaData.Save(writer);
+	}
+	IndexDirty = false;
+}
+
+
+Viewer::MetaIndex::Entry* Viewer::MetaIndex::FindEntry(const tString& name)
+{
+	auto found = EntryMap.find(name.Chr());
+	return (found != EntryMap.end()) ? found->second : nullptr;
+}
+
+
+Viewer::MetaIndex::Entry* Viewer::MetaIndex::FindOrAddEntry(const tString& name)
+{
+	Entry* entry = FindEntry(name);
+	if (entry)
+		return entry;
+
+	entry = new Entry;
+	entry->Name = name;
+	Entries.Append(entry);
+	EntryMap[name.Chr()] = entry;
+	return entry;
+}
+
+
+void Viewer::MetaIndex::ApplyEntry(Image& img, const Entry& entry)
+{
+	if (entry.Width <= 0)
+		return;
+
+	img.Cached_PrimaryWidth		= entry.Width;
+	img.Cached_PrimaryHeight	= entry.Height;
+	img.Cached_PrimaryArea		= int64(entry.Width) * int64(entry.Height);
+	img.Cached_PixelFormat		= entry.PixelFormat;
+	if (entry.MetaData.IsValid())
+		img.Cached_MetaData		= entry.MetaData;
+}
+
+
+void Viewer::MetaIndex::ScanFunction()
+{
+	// Match what a full load gives us if the jpg loader is going to apply the exif orientation.
+	bool exifOrient = Config::GetProfileData().MetaDataOrientLoading;
+	while (!ScanCancel)
+	{
+		ScanItem* item = ScanItems.Remove();
+		if (!item)
+			break;
+
+		// Files we can't parse still get an entry (with zero width) so we don't rescan them every time the folder
+		// is opened. The thumbnail generator will fill them in properly later.
+		tString filename = IndexDir + item->Result.Name;
+		ImageHeader::Info header;
+		if (ImageHeader::Read(header, filename, tGetFileType(filename), exifOrient))
+		{
+			item->Result.Width			= header.Width;
+			item->Result.Height			= header.Height;
+			item->Result.PixelFormat	= header.PixelFormat;
+			item->Result.MetaData		= header.MetaData;
+		}
+
+		std::lock_guard<std::mutex> lock(Mutex);
+		Entry* entry = FindOrAddEntry(item->Result.Name);
+		entry->FileSize		= item->Result.FileSize;
+		entry->ModTime		= item->Result.ModTime;
+		entry->Width		= item->Result.Width;
+		entry->Height		= item->Result.Height;
+		entry->PixelFormat	= item->Result.PixelFormat;
+		entry->MetaData		= item->Result.MetaData;
+		IndexDirty = true;
+		ScanResults.Append(item);
+		WakeMainLoop();
+	}
+	ScanRunning = false;
+}
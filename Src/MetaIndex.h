@@ -0,0 +1,48 @@
+// MetaIndex.h
+//
+// A persistent per-directory index of image properties that are expensive to get at. For each file it stores the
+// header dimensions, the source pixel format, and the parsed meta-data. Entries are validated by file size and
+// modification time. When a folder is opened the index is read and any images that have not changed get their
+// Cached_ members filled in immediately. Files not in the index are given to a background thread that only parses
+// the file header. This means all cached sort keys are available without waiting for thumbnail generation.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tList.h>
+#include <Foundation/tString.h>
+namespace Viewer { class Image; }
+
+
+namespace Viewer
+{
+	namespace MetaIndex
+	{
+		// Call after the Images list for dir has been populated. Reads the index file for the directory (if it
+		// exists) and sets the Cached_ members of every image whose size and modification time match. A background
+		// header scan is started for the remaining images. Calls Close first if an index is already open.
+		void Open(const tString& dir, tList<Image>& images);
+
+		// Call once per frame from the main thread. Transfers the results of the background scan to the images.
+		// Returns the number of images that were updated. If non-zero, a resort may be needed.
+		int Update();
+
+		// Adds or updates the entry for the supplied image. Thread safe. The thumbnail generator calls this since it
+		// has the true (fully loaded) values. Ignored if the image is not in the open directory.
+		void Store(const Image&);
+
+		// Stops the background scan and writes the index file if it changed. It is safe to call this after the
+		// images passed to Open have been deleted.
+		void Close();
+
+		bool IsScanning();
+	}
+}
@@ -0,0 +1,328 @@
+// Mipmap.cpp
+//
+// Mipmap chains for display textures. A picture is first shown with a chain of 2x2 box reductions that is built in
+// parallel and is cheap enough to never hold up the first display. If the profile asks for a better filter, that
+// chain is built afterwards on a background thread and the levels below the top are swapped into the texture.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <condition_variable>
+#include <cstring>
+#include <System/tMachine.h>
+#include <Image/tResample.h>
+#include "Mipmap.h"
+#include "WorkPool.h"
+#include "TacentView.h"
+#include "Config.h"
+using namespace tImage;
+
+
+namespace Viewer
+{
+	namespace Mipmap
+	{
+		struct QualityJob : public tLink<QualityJob>
+		{
+			tPicture* Picture										= nullptr;
+			tResampleFilter Filter									= tResampleFilter::Bilinear;
+			bool Chain												= true;
+
+			// Filled in by the worker. Only read by the main thread once Done is set.
+			tList<tLayer> Mips;
+			std::atomic<bool> Cancelled								= false;
+			bool Done												= false;	// Mutex must be held.
+		};
+
+		// Levels smaller than this are reduced on the calling thread. Spawning threads would cost more than it saves.
+		const int MinParallelPixels									= 256*256;
+
+		// The mutex protects Pending, Active, Quit, and the Done member of every job.
+		std::mutex Mutex;
+		std::condition_variable WorkAvailable;
+		std::condition_variable JobFinished;
+		tList<QualityJob> Pending;
+		QualityJob* Active											= nullptr;
+		bool Quit													= false;
+		std::thread Worker;
+
+		void ReduceRows(const uint8* src, int srcW, int srcH, uint8* dst, int dstW, int rowBegin, int rowEnd);
+		void ProcessJob(QualityJob&);
+		void WorkerFunction();
+	}
+}
+
+
+bool Viewer::Mipmap::IsEnabled()
+{
+	Config::ProfileData& profile = Config::GetProfileData();
+	return tResampleFilter(profile.MipmapFilter) != tResampleFilter::None;
+}
+
+
+bool Viewer::Mipmap::WantsQuality()
+{
+	Config::ProfileData& profile = Config::GetProfileData();
+	tResampleFilter filter = tResampleFilter(profile.MipmapFilter);
+	return (filter != tResampleFilter::None) && (filter != tResampleFilter::Box);
+}
+
+
+void Viewer::Mipmap::ReduceRows(const uint8* src, int srcW, int srcH, uint8* dst, int dstW, int rowBegin, int rowEnd)
+{
+	// Destination sizes round down, so an odd last source row or column is dropped. Only a dimension of 1 is clamped,
+	// averaging the single row or column with itself. Whole 2x2 blocks are handled by the first loop, which only
+	// touches bytes with fixed offsets so the compiler can vectorize it.
+	int pairs = tMath::tMin(dstW, srcW/2);
+	int srcStride = srcW*4;
+	for (int y = rowBegin; y < rowEnd; y++)
+	{
+		const uint8* row0 = src + int64(2*y)*srcStride;
+		const uint8* row1 = src + int64(tMath::tMin(2*y+1, srcH-1))*srcStride;
+		uint8* out = dst + int64(y)*dstW*4;
+		for (int x = 0; x < pairs; x++)
+		{
+			const uint8* a = row0 + x*8;
+			const uint8* b = row1 + x*8;
+			for (int c = 0; c < 4; c++)
+				out[x*4+c] = uint8((a[c] + a[c+4] + b[c] + b[c+4] + 2) >> 2);
+		}
+
+		for (int x = pairs; x < dstW; x++)
+		{
+			int s0 = tMath::tMin(2*x, srcW-1)*4;
+			int s1 = tMath::tMin(2*x+1, srcW-1)*4;
+			for (int c = 0; c < 4; c++)
+				out[x*4+c] = uint8((row0[s0+c] + row0[s1+c] + row1[s0+c] + row1[s1+c] + 2) >> 2);
+		}
+	}
+}
+
+
+uint8* Viewer::Mipmap::ReduceBox(const uint8* src, int srcW, int srcH, int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = tSystem::tGetNumCores();
+
+	int dstW = tMath::tMax(srcW/2, 1);
+	int dstH = tMath::tMax(srcH/2, 1);
+	uint8* dst = new uint8[int64(dstW)*dstH*4];
+
+	if ((numThreads <= 1) || (dstW*dstH < MinParallelPixels))
+	{
+		ReduceRows(src, srcW, srcH, dst, dstW, 0, dstH);
+	}
+	else
+	{
+		// Each thread gets a contiguous band of rows so no two threads ever write the same cache line for long. The
+		// bands go to the work pool so a reduction started from a pool thread does not start more threads.
+		int bandRows = (dstH + numThreads - 1) / numThreads;
+		WorkPool::ParallelFor
+		(
+			dstH, bandRows,
+			[=](int begin, int end) { ReduceRows(src, srcW, srcH, dst, dstW, begin, end); },
+			numThreads
+		);
+	}
+
+	return dst;
+}
+
+
+void Viewer::Mipmap::GenerateFastLayers(tList<tLayer>& layers, tPicture& picture, bool mipmaps, int numThreads)
+{
+	if (!picture.IsValid())
+		return;
+
+	if (numThreads <= 0)
+		numThreads = tSystem::tGetNumCores();
+
+	tLayer* level = new tLayer(tPixelFormat::R8G8B8A8, picture.GetWidth(), picture.GetHeight(), (uint8*)picture.GetPixels());
+	layers.Append(level);
+	if (!mipmaps)
+		return;
+
+	while ((level->Width != 1) || (level->Height != 1))
+	{
+		uint8* reduced = ReduceBox(level->Data, level->Width, level->Height, numThreads);
+		level = new tLayer(tPixelFormat::R8G8B8A8, tMath::tMax(level->Width/2, 1), tMath::tMax(level->Height/2, 1), reduced, true);
+		layers.Append(level);
+	}
+}
+
+
+void Viewer::Mipmap::GenerateFastLayers(int numPictures, tPicture* const* pictures, tList<tLayer>* layers, bool mipmaps)
+{
+	// With a single picture it is better to split its rows between all the cores.
+	if (numPictures == 1)
+	{
+		if (pictures[0])
+			GenerateFastLayers(layers[0], *pictures[0], mipmaps);
+		return;
+	}
+
+	// Otherwise each picture is reduced on a single thread and the pictures are shared out by the work pool. They are
+	// handed out one at a time since frames of different sizes take different times.
+	WorkPool::ParallelFor
+	(
+		numPictures, 1,
+		[=](int begin, int end)
+		{
+			for (int p = begin; p < end; p++)
+				if (pictures[p])
+					GenerateFastLayers(layers[p], *pictures[p], mipmaps, 1);
+		}
+	);
+}
+
+
+void Viewer::Mipmap::Init()
+{
+	Quit = false;
+	Worker = std::thread(WorkerFunction);
+}
+
+
+void Viewer::Mipmap::Shutdown()
+{
+	if (!Worker.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Quit = true;
+	}
+	WorkAvailable.notify_all();
+	Worker.join();
+
+	// Images cancel their jobs when unbound so nothing should be left. Anything that is gets dropped.
+	while (QualityJob* job = Pending.Remove())
+		delete job;
+}
+
+
+Viewer::Mipmap::QualityJob* Viewer::Mipmap::RequestQuality(tPicture* picture)
+{
+	tAssert(picture);
+	Config::ProfileData& profile = Config::GetProfileData();
+	QualityJob* job	= new QualityJob;
+	job->Picture	= picture;
+	job->Filter		= tResampleFilter(profile.MipmapFilter);
+	job->Chain		= profile.MipmapChaining;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Pending.Append(job);
+	}
+	WorkAvailable.notify_one();
+	return job;
+}
+
+
+bool Viewer::Mipmap::CollectQuality(QualityJob* job, tList<tLayer>& mips)
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		if (!job->Done)
+			return false;
+	}
+
+	while (tLayer* layer = job->Mips.Remove())
+		mips.Append(layer);
+	delete job;
+	return true;
+}
+
+
+void Viewer::Mipmap::CancelQuality(QualityJob* job)
+{
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		if (!job->Done && (job != Active))
+		{
+			Pending.Remove(job);
+		}
+		else
+		{
+			job->Cancelled = true;
+			JobFinished.wait(lock, [job] { return job->Done; });
+		}
+	}
+	delete job;
+}
+
+
+void Viewer::Mipmap::ProcessJob(QualityJob& job)
+{
+	// The top level is already in the texture so only the levels below it are built. Chaining resamples each level
+	// from the previous one, otherwise they all come from the full size picture.
+	tPicture& picture = *job.Picture;
+	tPixel4b* topPixels = picture.GetPixels();
+	int topW = picture.GetWidth();
+	int topH = picture.GetHeight();
+
+	tPixel4b* srcPixels = topPixels;
+	int srcW = topW;
+	int srcH = topH;
+	int w = topW;
+	int h = topH;
+	while ((w != 1) || (h != 1))
+	{
+		// Checked between levels. A single level of a huge picture is the longest a cancel can wait.
+		if (job.Cancelled)
+		{
+			job.Mips.Clear();
+			return;
+		}
+
+		w = tMath::tMax(w/2, 1);
+		h = tMath::tMax(h/2, 1);
+		uint8* data = new uint8[int64(w)*h*4];
+		Resample(srcPixels, srcW, srcH, (tPixel4b*)data, w, h, job.Filter, tResampleEdgeMode::Clamp);
+		job.Mips.Append(new tLayer(tPixelFormat::R8G8B8A8, w, h, data, true));
+
+		if (job.Chain)
+		{
+			srcPixels = (tPixel4b*)data;
+			srcW = w;
+			srcH = h;
+		}
+	}
+}
+
+
+void Viewer::Mipmap::WorkerFunction()
+{
+	while (true)
+	{
+		QualityJob* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			WorkAvailable.wait(lock, [] { return Quit || !Pending.IsEmpty(); });
+			if (Quit)
+				break;
+			job = Pending.Remove();
+			Active = job;
+		}
+
+		ProcessJob(*job);
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			job->Done = true;
+			Active = nullptr;
+		}
+		JobFinished.notify_all();
+		WakeMainLoop();
+	}
+}
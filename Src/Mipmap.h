@@ -0,0 +1,60 @@
+// Mipmap.h
+//
+// Mipmap chains for display textures. A picture is first shown with a chain of 2x2 box reductions that is built in
+// parallel and is cheap enough to never hold up the first display. If the profile asks for a better filter, that
+// chain is built afterwards on a background thread and the levels below the top are swapped into the texture.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tList.h>
+#include <Image/tPicture.h>
+#include <Image/tLayer.h>
+
+
+namespace Viewer
+{
+	namespace Mipmap
+	{
+		struct QualityJob;
+
+		// Read the current profile. Only call from the main thread.
+		bool IsEnabled();							// False if the mipmap filter is None.
+		bool WantsQuality();						// True if the mipmap filter is better than a box.
+
+		// Appends the top level, a copy of the picture, followed by every box-filtered level down to 1x1 if mipmaps
+		// is true. Each level is averaged from the one above in the same (sRGB-encoded) space as the resample box
+		// filter. The rows of large levels are split between numThreads threads. Zero means one per core.
+		void GenerateFastLayers(tList<tImage::tLayer>&, tImage::tPicture&, bool mipmaps, int numThreads = 0);
+
+		// Same as above for many pictures at once. Each picture is reduced on one work pool thread. Null pictures are skipped.
+		void GenerateFastLayers(int numPictures, tImage::tPicture* const* pictures, tList<tImage::tLayer>* layers, bool mipmaps);
+
+		// A single 2x2 box reduction of RGBA8 pixels. Returns a new[] buffer of max(srcW/2, 1) by max(srcH/2, 1)
+		// pixels. Rows are split between up to numThreads work pool threads if it is big enough. Zero means one per
+		// core.
+		uint8* ReduceBox(const uint8* src, int srcW, int srcH, int numThreads = 0);
+
+		// Call once from the main thread at startup and shutdown.
+		void Init();
+		void Shutdown();
+
+		// Queues the high quality chain for the picture using the profile's mipmap settings. The picture must not be
+		// modified or freed until the job is collected or cancelled.
+		QualityJob* RequestQuality(tImage::tPicture*);
+
+		// Never blocks. Once the chain is ready it is moved into mips, without the top level, and the job is freed.
+		bool CollectQuality(QualityJob*, tList<tImage::tLayer>& mips);
+
+		// Frees the job. If the worker is busy with it this waits until it finishes the level it is on.
+		void CancelQuality(QualityJob*);
+	}
+}
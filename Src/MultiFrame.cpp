@@ -25,6 +25,8 @@
 #include "Image.h"
 #include "GuiUtil.h"
 #include "Config.h"
+#include "Resampler.h"
+#include "SpatialQuantizer.h"
 using namespace tStd;
 using namespace tMath;
 using namespace tSystem;
@@ -37,27 +39,47 @@ namespace Viewer
 	void ComputeMaxWidthHeight(int& outWidth, int& outHeight);
 	bool AllDimensionsMatch(int width, int height);
 
+	// Unloaded images are probed rather than loaded. They have not been viewed so the current picture is the primary.
+	// Returns false if the dimensions could not be determined.
+	bool GetCurrentPicDimensions(Image*, int& width, int& height);
+
 	void SaveExtractedFrames(const tString& destDir, const tString& baseName, tFileType, tIntervalSet frames);
 }
 
 
+bool Viewer::GetCurrentPicDimensions(Image* img, int& width, int& height)
+{
+	if (!img->IsLoaded() && (img->Probe() == Image::ProbeResult::Success))
+	{
+		width = img->Cached_PrimaryWidth;
+		height = img->Cached_PrimaryHeight;
+		return true;
+	}
+
+	if (!img->IsLoaded())
+		img->Load();
+
+	tPicture* currPic = img->IsLoaded() ? img->GetCurrentPic() : nullptr;
+	if (!currPic)
+		return false;
+
+	width = currPic->GetWidth();
+	height = currPic->GetHeight();
+	return true;
+}
+
+
 void Viewer::ComputeMaxWidthHeight(int& outWidth, int& outHeight)
 {
 	outWidth = 0; outHeight = 0;
 	for (Image* img = Images.First(); img; img = img->Next())
 	{
-		if (!img->IsLoaded())
-			img->Load();
-
-		if (!img->IsLoaded())
+		int width = 0; int height = 0;
+		if (!GetCurrentPicDimensions(img, width, height))
 			continue;
 
-		tPicture* currPic = img->GetCurrentPic();
-		if (currPic)
-		{
-			if (currPic->GetWidth() > outWidth)		outWidth = currPic->GetWidth();
-			if (currPic->GetHeight() > outHeight)	outHeight = currPic->GetHeight();
-		}
+		if (width > outWidth)		outWidth = width;
+		if (height > outHeight)		outHeight = height;
 	}
 }
 
@@ -66,18 +88,12 @@ bool Viewer::AllDimensionsMatch(int width, int height)
 {
 	for (Image* img = Images.First(); img; img = img->Next())
 	{
-		if (!img->IsLoaded())
-			img->Load();
-
-		if (!img->IsLoaded())
+		int imgWidth = 0; int imgHeight = 0;
+		if (!GetCurrentPicDimensions(img, imgWidth, imgHeight))
 			continue;
 
-		tPicture* currPic = img->GetCurrentPic();
-		if (currPic)
-		{
-			if ((currPic->GetWidth() != width) || (currPic->GetHeight() != height))
-				return false;
-		}
+		if ((imgWidth != width) || (imgHeight != height))
+			return false;
 	}
 
 	return true;
@@ -254,7 +270,7 @@ void Viewer::SaveMultiFrameTo(const tString& outFile, int outWidth, int outHeigh
 
 		tImage::tPicture resampled(*currPic);
 		if ((resampled.GetWidth() != outWidth) || (resampled.GetHeight() != outHeight))
-			resampled.Resample(outWidth, outHeight, tImage::tResampleFilter(profile.ResampleFilter), tImage::tResampleEdgeMode(profile.ResampleEdgeMode));
+			Resampler::Resample(resampled, outWidth, outHeight, tImage::tResampleFilter(profile.ResampleFilter), tImage::tResampleEdgeMode(profile.ResampleEdgeMode));
 
 		tFrame* frame = new tFrame(resampled.StealPixels(), outWidth, outHeight, currPic->Duration);
 		frames.Append(frame);
@@ -266,7 +282,6 @@ void Viewer::SaveMultiFrameTo(const tString& outFile, int outWidth, int outHeigh
 	{
 		case tFileType::GIF:
 		{
-			tImageGIF gif(frames, true);
 			tImageGIF::SaveParams params;
 			params.Format					= tPixelFormat(int(tPixelFormat::FirstPalette) + profile.SaveFileGifBPP - 1);
 			params.Method					= tQuantize::Method(profile.SaveFileGifQuantMethod);
@@ -276,6 +291,8 @@ void Viewer::SaveMultiFrameTo(const tString& outFile, int outWidth, int outHeigh
 			params.DitherLevel				= double(profile.SaveFileGifDitherLevel);
 			params.FilterSize				= (profile.SaveFileGifFilterSize * 2) + 1;
 			params.SampleFactor				= profile.SaveFileGifSampleFactor;
+			SpatialQuantizer::PrepareGIF(frames, params, profile.SaveFileGifSpatialBudget);
+			tImageGIF gif(frames, true);
 			success = gif.Save(outFile, params);
 			break;
 		}
@@ -333,12 +350,14 @@ tString Viewer::GetFrameFilename(int frameNum, const tString& dir, const tString
 void Viewer::SaveExtractedFrames(const tString& destDir, const tString& baseName, tFileType fileType, tIntervalSet frameSet)
 {
 	tAssert(CurrImage);
-	int frameNum = 0;
-	for (tImage::tPicture* framePic = CurrImage->GetFirstPic(); framePic; framePic = framePic->Next(), frameNum++)
+	// GetFramePic makes sure frames held in compact form are decoded.
+	int numFrames = CurrImage->GetNumFrames();
+	for (int frameNum = 0; frameNum < numFrames; frameNum++)
 	{
 		if (!frameSet.Contains(frameNum))
 			continue;
 
+		tImage::tPicture* framePic = CurrImage->GetFramePic(frameNum);
 		tString frameFile = GetFrameFilename(frameNum, destDir, baseName, fileType);
 		Viewer::SavePictureAs(*framePic, frameFile, fileType, false);
 	}
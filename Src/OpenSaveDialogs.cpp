@@ -28,6 +28,8 @@
 #include "TacentView.h"
 #include "FileDialog.h"
 #include "Quantize.h"
+#include "Resampler.h"
+#include "SpatialQuantizer.h"
 using namespace tStd;
 using namespace tSystem;
 using namespace tMath;
@@ -358,6 +360,7 @@ void Viewer::DoSaveGifOptions(bool multiframeConfigValues)
 		profile.SaveFileGifQuantMethod,
 		profile.SaveFileGifFilterSize,
 		profile.SaveFileGifDitherLevel,
+		profile.SaveFileGifSpatialBudget,
 		profile.SaveFileGifSampleFactor,
 		itemWidth
 	);
@@ -423,8 +426,8 @@ void Viewer::DoSaveGifOptions(bool multiframeConfigValues)
 		tsaPrintf(desc, " Opaque. Image will have %d colours.\n", (1 << profile.SaveFileGifBPP));
 	else
 		tsaPrintf(desc, " Binary-alpha. Image will have %d colours.\n", (1 << profile.SaveFileGifBPP) - 1);
-	if ((profile.SaveFileGifQuantMethod == int(tQuantize::Method::Spatial)) && (profile.SaveFileGifBPP > 5))
-		tsaPrintf(desc, " WARNING: Scolorq at large BPPs may take\n a long time for large images.");
+	if ((profile.SaveFileGifQuantMethod == int(tQuantize::Method::Spatial)) && (profile.SaveFileGifBPP > 5) && (profile.SaveFileGifSpatialBudget <= 0.0f))
+		tsaPrintf(desc, " WARNING: Spatial at large BPPs may take\n a long time for large images.");
 	ImGui::Text(desc.Chr());
 
 	float buttonWidth = Gutil::GetUIParamScaled(76.0f, 2.5f);
@@ -437,6 +440,7 @@ void Viewer::DoSaveGifOptions(bool multiframeConfigValues)
 		profile.SaveFileGifDitherLevel		= 0.0f;
 		profile.SaveFileGifFilterSize		= 1;
 		profile.SaveFileGifSampleFactor		= 1;
+		profile.SaveFileGifSpatialBudget	= 0.0f;
 		profile.SaveFileWebpDurOverride		= -1;
 		profile.SaveFileGifDurOverride		= -1;
 		profile.SaveFileGifDurMultiFrame	= 3;
@@ -723,7 +727,7 @@ bool Viewer::SaveResizeImageAs(Image& img, const tString& outFile, int width, in
 	tMath::tiClampMin(outW, 4);
 	tMath::tiClampMin(outH, 4);
 	if ((outPic.GetWidth() != outW) || (outPic.GetHeight() != outH))
-		outPic.Resample(outW, outH, tImage::tResampleFilter(profile.ResampleFilter), tImage::tResampleEdgeMode(profile.ResampleEdgeMode));
+		Resampler::Resample(outPic, outW, outH, tImage::tResampleFilter(profile.ResampleFilter), tImage::tResampleEdgeMode(profile.ResampleEdgeMode));
 
 	tFileType saveFileType = tGetFileTypeFromName(profile.SaveFileType);
 	bool success = SavePictureAs(outPic, outFile, saveFileType, true);
@@ -1006,7 +1010,6 @@ void Viewer::AddSavedImageIfNecessary(const tString& savedFile)
 		// Add to list. It's still unloaded.
 		Image* newImg = new Image(savedFile);
 		Images.Append(newImg);
-		ImagesLoadTimeSorted.Append(newImg);
 	}
 }
 
@@ -1108,7 +1111,6 @@ bool Viewer::SavePictureAs(tImage::tPicture& picture, const tString& outFile, tF
 
 		case tFileType::GIF:
 		{
-			tImageGIF gif(picture, steal);
 			tImageGIF::SaveParams params;
 			params.Format					= tPixelFormat(int(tPixelFormat::FirstPalette) + profile.SaveFileGifBPP - 1);
 			params.Method					= tQuantize::Method(profile.SaveFileGifQuantMethod);
@@ -1118,6 +1120,12 @@ bool Viewer::SavePictureAs(tImage::tPicture& picture, const tString& outFile, tF
 			params.DitherLevel				= double(profile.SaveFileGifDitherLevel);
 			params.FilterSize				= (profile.SaveFileGifFilterSize * 2) + 1;
 			params.SampleFactor				= profile.SaveFileGifSampleFactor;
+
+			// The spatial quantizer works on a copy so the picture is untouched even when it isn't stolen.
+			tList<tFrame> frames;
+			frames.Append(new tFrame(picture.GetPixels(), picture.GetWidth(), picture.GetHeight(), picture.Duration));
+			SpatialQuantizer::PrepareGIF(frames, params, profile.SaveFileGifSpatialBudget);
+			tImageGIF gif(frames, true);
 			success = gif.Save(outFile, params);
 			break;
 		}
@@ -0,0 +1,501 @@
+// PixelKernels.cpp
+//
+// Vectorized loops for simple per-pixel work on RGBA8 pixels. Each kernel has a scalar version and SSE4 and AVX2
+// versions. The best one the CPU supports is picked at startup. All versions give exactly the same bytes.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "PixelKernels.h"
+#ifdef ARCHITECTURE_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define KERNEL_SSE4
+#define KERNEL_AVX2
+#else
+#define KERNEL_SSE4 __attribute__((target("sse4.1")))
+#define KERNEL_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+
+namespace Viewer
+{
+	namespace PixelKernels
+	{
+		// Every kernel here is the same operation. Each destination byte c is either the byte at Index[c] of the
+		// source pixel, or zero if Index[c] is negative, and is then ORed with Or[c].
+		struct Remap
+		{
+			int Index[4];
+			uint8 Or[4];
+		};
+
+		Level DetectLevel();
+		const Level SupportedLevel									= DetectLevel();
+		Level CurrentLevel											= SupportedLevel;
+
+		void RemapScalar(const uint8* src, int srcBytesPerPixel, uint8* dst, int64 count, const Remap&);
+		#ifdef ARCHITECTURE_X64
+		void RemapSSE4(const uint8* src, int srcBytesPerPixel, uint8* dst, int64 count, const Remap&);
+		void RemapAVX2(const uint8* src, int srcBytesPerPixel, uint8* dst, int64 count, const Remap&);
+		#endif
+		void Run(const uint8* src, int srcBytesPerPixel, uint8* dst, int64 count, const Remap&);
+
+		// The scalar resample loops do the same integer sums in the same order as the vector ones.
+		uint8 ResampleRound(int32 sum);
+		void ResampleRowScalar(const tPixel4b* src, tPixel4b* dst, int begin, int end, const int* index, const int16* weights, int taps);
+		void ResampleColumnsScalar(const tPixel4b* const* rows, const int16* weights, int taps, tPixel4b* dst, int begin, int end);
+		#ifdef ARCHITECTURE_X64
+		void ResampleRowSSE4(const tPixel4b* src, tPixel4b* dst, int dstW, const int* index, const int16* weights, int taps);
+		void ResampleRowAVX2(const tPixel4b* src, tPixel4b* dst, int dstW, const int* index, const int16* weights, int taps);
+		void ResampleColumnsSSE4(const tPixel4b* const* rows, const int16* weights, int taps, tPixel4b* dst, int width);
+		void ResampleColumnsAVX2(const tPixel4b* const* rows, const int16* weights, int taps, tPixel4b* dst, int width);
+		#endif
+	}
+}
+
+
+Viewer::PixelKernels::Level Viewer::PixelKernels::DetectLevel()
+{
+	#if defined(ARCHITECTURE_X64) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool sse41		= (info[2] & (1 << 19)) != 0;
+	bool osxsave	= (info[2] & (1 << 27)) != 0;
+	bool avx		= (info[2] & (1 << 28)) != 0;
+	__cpuidex(info, 7, 0);
+	bool avx2		= (info[1] & (1 << 5)) != 0;
+
+	// AVX2 also needs the OS to save the upper halves of the ymm registers.
+	bool ymmSaved	= osxsave && avx && ((_xgetbv(0) & 0x6) == 0x6);
+	if (avx2 && ymmSaved)
+		return Level::AVX2;
+	if (sse41)
+		return Level::SSE4;
+
+	#elif defined(ARCHITECTURE_X64)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return Level::AVX2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return Level::SSE4;
+	#endif
+
+	return Level::Scalar;
+}
+
+
+Viewer::PixelKernels::Level Viewer::PixelKernels::GetLevel()
+{
+	return CurrentLevel;
+}
+
+
+Viewer::PixelKernels::Level Viewer::PixelKernels::GetSupportedLevel()
+{
+	return SupportedLevel;
+}
+
+
+void Viewer::PixelKernels::SetLevel(Level level)
+{
+	CurrentLevel = (int(level) <= int(SupportedLevel)) ? level : SupportedLevel;
+}
+
+
+const char* Viewer::PixelKernels::GetLevelName(Level level)
+{
+	switch (level)
+	{
+		case Level::SSE4:	return "SSE4";
+		case Level::AVX2:	return "AVX2";
+		default:			return "Scalar";
+	}
+}
+
+
+void Viewer::PixelKernels::RemapScalar(const uint8* src, int srcBytesPerPixel, uint8* dst, int64 count, const Remap& remap)
+{
+	for (int64 p = 0; p < count; p++, src += srcBytesPerPixel, dst += 4)
+	{
+		// The whole source pixel is read before writing in case src and dst are the same.
+		uint8 out[4];
+		for (int c = 0; c < 4; c++)
+			out[c] = ((remap.Index[c] >= 0) ? src[remap.Index[c]] : 0) | remap.Or[c];
+		for (int c = 0; c < 4; c++)
+			dst[c] = out[c];
+	}
+}
+
+
+#ifdef ARCHITECTURE_X64
+KERNEL_SSE4 void Viewer::PixelKernels::RemapSSE4(const uint8* src, int srcBytesPerPixel, uint8* dst, int64 count, const Remap& remap)
+{
+	// The shuffle control picks source byte i for each output byte, or makes it zero if the high bit is set. Each
+	// 16 byte block makes 4 output pixels. 8 byte pixels need two blocks, each giving the low 8 bytes.
+	int pixelsPerLoad = (srcBytesPerPixel == 8) ? 2 : 4;
+	alignas(16) uint8 control[16];
+	alignas(16) uint8 orBytes[16];
+	for (int b = 0; b < 16; b++)
+	{
+		int p = b / 4;
+		int c = b % 4;
+		bool used = (p < pixelsPerLoad) && (remap.Index[c] >= 0);
+		control[b] = used ? uint8(p*srcBytesPerPixel + remap.Index[c]) : 0x80;
+		orBytes[b] = remap.Or[c];
+	}
+	__m128i ctrl = _mm_load_si128((const __m128i*)control);
+	__m128i orv = _mm_load_si128((const __m128i*)orBytes);
+
+	// A 16 byte load must not read past the end of the source. With 3 byte pixels it covers more than 4 of them.
+	int64 loadPixels = (16 + srcBytesPerPixel - 1) / srcBytesPerPixel;
+	int64 p = 0;
+	for (; p + tMath::tMax(int64(4), loadPixels) <= count; p += 4)
+	{
+		const uint8* s = src + p*srcBytesPerPixel;
+		__m128i out;
+		if (srcBytesPerPixel == 8)
+		{
+			__m128i lo = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)s), ctrl);
+			__m128i hi = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 16)), ctrl);
+			out = _mm_unpacklo_epi64(lo, hi);
+		}
+		else
+		{
+			out = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)s), ctrl);
+		}
+		_mm_storeu_si128((__m128i*)(dst + p*4), _mm_or_si128(out, orv));
+	}
+
+	RemapScalar(src + p*srcBytesPerPixel, srcBytesPerPixel, dst + p*4, count - p, remap);
+}
+
+
+KERNEL_AVX2 void Viewer::PixelKernels::RemapAVX2(const uint8* src, int srcBytesPerPixel, uint8* dst, int64 count, const Remap& remap)
+{
+	// The 256 bit shuffle works on each 128 bit half separately, which suits 4 byte pixels. 8 byte pixels would need
+	// a cross-half permute and are rare enough to leave to SSE4.
+	if (srcBytesPerPixel == 8)
+	{
+		RemapSSE4(src, srcBytesPerPixel, dst, count, remap);
+		return;
+	}
+
+	alignas(32) uint8 control[32];
+	alignas(32) uint8 orBytes[32];
+	for (int b = 0; b < 32; b++)
+	{
+		int p = (b % 16) / 4;
+		int c = b % 4;
+		control[b] = (remap.Index[c] >= 0) ? uint8(p*srcBytesPerPixel + remap.Index[c]) : 0x80;
+		orBytes[b] = remap.Or[c];
+	}
+	__m256i ctrl = _mm256_load_si256((const __m256i*)control);
+	__m256i orv = _mm256_load_si256((const __m256i*)orBytes);
+
+	// Each half loads 16 bytes starting at its first pixel. The second half starts 4 pixels in.
+	int64 loadPixels = 4 + (16 + srcBytesPerPixel - 1) / srcBytesPerPixel;
+	int64 p = 0;
+	for (; p + tMath::tMax(int64(8), loadPixels) <= count; p += 8)
+	{
+		const uint8* s = src + p*srcBytesPerPixel;
+		__m128i lo = _mm_loadu_si128((const __m128i*)s);
+		__m128i hi = _mm_loadu_si128((const __m128i*)(s + 4*srcBytesPerPixel));
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		__m256i out = _mm256_or_si256(_mm256_shuffle_epi8(in, ctrl), orv);
+		_mm256_storeu_si256((__m256i*)(dst + p*4), out);
+	}
+
+	RemapSSE4(src + p*srcBytesPerPixel, srcBytesPerPixel, dst + p*4, count - p, remap);
+}
+#endif
+
+
+void Viewer::PixelKernels::Run(const uint8* src, int srcBytesPerPixel, uint8* dst, int64 count, const Remap& remap)
+{
+	if (count <= 0)
+		return;
+
+	switch (CurrentLevel)
+	{
+		#ifdef ARCHITECTURE_X64
+		case Level::AVX2:	RemapAVX2(src, srcBytesPerPixel, dst, count, remap);	break;
+		case Level::SSE4:	RemapSSE4(src, srcBytesPerPixel, dst, count, remap);	break;
+		#endif
+		default:			RemapScalar(src, srcBytesPerPixel, dst, count, remap);	break;
+	}
+}
+
+
+void Viewer::PixelKernels::Swizzle(tPixel4b* pixels, int64 count, tComp R, tComp G, tComp B, tComp A)
+{
+	Remap remap;
+	tComp comps[4] = { R, G, B, A };
+	for (int c = 0; c < 4; c++)
+	{
+		remap.Or[c] = 0;
+		switch (comps[c])
+		{
+			case tComp::R:		remap.Index[c] = 0;		break;
+			case tComp::G:		remap.Index[c] = 1;		break;
+			case tComp::B:		remap.Index[c] = 2;		break;
+			case tComp::A:		remap.Index[c] = 3;		break;
+			case tComp::Zero:	remap.Index[c] = -1;	break;
+			case tComp::Full:	remap.Index[c] = -1;	remap.Or[c] = 0xFF;		break;
+			default:			remap.Index[c] = c;		break;
+		}
+	}
+
+	Run((const uint8*)pixels, 4, (uint8*)pixels, count, remap);
+}
+
+
+void Viewer::PixelKernels::Spread(tPixel4b* pixels, int64 count, tComp channel)
+{
+	if ((channel != tComp::R) && (channel != tComp::G) && (channel != tComp::B) && (channel != tComp::A))
+		return;
+
+	Swizzle(pixels, count, channel, channel, channel, tComp::A);
+}
+
+
+void Viewer::PixelKernels::SetChannels(tPixel4b* pixels, int64 count, const tColour4b& colour, comp_t channels)
+{
+	Remap remap;
+	comp_t bits[4] = { tCompBit_R, tCompBit_G, tCompBit_B, tCompBit_A };
+	uint8 values[4] = { colour.R, colour.G, colour.B, colour.A };
+	for (int c = 0; c < 4; c++)
+	{
+		bool set = (channels & bits[c]) != 0;
+		remap.Index[c] = set ? -1 : c;
+		remap.Or[c] = set ? values[c] : 0;
+	}
+
+	Run((const uint8*)pixels, 4, (uint8*)pixels, count, remap);
+}
+
+
+void Viewer::PixelKernels::ConvertPacked(const uint8* src, int srcBytesPerPixel, tPixel4b* dst, int64 count, const int srcByte[4])
+{
+	tAssert((srcBytesPerPixel == 3) || (srcBytesPerPixel == 4) || (srcBytesPerPixel == 8));
+	Remap remap;
+	for (int c = 0; c < 4; c++)
+	{
+		remap.Index[c] = srcByte[c];
+		remap.Or[c] = (srcByte[c] < 0) ? 0xFF : 0;
+	}
+
+	Run(src, srcBytesPerPixel, (uint8*)dst, count, remap);
+}
+
+
+uint8 Viewer::PixelKernels::ResampleRound(int32 sum)
+{
+	int32 value = (sum + (1 << (ResampleWeightBits-1))) >> ResampleWeightBits;
+	return uint8(tMath::tClamp(value, 0, 255));
+}
+
+
+void Viewer::PixelKernels::ResampleRowScalar(const tPixel4b* src, tPixel4b* dst, int begin, int end, const int* index, const int16* weights, int taps)
+{
+	for (int x = begin; x < end; x++)
+	{
+		const int* idx = index + x*taps;
+		const int16* w = weights + x*taps;
+		int32 sum[4] = { 0, 0, 0, 0 };
+		for (int t = 0; t < taps; t++)
+		{
+			const uint8* p = (const uint8*)(src + idx[t]);
+			for (int c = 0; c < 4; c++)
+				sum[c] += int32(p[c]) * w[t];
+		}
+
+		uint8* out = (uint8*)(dst + x);
+		for (int c = 0; c < 4; c++)
+			out[c] = ResampleRound(sum[c]);
+	}
+}
+
+
+void Viewer::PixelKernels::ResampleColumnsScalar(const tPixel4b* const* rows, const int16* weights, int taps, tPixel4b* dst, int begin, int end)
+{
+	for (int x = begin; x < end; x++)
+	{
+		int32 sum[4] = { 0, 0, 0, 0 };
+		for (int t = 0; t < taps; t++)
+		{
+			const uint8* p = (const uint8*)(rows[t] + x);
+			for (int c = 0; c < 4; c++)
+				sum[c] += int32(p[c]) * weights[t];
+		}
+
+		uint8* out = (uint8*)(dst + x);
+		for (int c = 0; c < 4; c++)
+			out[c] = ResampleRound(sum[c]);
+	}
+}
+
+
+#ifdef ARCHITECTURE_X64
+KERNEL_SSE4 void Viewer::PixelKernels::ResampleRowSSE4(const tPixel4b* src, tPixel4b* dst, int dstW, const int* index, const int16* weights, int taps)
+{
+	// Two taps at a time. Interleaving the bytes of the two source pixels lines up each channel pair for a single
+	// multiply-add against the two weights.
+	__m128i zero = _mm_setzero_si128();
+	__m128i round = _mm_set1_epi32(1 << (ResampleWeightBits-1));
+	for (int x = 0; x < dstW; x++)
+	{
+		const int* idx = index + x*taps;
+		const int16* w = weights + x*taps;
+		__m128i sum = _mm_setzero_si128();
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m128i p0 = _mm_cvtsi32_si128(int(src[idx[t]].BP));
+			__m128i p1 = _mm_cvtsi32_si128(int(src[idx[t+1]].BP));
+			__m128i pair = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p0, p1), zero);
+			__m128i wts = _mm_set1_epi32((int(uint16(w[t+1])) << 16) | int(uint16(w[t])));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, wts));
+		}
+
+		sum = _mm_srai_epi32(_mm_add_epi32(sum, round), ResampleWeightBits);
+		sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), zero);
+		dst[x].BP = uint32(_mm_cvtsi128_si32(sum));
+	}
+}
+
+
+KERNEL_AVX2 void Viewer::PixelKernels::ResampleRowAVX2(const tPixel4b* src, tPixel4b* dst, int dstW, const int* index, const int16* weights, int taps)
+{
+	// Same as SSE4 with two output pixels at once, one in each 128 bit half.
+	__m256i zero = _mm256_setzero_si256();
+	__m256i round = _mm256_set1_epi32(1 << (ResampleWeightBits-1));
+	int x = 0;
+	for (; x + 2 <= dstW; x += 2)
+	{
+		const int* idxA = index + x*taps;
+		const int* idxB = idxA + taps;
+		const int16* wA = weights + x*taps;
+		const int16* wB = wA + taps;
+		__m256i sum = _mm256_setzero_si256();
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m256i p0 = _mm256_setr_epi32(int(src[idxA[t]].BP), 0, 0, 0, int(src[idxB[t]].BP), 0, 0, 0);
+			__m256i p1 = _mm256_setr_epi32(int(src[idxA[t+1]].BP), 0, 0, 0, int(src[idxB[t+1]].BP), 0, 0, 0);
+			__m256i pair = _mm256_unpacklo_epi8(_mm256_unpacklo_epi8(p0, p1), zero);
+			int wtsA = (int(uint16(wA[t+1])) << 16) | int(uint16(wA[t]));
+			int wtsB = (int(uint16(wB[t+1])) << 16) | int(uint16(wB[t]));
+			__m256i wts = _mm256_setr_epi32(wtsA, wtsA, wtsA, wtsA, wtsB, wtsB, wtsB, wtsB);
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pair, wts));
+		}
+
+		sum = _mm256_srai_epi32(_mm256_add_epi32(sum, round), ResampleWeightBits);
+		sum = _mm256_packus_epi16(_mm256_packs_epi32(sum, sum), zero);
+		dst[x].BP = uint32(_mm256_extract_epi32(sum, 0));
+		dst[x+1].BP = uint32(_mm256_extract_epi32(sum, 4));
+	}
+
+	ResampleRowScalar(src, dst, x, dstW, index, weights, taps);
+}
+
+
+KERNEL_SSE4 void Viewer::PixelKernels::ResampleColumnsSSE4(const tPixel4b* const* rows, const int16* weights, int taps, tPixel4b* dst, int width)
+{
+	// Sixteen bytes of the output row at a time. The bytes of two source rows are interleaved so each multiply-add
+	// applies both weights to a channel.
+	__m128i zero = _mm_setzero_si128();
+	__m128i round = _mm_set1_epi32(1 << (ResampleWeightBits-1));
+	int x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i sum[4] = { zero, zero, zero, zero };
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(rows[t] + x));
+			__m128i b = _mm_loadu_si128((const __m128i*)(rows[t+1] + x));
+			__m128i wts = _mm_set1_epi32((int(uint16(weights[t+1])) << 16) | int(uint16(weights[t])));
+			__m128i lo = _mm_unpacklo_epi8(a, b);
+			__m128i hi = _mm_unpackhi_epi8(a, b);
+			sum[0] = _mm_add_epi32(sum[0], _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), wts));
+			sum[1] = _mm_add_epi32(sum[1], _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), wts));
+			sum[2] = _mm_add_epi32(sum[2], _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), wts));
+			sum[3] = _mm_add_epi32(sum[3], _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), wts));
+		}
+
+		for (int s = 0; s < 4; s++)
+			sum[s] = _mm_srai_epi32(_mm_add_epi32(sum[s], round), ResampleWeightBits);
+		__m128i out = _mm_packus_epi16(_mm_packs_epi32(sum[0], sum[1]), _mm_packs_epi32(sum[2], sum[3]));
+		_mm_storeu_si128((__m128i*)(dst + x), out);
+	}
+
+	ResampleColumnsScalar(rows, weights, taps, dst, x, width);
+}
+
+
+KERNEL_AVX2 void Viewer::PixelKernels::ResampleColumnsAVX2(const tPixel4b* const* rows, const int16* weights, int taps, tPixel4b* dst, int width)
+{
+	// The unpacks and packs work within each 128 bit half, so the bytes come back out in their original order.
+	__m256i zero = _mm256_setzero_si256();
+	__m256i round = _mm256_set1_epi32(1 << (ResampleWeightBits-1));
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i sum[4] = { zero, zero, zero, zero };
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(rows[t] + x));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(rows[t+1] + x));
+			__m256i wts = _mm256_set1_epi32((int(uint16(weights[t+1])) << 16) | int(uint16(weights[t])));
+			__m256i lo = _mm256_unpacklo_epi8(a, b);
+			__m256i hi = _mm256_unpackhi_epi8(a, b);
+			sum[0] = _mm256_add_epi32(sum[0], _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), wts));
+			sum[1] = _mm256_add_epi32(sum[1], _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), wts));
+			sum[2] = _mm256_add_epi32(sum[2], _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), wts));
+			sum[3] = _mm256_add_epi32(sum[3], _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), wts));
+		}
+
+		for (int s = 0; s < 4; s++)
+			sum[s] = _mm256_srai_epi32(_mm256_add_epi32(sum[s], round), ResampleWeightBits);
+		__m256i out = _mm256_packus_epi16(_mm256_packs_epi32(sum[0], sum[1]), _mm256_packs_epi32(sum[2], sum[3]));
+		_mm256_storeu_si256((__m256i*)(dst + x), out);
+	}
+
+	ResampleColumnsScalar(rows, weights, taps, dst, x, width);
+}
+#endif
+
+
+void Viewer::PixelKernels::ResampleRow(const tPixel4b* src, tPixel4b* dst, int dstW, const int* index, const int16* weights, int taps)
+{
+	tAssert(!(taps & 1));
+	switch (CurrentLevel)
+	{
+		#ifdef ARCHITECTURE_X64
+		case Level::AVX2:	ResampleRowAVX2(src, dst, dstW, index, weights, taps);			break;
+		case Level::SSE4:	ResampleRowSSE4(src, dst, dstW, index, weights, taps);			break;
+		#endif
+		default:			ResampleRowScalar(src, dst, 0, dstW, index, weights, taps);		break;
+	}
+}
+
+
+void Viewer::PixelKernels::ResampleColumns(const tPixel4b* const* rows, const int16* weights, int taps, tPixel4b* dst, int width)
+{
+	tAssert(!(taps & 1));
+	switch (CurrentLevel)
+	{
+		#ifdef ARCHITECTURE_X64
+		case Level::AVX2:	ResampleColumnsAVX2(rows, weights, taps, dst, width);			break;
+		case Level::SSE4:	ResampleColumnsSSE4(rows, weights, taps, dst, width);			break;
+		#endif
+		default:			ResampleColumnsScalar(rows, weights, taps, dst, 0, width);		break;
+	}
+}
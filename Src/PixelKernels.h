@@ -0,0 +1,66 @@
+// PixelKernels.h
+//
+// Vectorized loops for simple per-pixel work on RGBA8 pixels. Each kernel has a scalar version and SSE4 and AVX2
+// versions. The best one the CPU supports is picked at startup. All versions give exactly the same bytes.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tStandard.h>
+#include <Math/tColour.h>
+
+
+namespace Viewer
+{
+	namespace PixelKernels
+	{
+		enum class Level
+		{
+			Scalar,
+			SSE4,
+			AVX2
+		};
+
+		// The level in use. Starts as the best one the CPU supports. SetLevel may pick a lower one, for example to
+		// compare results against the scalar kernels. Higher levels than the CPU supports are ignored. Only change
+		// the level while no kernels are running.
+		Level GetLevel();
+		Level GetSupportedLevel();
+		void SetLevel(Level);
+		const char* GetLevelName(Level);
+
+		// Rearranges the channels of every pixel in place. Arguments are the source of the destination RGBA channels
+		// in that order, the same as tPicture::Swizzle. Auto keeps the channel, and Zero and Full set it to 0 or 255.
+		void Swizzle(tPixel4b*, int64 count, tComp R, tComp G, tComp B, tComp A);
+
+		// Copies the given channel into R, G, and B. Alpha is unchanged.
+		void Spread(tPixel4b*, int64 count, tComp channel);
+
+		// Sets the given channels of every pixel to the channels of the colour.
+		void SetChannels(tPixel4b*, int64 count, const tColour4b&, comp_t channels);
+
+		// Converts packed 3, 4, or 8 byte pixels to RGBA. srcByte holds the offset of the byte within a source pixel
+		// to use for each of R, G, B, and A. An offset of -1 gives a fully opaque alpha. For 8 byte pixels use the
+		// offset of the most significant byte of each 16 bit channel. src and dst may be the same for 4 byte pixels.
+		void ConvertPacked(const uint8* src, int srcBytesPerPixel, tPixel4b* dst, int64 count, const int srcByte[4]);
+
+		// The resample passes use fixed point weights with this many fraction bits. Results are rounded and clamped.
+		const int ResampleWeightBits								= 14;
+
+		// A horizontal resample pass over one row. Output pixel x is the sum over t of src[index[x*taps + t]] times
+		// weights[x*taps + t]. The number of taps must be even. Pad with zero weights.
+		void ResampleRow(const tPixel4b* src, tPixel4b* dst, int dstW, const int* index, const int16* weights, int taps);
+
+		// A vertical resample pass making one row. Output pixel x is the sum over t of rows[t][x] times weights[t].
+		// The number of taps must be even. Pad with zero weights.
+		void ResampleColumns(const tPixel4b* const* rows, const int16* weights, int taps, tPixel4b* dst, int width);
+	}
+}
@@ -373,9 +373,24 @@ void Viewer::ShowPreferencesWindow(bool* popen)
 
 			ImGui::SetNextItemWidth(itemWidth);
 			ImGui::InputInt("Max Mem (MB)", &profile.MaxImageMemMB); ImGui::SameLine();
-			Gutil::HelpMark("Approx memory use limit of this app. Minimum 256 MB.");
+			Gutil::HelpMark("Approx image memory use limit of this app. Least recently viewed images are unloaded\nwhen exceeded. Minimum 256 MB.");
 			tMath::tiClampMin(profile.MaxImageMemMB, 256);
 
+			ImGui::SetNextItemWidth(itemWidth);
+			ImGui::InputInt("Max VRAM (MB)", &profile.MaxTextureMemMB); ImGui::SameLine();
+			Gutil::HelpMark("Approx video memory limit for image textures. Textures of least recently viewed\nimages are released when exceeded. Minimum 128 MB.");
+			tMath::tiClampMin(profile.MaxTextureMemMB, 128);
+
+			ImGui::SetNextItemWidth(itemWidth);
+			ImGui::InputInt("Max Undo Mem (MB)", &profile.MaxUndoMemMB); ImGui::SameLine();
+			Gutil::HelpMark("Approx memory limit for undo steps over all images. The oldest steps of least\nrecently viewed images are dropped first. Minimum 64 MB.");
+			tMath::tiClampMin(profile.MaxUndoMemMB, 64);
+
+			ImGui::SetNextItemWidth(itemWidth);
+			ImGui::InputInt("Max Edit Frames", &profile.MaxEditFrames); ImGui::SameLine();
+			Gutil::HelpMark("Maximum number of frames of an animated image edited at the same time. Each one may\nneed a working copy so lower values use less memory. Zero for one per core.");
+			tMath::tiClamp(profile.MaxEditFrames, 0, 256);
+
 			ImGui::SetNextItemWidth(itemWidth);
 			ImGui::InputInt("Max Cache Files", &profile.MaxCacheFiles); ImGui::SameLine();
 			Gutil::HelpMark("Maximum number of cache files that may be created. Minimum 200.");
@@ -440,6 +455,9 @@ void Viewer::ShowPreferencesWindow(bool* popen)
 			ImGui::Checkbox("Detect APNG Inside PNG", &profile.DetectAPNGInsidePNG); ImGui::SameLine();
 			Gutil::HelpMark("Some png image files are really apng files. If detecton is true these png files will be displayed animated.");
 
+			ImGui::Checkbox("Keep Block Compressed", &profile.KeepBlockCompressed); ImGui::SameLine();
+			Gutil::HelpMark("Keeps BC1-BC5 and BC7 dds, ktx, and pvr files in their compressed form in memory and VRAM.\nThey are decoded only when pixels are needed, such as when editing or saving.\nCubemaps are always decoded. Takes effect the next time an image is loaded.");
+
 			ImGui::Checkbox("Mipmap Chaining", &profile.MipmapChaining); ImGui::SameLine();
 			Gutil::HelpMark("Chaining generates mipmaps faster. No chaining gives slightly\nbetter results at cost of large generation time.");
 
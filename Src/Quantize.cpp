@@ -12,11 +12,14 @@
 // AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 // PERFORMANCE OF THIS SOFTWARE.
 
+#include <mutex>
 #include "imgui.h"
 #include "Quantize.h"
 #include "Image.h"
 #include "TacentView.h"
 #include "GuiUtil.h"
+#include "EditJob.h"
+#include "SpatialQuantizer.h"
 using namespace tStd;
 using namespace tSystem;
 using namespace tMath;
@@ -25,37 +28,57 @@ using namespace tImage;
 
 namespace Viewer
 {
-	// Compute a (very) approx number of seconds it will take to quantize on an intel 11th gen mobile CPU.
-	float ComputeApproxQuantizeDuration(const Image* image, tImage::tQuantize::Method method, int numColours);
+	// Compute a (very) approx number of seconds it will take to quantize on an intel 11th gen mobile CPU. The spatial
+	// estimate is for this machine and its work pool.
+	float ComputeApproxQuantizeDuration
+	(
+		const Image* image, tImage::tQuantize::Method method, int numColours,
+		const SpatialQuantizer::Params& spatialParams
+	);
 }
 
 
-float Viewer::ComputeApproxQuantizeDuration(const Image* image, tImage::tQuantize::Method method, int numColours)
+float Viewer::ComputeApproxQuantizeDuration
+(
+	const Image* image, tImage::tQuantize::Method method, int numColours,
+	const SpatialQuantizer::Params& spatialParams
+)
 {
 	if (!image || (numColours < 2))
 		return 0.0f;
 
-	// We currently only consider scolorq and neu methods. The other two are quite fast.
+	// Unloaded images use the probed or cached area so no load is needed.
+	float area = float(image->IsLoaded() ? image->GetArea() : image->Cached_PrimaryArea);
+
+	// We currently only consider spatial and neu methods. The other two are quite fast.
 	switch (method)
 	{
 		case tImage::tQuantize::Method::Spatial:
-			// 1024x1024 pixels, 2 colours -> approx 5 seconds.
-			return (5.0f*CurrImage->GetArea()*numColours) / (1024.0f*1024.0f*2.0f);
+		{
+			// Only the area matters to the estimate so a square of the same area stands in for the image.
+			int side = int(tSqrt(area));
+			return SpatialQuantizer::EstimateDuration(side, side, spatialParams);
+		}
 
 		case tImage::tQuantize::Method::Neu:
 			// 1024x1024 pixels, 256 colours -> approx 3 seconds.
-			return (3.0f*CurrImage->GetArea()*numColours) / (1024.0f*1024.0f*256.0f);
+			return (3.0f*area*numColours) / (1024.0f*1024.0f*256.0f);
 	}
 	return 0.0f;
 }
 
 
-void Viewer::DoQuantizeInterface(int& method, int& spatialFilterSize, float& spatialDitherLevel, int& neuSampleFactor, float itemWidth)
+void Viewer::DoQuantizeInterface
+(
+	int& method,
+	int& spatialFilterSize, float& spatialDitherLevel, float& spatialBudget, int& neuSampleFactor,
+	float itemWidth
+)
 {
 	if (itemWidth > 0.0f)
 		ImGui::SetNextItemWidth(itemWidth);
 
-	const char* methodItems[] = { "Fixed Palette", "Spatial Scolorq", "Neu Quant", "Wu Bipartition" };
+	const char* methodItems[] = { "Fixed Palette", "Spatial", "Neu Quant", "Wu Bipartition" };
 	ImGui::Combo("Quantize Method", &method , methodItems, tNumElements(methodItems));
 	ImGui::SameLine();
 	Gutil::HelpMark
@@ -68,8 +91,9 @@ void Viewer::DoQuantizeInterface(int& method, int& spatialFilterSize, float& spa
 		"be used because the source image colours may not be close to all the\n"
 		"colours in the fixed palette.\n\n"
 
-		"Spatial Scolorq: High quality but slow. Good for 5-bit (32-colour)\n"
-		"palettes and smaller. This quantization method supports dither.\n\n"
+		"Spatial: High quality but the slowest. Good for 5-bit (32-colour)\n"
+		"palettes and smaller. This quantization method supports dither. It\n"
+		"may be given a time budget.\n\n"
 
 		"Neu Quant: Defacto high-quality quantizer. Neural-network based. Good\n"
 		"for 6-bit (64-colour) palettes and larger.\n\n"
@@ -85,7 +109,7 @@ void Viewer::DoQuantizeInterface(int& method, int& spatialFilterSize, float& spa
 		const char* filterSizeItems[] = { "Low", "Med", "High" };
 		ImGui::Combo("Quantize Filter Size", &spatialFilterSize , filterSizeItems, tNumElements(filterSizeItems));
 		ImGui::SameLine();
-		Gutil::HelpMark("Filter size for the scolorq/spatial quantizer. Low -> 1, Med -> 3, High -> 5");
+		Gutil::HelpMark("Filter size for the spatial quantizer. Low -> 1, Med -> 3, High -> 5");
 
 		if (itemWidth > 0.0f)
 			ImGui::SetNextItemWidth(itemWidth);
@@ -93,10 +117,23 @@ void Viewer::DoQuantizeInterface(int& method, int& spatialFilterSize, float& spa
 		ImGui::SameLine();
 		Gutil::HelpMark
 		(
-			"Dither level for the scolorq/spatial quantizer. 0 means auto-determine a good value for\n"
+			"Dither level for the spatial quantizer. 0 means auto-determine a good value for\n"
 			"the current image based on its dimensions. Greater than zero means manually set the\n"
 			"amount. A dither value of 0.1 results in no dithering. 2.0 results in significant dithering."
 		);
+
+		if (itemWidth > 0.0f)
+			ImGui::SetNextItemWidth(itemWidth);
+		ImGui::InputFloat("Quantize Budget", &spatialBudget, 1.0f, 10.0f, "%.1f");
+		tiClampMin(spatialBudget, 0.0f);
+		ImGui::SameLine();
+		Gutil::HelpMark
+		(
+			"Time budget in seconds for the spatial quantizer, per frame. Once used up no more\n"
+			"refining passes are made and the result so far is kept. When saving, the budget is\n"
+			"turned into a fixed number of passes so the file is the same on any machine. 0 means\n"
+			"no limit."
+		);
 	}
 
 	if (method == int(tQuantize::Method::Neu))
@@ -137,10 +174,11 @@ void Viewer::DoQuantizeModal(bool quantizeImagePressed)
 	static int method = int(tImage::tQuantize::Method::Wu);
 	static int spatialFilterSize = 1;
 	static float spatialDitherLevel = 0.0f;
+	static float spatialBudget = 0.0f;
 	static int neuSampleFactor = 1;
 	static int numColours = 256;
 
-	DoQuantizeInterface(method, spatialFilterSize, spatialDitherLevel, neuSampleFactor, itemWidth);
+	DoQuantizeInterface(method, spatialFilterSize, spatialDitherLevel, spatialBudget, neuSampleFactor, itemWidth);
 
 	ImGui::SetNextItemWidth(itemWidth);
 	ImGui::InputInt("Num Colours", &numColours);
@@ -162,8 +200,20 @@ void Viewer::DoQuantizeModal(bool quantizeImagePressed)
 		"quantize will proceed either way, and the chosen quantize method may adjust the colours."
 	);
 
+	SpatialQuantizer::Params spatialParams;
+	spatialParams.NumColours	= numColours;
+	spatialParams.DitherLevel	= double(spatialDitherLevel);
+	spatialParams.FilterSize	= (spatialFilterSize * 2) + 1;
+	spatialParams.TimeBudget	= spatialBudget;
+
+	// Here the budget is for the wait, so it is measured on the clock.
+	spatialParams.WallClockBudget = true;
+
 	// This is so we can print a warning if it's going to take a really long time.
-	float quantizeDurationApprox = ComputeApproxQuantizeDuration(CurrImage, tImage::tQuantize::Method(method), numColours);
+	float quantizeDurationApprox = ComputeApproxQuantizeDuration
+	(
+		CurrImage, tImage::tQuantize::Method(method), numColours, spatialParams
+	);
 	float maxDurationBeforeWarning = 10.0f;
 	if (quantizeDurationApprox > maxDurationBeforeWarning)
 	{
@@ -173,8 +223,8 @@ void Viewer::DoQuantizeModal(bool quantizeImagePressed)
 			"Based on the image resolution, quantization\n"
 			"method, and number of colours, this operation\n"
 			"will take more than %d seconds.\n\n"
-			"Consider a different method or reduce the\n"
-			"number of colours.",
+			"Consider a different method, reduce the\n"
+			"number of colours, or set a time budget.",
 			int(quantizeDurationApprox)
 		);
 	}
@@ -188,6 +238,7 @@ void Viewer::DoQuantizeModal(bool quantizeImagePressed)
 		method = int(tImage::tQuantize::Method::Wu);
 		spatialFilterSize = 1;
 		spatialDitherLevel = 0.0f;
+		spatialBudget = 0.0f;
 		neuSampleFactor = 1;
 		numColours = 256;
 		checkExact = true;
@@ -205,31 +256,45 @@ void Viewer::DoQuantizeModal(bool quantizeImagePressed)
 		ImGui::SetKeyboardFocusHere();
 	if (Gutil::Button("Quantize##Button", tVector2(buttonWidth, 0.0f)))
 	{
-		CurrImage->Unbind();
+		// The operation runs on worker threads so it gets copies of the settings rather than the statics.
+		int colours = numColours;
+		bool exact = checkExact;
+		EditJob::Operation op;
 		switch (tImage::tQuantize::Method(method))
 		{
 			case tImage::tQuantize::Method::Fixed:
-				CurrImage->QuantizeFixed(numColours, checkExact);
+				op = [=](tPicture& pic, int, WorkPool::Progress&) { pic.QuantizeFixed(colours, exact); };
 				break;
 
 			case tImage::tQuantize::Method::Spatial:
-			{
-				int filterSize135 = (spatialFilterSize * 2) + 1;
-				CurrImage->QuantizeSpatial(numColours, checkExact, spatialDitherLevel, filterSize135);
+				op = [=](tPicture& pic, int, WorkPool::Progress& progress)
+				{
+					SpatialQuantizer::Quantize(pic, spatialParams, exact, &progress);
+				};
 				break;
-			}
 
 			case tImage::tQuantize::Method::Neu:
-				CurrImage->QuantizeNeu(numColours, checkExact, neuSampleFactor);
+			{
+				// NeuQuant learns into a single network so frames take turns. Frames waiting their turn when the edit
+				// is cancelled don't start.
+				int sampleFactor = neuSampleFactor;
+				op = [=](tPicture& pic, int, WorkPool::Progress& progress)
+				{
+					static std::mutex neuMutex;
+					std::lock_guard<std::mutex> lock(neuMutex);
+					if (!progress.IsCancelled())
+						pic.QuantizeNeu(colours, exact, sampleFactor);
+				};
 				break;
+			}
 
 			case tImage::tQuantize::Method::Wu:
-				CurrImage->QuantizeWu(numColours, checkExact);
+				op = [=](tPicture& pic, int, WorkPool::Progress&) { pic.QuantizeWu(colours, exact); };
 				break;
 		}
-		CurrImage->Bind();
-		Gutil::SetWindowTitle();
 
+		tString desc; tsPrintf(desc, "Quantize %d", colours);
+		EditJob::Start(CurrImage, desc, op, [] { Gutil::SetWindowTitle(); });
 		ImGui::CloseCurrentPopup();
 	}
 	ImGui::EndPopup();
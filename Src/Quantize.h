@@ -21,7 +21,7 @@ namespace Viewer
 	void DoQuantizeInterface
 	(
 		int& method,
-		int& spatialFilterSize, float& spatialDitherLevel, int& neuSampleFactor,
+		int& spatialFilterSize, float& spatialDitherLevel, float& spatialBudget, int& neuSampleFactor,
 		float itemWidth = 0.0f
 	);
 }
@@ -0,0 +1,490 @@
+// Renderer.cpp
+//
+// A small retained-mode renderer for the work area. Geometry is batched into a streamed vertex buffer and drawn with
+// three simple GLSL 1.20 programs: flat colour, textured with a channel filter, and a procedural checkerboard. Only
+// OpenGL 2.1 is required so it runs on Mesa's llvmpipe. ImGui still draws itself with its own backend after End.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <cstddef>
+#include <glad/glad.h>
+#include <System/tPrint.h>
+#include "Renderer.h"
+using namespace tMath;
+
+
+namespace Viewer
+{
+	namespace Renderer
+	{
+		struct Vertex
+		{
+			float X, Y;
+			float U, V;
+			float R, G, B, A;
+		};
+
+		enum class Program
+		{
+			Colour,
+			Texture,
+			Checker,
+			NumPrograms
+		};
+
+		enum Attrib
+		{
+			Attrib_Position,
+			Attrib_TexCoord,
+			Attrib_Colour,
+			NumAttribs
+		};
+
+		struct ProgramInfo
+		{
+			GLuint Handle									= 0;
+			GLint LocProjection								= -1;
+			GLint LocModel									= -1;
+			GLint LocTexture								= -1;
+			GLint LocChannelMatrix							= -1;
+			GLint LocChannelOffset							= -1;
+			GLint LocCheckColourEven						= -1;
+			GLint LocCheckColourOdd							= -1;
+		};
+
+		GLuint CompileShader(GLenum type, const char* source);
+		bool LinkProgram(ProgramInfo&, GLuint vertShader, const char* fragSource);
+		void UseProgram(Program);
+		void Reserve(GLenum mode, int numVerts);
+		void Flush();
+		void AddVertex(float x, float y, float u, float v, const tColour4f&);
+
+		const char* VertexSource =
+			"#version 120\n"
+			"uniform mat4 Projection;\n"
+			"uniform mat4 Model;\n"
+			"attribute vec2 Position;\n"
+			"attribute vec2 TexCoord;\n"
+			"attribute vec4 Colour;\n"
+			"varying vec2 vTexCoord;\n"
+			"varying vec4 vColour;\n"
+			"void main()\n"
+			"{\n"
+			"	vTexCoord = TexCoord;\n"
+			"	vColour = Colour;\n"
+			"	gl_Position = Projection * Model * vec4(Position, 0.0, 1.0);\n"
+			"}\n";
+
+		const char* FragmentSourceColour =
+			"#version 120\n"
+			"varying vec2 vTexCoord;\n"
+			"varying vec4 vColour;\n"
+			"void main()\n"
+			"{\n"
+			"	gl_FragColor = vColour;\n"
+			"}\n";
+
+		const char* FragmentSourceTexture =
+			"#version 120\n"
+			"uniform sampler2D Texture;\n"
+			"uniform mat4 ChannelMatrix;\n"
+			"uniform vec4 ChannelOffset;\n"
+			"varying vec2 vTexCoord;\n"
+			"varying vec4 vColour;\n"
+			"void main()\n"
+			"{\n"
+			"	vec4 texel = texture2D(Texture, vTexCoord);\n"
+			"	gl_FragColor = vColour * (ChannelMatrix*texel + ChannelOffset);\n"
+			"}\n";
+
+		// The texture coordinates are in units of checks relative to the checkerboard origin.
+		const char* FragmentSourceChecker =
+			"#version 120\n"
+			"uniform vec4 CheckColourEven;\n"
+			"uniform vec4 CheckColourOdd;\n"
+			"varying vec2 vTexCoord;\n"
+			"varying vec4 vColour;\n"
+			"void main()\n"
+			"{\n"
+			"	vec2 check = floor(vTexCoord);\n"
+			"	float odd = mod(check.x + check.y, 2.0);\n"
+			"	gl_FragColor = mix(CheckColourEven, CheckColourOdd, odd);\n"
+			"}\n";
+
+		// Big enough that the crop widget and reticle always fit in one batch.
+		const int MaxBatchVerts								= 1024;
+		Vertex BatchVerts[MaxBatchVerts];
+		int NumBatchVerts									= 0;
+		GLenum BatchMode									= GL_TRIANGLES;
+
+		ProgramInfo Programs[int(Program::NumPrograms)];
+		Program CurrProgram									= Program::NumPrograms;
+		GLuint VertexShader									= 0;
+		GLuint VertexBuffer									= 0;
+		bool Initialized									= false;
+
+		float Projection[16];
+		float Model[16];
+	}
+}
+
+
+void Viewer::Renderer::ChannelFilter::SetIdentity()
+{
+	for (int e = 0; e < 16; e++)
+		Matrix[e] = (e % 5) ? 0.0f : 1.0f;
+	for (int c = 0; c < 4; c++)
+		Offset[c] = 0.0f;
+}
+
+
+void Viewer::Renderer::ChannelFilter::SetChannels(bool r, bool g, bool b, bool a, bool asIntensity)
+{
+	for (int e = 0; e < 16; e++)
+		Matrix[e] = 0.0f;
+	for (int c = 0; c < 4; c++)
+		Offset[c] = 0.0f;
+
+	if (asIntensity)
+	{
+		// Same precedence as the original swizzle code. The last selected channel wins.
+		int src = -1;
+		if (r) src = 0;
+		if (g) src = 1;
+		if (b) src = 2;
+		if (a) src = 3;
+		if (src != -1)
+		{
+			for (int dst = 0; dst < 3; dst++)
+				Matrix[src*4 + dst] = 1.0f;
+			Offset[3] = 1.0f;
+			return;
+		}
+	}
+
+	bool enabled[4] = { r, g, b, a };
+	for (int c = 0; c < 3; c++)
+		if (enabled[c])
+			Matrix[c*4 + c] = 1.0f;
+
+	if (a)
+		Matrix[3*4 + 3] = 1.0f;
+	else
+		Offset[3] = 1.0f;
+}
+
+
+void Viewer::Renderer::ChannelFilter::SetWhite()
+{
+	for (int e = 0; e < 16; e++)
+		Matrix[e] = 0.0f;
+	for (int c = 0; c < 4; c++)
+		Offset[c] = 1.0f;
+}
+
+
+GLuint Viewer::Renderer::CompileShader(GLenum type, const char* source)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+		tPrintf("Renderer shader compile failed:\n%s\n", log);
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+
+bool Viewer::Renderer::LinkProgram(ProgramInfo& info, GLuint vertShader, const char* fragSource)
+{
+	GLuint fragShader = CompileShader(GL_FRAGMENT_SHADER, fragSource);
+	if (!fragShader)
+		return false;
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertShader);
+	glAttachShader(program, fragShader);
+
+	// Binding before linking means every program shares the same attribute layout.
+	glBindAttribLocation(program, Attrib_Position, "Position");
+	glBindAttribLocation(program, Attrib_TexCoord, "TexCoord");
+	glBindAttribLocation(program, Attrib_Colour, "Colour");
+	glLinkProgram(program);
+
+	// The program keeps what it needs. The vertex shader is shared and deleted in Shutdown.
+	glDetachShader(program, fragShader);
+	glDeleteShader(fragShader);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char log[1024];
+		glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+		tPrintf("Renderer program link failed:\n%s\n", log);
+		glDeleteProgram(program);
+		return false;
+	}
+
+	info.Handle					= program;
+	info.LocProjection			= glGetUniformLocation(program, "Projection");
+	info.LocModel				= glGetUniformLocation(program, "Model");
+	info.LocTexture				= glGetUniformLocation(program, "Texture");
+	info.LocChannelMatrix		= glGetUniformLocation(program, "ChannelMatrix");
+	info.LocChannelOffset		= glGetUniformLocation(program, "ChannelOffset");
+	info.LocCheckColourEven		= glGetUniformLocation(program, "CheckColourEven");
+	info.LocCheckColourOdd		= glGetUniformLocation(program, "CheckColourOdd");
+	return true;
+}
+
+
+bool Viewer::Renderer::Init()
+{
+	if (Initialized)
+		return true;
+
+	VertexShader = CompileShader(GL_VERTEX_SHADER, VertexSource);
+	if (!VertexShader)
+		return false;
+
+	const char* fragSources[int(Program::NumPrograms)] = { FragmentSourceColour, FragmentSourceTexture, FragmentSourceChecker };
+	for (int p = 0; p < int(Program::NumPrograms); p++)
+	{
+		if (!LinkProgram(Programs[p], VertexShader, fragSources[p]))
+		{
+			Shutdown();
+			return false;
+		}
+	}
+
+	glGenBuffers(1, &VertexBuffer);
+	for (int e = 0; e < 16; e++)
+		Model[e] = Projection[e] = (e % 5) ? 0.0f : 1.0f;
+
+	Initialized = true;
+	return true;
+}
+
+
+void Viewer::Renderer::Shutdown()
+{
+	for (int p = 0; p < int(Program::NumPrograms); p++)
+	{
+		if (Programs[p].Handle)
+			glDeleteProgram(Programs[p].Handle);
+		Programs[p] = ProgramInfo();
+	}
+
+	if (VertexShader)
+		glDeleteShader(VertexShader);
+	VertexShader = 0;
+
+	if (VertexBuffer)
+		glDeleteBuffers(1, &VertexBuffer);
+	VertexBuffer = 0;
+
+	CurrProgram = Program::NumPrograms;
+	NumBatchVerts = 0;
+	Initialized = false;
+}
+
+
+void Viewer::Renderer::Begin(int workW, int workH)
+{
+	tAssert(Initialized);
+
+	// Orthographic projection with the origin at the lower-left. Same as glOrtho(0, w, 0, h, -1, 1).
+	for (int e = 0; e < 16; e++)
+		Projection[e] = 0.0f;
+	Projection[0]	= 2.0f / float(workW > 0 ? workW : 1);
+	Projection[5]	= 2.0f / float(workH > 0 ? workH : 1);
+	Projection[10]	= -1.0f;
+	Projection[12]	= -1.0f;
+	Projection[13]	= -1.0f;
+	Projection[15]	= 1.0f;
+	for (int e = 0; e < 16; e++)
+		Model[e] = (e % 5) ? 0.0f : 1.0f;
+
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+	const GLsizei stride = sizeof(Vertex);
+	glEnableVertexAttribArray(Attrib_Position);
+	glEnableVertexAttribArray(Attrib_TexCoord);
+	glEnableVertexAttribArray(Attrib_Colour);
+	glVertexAttribPointer(Attrib_Position,	2, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, X));
+	glVertexAttribPointer(Attrib_TexCoord,	2, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, U));
+	glVertexAttribPointer(Attrib_Colour,	4, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, R));
+
+	// Force the uniforms to be set on first use.
+	CurrProgram = Program::NumPrograms;
+	NumBatchVerts = 0;
+}
+
+
+void Viewer::Renderer::End()
+{
+	Flush();
+
+	// ImGui's GL2 backend uses the fixed function pipeline and client-side arrays.
+	glUseProgram(0);
+	glDisableVertexAttribArray(Attrib_Position);
+	glDisableVertexAttribArray(Attrib_TexCoord);
+	glDisableVertexAttribArray(Attrib_Colour);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	CurrProgram = Program::NumPrograms;
+}
+
+
+void Viewer::Renderer::UseProgram(Program program)
+{
+	if (program == CurrProgram)
+		return;
+
+	Flush();
+	const ProgramInfo& info = Programs[int(program)];
+	glUseProgram(info.Handle);
+	glUniformMatrix4fv(info.LocProjection, 1, GL_FALSE, Projection);
+	glUniformMatrix4fv(info.LocModel, 1, GL_FALSE, Model);
+	if (info.LocTexture != -1)
+		glUniform1i(info.LocTexture, 0);
+	CurrProgram = program;
+}
+
+
+void Viewer::Renderer::SetTransform(const tMatrix4& transform)
+{
+	Flush();
+	for (int e = 0; e < 16; e++)
+		Model[e] = transform.E[e];
+
+	// Uniforms belong to the program so the next UseProgram must upload the new model matrix.
+	CurrProgram = Program::NumPrograms;
+}
+
+
+void Viewer::Renderer::ResetTransform()
+{
+	Flush();
+	for (int e = 0; e < 16; e++)
+		Model[e] = (e % 5) ? 0.0f : 1.0f;
+	CurrProgram = Program::NumPrograms;
+}
+
+
+void Viewer::Renderer::Reserve(GLenum mode, int numVerts)
+{
+	if ((mode != BatchMode) || (NumBatchVerts + numVerts > MaxBatchVerts))
+		Flush();
+	BatchMode = mode;
+}
+
+
+void Viewer::Renderer::Flush()
+{
+	if (NumBatchVerts <= 0)
+		return;
+
+	// Orphaning the buffer every flush lets the driver hand us fresh storage instead of stalling on the last draw.
+	glBufferData(GL_ARRAY_BUFFER, NumBatchVerts*sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, NumBatchVerts*sizeof(Vertex), BatchVerts);
+	glDrawArrays(BatchMode, 0, NumBatchVerts);
+	NumBatchVerts = 0;
+}
+
+
+void Viewer::Renderer::AddVertex(float x, float y, float u, float v, const tColour4f& col)
+{
+	Vertex& vert = BatchVerts[NumBatchVerts++];
+	vert.X = x;		vert.Y = y;
+	vert.U = u;		vert.V = v;
+	vert.R = col.R;	vert.G = col.G;	vert.B = col.B;	vert.A = col.A;
+}
+
+
+void Viewer::Renderer::DrawQuad(float l, float b, float r, float t, const tColour4f& col)
+{
+	UseProgram(Program::Colour);
+	Reserve(GL_TRIANGLES, 6);
+	AddVertex(l, b, 0.0f, 0.0f, col);	AddVertex(r, b, 0.0f, 0.0f, col);	AddVertex(r, t, 0.0f, 0.0f, col);
+	AddVertex(l, b, 0.0f, 0.0f, col);	AddVertex(r, t, 0.0f, 0.0f, col);	AddVertex(l, t, 0.0f, 0.0f, col);
+}
+
+
+void Viewer::Renderer::DrawTriangle(float x0, float y0, float x1, float y1, float x2, float y2, const tColour4f& col)
+{
+	UseProgram(Program::Colour);
+	Reserve(GL_TRIANGLES, 3);
+	AddVertex(x0, y0, 0.0f, 0.0f, col);
+	AddVertex(x1, y1, 0.0f, 0.0f, col);
+	AddVertex(x2, y2, 0.0f, 0.0f, col);
+}
+
+
+void Viewer::Renderer::DrawLine(float x0, float y0, float x1, float y1, const tColour4f& col)
+{
+	UseProgram(Program::Colour);
+	Reserve(GL_LINES, 2);
+	AddVertex(x0, y0, 0.0f, 0.0f, col);
+	AddVertex(x1, y1, 0.0f, 0.0f, col);
+}
+
+
+void Viewer::Renderer::DrawCheckerboard
+(
+	float l, float b, float r, float t, float originX, float originY, float checkSize,
+	const tColour4f& colourEven, const tColour4f& colourOdd
+)
+{
+	if ((r <= l) || (t <= b) || (checkSize <= 0.0f))
+		return;
+
+	Flush();
+	UseProgram(Program::Checker);
+	const ProgramInfo& info = Programs[int(Program::Checker)];
+	glUniform4f(info.LocCheckColourEven, colourEven.R, colourEven.G, colourEven.B, colourEven.A);
+	glUniform4f(info.LocCheckColourOdd, colourOdd.R, colourOdd.G, colourOdd.B, colourOdd.A);
+
+	float ul = (l - originX) / checkSize;	float ur = (r - originX) / checkSize;
+	float vb = (b - originY) / checkSize;	float vt = (t - originY) / checkSize;
+	Reserve(GL_TRIANGLES, 6);
+	AddVertex(l, b, ul, vb, tColour4f::white);	AddVertex(r, b, ur, vb, tColour4f::white);	AddVertex(r, t, ur, vt, tColour4f::white);
+	AddVertex(l, b, ul, vb, tColour4f::white);	AddVertex(r, t, ur, vt, tColour4f::white);	AddVertex(l, t, ul, vt, tColour4f::white);
+	Flush();
+}
+
+
+void Viewer::Renderer::DrawTexturedQuad
+(
+	float l, float b, float r, float t, float u0, float v0, float u1, float v1,
+	const ChannelFilter& filter, const tColour4f& tint
+)
+{
+	Flush();
+	UseProgram(Program::Texture);
+	const ProgramInfo& info = Programs[int(Program::Texture)];
+	glUniformMatrix4fv(info.LocChannelMatrix, 1, GL_FALSE, filter.Matrix);
+	glUniform4fv(info.LocChannelOffset, 1, filter.Offset);
+
+	Reserve(GL_TRIANGLES, 6);
+	AddVertex(l, b, u0, v0, tint);	AddVertex(r, b, u1, v0, tint);	AddVertex(r, t, u1, v1, tint);
+	AddVertex(l, b, u0, v0, tint);	AddVertex(r, t, u1, v1, tint);	AddVertex(l, t, u0, v1, tint);
+
+	// The texture binding may change after we return.
+	Flush();
+}
@@ -0,0 +1,78 @@
+// Renderer.h
+//
+// A small retained-mode renderer for the work area. Geometry is batched into a streamed vertex buffer and drawn with
+// three simple GLSL 1.20 programs: flat colour, textured with a channel filter, and a procedural checkerboard. Only
+// OpenGL 2.1 is required so it runs on Mesa's llvmpipe. ImGui still draws itself with its own backend after End.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Math/tColour.h>
+#include <Math/tMatrix4.h>
+
+
+namespace Viewer
+{
+	namespace Renderer
+	{
+		// The output colour is Matrix * texel + Offset. This replaces GL_TEXTURE_SWIZZLE state changes so the texture
+		// parameters never need to be modified or restored.
+		struct ChannelFilter
+		{
+			ChannelFilter()																								{ SetIdentity(); }
+			void SetIdentity();
+
+			// Mirrors the view menu channel options. Unselected colour channels are zero and an unselected alpha is one.
+			// With asIntensity the single selected channel is copied to RGB and alpha is one.
+			void SetChannels(bool r, bool g, bool b, bool a, bool asIntensity);
+
+			// Every channel is one. Used for the shutter effect when copying to the clipboard.
+			void SetWhite();
+
+			float Matrix[16];		// Column-major. Column n is the contribution of input channel n.
+			float Offset[4];
+		};
+
+		// Call once after the GL functions are loaded. Returns false if the shaders fail to compile or link.
+		bool Init();
+		void Shutdown();
+
+		// Everything between Begin and End is drawn in a workW by workH space with the origin at the lower-left. The
+		// viewport must already be set. End flushes and restores the fixed function state ImGui expects.
+		void Begin(int workW, int workH);
+		void End();
+
+		// Applies to everything drawn after the call until reset. Flushes any pending geometry.
+		void SetTransform(const tMath::tMatrix4&);
+		void ResetTransform();
+
+		// Coloured geometry is batched. Consecutive quads, triangles, and lines of any colour cost a single draw call.
+		void DrawQuad(float l, float b, float r, float t, const tColour4f&);
+		void DrawTriangle(float x0, float y0, float x1, float y1, float x2, float y2, const tColour4f&);
+		void DrawLine(float x0, float y0, float x1, float y1, const tColour4f&);
+
+		// The checkerboard is one quad. The checks are computed per-fragment, aligned so the lower-left check starts at
+		// (originX, originY). The quad itself may be clipped to any sub-rectangle without moving the checks.
+		void DrawCheckerboard
+		(
+			float l, float b, float r, float t, float originX, float originY, float checkSize,
+			const tColour4f& colourEven, const tColour4f& colourOdd
+		);
+
+		// Draws with whatever texture is currently bound to GL_TEXTURE_2D. (u0, v0) maps to (l, b) and (u1, v1) maps
+		// to (r, t). The filtered texel is multiplied by the tint.
+		void DrawTexturedQuad
+		(
+			float l, float b, float r, float t, float u0, float v0, float u1, float v1,
+			const ChannelFilter& = ChannelFilter(), const tColour4f& tint = tColour4f::white
+		);
+	}
+}
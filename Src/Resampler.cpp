@@ -0,0 +1,314 @@
+// Resampler.cpp
+//
+// A separable resampler for RGBA8 pictures. Weights for each filter are worked out once per axis in fixed point and
+// the horizontal and vertical passes run on the vector pixel kernels, with rows split between the work pool threads.
+// Large reductions are first halved with a 2x2 box down to within a factor of four of the target size so wide
+// kernels never run over the full size picture.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <vector>
+#include "Resampler.h"
+#include "PixelKernels.h"
+#include "WorkPool.h"
+#include "Mipmap.h"
+using namespace tImage;
+using namespace tMath;
+
+
+namespace Viewer
+{
+	namespace Resampler
+	{
+		// The weights of one axis. Output pixel i reads Taps source pixels starting at Index[i*Taps].
+		struct Axis
+		{
+			int Taps													= 0;
+			std::vector<int> Index;
+			std::vector<int16> Weights;
+		};
+
+		// Reductions of at least this much in both directions are halved with a box first. Odd sizes drop their last
+		// row or column at each halving, which moves the result by well under a pixel.
+		const int PyramidRatio											= 4;
+
+		// Ranges of rows smaller than this many pixels cost more to hand out than they save.
+		const int MinRangePixels										= 64*1024;
+
+		// More ranges than threads so a thread that finishes early can take another.
+		const int RangesPerThread										= 4;
+
+		float GetSupport(tResampleFilter);
+		float Cubic(float x, float b, float c);
+		float Sinc(float x);
+		int GetEdgeIndex(int index, int size, tResampleEdgeMode);
+		void ComputeAxis(Axis&, int srcSize, int dstSize, tResampleFilter, tResampleEdgeMode);
+		int GetRowGrain(int numRows, int width);
+	}
+}
+
+
+float Viewer::Resampler::GetSupport(tResampleFilter filter)
+{
+	switch (filter)
+	{
+		case tResampleFilter::Nearest:				return 0.5f;
+		case tResampleFilter::Box:					return 0.5f;
+		case tResampleFilter::Bilinear:				return 1.0f;
+		case tResampleFilter::Lanczos_Narrow:		return 2.0f;
+		case tResampleFilter::Lanczos_Normal:		return 3.0f;
+		case tResampleFilter::Lanczos_Wide:			return 4.0f;
+		default:									return 2.0f;	// All the bicubics.
+	}
+}
+
+
+float Viewer::Resampler::Cubic(float x, float b, float c)
+{
+	// Mitchell-Netravali. x must be positive.
+	if (x < 1.0f)
+		return ((12.0f - 9.0f*b - 6.0f*c)*x*x*x + (-18.0f + 12.0f*b + 6.0f*c)*x*x + (6.0f - 2.0f*b)) / 6.0f;
+	if (x < 2.0f)
+		return ((-b - 6.0f*c)*x*x*x + (6.0f*b + 30.0f*c)*x*x + (-12.0f*b - 48.0f*c)*x + (8.0f*b + 24.0f*c)) / 6.0f;
+	return 0.0f;
+}
+
+
+float Viewer::Resampler::Sinc(float x)
+{
+	if (x < 1.0e-6f)
+		return 1.0f;
+	float px = Pi*x;
+	return tSin(px) / px;
+}
+
+
+float Viewer::Resampler::GetWeight(tResampleFilter filter, float x)
+{
+	x = tAbs(x);
+	switch (filter)
+	{
+		case tResampleFilter::Box:
+			// A sample exactly on the edge is shared between the two outputs either side of it.
+			return (x < 0.5f) ? 1.0f : ((x == 0.5f) ? 0.5f : 0.0f);
+
+		case tResampleFilter::Bilinear:				return tMax(1.0f - x, 0.0f);
+		case tResampleFilter::Bicubic_Standard:		return Cubic(x, 0.0f, 0.75f);
+		case tResampleFilter::Bicubic_CatmullRom:	return Cubic(x, 0.0f, 0.5f);
+		case tResampleFilter::Bicubic_Mitchell:		return Cubic(x, 1.0f/3.0f, 1.0f/3.0f);
+		case tResampleFilter::Bicubic_Cardinal:		return Cubic(x, 0.0f, 1.0f);
+		case tResampleFilter::Bicubic_BSpline:		return Cubic(x, 1.0f, 0.0f);
+
+		case tResampleFilter::Lanczos_Narrow:
+		case tResampleFilter::Lanczos_Normal:
+		case tResampleFilter::Lanczos_Wide:
+		{
+			float a = GetSupport(filter);
+			return (x < a) ? Sinc(x)*Sinc(x/a) : 0.0f;
+		}
+
+		default:									return 0.0f;
+	}
+}
+
+
+int Viewer::Resampler::GetEdgeIndex(int index, int size, tResampleEdgeMode edgeMode)
+{
+	if (edgeMode == tResampleEdgeMode::Wrap)
+		return ((index % size) + size) % size;
+	return tClamp(index, 0, size-1);
+}
+
+
+void Viewer::Resampler::ComputeAxis(Axis& axis, int srcSize, int dstSize, tResampleFilter filter, tResampleEdgeMode edgeMode)
+{
+	// Source pixel j is centred at j + 0.5 in source space. When reducing, the filter is stretched to cover every
+	// source pixel that lands in the output pixel.
+	const int one = 1 << PixelKernels::ResampleWeightBits;
+	float ratio = float(srcSize) / float(dstSize);
+	float filterScale = tMax(ratio, 1.0f);
+	float support = GetSupport(filter)*filterScale;
+
+	// The kernels need an even number of taps. Unused ones get a zero weight.
+	int taps = (filter == tResampleFilter::Nearest) ? 1 : int(tCeiling(2.0f*support)) + 1;
+	taps = (taps + 1) & ~1;
+	axis.Taps = taps;
+	axis.Index.resize(int64(dstSize)*taps);
+	axis.Weights.resize(int64(dstSize)*taps);
+
+	std::vector<float> weights(taps);
+	for (int i = 0; i < dstSize; i++)
+	{
+		int* index = &axis.Index[int64(i)*taps];
+		int16* fixed = &axis.Weights[int64(i)*taps];
+		float centre = (float(i) + 0.5f)*ratio;
+		if (filter == tResampleFilter::Nearest)
+		{
+			index[0] = index[1] = GetEdgeIndex(int(centre), srcSize, edgeMode);
+			fixed[0] = int16(one);
+			fixed[1] = 0;
+			continue;
+		}
+
+		int first = int(tFloor(centre - 0.5f - support));
+		float sum = 0.0f;
+		int nearest = 0;
+		for (int t = 0; t < taps; t++)
+		{
+			float offset = float(first + t) + 0.5f - centre;
+			weights[t] = GetWeight(filter, offset/filterScale);
+			sum += weights[t];
+			if (tAbs(offset) < tAbs(float(first + nearest) + 0.5f - centre))
+				nearest = t;
+		}
+
+		// Normalize and fix any rounding so flat areas keep exactly their colour.
+		int total = 0;
+		int largest = 0;
+		for (int t = 0; t < taps; t++)
+		{
+			index[t] = GetEdgeIndex(first + t, srcSize, edgeMode);
+			fixed[t] = (sum > 0.0f) ? int16(tRound(weights[t] / sum * float(one))) : int16((t == nearest) ? one : 0);
+			total += fixed[t];
+			if (fixed[t] > fixed[largest])
+				largest = t;
+		}
+		fixed[largest] += int16(one - total);
+	}
+}
+
+
+int Viewer::Resampler::GetRowGrain(int numRows, int width)
+{
+	int numRanges = WorkPool::GetNumThreads()*RangesPerThread;
+	int minRows = tMax(MinRangePixels / tMax(width, 1), 1);
+	return tMax((numRows + numRanges - 1) / numRanges, minRows);
+}
+
+
+bool Viewer::Resampler::Resample
+(
+	const tPixel4b* src, int srcW, int srcH, tPixel4b* dst, int dstW, int dstH,
+	tResampleFilter filter, tResampleEdgeMode edgeMode, WorkPool::Progress* progress
+)
+{
+	if (!src || !dst || (srcW <= 0) || (srcH <= 0) || (dstW <= 0) || (dstH <= 0))
+		return false;
+	if ((filter == tResampleFilter::None) || (int(filter) >= int(tResampleFilter::NumFilters)))
+		return false;
+
+	// Each halving costs far less than running a wide kernel over the full size picture, and the requested filter
+	// still does the last step of up to four times. Nearest is left alone so it still picks real source pixels.
+	uint8* reduced = nullptr;
+	while ((filter != tResampleFilter::Nearest) && (srcW >= PyramidRatio*dstW) && (srcH >= PyramidRatio*dstH))
+	{
+		uint8* next = Mipmap::ReduceBox(reduced ? reduced : (const uint8*)src, srcW, srcH);
+		delete[] reduced;
+		reduced = next;
+		srcW = tMax(srcW/2, 1);
+		srcH = tMax(srcH/2, 1);
+	}
+	if (reduced)
+		src = (const tPixel4b*)reduced;
+
+	Axis horizontal;
+	Axis vertical;
+	ComputeAxis(horizontal, srcW, dstW, filter, edgeMode);
+	ComputeAxis(vertical, srcH, dstH, filter, edgeMode);
+
+	// The horizontal pass makes every source row dstW wide. The vertical pass then combines those rows.
+	tPixel4b* across = new tPixel4b[int64(dstW)*srcH];
+	WorkPool::ParallelFor
+	(
+		srcH, GetRowGrain(srcH, tMax(srcW, dstW)),
+		[&](int begin, int end)
+		{
+			for (int y = begin; y < end; y++)
+				PixelKernels::ResampleRow
+				(
+					src + int64(y)*srcW, across + int64(y)*dstW, dstW,
+					horizontal.Index.data(), horizontal.Weights.data(), horizontal.Taps
+				);
+		},
+		0, progress
+	);
+
+	WorkPool::ParallelFor
+	(
+		dstH, GetRowGrain(dstH, dstW*vertical.Taps),
+		[&](int begin, int end)
+		{
+			std::vector<const tPixel4b*> rows(vertical.Taps);
+			for (int y = begin; y < end; y++)
+			{
+				const int* index = &vertical.Index[int64(y)*vertical.Taps];
+				for (int t = 0; t < vertical.Taps; t++)
+					rows[t] = across + int64(index[t])*dstW;
+				PixelKernels::ResampleColumns
+				(
+					rows.data(), &vertical.Weights[int64(y)*vertical.Taps], vertical.Taps,
+					dst + int64(y)*dstW, dstW
+				);
+			}
+		},
+		0, progress
+	);
+
+	delete[] across;
+	delete[] reduced;
+	return !(progress && progress->IsCancelled());
+}
+
+
+bool Viewer::Resampler::Resample
+(
+	tPicture& picture, int newW, int newH, tResampleFilter filter, tResampleEdgeMode edgeMode,
+	WorkPool::Progress* progress
+)
+{
+	if (!picture.IsValid() || (newW <= 0) || (newH <= 0))
+		return false;
+	if ((picture.GetWidth() == newW) && (picture.GetHeight() == newH))
+		return true;
+
+	tPixel4b* pixels = new tPixel4b[int64(newW)*newH];
+	if (!Resample(picture.GetPixels(), picture.GetWidth(), picture.GetHeight(), pixels, newW, newH, filter, edgeMode, progress))
+	{
+		delete[] pixels;
+		return false;
+	}
+
+	// Set resets the duration along with everything else.
+	float duration = picture.Duration;
+	picture.Set(newW, newH, pixels, false);
+	picture.Duration = duration;
+	return true;
+}
+
+
+int64 Viewer::Resampler::GetWorkingBytes(int srcW, int srcH, int dstW, int dstH, tResampleFilter filter)
+{
+	// The same pyramid as Resample. Each level is made while the one before is alive, and the last is kept while the
+	// passes run.
+	int64 peak = 0;
+	int64 reduced = 0;
+	while ((filter != tResampleFilter::Nearest) && (srcW >= PyramidRatio*dstW) && (srcH >= PyramidRatio*dstH))
+	{
+		srcW = tMax(srcW/2, 1);
+		srcH = tMax(srcH/2, 1);
+		int64 next = int64(srcW)*srcH*int64(sizeof(tPixel4b));
+		peak = tMax(peak, reduced + next);
+		reduced = next;
+	}
+
+	int64 across = int64(dstW)*srcH*int64(sizeof(tPixel4b));
+	return tMax(peak, reduced + across);
+}
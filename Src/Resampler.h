@@ -0,0 +1,55 @@
+// Resampler.h
+//
+// A separable resampler for RGBA8 pictures. Weights for each filter are worked out once per axis in fixed point and
+// the horizontal and vertical passes run on the vector pixel kernels, with rows split between the work pool threads.
+// Large reductions are first halved with a 2x2 box down to within a factor of four of the target size so wide
+// kernels never run over the full size picture.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Image/tPicture.h>
+#include <Image/tResample.h>
+#include "WorkPool.h"
+
+
+namespace Viewer
+{
+	namespace Resampler
+	{
+		// Resamples src into dst, which must hold dstW*dstH pixels and must not overlap src. Takes the same filters
+		// and edge modes as tImage::Resample, and like it works directly on the stored (sRGB-encoded) values. The
+		// results are close to, but not bit-identical with, the tacent resampler. Returns false if the filter is None,
+		// either size is empty, or the progress was cancelled.
+		bool Resample
+		(
+			const tPixel4b* src, int srcW, int srcH, tPixel4b* dst, int dstW, int dstH,
+			tImage::tResampleFilter, tImage::tResampleEdgeMode, WorkPool::Progress* = nullptr
+		);
+
+		// A drop-in replacement for tPicture::Resample. The frame duration is kept. A cancelled resample leaves the
+		// picture unchanged.
+		bool Resample
+		(
+			tImage::tPicture&, int newW, int newH,
+			tImage::tResampleFilter = tImage::tResampleFilter::Bilinear,
+			tImage::tResampleEdgeMode = tImage::tResampleEdgeMode::Clamp,
+			WorkPool::Progress* = nullptr
+		);
+
+		// The most memory Resample allocates for itself, not counting the source and destination. Used by --plan.
+		int64 GetWorkingBytes(int srcW, int srcH, int dstW, int dstH, tImage::tResampleFilter);
+
+		// The height of the filter kernel at a distance of x source pixels, before normalizing. Only meaningful for
+		// filters that blend, not Nearest or None.
+		float GetWeight(tImage::tResampleFilter, float x);
+	}
+}
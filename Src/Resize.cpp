@@ -17,6 +17,8 @@
 #include "Image.h"
 #include "TacentView.h"
 #include "GuiUtil.h"
+#include "EditJob.h"
+#include "Resampler.h"
 using namespace tStd;
 using namespace tSystem;
 using namespace tMath;
@@ -217,20 +219,22 @@ void Viewer::DoResizeCrop(int srcW, int srcH, int dstW, int dstH)
 	if ((dstW != srcW) || (dstH != srcH))
 	{
 		Config::ProfileData& profile = Config::GetProfileData();
-		CurrImage->Unbind();
+		tColour4b fill = profile.FillColour;
+		EditJob::Operation op;
 		if (profile.CropAnchor == -1)
 		{
 			int originX = (Viewer::CursorX * (srcW - dstW)) / srcW;
 			int originY = (Viewer::CursorY * (srcH - dstH)) / srcH;
-			CurrImage->Crop(dstW, dstH, originX, originY, profile.FillColour);
+			op = [=](tPicture& pic, int, WorkPool::Progress&) { pic.Crop(dstW, dstH, originX, originY, fill); };
 		}
 		else
 		{
-			CurrImage->Crop(dstW, dstH, tPicture::Anchor(profile.CropAnchor), profile.FillColour);
+			tPicture::Anchor anchor = tPicture::Anchor(profile.CropAnchor);
+			op = [=](tPicture& pic, int, WorkPool::Progress&) { pic.Crop(dstW, dstH, anchor, fill); };
 		}
-		CurrImage->Bind();
-		Gutil::SetWindowTitle();
-		Viewer::ZoomDownscaleOnly();
+
+		tString desc; tsPrintf(desc, "Crop %d %d", dstW, dstH);
+		EditJob::Start(CurrImage, desc, op, [] { Gutil::SetWindowTitle(); Viewer::ZoomDownscaleOnly(); });
 	}
 }
 
@@ -326,11 +330,17 @@ void Viewer::DoResizeImageModal(bool resizeImagePressed)
 	{
 		if ((dstW != srcW) || (dstH != srcH))
 		{
-			CurrImage->Unbind();
-			CurrImage->Resample(dstW, dstH, tImage::tResampleFilter(profile.ResampleFilter), tImage::tResampleEdgeMode(profile.ResampleEdgeMode));
-			CurrImage->Bind();
-			Gutil::SetWindowTitle();
-			Viewer::ZoomDownscaleOnly();
+			int w = dstW;
+			int h = dstH;
+			tImage::tResampleFilter filter = tImage::tResampleFilter(profile.ResampleFilter);
+			tImage::tResampleEdgeMode edgeMode = tImage::tResampleEdgeMode(profile.ResampleEdgeMode);
+			tString desc; tsPrintf(desc, "Resample %d %d", w, h);
+			EditJob::Start
+			(
+				CurrImage, desc,
+				[=](tPicture& pic, int, WorkPool::Progress& progress) { Resampler::Resample(pic, w, h, filter, edgeMode, &progress); },
+				[] { Gutil::SetWindowTitle(); Viewer::ZoomDownscaleOnly(); }
+			);
 		}
 		ImGui::CloseCurrentPopup();
 	}
@@ -17,7 +17,10 @@
 #include "Image.h"
 #include "TacentView.h"
 #include "GuiUtil.h"
+#include "EditJob.h"
 #include "Config.h"
+#include "Resampler.h"
+#include "Rotator.h"
 using namespace tStd;
 using namespace tSystem;
 using namespace tMath;
@@ -52,7 +55,7 @@ void Viewer::DoRotateImageModal(bool rotateImagePressed)
 	ImGui::SameLine();
 	Gutil::HelpMark
 	(
-		"Filtering method used during up-sampling.\n"
+		"Filtering method used to sample the picture.\n"
 		"If set to None no resampling, preserves colours,\n"
 		"nearest neighbour, fast, for pixel art."
 	);
@@ -64,8 +67,10 @@ void Viewer::DoRotateImageModal(bool rotateImagePressed)
 		Gutil::HelpMark
 		(
 			"Filtering method used during down-sampling.\n"
-			"Box works well. If set to None uses an an alternate\n"
-			"down-sample that produces sharper images."
+			"If set to None the picture is sampled once with\n"
+			"the up filter, which is sharper and much faster.\n"
+			"Otherwise it is up-sampled 2X, rotated, and\n"
+			"down-sampled with this filter. Box works well."
 		);
 	}
 
@@ -109,65 +114,63 @@ void Viewer::DoRotateImageModal(bool rotateImagePressed)
 
 	if (Gutil::Button("Rotate", tVector2(buttonWidth, 0.0f)))
 	{
-		tPicture* picture = CurrImage->GetCurrentPic();
-		if (!picture)
+		// The operation runs on worker threads so it gets copies of the settings rather than the profile.
+		float angle = tDegToRad(RotateAnglePreview);
+		tColour4b fill = profile.FillColour;
+		tResampleFilter upFilter = tResampleFilter(profile.ResampleFilterRotateUp);
+		tResampleFilter downFilter = tResampleFilter(profile.ResampleFilterRotateDown);
+		Config::ProfileData::RotateModeEnum rotateMode = profile.GetRotateMode();
+		auto op = [=](tPicture& picture, int, WorkPool::Progress& progress)
 		{
-			RotateAnglePreview = 0.0f;
-			ImGui::CloseCurrentPopup();
-			ImGui::EndPopup();
-			return;
-		}
-		int origW = picture->GetWidth();
-		int origH = picture->GetHeight();
-
-		CurrImage->Unbind();
-		CurrImage->Rotate
-		(
-			tDegToRad(RotateAnglePreview), profile.FillColour,
-			tResampleFilter(profile.ResampleFilterRotateUp),
-			tResampleFilter(profile.ResampleFilterRotateDown)
-		);
+			int origW = picture.GetWidth();
+			int origH = picture.GetHeight();
+			if (!Rotator::RotateCenter(picture, angle, fill, upFilter, downFilter, &progress))
+				return;
 
-		if ((profile.GetRotateMode() == Config::ProfileData::RotateModeEnum::Crop) || (profile.GetRotateMode() == Config::ProfileData::RotateModeEnum::CropResize))
-		{
-			// If one of the crop modes is selected we need to crop the edges. Since rectangles are made of lines and there
-			// is symmetry and we can compute the reduced size by subtracting the original size from the rotated size.
-			int rotW = picture->GetWidth();
-			int rotH = picture->GetHeight();
-			bool aspectFlip = ((origW > origH) && (rotW < rotH)) || ((origW < origH) && (rotW > rotH));
-			if (aspectFlip)
-				tSwap(origW, origH);
-
-			int dx = rotW - origW;
-			int dy = rotH - origH;
-			int newW = origW - dx;
-			int newH = origH - dy;
-
-			if (dx > origW/2)
+			if ((rotateMode == Config::ProfileData::RotateModeEnum::Crop) || (rotateMode == Config::ProfileData::RotateModeEnum::CropResize))
 			{
-				newW = origW - origW/2;
-				newH = (newW*origH)/origW;
+				// If one of the crop modes is selected we need to crop the edges. Since rectangles are made of lines and there
+				// is symmetry and we can compute the reduced size by subtracting the original size from the rotated size.
+				int rotW = picture.GetWidth();
+				int rotH = picture.GetHeight();
+				bool aspectFlip = ((origW > origH) && (rotW < rotH)) || ((origW < origH) && (rotW > rotH));
+				if (aspectFlip)
+					tSwap(origW, origH);
+
+				int dx = rotW - origW;
+				int dy = rotH - origH;
+				int newW = origW - dx;
+				int newH = origH - dy;
+
+				if (dx > origW/2)
+				{
+					newW = origW - origW/2;
+					newH = (newW*origH)/origW;
+				}
+				else if (dy > origH/2)
+				{
+					newH = origH - origH/2;
+					newW = (newH*origW)/origH;
+				}
+
+				// The above code has been tested with a 1x1 input and (newH,newW) result correcty as (1,1). 
+				picture.Crop(newW, newH, tPicture::Anchor::MiddleMiddle);
 			}
-			else if (dy > origH/2)
+
+			if (rotateMode == Config::ProfileData::RotateModeEnum::CropResize)
 			{
-				newH = origH - origH/2;
-				newW = (newH*origW)/origH;
+				// The crop is done. Now resample.
+				tResampleFilter filter = (upFilter != tResampleFilter::None) ? upFilter : tResampleFilter::Nearest;
+				Resampler::Resample(picture, origW, origH, filter, tResampleEdgeMode::Clamp, &progress);
 			}
+		};
 
-			// The above code has been tested with a 1x1 input and (newH,newW) result correcty as (1,1). 
-			CurrImage->Crop(newW, newH, tPicture::Anchor::MiddleMiddle);
-		}
-
-		if (profile.GetRotateMode() == Config::ProfileData::RotateModeEnum::CropResize)
+		if (angle != 0.0f)
 		{
-			// The crop is done. Now resample.
-			tResampleFilter filter = (profile.ResampleFilterRotateUp != int(tResampleFilter::None)) ? tResampleFilter(profile.ResampleFilterRotateUp) : tResampleFilter::Nearest;
-			CurrImage->Resample(origW, origH, filter, tResampleEdgeMode::Clamp);
+			tString desc; tsPrintf(desc, "Rotate %.1f", RotateAnglePreview);
+			EditJob::Start(CurrImage, desc, op, [] { Gutil::SetWindowTitle(); });
 		}
-
-		CurrImage->Bind();
 		RotateAnglePreview = 0.0f;
-		Gutil::SetWindowTitle();
 		ImGui::CloseCurrentPopup();
 	}
 	ImGui::EndPopup();
@@ -0,0 +1,336 @@
+// Rotator.cpp
+//
+// Arbitrary angle rotation of RGBA8 pictures. Every destination pixel is mapped back into the source and sampled
+// once, with nearest, bilinear, or bicubic weights, so there are no full size up and down resamples. Rows are split
+// between the work pool threads and summed by the vector pixel kernels.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include "Rotator.h"
+#include "Resampler.h"
+#include "PixelKernels.h"
+#include "WorkPool.h"
+using namespace tImage;
+using namespace tMath;
+
+
+namespace Viewer
+{
+	namespace Rotator
+	{
+		enum class Sampler
+		{
+			Nearest,
+			Bilinear,
+			Bicubic
+		};
+
+		// The source is copied with a border of fill colour this wide. Taps that land outside the source are clamped
+		// into the border, so they read the fill without any per-tap tests.
+		const int FillBorder											= 2;
+
+		// Ranges of rows smaller than this many pixels cost more to hand out than they save.
+		const int MinRangePixels										= 64*1024;
+
+		// More ranges than threads so a thread that finishes early can take another.
+		const int RangesPerThread										= 4;
+
+		// Sample positions are stepped along each row in fixed point with this many fraction bits. Plenty so the
+		// error stays far below a pixel across the widest pictures.
+		const int PositionBits											= 32;
+
+		// Bicubic weights are looked up for the sample position rounded to this fraction of a pixel.
+		const int CubicStepBits											= 10;
+		const int CubicSteps											= 1 << CubicStepBits;
+
+		// The four bicubic weights along one axis for each step between two source pixels. Each set sums to one.
+		struct CubicTable
+		{
+			int Weights[CubicSteps+1][4];
+		};
+
+		int GetNumTaps(Sampler);
+		void MakeCubicTable(CubicTable&, tResampleFilter);
+		tPixel4b* MakeBordered(const tPicture&, const tColour4b& fill, int& borderedW, int& borderedH);
+
+		// Fills in the taps for one destination pixel. u and v are the fixed point sample position in bordered pixels.
+		void SetTaps(int* index, int16* weights, int64 u, int64 v, int borderedW, int borderedH, Sampler, const CubicTable*);
+	}
+}
+
+
+int Viewer::Rotator::GetNumTaps(Sampler sampler)
+{
+	// The kernels need an even number of taps. Nearest pads its single tap with a zero weight.
+	switch (sampler)
+	{
+		case Sampler::Bilinear:		return 4;
+		case Sampler::Bicubic:		return 16;
+		default:					return 2;
+	}
+}
+
+
+void Viewer::Rotator::GetRotatedSize(int& dstW, int& dstH, int srcW, int srcH, float angle)
+{
+	// The small tolerance stops rounding error at multiples of 90 degrees adding a row or column.
+	float cosA = tAbs(tCos(angle));
+	float sinA = tAbs(tSin(angle));
+	dstW = tMax(int(tCeiling(float(srcW)*cosA + float(srcH)*sinA - 0.001f)), 1);
+	dstH = tMax(int(tCeiling(float(srcW)*sinA + float(srcH)*cosA - 0.001f)), 1);
+}
+
+
+void Viewer::Rotator::MakeCubicTable(CubicTable& table, tResampleFilter filter)
+{
+	const int one = 1 << PixelKernels::ResampleWeightBits;
+	for (int step = 0; step <= CubicSteps; step++)
+	{
+		float frac = float(step) / float(CubicSteps);
+		float weights[4];
+		float sum = 0.0f;
+		for (int t = 0; t < 4; t++)
+		{
+			weights[t] = Resampler::GetWeight(filter, float(t-1) - frac);
+			sum += weights[t];
+		}
+
+		// The nearer of the two middle taps takes any rounding error.
+		int total = 0;
+		for (int t = 0; t < 4; t++)
+		{
+			table.Weights[step][t] = int(tRound(weights[t] / sum * float(one)));
+			total += table.Weights[step][t];
+		}
+		table.Weights[step][(frac < 0.5f) ? 1 : 2] += one - total;
+	}
+}
+
+
+tPixel4b* Viewer::Rotator::MakeBordered(const tPicture& picture, const tColour4b& fill, int& borderedW, int& borderedH)
+{
+	int srcW = picture.GetWidth();
+	int srcH = picture.GetHeight();
+	borderedW = srcW + 2*FillBorder;
+	borderedH = srcH + 2*FillBorder;
+	tPixel4b* bordered = new tPixel4b[int64(borderedW)*borderedH];
+	WorkPool::ParallelFor
+	(
+		borderedH, tMax(MinRangePixels / borderedW, 1),
+		[&](int begin, int end)
+		{
+			for (int y = begin; y < end; y++)
+			{
+				tPixel4b* row = bordered + int64(y)*borderedW;
+				int srcY = y - FillBorder;
+				if ((srcY < 0) || (srcY >= srcH))
+				{
+					for (int x = 0; x < borderedW; x++)
+						row[x] = fill;
+					continue;
+				}
+
+				for (int x = 0; x < FillBorder; x++)
+					row[x] = row[borderedW-1-x] = fill;
+				std::memcpy(row + FillBorder, picture.GetPixelPointer(0, srcY), srcW*sizeof(tPixel4b));
+			}
+		}
+	);
+
+	return bordered;
+}
+
+
+void Viewer::Rotator::SetTaps(int* index, int16* weights, int64 u, int64 v, int borderedW, int borderedH, Sampler sampler, const CubicTable* cubic)
+{
+	const int one = 1 << PixelKernels::ResampleWeightBits;
+	const int64 half = int64(1) << (PositionBits-1);
+	if (sampler == Sampler::Nearest)
+	{
+		int x = int(tClamp((u + half) >> PositionBits, int64(0), int64(borderedW-1)));
+		int y = int(tClamp((v + half) >> PositionBits, int64(0), int64(borderedH-1)));
+		index[0] = index[1] = y*borderedW + x;
+		weights[0] = int16(one);
+		weights[1] = 0;
+		return;
+	}
+
+	// Positions outside the source are clamped into the border, where every tap reads the fill.
+	int x0 = int(tClamp(u >> PositionBits, int64(-2), int64(borderedW)));
+	int y0 = int(tClamp(v >> PositionBits, int64(-2), int64(borderedH)));
+	uint32 fx = uint32(u & 0xFFFFFFFF);
+	uint32 fy = uint32(v & 0xFFFFFFFF);
+	if (sampler == Sampler::Bilinear)
+	{
+		int ix = int(fx >> (PositionBits - PixelKernels::ResampleWeightBits));
+		int iy = int(fy >> (PositionBits - PixelKernels::ResampleWeightBits));
+		int w00 = ((one - ix)*(one - iy) + (one >> 1)) >> PixelKernels::ResampleWeightBits;
+		int w10 = (ix*(one - iy) + (one >> 1)) >> PixelKernels::ResampleWeightBits;
+		int w01 = ((one - ix)*iy + (one >> 1)) >> PixelKernels::ResampleWeightBits;
+		int w11 = one - w00 - w10 - w01;
+
+		int xa = tClamp(x0, 0, borderedW-1);
+		int xb = tClamp(x0+1, 0, borderedW-1);
+		int ya = tClamp(y0, 0, borderedH-1);
+		int yb = tClamp(y0+1, 0, borderedH-1);
+		index[0] = ya*borderedW + xa;		weights[0] = int16(w00);
+		index[1] = ya*borderedW + xb;		weights[1] = int16(w10);
+		index[2] = yb*borderedW + xa;		weights[2] = int16(w01);
+		index[3] = yb*borderedW + xb;		weights[3] = int16(w11);
+		return;
+	}
+
+	// Bicubic. The 4x4 weights are the products of the weights along each axis.
+	const int roundStep = 1 << (PositionBits - CubicStepBits - 1);
+	const int* wx = cubic->Weights[(uint64(fx) + roundStep) >> (PositionBits - CubicStepBits)];
+	const int* wy = cubic->Weights[(uint64(fy) + roundStep) >> (PositionBits - CubicStepBits)];
+	int total = 0;
+	int largest = 0;
+	for (int j = 0; j < 4; j++)
+	{
+		int y = tClamp(y0 - 1 + j, 0, borderedH-1);
+		for (int i = 0; i < 4; i++)
+		{
+			int t = j*4 + i;
+			index[t] = y*borderedW + tClamp(x0 - 1 + i, 0, borderedW-1);
+			weights[t] = int16((wx[i]*wy[j] + (one >> 1)) >> PixelKernels::ResampleWeightBits);
+			total += weights[t];
+			if (weights[t] > weights[largest])
+				largest = t;
+		}
+	}
+
+	// Keeps flat areas, including the fill, exactly their colour.
+	weights[largest] += int16(one - total);
+}
+
+
+bool Viewer::Rotator::Rotate(tPicture& picture, float angle, const tColour4b& fill, tResampleFilter filter, WorkPool::Progress* progress)
+{
+	if (!picture.IsValid())
+		return false;
+
+	Sampler sampler = Sampler::Bicubic;
+	switch (filter)
+	{
+		case tResampleFilter::None:
+		case tResampleFilter::Nearest:
+			sampler = Sampler::Nearest;
+			break;
+
+		case tResampleFilter::Box:
+		case tResampleFilter::Bilinear:
+			sampler = Sampler::Bilinear;
+			break;
+
+		case tResampleFilter::Lanczos_Narrow:
+		case tResampleFilter::Lanczos_Normal:
+		case tResampleFilter::Lanczos_Wide:
+			filter = tResampleFilter::Bicubic_CatmullRom;
+			break;
+
+		default:
+			break;
+	}
+
+	int srcW = picture.GetWidth();
+	int srcH = picture.GetHeight();
+	int dstW = 0;
+	int dstH = 0;
+	GetRotatedSize(dstW, dstH, srcW, srcH, angle);
+
+	int borderedW = 0;
+	int borderedH = 0;
+	tPixel4b* bordered = MakeBordered(picture, fill, borderedW, borderedH);
+	tAssert(int64(borderedW)*borderedH <= int64(0x7FFFFFFF));
+
+	// Destination pixel centres are mapped back through the inverse rotation. Rows go up the picture so a positive
+	// angle turns it anticlockwise on screen.
+	double cosA = std::cos(double(angle));
+	double sinA = std::sin(double(angle));
+	double srcCentreX = 0.5*double(srcW) - 0.5 + double(FillBorder);
+	double srcCentreY = 0.5*double(srcH) - 0.5 + double(FillBorder);
+
+	CubicTable* cubic = nullptr;
+	if (sampler == Sampler::Bicubic)
+	{
+		cubic = new CubicTable;
+		MakeCubicTable(*cubic, filter);
+	}
+
+	// Positions stay within a picture diagonal of the source so they fit easily in 64 bits.
+	auto ToFixed = [](double position) -> int64
+	{
+		return int64(std::floor(position * double(int64(1) << PositionBits)));
+	};
+	int64 stepU = int64(std::llround(cosA * double(int64(1) << PositionBits)));
+	int64 stepV = int64(std::llround(-sinA * double(int64(1) << PositionBits)));
+
+	int taps = GetNumTaps(sampler);
+	tPixel4b* dst = new tPixel4b[int64(dstW)*dstH];
+	int numRanges = WorkPool::GetNumThreads()*RangesPerThread;
+	int grain = tMax((dstH + numRanges - 1) / numRanges, tMax(MinRangePixels / dstW, 1));
+	WorkPool::ParallelFor
+	(
+		dstH, grain,
+		[&](int begin, int end)
+		{
+			std::vector<int> index(int64(dstW)*taps);
+			std::vector<int16> weights(int64(dstW)*taps);
+			for (int y = begin; y < end; y++)
+			{
+				// The start of each row is worked out exactly. Only steps along the row accumulate error.
+				double dx = 0.5 - 0.5*double(dstW);
+				double dy = double(y) + 0.5 - 0.5*double(dstH);
+				int64 u = ToFixed(cosA*dx + sinA*dy + srcCentreX);
+				int64 v = ToFixed(cosA*dy - sinA*dx + srcCentreY);
+				for (int x = 0; x < dstW; x++, u += stepU, v += stepV)
+					SetTaps(&index[int64(x)*taps], &weights[int64(x)*taps], u, v, borderedW, borderedH, sampler, cubic);
+				PixelKernels::ResampleRow(bordered, dst + int64(y)*dstW, dstW, index.data(), weights.data(), taps);
+			}
+		},
+		0, progress
+	);
+	delete cubic;
+	delete[] bordered;
+
+	if (progress && progress->IsCancelled())
+	{
+		delete[] dst;
+		return false;
+	}
+
+	// Set resets the duration along with everything else.
+	float duration = picture.Duration;
+	picture.Set(dstW, dstH, dst, false);
+	picture.Duration = duration;
+	return true;
+}
+
+
+bool Viewer::Rotator::RotateCenter
+(
+	tPicture& picture, float angle, const tColour4b& fill, tResampleFilter upFilter, tResampleFilter downFilter,
+	WorkPool::Progress* progress
+)
+{
+	if ((upFilter == tResampleFilter::None) || (downFilter == tResampleFilter::None))
+		return Rotate(picture, angle, fill, upFilter, progress);
+
+	if (progress && progress->IsCancelled())
+		return false;
+
+	picture.RotateCenter(angle, fill, upFilter, downFilter);
+	return picture.IsValid();
+}
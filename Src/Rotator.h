@@ -0,0 +1,51 @@
+// Rotator.h
+//
+// Arbitrary angle rotation of RGBA8 pictures. Every destination pixel is mapped back into the source and sampled
+// once, with nearest, bilinear, or bicubic weights, so there are no full size up and down resamples. Rows are split
+// between the work pool threads and summed by the vector pixel kernels.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Image/tPicture.h>
+#include <Image/tResample.h>
+#include "WorkPool.h"
+
+
+namespace Viewer
+{
+	namespace Rotator
+	{
+		// The size of the box that just holds a srcW by srcH picture rotated by angle radians.
+		void GetRotatedSize(int& dstW, int& dstH, int srcW, int srcH, float angle);
+
+		// Rotates the picture about its centre by angle radians. Positive angles are anticlockwise. The picture grows
+		// to the rotated size and the corners get the fill colour. None and Nearest keep the original colours. Box
+		// and Bilinear sample 2x2 source pixels, and the bicubics and Lanczos sample 4x4 with a bicubic kernel
+		// (Catmull-Rom for Lanczos). Edges blend smoothly into the fill. The frame duration is kept. Returns false and
+		// leaves the picture unchanged if the progress is cancelled.
+		bool Rotate
+		(
+			tImage::tPicture&, float angle, const tColour4b& fill, tImage::tResampleFilter,
+			WorkPool::Progress* = nullptr
+		);
+
+		// A drop-in replacement for tPicture::RotateCenter. Without a down filter the picture is sampled once with
+		// the up filter as above. With one, the tacent upsample, rotate, and downsample scheme is used as before, and
+		// the progress is only checked before it starts.
+		bool RotateCenter
+		(
+			tImage::tPicture&, float angle, const tColour4b& fill,
+			tImage::tResampleFilter upFilter, tImage::tResampleFilter downFilter,
+			WorkPool::Progress* = nullptr
+		);
+	}
+}
@@ -0,0 +1,1058 @@
+// SelfTest.cpp
+//
+// Built-in checks run with --selftest from the command line. They cover the parts of the viewer that promise exact
+// results no matter how they run, like the vectorized pixel kernels matching the scalar ones byte for byte, the
+// resampler, rotator, and spatial quantizer giving the same pixels on any number of threads, the undo spill codec
+// giving back exactly what it was given, undo and redo of operation and region steps giving back the exact pixels,
+// and the 64-bit size accounting for images too big to allocate in a test. Nothing is loaded from or saved to disk.
+// The ctest SelfTest target runs these.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <functional>
+#include <Foundation/tStandard.h>
+#include <System/tPrint.h>
+#include "SelfTest.h"
+#include "PixelKernels.h"
+#include "ImageHeader.h"
+#include "Image.h"
+#include "Resampler.h"
+#include "Rotator.h"
+#include "SpatialQuantizer.h"
+#include "Undo.h"
+#include "UndoSpill.h"
+#include "WorkPool.h"
+using namespace tStd;
+using namespace tSystem;
+using namespace tImage;
+
+
+namespace Viewer
+{
+	namespace SelfTest
+	{
+		// A small fixed-seed generator so every run and every platform checks the same data.
+		class Random
+		{
+		public:
+			Random(uint32 seed)																							: State(seed ? seed : 1) { }
+			uint32 Next()																								{ State ^= State << 13; State ^= State >> 17; State ^= State << 5; return State; }
+			int Range(int min, int max)																					{ return min + int(Next() % uint32(max - min + 1)); }
+			void Fill(uint8* dst, int numBytes)																			{ for (int b = 0; b < numBytes; b++) dst[b] = uint8(Next() >> 24); }
+
+		private:
+			uint32 State;
+		};
+
+		// Counts that hit the empty case, every tail length of the 4 and 8 pixel vector loops, and a long run.
+		const int NumCounts																								= 22;
+		const int Counts[NumCounts]																						= { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 15, 16, 17, 31, 32, 33, 63, 65, 1001 };
+
+		// Runs the kernel at the scalar level and at every higher level the CPU supports and compares the output bytes.
+		// The run function must write numBytes to out, starting from the same input each time.
+		bool CompareLevels(const char* name, int numBytes, const std::function<void(uint8* out)>& run);
+
+		// Runs the work on the shared pool and then on the calling thread alone and compares the output bytes. Only
+		// call from the main thread while nothing else uses the pool.
+		bool CompareThreads(const char* name, int numBytes, const std::function<void(uint8* out)>& run);
+
+		// Helpers for building file headers in memory.
+		inline void PutBE32(uint8* d, uint32 v)																			{ d[0] = uint8(v >> 24); d[1] = uint8(v >> 16); d[2] = uint8(v >> 8); d[3] = uint8(v); }
+		inline void PutLE16(uint8* d, uint32 v)																			{ d[0] = uint8(v); d[1] = uint8(v >> 8); }
+		inline void PutLE32(uint8* d, uint32 v)																			{ d[0] = uint8(v); d[1] = uint8(v >> 8); d[2] = uint8(v >> 16); d[3] = uint8(v >> 24); }
+
+		// Prints a failure if the header doesn't parse to the expected totals. An expected width of 0 means the header
+		// must be rejected.
+		bool CheckHeader(const char* name, const uint8* data, int numBytes, tFileType, int width, int height, int numFrames, int64 numPixels);
+
+		// Prints a failure if the pixels don't survive the undo spill codec exactly, or if the encoding with its last
+		// byte missing still decodes. Returns the encoded size in the last argument.
+		bool CheckSpillCodec(const char* name, const tPixel4b* pixels, int numPixels, int& numBytes);
+
+		// Makes two random frames, pushes the step made by push, and applies the edit. Undo must then give back the
+		// original bytes and sizes, and redo the edited ones. A null step pushes a full copy.
+		bool CheckUndoRoundTrip
+		(
+			const char* name, int width, int height,
+			const std::function<Undo::Step*(const tList<tPicture>&)>& push,
+			const std::function<void(tPicture&)>& edit
+		);
+		bool IsSamePictures(const tList<tPicture>&, const tList<tPicture>&);
+
+		bool CheckPixelKernels();
+		bool CheckImageSizes();
+		bool CheckResampler();
+		bool CheckRotator();
+		bool CheckSpatialQuantizer();
+		bool CheckUndoSpill();
+		bool CheckUndoSteps();
+	}
+}
+
+
+bool Viewer::SelfTest::CompareLevels(const char* name, int numBytes, const std::function<void(uint8* out)>& run)
+{
+	PixelKernels::Level restoreLevel = PixelKernels::GetLevel();
+
+	// One extra guard byte catches kernels writing past the end.
+	const uint8 guard = 0xA5;
+	uint8* expected = new uint8[numBytes+1];
+	uint8* result = new uint8[numBytes+1];
+	PixelKernels::SetLevel(PixelKernels::Level::Scalar);
+	run(expected);
+
+	bool ok = true;
+	for (int level = int(PixelKernels::Level::Scalar)+1; level <= int(PixelKernels::GetSupportedLevel()); level++)
+	{
+		PixelKernels::SetLevel(PixelKernels::Level(level));
+		result[numBytes] = guard;
+		run(result);
+		if (tMemcmp(expected, result, numBytes) || (result[numBytes] != guard))
+		{
+			tPrintfNorm("Fail: %s %s differs from Scalar for %d bytes.\n", name, PixelKernels::GetLevelName(PixelKernels::Level(level)), numBytes);
+			ok = false;
+		}
+	}
+
+	PixelKernels::SetLevel(restoreLevel);
+	delete[] result;
+	delete[] expected;
+	return ok;
+}
+
+
+bool Viewer::SelfTest::CompareThreads(const char* name, int numBytes, const std::function<void(uint8* out)>& run)
+{
+	uint8* pooled = new uint8[numBytes];
+	uint8* single = new uint8[numBytes];
+	run(pooled);
+
+	// With the pool shut down all work runs on the calling thread.
+	int numThreads = WorkPool::GetNumThreads();
+	WorkPool::Shutdown();
+	run(single);
+	WorkPool::Init(numThreads);
+
+	bool ok = !tMemcmp(pooled, single, numBytes);
+	if (!ok)
+		tPrintfNorm("Fail: %s on %d threads differs from 1 thread.\n", name, numThreads);
+
+	delete[] single;
+	delete[] pooled;
+	return ok;
+}
+
+
+bool Viewer::SelfTest::CheckPixelKernels()
+{
+	Random random(0x1234567);
+	bool ok = true;
+
+	const int numSwizzles = 6;
+	tComp swizzles[numSwizzles][4] =
+	{
+		{ tComp::B, tComp::G, tComp::R, tComp::A },
+		{ tComp::A, tComp::B, tComp::G, tComp::R },
+		{ tComp::R, tComp::R, tComp::R, tComp::Full },
+		{ tComp::Auto, tComp::Zero, tComp::Auto, tComp::Full },
+		{ tComp::Zero, tComp::Zero, tComp::Zero, tComp::Zero },
+		{ tComp::G, tComp::Auto, tComp::A, tComp::B }
+	};
+
+	const int numSetChannels = 4;
+	comp_t setChannels[numSetChannels] = { tCompBit_R, tCompBit_A, tCompBit_R | tCompBit_G | tCompBit_B, tCompBit_R | tCompBit_G | tCompBit_B | tCompBit_A };
+
+	// Source byte offsets for ConvertPacked, by bytes per pixel. For 8 byte pixels these are the high bytes.
+	const int numPacked = 3;
+	int packedBytesPerPixel[numPacked] = { 3, 4, 8 };
+	int packedSrcBytes[numPacked][2][4] =
+	{
+		{ { 0, 1, 2, -1 }, { 2, 1, 0, -1 } },
+		{ { 0, 1, 2, 3 }, { 2, 1, 0, 3 } },
+		{ { 1, 3, 5, 7 }, { 5, 3, 1, -1 } }
+	};
+
+	for (int n = 0; n < NumCounts; n++)
+	{
+		int count = Counts[n];
+		int numBytes = count*4;
+
+		// The source is allocated to the exact size so an address sanitizer catches any over-read in the tails.
+		uint8* source = new uint8[tMath::tMax(numBytes, 1)];
+		random.Fill(source, numBytes);
+
+		for (int s = 0; s < numSwizzles; s++)
+		{
+			tComp* comps = swizzles[s];
+			ok = CompareLevels("Swizzle", numBytes, [&](uint8* out)
+			{
+				tMemcpy(out, source, numBytes);
+				PixelKernels::Swizzle((tPixel4b*)out, count, comps[0], comps[1], comps[2], comps[3]);
+			}) && ok;
+		}
+
+		tComp spreads[4] = { tComp::R, tComp::G, tComp::B, tComp::A };
+		for (int s = 0; s < 4; s++)
+		{
+			ok = CompareLevels("Spread", numBytes, [&](uint8* out)
+			{
+				tMemcpy(out, source, numBytes);
+				PixelKernels::Spread((tPixel4b*)out, count, spreads[s]);
+			}) && ok;
+		}
+
+		tColour4b colour(uint8(random.Next()), uint8(random.Next()), uint8(random.Next()), uint8(random.Next()));
+		for (int s = 0; s < numSetChannels; s++)
+		{
+			ok = CompareLevels("SetChannels", numBytes, [&](uint8* out)
+			{
+				tMemcpy(out, source, numBytes);
+				PixelKernels::SetChannels((tPixel4b*)out, count, colour, setChannels[s]);
+			}) && ok;
+		}
+		delete[] source;
+
+		for (int p = 0; p < numPacked; p++)
+		{
+			int bytesPerPixel = packedBytesPerPixel[p];
+			int packedBytes = count*bytesPerPixel;
+			uint8* packed = new uint8[tMath::tMax(packedBytes, 1)];
+			random.Fill(packed, packedBytes);
+			for (int m = 0; m < 2; m++)
+			{
+				const int* srcBytes = packedSrcBytes[p][m];
+				ok = CompareLevels("ConvertPacked", numBytes, [&](uint8* out)
+				{
+					PixelKernels::ConvertPacked(packed, bytesPerPixel, (tPixel4b*)out, count, srcBytes);
+				}) && ok;
+			}
+			delete[] packed;
+		}
+	}
+
+	// The resample kernels. Weights add up to one in fixed point like real filters do, but with negative lobes and
+	// overshoot so the rounding and clamping at both ends get exercised.
+	for (int n = 0; n < NumCounts; n++)
+	{
+		int width = Counts[n];
+		for (int taps = 2; taps <= 8; taps += 2)
+		{
+			int srcW = random.Range(1, 40);
+			int* index = new int[tMath::tMax(width*taps, 1)];
+			int16* weights = new int16[tMath::tMax(width*taps, 1)];
+			for (int x = 0; x < width; x++)
+			{
+				int remaining = 1 << PixelKernels::ResampleWeightBits;
+				for (int t = 0; t < taps; t++)
+				{
+					index[x*taps + t] = random.Range(0, srcW-1);
+					int weight = (t == taps-1) ? remaining : random.Range(-2048, 4096);
+					weights[x*taps + t] = int16(weight);
+					remaining -= weight;
+				}
+			}
+
+			tPixel4b* src = new tPixel4b[srcW];
+			random.Fill((uint8*)src, srcW*4);
+			ok = CompareLevels("ResampleRow", width*4, [&](uint8* out)
+			{
+				PixelKernels::ResampleRow(src, (tPixel4b*)out, width, index, weights, taps);
+			}) && ok;
+			delete[] src;
+
+			tPixel4b* rows[8];
+			int16 rowWeights[8];
+			int remaining = 1 << PixelKernels::ResampleWeightBits;
+			for (int t = 0; t < taps; t++)
+			{
+				rows[t] = new tPixel4b[tMath::tMax(width, 1)];
+				random.Fill((uint8*)rows[t], width*4);
+				int weight = (t == taps-1) ? remaining : random.Range(-2048, 4096);
+				rowWeights[t] = int16(weight);
+				remaining -= weight;
+			}
+			ok = CompareLevels("ResampleColumns", width*4, [&](uint8* out)
+			{
+				PixelKernels::ResampleColumns(rows, rowWeights, taps, (tPixel4b*)out, width);
+			}) && ok;
+			for (int t = 0; t < taps; t++)
+				delete[] rows[t];
+
+			delete[] weights;
+			delete[] index;
+		}
+	}
+
+	return ok;
+}
+
+
+bool Viewer::SelfTest::CheckHeader(const char* name, const uint8* data, int numBytes, tFileType fileType, int width, int height, int numFrames, int64 numPixels)
+{
+	ImageHeader::Info info;
+	bool read = ImageHeader::Read(info, data, numBytes, fileType);
+	if (!width)
+	{
+		if (read)
+			tPrintfNorm("Fail: %s header accepted. It should be rejected.\n", name);
+		return !read;
+	}
+
+	if (!read || (info.Width != width) || (info.Height != height) || (info.NumFrames != numFrames) || (info.NumPixels != numPixels))
+	{
+		tPrintfNorm("Fail: %s header gave %dx%d %d frames %|64d pixels. Expected %dx%d %d frames %|64d pixels.\n", name, info.Width, info.Height, info.NumFrames, info.NumPixels, width, height, numFrames, numPixels);
+		return false;
+	}
+	return true;
+}
+
+
+bool Viewer::SelfTest::CheckImageSizes()
+{
+	// Byte counts for pictures with more than 2^31 pixels. Nothing this size is ever allocated here.
+	bool ok = true;
+	const int64 maxDim = Image::MaxDim;
+	if (Image::ComputePictureMemSizeBytes(Image::MaxDim, Image::MaxDim) != maxDim*maxDim*4)
+	{
+		tPrintfNorm("Fail: MaxDim picture memory size overflowed.\n");
+		ok = false;
+	}
+	if (Image::ComputePictureMemSizeBytes(46341, 46341) != int64(46341)*int64(46341)*4)
+	{
+		tPrintfNorm("Fail: Picture memory size just over 2^31 pixels overflowed.\n");
+		ok = false;
+	}
+
+	// A MaxDim x MaxDim png. It has 2^32 pixels.
+	const uint8 pngSig[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+	uint8 png[64];
+	tMemset(png, 0, sizeof(png));
+	tMemcpy(png, pngSig, 8);
+	PutBE32(png+8, 13);
+	tMemcpy(png+12, "IHDR", 4);
+	PutBE32(png+16, Image::MaxDim);
+	PutBE32(png+20, Image::MaxDim);
+	png[24] = 8;
+	png[25] = 6;
+	PutBE32(png+33, 0);
+	tMemcpy(png+37, "IDAT", 4);
+	ok = CheckHeader("Png", png, sizeof(png), tFileType::PNG, Image::MaxDim, Image::MaxDim, 1, maxDim*maxDim) && ok;
+
+	// Turn it into an apng with 3 frames by replacing the IDAT with an acTL chunk. Then with the largest unsigned
+	// frame count, which must clamp rather than wrap.
+	PutBE32(png+33, 8);
+	tMemcpy(png+37, "acTL", 4);
+	PutBE32(png+41, 3);
+	ok = CheckHeader("Apng", png, sizeof(png), tFileType::APNG, Image::MaxDim, Image::MaxDim, 3, 3*maxDim*maxDim) && ok;
+	PutBE32(png+41, 0xFFFFFFFF);
+	ok = CheckHeader("Apng max frames", png, sizeof(png), tFileType::APNG, Image::MaxDim, Image::MaxDim, 0x7FFFFFFF, int64(0x7FFFFFFF)*maxDim*maxDim) && ok;
+
+	// One past MaxDim is rejected.
+	PutBE32(png+16, Image::MaxDim+1);
+	ok = CheckHeader("Png over MaxDim", png, sizeof(png), tFileType::PNG, 0, 0, 0, 0) && ok;
+
+	// A full mip chain cubemap dds. Each face has 4^16 + 4^15 + ... + 1 = (4^17 - 1) / 3 pixels.
+	uint8 dds[128];
+	tMemset(dds, 0, sizeof(dds));
+	tMemcpy(dds, "DDS ", 4);
+	PutLE32(dds+4, 124);
+	PutLE32(dds+8, 0x00020000);
+	PutLE32(dds+12, Image::MaxDim);
+	PutLE32(dds+16, Image::MaxDim);
+	PutLE32(dds+28, 17);
+	PutLE32(dds+88, 32);
+	PutLE32(dds+112, 0x00000200);
+	int64 facePixels = ((int64(1) << 34) - 1) / 3;
+	ok = CheckHeader("Dds cubemap", dds, sizeof(dds), tFileType::DDS, Image::MaxDim, Image::MaxDim, 17*6, 6*facePixels) && ok;
+
+	// The largest gif. The frame count is unknown from the header so only the first frame is counted.
+	uint8 gif[16];
+	tMemset(gif, 0, sizeof(gif));
+	tMemcpy(gif, "GIF89a", 6);
+	PutLE16(gif+6, 0xFFFF);
+	PutLE16(gif+8, 0xFFFF);
+	ok = CheckHeader("Gif", gif, sizeof(gif), tFileType::GIF, 0xFFFF, 0xFFFF, 0, int64(0xFFFF)*int64(0xFFFF)) && ok;
+
+	return ok;
+}
+
+
+bool Viewer::SelfTest::CheckResampler()
+{
+	Random random(0x7654321);
+	bool ok = true;
+	const int numFilters = int(tResampleFilter::NumFilters);
+	tResampleEdgeMode edgeModes[2] = { tResampleEdgeMode::Clamp, tResampleEdgeMode::Wrap };
+
+	// Source and destination sizes. Up, down, one axis each way, single pixels, and a reduction big enough to use
+	// the box pyramid before the filter.
+	const int numSizes = 6;
+	int sizes[numSizes][4] =
+	{
+		{ 7, 5, 3, 2 }, { 3, 2, 7, 5 }, { 1, 1, 9, 4 }, { 20, 1, 3, 1 }, { 5, 9, 11, 4 }, { 64, 48, 5, 3 }
+	};
+
+	// A flat colour stays exactly the same colour for every filter and edge mode. The fixed point weights of each
+	// output pixel add up to exactly one.
+	tPixel4b flat(200, 17, 99, 128);
+	for (int s = 0; s < numSizes; s++)
+	{
+		int srcW = sizes[s][0], srcH = sizes[s][1], dstW = sizes[s][2], dstH = sizes[s][3];
+		tPixel4b* src = new tPixel4b[srcW*srcH];
+		tPixel4b* dst = new tPixel4b[dstW*dstH];
+		for (int p = 0; p < srcW*srcH; p++)
+			src[p] = flat;
+
+		for (int f = 0; f < numFilters; f++)
+		{
+			for (tResampleEdgeMode edgeMode : edgeModes)
+			{
+				bool resampled = Resampler::Resample(src, srcW, srcH, dst, dstW, dstH, tResampleFilter(f), edgeMode);
+				bool same = resampled;
+				for (int p = 0; (p < dstW*dstH) && same; p++)
+					same = (dst[p].BP == flat.BP);
+				if (!same)
+				{
+					tPrintfNorm("Fail: Resample filter %d %dx%d to %dx%d changed a flat colour.\n", f, srcW, srcH, dstW, dstH);
+					ok = false;
+				}
+			}
+		}
+		delete[] dst;
+		delete[] src;
+	}
+
+	// Halving with nearest picks the source pixel whose centre is nearest the output centre. That is the second of
+	// each pair. Halving with box averages each 2x2 block. All the values are multiples of 4 so the two passes round
+	// nothing and the average is exact.
+	tPixel4b src8x6[8*6];
+	random.Fill((uint8*)src8x6, sizeof(src8x6));
+	for (int p = 0; p < 8*6; p++)
+		src8x6[p].BP &= 0xFCFCFCFC;
+
+	tPixel4b half[4*3];
+	if (!Resampler::Resample(src8x6, 8, 6, half, 4, 3, tResampleFilter::Nearest, tResampleEdgeMode::Clamp))
+		ok = false;
+	for (int y = 0; y < 3; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			if (half[y*4 + x].BP != src8x6[(2*y+1)*8 + 2*x+1].BP)
+			{
+				tPrintfNorm("Fail: Resample nearest halving picked the wrong pixel at %d,%d.\n", x, y);
+				ok = false;
+			}
+		}
+	}
+
+	if (!Resampler::Resample(src8x6, 8, 6, half, 4, 3, tResampleFilter::Box, tResampleEdgeMode::Clamp))
+		ok = false;
+	for (int y = 0; y < 3; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			const uint8* out = (const uint8*)&half[y*4 + x];
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = 0;
+				for (int by = 0; by < 2; by++)
+					for (int bx = 0; bx < 2; bx++)
+						sum += ((const uint8*)&src8x6[(2*y+by)*8 + 2*x+bx])[c];
+				if (out[c] != sum/4)
+				{
+					tPrintfNorm("Fail: Resample box halving is not the 2x2 average at %d,%d.\n", x, y);
+					ok = false;
+				}
+			}
+		}
+	}
+
+	// Random pixels give the same bytes at every kernel level.
+	const int srcW = 37, srcH = 23;
+	tPixel4b* src = new tPixel4b[srcW*srcH];
+	random.Fill((uint8*)src, srcW*srcH*4);
+	int dstSizes[4][2] = { { 13, 7 }, { 64, 40 }, { 37, 23 }, { 5, 3 } };
+	for (int d = 0; d < 4; d++)
+	{
+		int dstW = dstSizes[d][0], dstH = dstSizes[d][1];
+		for (int f = 0; f < numFilters; f++)
+		{
+			for (tResampleEdgeMode edgeMode : edgeModes)
+			{
+				ok = CompareLevels("Resample", dstW*dstH*4, [&](uint8* out)
+				{
+					Resampler::Resample(src, srcW, srcH, (tPixel4b*)out, dstW, dstH, tResampleFilter(f), edgeMode);
+				}) && ok;
+			}
+		}
+	}
+	delete[] src;
+
+	// Big enough that the rows are split into several ranges.
+	const int bigW = 600, bigH = 400, outW = 257, outH = 311;
+	tPixel4b* big = new tPixel4b[bigW*bigH];
+	random.Fill((uint8*)big, bigW*bigH*4);
+	ok = CompareThreads("Resample", outW*outH*4, [&](uint8* out)
+	{
+		Resampler::Resample(big, bigW, bigH, (tPixel4b*)out, outW, outH, tResampleFilter::Lanczos_Normal, tResampleEdgeMode::Clamp);
+	}) && ok;
+	delete[] big;
+
+	return ok;
+}
+
+
+bool Viewer::SelfTest::CheckRotator()
+{
+	Random random(0x3456789);
+	bool ok = true;
+	const int numFilters = int(tResampleFilter::NumFilters);
+
+	const int srcW = 7, srcH = 5;
+	tPixel4b src[srcW*srcH];
+	random.Fill((uint8*)src, sizeof(src));
+	tColour4b fill(10, 20, 30, 0);
+
+	// No rotation keeps every pixel. The sample positions land exactly on the source centres, so every filter that
+	// passes through its samples gives them back. Mitchell and B-spline smooth them.
+	for (int f = 0; f < numFilters; f++)
+	{
+		if ((tResampleFilter(f) == tResampleFilter::Bicubic_Mitchell) || (tResampleFilter(f) == tResampleFilter::Bicubic_BSpline))
+			continue;
+
+		tPicture picture(srcW, srcH, src, true);
+		picture.Duration = 0.25f;
+		bool rotated = Rotator::Rotate(picture, 0.0f, fill, tResampleFilter(f));
+		bool same = rotated && (picture.GetWidth() == srcW) && (picture.GetHeight() == srcH) && (picture.Duration == 0.25f);
+		for (int p = 0; (p < srcW*srcH) && same; p++)
+			same = (picture.GetPixels()[p].BP == src[p].BP);
+		if (!same)
+		{
+			tPrintfNorm("Fail: Rotate filter %d by 0 degrees changed the picture.\n", f);
+			ok = false;
+		}
+	}
+
+	// Quarter turns with nearest move every pixel to its rotated place and add no fill. Positive is anticlockwise.
+	for (int quarter = 1; quarter <= 3; quarter++)
+	{
+		tPicture picture(srcW, srcH, src, true);
+		Rotator::Rotate(picture, tMath::tDegToRad(90.0f*float(quarter)), fill, tResampleFilter::Nearest);
+		int dstW = (quarter == 2) ? srcW : srcH;
+		int dstH = (quarter == 2) ? srcH : srcW;
+		if ((picture.GetWidth() != dstW) || (picture.GetHeight() != dstH))
+		{
+			tPrintfNorm("Fail: Rotate by %d degrees gave %dx%d.\n", 90*quarter, picture.GetWidth(), picture.GetHeight());
+			ok = false;
+			continue;
+		}
+
+		for (int y = 0; y < dstH; y++)
+		{
+			for (int x = 0; x < dstW; x++)
+			{
+				int sx = x, sy = y;
+				switch (quarter)
+				{
+					case 1:		sx = y;				sy = srcH-1 - x;	break;
+					case 2:		sx = srcW-1 - x;	sy = srcH-1 - y;	break;
+					case 3:		sx = srcW-1 - y;	sy = x;				break;
+				}
+				if (picture.GetPixels()[y*dstW + x].BP != src[sy*srcW + sx].BP)
+				{
+					tPrintfNorm("Fail: Rotate by %d degrees moved the wrong pixel to %d,%d.\n", 90*quarter, x, y);
+					ok = false;
+				}
+			}
+		}
+	}
+
+	// A flat picture on a fill of the same colour stays flat at any angle for every filter. With a different fill
+	// the corners of the grown picture are exactly the fill. At 40 degrees they are more than 5 pixels from the
+	// source, beyond the reach of any filter.
+	const int flatW = 16, flatH = 12;
+	tPixel4b flat(200, 17, 99, 128);
+	tPixel4b flatSrc[flatW*flatH];
+	for (int p = 0; p < flatW*flatH; p++)
+		flatSrc[p] = flat;
+	for (int f = 0; f < numFilters; f++)
+	{
+		tPicture picture(flatW, flatH, flatSrc, true);
+		Rotator::Rotate(picture, tMath::tDegToRad(40.0f), flat, tResampleFilter(f));
+		bool same = true;
+		for (int p = 0; (p < picture.GetWidth()*picture.GetHeight()) && same; p++)
+			same = (picture.GetPixels()[p].BP == flat.BP);
+		if (!same)
+		{
+			tPrintfNorm("Fail: Rotate filter %d changed a flat colour.\n", f);
+			ok = false;
+		}
+
+		tPicture filled(flatW, flatH, flatSrc, true);
+		Rotator::Rotate(filled, tMath::tDegToRad(40.0f), fill, tResampleFilter(f));
+		int w = filled.GetWidth(), h = filled.GetHeight();
+		const tPixel4b* pixels = filled.GetPixels();
+		if ((pixels[0].BP != fill.BP) || (pixels[w-1].BP != fill.BP) || (pixels[(h-1)*w].BP != fill.BP) || (pixels[h*w-1].BP != fill.BP))
+		{
+			tPrintfNorm("Fail: Rotate filter %d corners are not the fill colour.\n", f);
+			ok = false;
+		}
+	}
+
+	// Random pixels give the same bytes at every kernel level.
+	const int randW = 31, randH = 17;
+	tPixel4b* rand = new tPixel4b[randW*randH];
+	random.Fill((uint8*)rand, randW*randH*4);
+	float angles[3] = { 0.3f, -1.1f, 2.5f };
+	for (float angle : angles)
+	{
+		int dstW = 0, dstH = 0;
+		Rotator::GetRotatedSize(dstW, dstH, randW, randH, angle);
+		for (int f = 0; f < numFilters; f++)
+		{
+			ok = CompareLevels("Rotate", dstW*dstH*4, [&](uint8* out)
+			{
+				tPicture picture(randW, randH, rand, true);
+				Rotator::Rotate(picture, angle, fill, tResampleFilter(f));
+				tMemcpy(out, picture.GetPixels(), dstW*dstH*4);
+			}) && ok;
+		}
+	}
+	delete[] rand;
+
+	// Big enough that the rows are split into several ranges.
+	const int bigW = 500, bigH = 400;
+	tPixel4b* big = new tPixel4b[bigW*bigH];
+	random.Fill((uint8*)big, bigW*bigH*4);
+	int outW = 0, outH = 0;
+	Rotator::GetRotatedSize(outW, outH, bigW, bigH, 0.5f);
+	ok = CompareThreads("Rotate", outW*outH*4, [&](uint8* out)
+	{
+		tPicture picture(bigW, bigH, big, true);
+		Rotator::Rotate(picture, 0.5f, fill, tResampleFilter::Bicubic_Standard);
+		tMemcpy(out, picture.GetPixels(), outW*outH*4);
+	}) && ok;
+	delete[] big;
+
+	return ok;
+}
+
+
+bool Viewer::SelfTest::CheckSpatialQuantizer()
+{
+	Random random(0x4567890);
+	bool ok = true;
+
+	// A smooth gradient with a little noise needs dithering and has far more colours than asked for. The alpha is
+	// random so any change to it shows.
+	const int w = 300, h = 200;
+	tPixel4b* src = new tPixel4b[w*h];
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++)
+			src[y*w + x] = tPixel4b(uint8(x*255/w), uint8(y*255/h), uint8(random.Range(100, 140)), uint8(random.Next() >> 24));
+
+	// At most the requested number of colours come out for every filter size, and alpha is left alone.
+	int filterSizes[3] = { 1, 3, 5 };
+	int numColours[3] = { 2, 7, 16 };
+	tPixel4b* dst = new tPixel4b[w*h];
+	for (int f = 0; f < 3; f++)
+	{
+		SpatialQuantizer::Params params;
+		params.NumColours = numColours[f];
+		params.FilterSize = filterSizes[f];
+		tMemcpy(dst, src, w*h*4);
+		if (!SpatialQuantizer::Quantize(dst, w, h, params))
+		{
+			tPrintfNorm("Fail: Spatial quantize to %d colours failed.\n", numColours[f]);
+			ok = false;
+			continue;
+		}
+
+		uint32 colours[16];
+		int found = 0;
+		bool alphaKept = true;
+		for (int p = 0; p < w*h; p++)
+		{
+			uint32 rgb = dst[p].BP & tPixel4b(255, 255, 255, 0).BP;
+			int c = 0;
+			while ((c < found) && (colours[c] != rgb))
+				c++;
+			if ((c == found) && (found < 16))
+				colours[found] = rgb;
+			if (c == found)
+				found++;
+			alphaKept = alphaKept && (dst[p].A == src[p].A);
+		}
+		if (found > numColours[f])
+		{
+			tPrintfNorm("Fail: Spatial quantize to %d colours gave more than that.\n", numColours[f]);
+			ok = false;
+		}
+		if (!alphaKept)
+		{
+			tPrintfNorm("Fail: Spatial quantize changed the alpha.\n");
+			ok = false;
+		}
+	}
+
+	// With no more colours than asked for and checkExact set the picture is left exactly as it was.
+	tPixel4b few[64];
+	tPixel4b fewColours[4] = { tPixel4b(0, 0, 0, 255), tPixel4b(255, 0, 0, 255), tPixel4b(12, 200, 34, 9), tPixel4b(250, 250, 250, 0) };
+	for (int p = 0; p < 64; p++)
+		few[p] = fewColours[random.Range(0, 3)];
+	tPixel4b fewResult[64];
+	tMemcpy(fewResult, few, sizeof(few));
+	SpatialQuantizer::Params fewParams;
+	fewParams.NumColours = 4;
+	if (!SpatialQuantizer::Quantize(fewResult, 8, 8, fewParams) || tMemcmp(few, fewResult, sizeof(few)))
+	{
+		tPrintfNorm("Fail: Spatial quantize changed a picture that already had few enough colours.\n");
+		ok = false;
+	}
+
+	// The tiles of each phase are swept at once, so the result must not depend on the number of threads. The same
+	// goes for a budget, which is spent as a fixed number of rounds. One buys a single refinement of this picture
+	// and the other doesn't even cover the start.
+	float budgets[3] = { 0.0f, 0.2f, 0.01f };
+	for (float budget : budgets)
+	{
+		SpatialQuantizer::Params params;
+		params.NumColours = 16;
+		params.FilterSize = 5;
+		params.TimeBudget = budget;
+		ok = CompareThreads("Spatial quantize", w*h*4, [&](uint8* out)
+		{
+			tMemcpy(out, src, w*h*4);
+			SpatialQuantizer::Quantize((tPixel4b*)out, w, h, params);
+		}) && ok;
+	}
+
+	delete[] dst;
+	delete[] src;
+	return ok;
+}
+
+
+bool Viewer::SelfTest::CheckSpillCodec(const char* name, const tPixel4b* pixels, int numPixels, int& numBytes)
+{
+	std::vector<uint8> encoded;
+	UndoSpill::Encode(pixels, numPixels, encoded);
+	numBytes = int(encoded.size());
+
+	// One extra guard pixel catches the decoder writing past the end.
+	tPixel4b guard(0xA5, 0x5A, 0xC3, 0x3C);
+	tPixel4b* decoded = new tPixel4b[numPixels+1];
+	decoded[numPixels] = guard;
+	bool ok = true;
+	if (!UndoSpill::Decode(encoded.data(), numBytes, decoded, numPixels) || tMemcmp(decoded, pixels, numPixels*4) || (decoded[numPixels].BP != guard.BP))
+	{
+		tPrintfNorm("Fail: Undo spill %s did not decode to the same pixels.\n", name);
+		ok = false;
+	}
+
+	if ((numBytes > 0) && UndoSpill::Decode(encoded.data(), numBytes-1, decoded, numPixels))
+	{
+		tPrintfNorm("Fail: Undo spill %s decoded with its last byte missing.\n", name);
+		ok = false;
+	}
+
+	delete[] decoded;
+	return ok;
+}
+
+
+bool Viewer::SelfTest::CheckUndoSpill()
+{
+	Random random(0x5678901);
+	bool ok = true;
+	int numBytes = 0;
+	const int maxPixels = 1024;
+	tPixel4b pixels[maxPixels];
+
+	// Random pixels are mostly literals with the alpha changing every time.
+	random.Fill((uint8*)pixels, sizeof(pixels));
+	ok = CheckSpillCodec("random", pixels, maxPixels, numBytes) && ok;
+
+	// Flat pixels are runs. The encoder starts from opaque black, so a picture of it is all runs from the first pixel.
+	for (int p = 0; p < maxPixels; p++)
+		pixels[p] = tPixel4b(9, 8, 7, 255);
+	ok = CheckSpillCodec("flat", pixels, maxPixels, numBytes) && ok;
+	for (int p = 0; p < maxPixels; p++)
+		pixels[p] = tPixel4b(0, 0, 0, 255);
+	ok = CheckSpillCodec("flat black", pixels, maxPixels, numBytes) && ok;
+	if (numBytes != (maxPixels + 61) / 62)
+	{
+		tPrintfNorm("Fail: Undo spill flat black took %d bytes.\n", numBytes);
+		ok = false;
+	}
+
+	// Runs either side of the longest one op holds, followed by another colour or ending the buffer.
+	int runs[5] = { 1, 61, 62, 63, 125 };
+	for (int run : runs)
+	{
+		for (int atEnd = 0; atEnd < 2; atEnd++)
+		{
+			int n = 0;
+			pixels[n++] = tPixel4b(200, 100, 50, 255);
+			for (int r = 0; r < run; r++)
+				pixels[n++] = tPixel4b(30, 60, 90, 120);
+			if (!atEnd)
+				pixels[n++] = tPixel4b(31, 60, 90, 120);
+
+			tString name;
+			tsPrintf(name, "run of %d%s", run, atEnd ? " at the end" : "");
+			ok = CheckSpillCodec(name.Chr(), pixels, n, numBytes) && ok;
+		}
+	}
+
+	// Alpha changing with the colour the same, and with small colour steps that would otherwise be diffs.
+	for (int p = 0; p < maxPixels; p++)
+		pixels[p] = tPixel4b(uint8(100 + (p & 1)), 100, 100, uint8((p % 3)*100));
+	ok = CheckSpillCodec("alpha changes", pixels, maxPixels, numBytes) && ok;
+
+	// Smooth ramps give diffs and lumas, with every channel wrapping around.
+	for (int p = 0; p < maxPixels; p++)
+		pixels[p] = tPixel4b(uint8(p), uint8(p*3), uint8(255 - p*2), 255);
+	ok = CheckSpillCodec("ramps", pixels, maxPixels, numBytes) && ok;
+
+	// A few colours far apart visited in turn are table hits after the first time round, one byte each.
+	tPixel4b palette[5] = { tPixel4b(255, 0, 0, 255), tPixel4b(0, 200, 0, 10), tPixel4b(0, 0, 150, 255), tPixel4b(90, 90, 90, 0), tPixel4b(1, 250, 3, 77) };
+	for (int p = 0; p < maxPixels; p++)
+		pixels[p] = palette[p % 5];
+	ok = CheckSpillCodec("table hits", pixels, maxPixels, numBytes) && ok;
+	if (numBytes > maxPixels + 5*5)
+	{
+		tPrintfNorm("Fail: Undo spill table hits took %d bytes.\n", numBytes);
+		ok = false;
+	}
+
+	ok = CheckSpillCodec("empty", pixels, 0, numBytes) && ok;
+	return ok;
+}
+
+
+bool Viewer::SelfTest::IsSamePictures(const tList<tPicture>& a, const tList<tPicture>& b)
+{
+	if (a.Count() != b.Count())
+		return false;
+
+	for (const tPicture* pa = a.First(), *pb = b.First(); pa && pb; pa = pa->Next(), pb = pb->Next())
+	{
+		if ((pa->GetWidth() != pb->GetWidth()) || (pa->GetHeight() != pb->GetHeight()))
+			return false;
+		if (tMemcmp(pa->GetPixels(), pb->GetPixels(), pa->GetWidth()*pa->GetHeight()*4))
+			return false;
+	}
+	return true;
+}
+
+
+bool Viewer::SelfTest::CheckUndoRoundTrip
+(
+	const char* name, int width, int height,
+	const std::function<Undo::Step*(const tList<tPicture>&)>& push,
+	const std::function<void(tPicture&)>& edit
+)
+{
+	Random random(0x6789012);
+	tList<tPicture> pictures;
+	tList<tPicture> original;
+	tList<tPicture> edited;
+	tPixel4b* pixels = new tPixel4b[width*height];
+	for (int f = 0; f < 2; f++)
+	{
+		random.Fill((uint8*)pixels, width*height*4);
+		pictures.Append(new tPicture(width, height, pixels, true));
+		original.Append(new tPicture(width, height, pixels, true));
+	}
+	delete[] pixels;
+
+	Undo::Stack stack;
+	Undo::Step* step = push(pictures);
+	if (step)
+		stack.Push(step);
+	else
+		stack.Push(pictures, name, false);
+	for (tPicture* picture = pictures.First(); picture; picture = picture->Next())
+	{
+		edit(*picture);
+		edited.Append(new tPicture(*picture));
+	}
+
+	bool ok = true;
+	bool dirty = true;
+	stack.Undo(pictures, dirty);
+	if (!IsSamePictures(pictures, original) || dirty)
+	{
+		tPrintfNorm("Fail: Undo of %s did not give back the original pictures.\n", name);
+		ok = false;
+	}
+
+	stack.Redo(pictures, dirty);
+	if (!IsSamePictures(pictures, edited) || !dirty)
+	{
+		tPrintfNorm("Fail: Redo of %s did not give back the edited pictures.\n", name);
+		ok = false;
+	}
+
+	pictures.Empty();
+	original.Empty();
+	edited.Empty();
+	return ok;
+}
+
+
+bool Viewer::SelfTest::CheckUndoSteps()
+{
+	bool ok = true;
+
+	// A permutation swizzle is undone by its inverse. One that copies a channel loses the other and needs a copy.
+	ok = CheckUndoRoundTrip
+	(
+		"swizzle GBRA", 7, 4,
+		[](const tList<tPicture>&) { return Undo::Step_Operation::CreateSwizzle("Swizzle", false, tComp::G, tComp::B, tComp::R, tComp::A); },
+		[](tPicture& picture) { picture.Swizzle(tComp::G, tComp::B, tComp::R, tComp::A); }
+	) && ok;
+
+	if (Undo::Step_Operation::CreateSwizzle("Swizzle", false, tComp::R, tComp::R, tComp::B, tComp::A))
+	{
+		tPrintfNorm("Fail: Undo made an operation step for a swizzle that is not a permutation.\n");
+		ok = false;
+	}
+	ok = CheckUndoRoundTrip
+	(
+		"swizzle RRBA", 7, 4,
+		[](const tList<tPicture>&) { return nullptr; },
+		[](tPicture& picture) { picture.Swizzle(tComp::R, tComp::R, tComp::B, tComp::A); }
+	) && ok;
+
+	// Quarter turns of a picture that isn't square, and both flips.
+	ok = CheckUndoRoundTrip
+	(
+		"rotate 90 CW", 7, 4,
+		[](const tList<tPicture>&) { return new Undo::Step_Operation("Rotate", false, Undo::Operation::Rotate90CW); },
+		[](tPicture& picture) { picture.Rotate90(false); }
+	) && ok;
+	ok = CheckUndoRoundTrip
+	(
+		"rotate 90 ACW", 7, 4,
+		[](const tList<tPicture>&) { return new Undo::Step_Operation("Rotate", false, Undo::Operation::Rotate90ACW); },
+		[](tPicture& picture) { picture.Rotate90(true); }
+	) && ok;
+	ok = CheckUndoRoundTrip
+	(
+		"flip horizontal", 7, 4,
+		[](const tList<tPicture>&) { return new Undo::Step_Operation("Flip", false, Undo::Operation::FlipHorizontal); },
+		[](tPicture& picture) { picture.Flip(true); }
+	) && ok;
+	ok = CheckUndoRoundTrip
+	(
+		"flip vertical", 7, 4,
+		[](const tList<tPicture>&) { return new Undo::Step_Operation("Flip", false, Undo::Operation::FlipVertical); },
+		[](tPicture& picture) { picture.Flip(false); }
+	) && ok;
+
+	// An anchored paste only saves the rect it writes to. Every anchor is tried with an odd and an even sized region
+	// inside the picture, and one bigger than the picture that is clipped on every edge.
+	const int numRegions = 3;
+	int regions[numRegions][2] = { { 3, 3 }, { 4, 2 }, { 10, 6 } };
+	tPixel4b regionPixels[10*6];
+	for (int p = 0; p < 10*6; p++)
+		regionPixels[p] = tPixel4b(uint8(p), 0, 255, 128);
+	tPicture::Anchor anchors[] =
+	{
+		tPicture::Anchor::LeftTop,		tPicture::Anchor::MiddleTop,	tPicture::Anchor::RightTop,
+		tPicture::Anchor::LeftMiddle,	tPicture::Anchor::MiddleMiddle,	tPicture::Anchor::RightMiddle,
+		tPicture::Anchor::LeftBottom,	tPicture::Anchor::MiddleBottom,	tPicture::Anchor::RightBottom
+	};
+	for (int a = 0; a < tNumElements(anchors); a++)
+	{
+		tPicture::Anchor anchor = anchors[a];
+		for (int r = 0; r < numRegions; r++)
+		{
+			int regionW = regions[r][0];
+			int regionH = regions[r][1];
+			tString name;
+			tsPrintf(name, "paste %dx%d anchor %d", regionW, regionH, a);
+			ok = CheckUndoRoundTrip
+			(
+				name.Chr(), 7, 4,
+				[&](const tList<tPicture>& pictures)
+				{
+					std::vector<Undo::Step_Region::Rect> rects;
+					for (const tPicture* picture = pictures.First(); picture; picture = picture->Next())
+						rects.push_back(Image::GetPasteRect(picture->GetWidth(), picture->GetHeight(), regionW, regionH, anchor));
+					return new Undo::Step_Region("Paste", false, pictures, rects);
+				},
+				[&](tPicture& picture) { picture.CopyRegion(regionW, regionH, regionPixels, anchor); }
+			) && ok;
+		}
+	}
+
+	// A region step made before a resize no longer fits, so undo drops it and leaves the pictures alone.
+	tPixel4b pixels[7*4];
+	for (int p = 0; p < 7*4; p++)
+		pixels[p] = tPixel4b(uint8(p), uint8(p*2), uint8(p*3), 255);
+	tList<tPicture> pictures;
+	pictures.Append(new tPicture(7, 4, pixels, true));
+	std::vector<Undo::Step_Region::Rect> rects(1, { 1, 1, 3, 2 });
+	Undo::Stack stack;
+	stack.Push(new Undo::Step_Region("Paste", false, pictures, rects));
+	pictures.First()->Crop(6, 4, tPicture::Anchor::LeftBottom);
+	tList<tPicture> resized;
+	resized.Append(new tPicture(*pictures.First()));
+
+	bool dirty = true;
+	stack.Undo(pictures, dirty);
+	if (!IsSamePictures(pictures, resized) || !dirty || stack.UndoAvailable() || stack.RedoAvailable())
+	{
+		tPrintfNorm("Fail: Undo restored a region step into pictures of a different size.\n");
+		ok = false;
+	}
+	pictures.Empty();
+	resized.Empty();
+
+	return ok;
+}
+
+
+bool Viewer::SelfTest::Run()
+{
+	struct Check
+	{
+		const char* Name;
+		bool (*Func)();
+	};
+
+	Check checks[] =
+	{
+		{ "PixelKernels",		CheckPixelKernels },
+		{ "ImageSizes",			CheckImageSizes },
+		{ "Resampler",			CheckResampler },
+		{ "Rotator",			CheckRotator },
+		{ "SpatialQuantizer",	CheckSpatialQuantizer },
+		{ "UndoSpill",			CheckUndoSpill },
+		{ "UndoSteps",			CheckUndoSteps }
+	};
+
+	tPrintfNorm("Self test. Pixel kernels supported: %s\n", PixelKernels::GetLevelName(PixelKernels::GetSupportedLevel()));
+	int numFailed = 0;
+	for (int c = 0; c < tNumElements(checks); c++)
+	{
+		bool passed = checks[c].Func();
+		tPrintfNorm("%-20s %s\n", checks[c].Name, passed ? "Pass" : "Fail");
+		if (!passed)
+			numFailed++;
+	}
+
+	tPrintfNorm("Self test %s. %d of %d checks failed.\n", numFailed ? "failed" : "passed", numFailed, int(tNumElements(checks)));
+	return numFailed == 0;
+}
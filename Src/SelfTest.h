@@ -0,0 +1,30 @@
+// SelfTest.h
+//
+// Built-in checks run with --selftest from the command line. They cover the parts of the viewer that promise exact
+// results no matter how they run, like the vectorized pixel kernels matching the scalar ones byte for byte, the
+// resampler, rotator, and spatial quantizer giving the same pixels on any number of threads, the undo spill codec
+// giving back exactly what it was given, undo and redo of operation and region steps giving back the exact pixels,
+// and the 64-bit size accounting for images too big to allocate in a test. Nothing is loaded from or saved to disk.
+// The ctest SelfTest target runs these.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+
+
+namespace Viewer
+{
+	namespace SelfTest
+	{
+		// Runs every check and prints a line for each one. Returns true if they all passed.
+		bool Run();
+	}
+}
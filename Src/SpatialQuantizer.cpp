@@ -0,0 +1,854 @@
+// SpatialQuantizer.cpp
+//
+// Spatial colour quantization of RGBA8 pictures. Like the tacent (scolorq) quantizer it picks a palette and a pixel
+// to palette mapping that minimize the difference between the picture and the quantized result as seen through a
+// small blur, which is what produces the dithering. Instead of annealing the full size picture, the palette is settled
+// on a box-reduced pyramid from the smallest level up and every level starts from an error-diffused mapping, so the
+// full size picture only needs a few refining sweeps. Sweeps run on the work pool over tiles that are far enough apart
+// not to interact, and the result does not depend on the thread count.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <vector>
+#include <chrono>
+#include <unordered_set>
+#include <algorithm>
+#include "SpatialQuantizer.h"
+#include "WorkPool.h"
+#include "Mipmap.h"
+using namespace tImage;
+using namespace tMath;
+
+
+namespace Viewer
+{
+	namespace SpatialQuantizer
+	{
+		// The error of pixel q is e(q) = palette[index(q)] - pixel(q). The quantity minimized is the sum over all p of
+		// |sum over q of K(p-q) e(q)|^2, with K the blur. Expanding it, pixel q and pixel q+r interact with weight
+		// B(r), the autocorrelation of K, which reaches twice as far as K does.
+		struct Filter
+		{
+			int Radius													= 0;	// Of B.
+			int Width													= 1;	// Of B.
+			std::vector<float> B;
+			float B0													= 1.0f;	// The centre of B.
+		};
+
+		// Palette lookup. RGB space is cut into cells and each cell lists every colour that can be the nearest to some
+		// point in it, so a lookup only measures a handful of colours.
+		struct Palette
+		{
+			int NumColours												= 0;
+			std::vector<float> Colours;											// NumColours RGB triples.
+			std::vector<int> CellStart;											// NumCells+1 offsets into Candidates.
+			std::vector<uint8> Candidates;
+		};
+
+		// One level of the pyramid. Level 0 is the picture itself.
+		struct Level
+		{
+			int W														= 0;
+			int H														= 0;
+			const tPixel4b* Pixels										= nullptr;
+			std::vector<uint8> Index;
+		};
+
+		struct Solver
+		{
+			Filter Blur;
+			Palette Pal;
+			int IgnoreAlpha												= -1;
+			std::chrono::steady_clock::time_point StartTime;
+			float TimeBudget											= 0.0f;
+			bool OutOfBudget											= false;
+
+			// Work is counted in rows of the full size picture.
+			WorkPool::Progress* Prog									= nullptr;
+			int64 WorkDone												= 0;
+		};
+
+		const int CellBits												= 3;
+		const int CellsPerAxis											= 256 >> CellBits;
+		const int NumCells												= CellsPerAxis*CellsPerAxis*CellsPerAxis;
+
+		// Tiles of one phase are a tile apart, which must be at least the filter reach (4 for the 5x5 blur).
+		const int TileSize												= 32;
+
+		// The pyramid stops once the largest side is this small. The palette is first picked on the first level no
+		// bigger than PaletteLevelSize.
+		const int CoarsestSize											= 128;
+		const int PaletteLevelSize										= 1024;
+
+		// Refinement rounds on the coarsest level. Each round updates the palette and then sweeps to convergence.
+		const int CoarsestRounds										= 6;
+		const int MaxSweeps												= 8;
+
+		// A sweep that changes fewer than 1 in this many pixels counts as converged.
+		const int ConvergedFraction										= 250;
+
+		// The palette sums are made over this many fixed bands of rows so the order of additions, and so the result,
+		// never depends on the number of threads.
+		const int NumSumBands											= 16;
+		const int PaletteIterations										= 32;
+
+		bool IsIgnored(const tPixel4b& pixel, int ignoreAlpha)													{ return int(pixel.A) <= ignoreAlpha; }
+		double GetAutoDitherLevel(int w, int h, int numColours);
+		void ComputeFilter(Filter&, int filterSize, double ditherLevel);
+		void BuildCells(Palette&);
+		int FindNearest(const Palette&, float r, float g, float b);
+		bool InitPalette(Palette&, const Level&, int numColours, int ignoreAlpha);
+		void MapIgnored(Level&, const Solver&);
+		void Diffuse(Level&, const Solver&);
+		int Sweep(Level&, const Solver&, std::vector<uint8>& dirtyTiles);
+		int SweepTile(Level&, const Solver&, int tileX, int tileY, std::vector<float>& errors);
+		void UpdatePalette(const Level&, Solver&);
+		bool IsOutOfTime(const Solver&);
+		void GetDurations(float& start, float& perRefinement, int w, int h, const Params&);
+		bool IsCancelled(const Solver& solver)																	{ return solver.Prog && solver.Prog->IsCancelled(); }
+		void AddDone(Solver&, int64 work);
+		void Refine(Level&, Solver&, int rounds, bool checkTime, int64 workPerRound);
+		bool HasFewColours(const tPixel4b* pixels, int64 numPixels, int numColours);
+	}
+}
+
+
+double Viewer::SpatialQuantizer::GetAutoDitherLevel(int w, int h, int numColours)
+{
+	// The same formula the tacent (scolorq) quantizer uses so an unset level looks the same.
+	return 0.09*double(tLog(float(w)*float(h))) - 0.04*double(tLog(float(numColours))) + 0.001;
+}
+
+
+void Viewer::SpatialQuantizer::ComputeFilter(Filter& filter, int filterSize, double ditherLevel)
+{
+	int radius = tClamp(filterSize, 1, 5) / 2;
+	int size = 2*radius + 1;
+	float stddev2 = float(ditherLevel*ditherLevel);
+
+	// K(i,j) = exp(-sqrt(i^2 + j^2) / stddev^2) normalized, exactly as scolorq builds it.
+	std::vector<double> k(size*size);
+	double sum = 0.0;
+	for (int j = -radius; j <= radius; j++)
+		for (int i = -radius; i <= radius; i++)
+		{
+			double value = double(tExp(-tSqrt(float(i*i + j*j)) / stddev2));
+			k[(j+radius)*size + (i+radius)] = value;
+			sum += value;
+		}
+	for (double& value : k)
+		value /= sum;
+
+	filter.Radius = 2*radius;
+	filter.Width = 2*filter.Radius + 1;
+	filter.B.assign(filter.Width*filter.Width, 0.0f);
+	for (int ry = -filter.Radius; ry <= filter.Radius; ry++)
+		for (int rx = -filter.Radius; rx <= filter.Radius; rx++)
+		{
+			double b = 0.0;
+			for (int j = -radius; j <= radius; j++)
+				for (int i = -radius; i <= radius; i++)
+				{
+					int i2 = i + rx;
+					int j2 = j + ry;
+					if ((i2 < -radius) || (i2 > radius) || (j2 < -radius) || (j2 > radius))
+						continue;
+					b += k[(j+radius)*size + (i+radius)] * k[(j2+radius)*size + (i2+radius)];
+				}
+			filter.B[(ry+filter.Radius)*filter.Width + (rx+filter.Radius)] = float(b);
+		}
+	filter.B0 = filter.B[filter.Radius*filter.Width + filter.Radius];
+}
+
+
+void Viewer::SpatialQuantizer::BuildCells(Palette& pal)
+{
+	// For any point in a cell the nearest colour is at most d + h away, where d is the distance from the cell centre
+	// to its nearest colour and h is the half diagonal. A colour more than d + 2h from the centre can't beat that.
+	const float cellSize = float(1 << CellBits);
+	const float halfDiagonal = 0.5f*cellSize*tSqrt(3.0f);
+	std::vector<std::vector<uint8>> sliceCandidates(CellsPerAxis);
+	std::vector<int> counts(NumCells);
+
+	WorkPool::ParallelFor
+	(
+		CellsPerAxis, 1,
+		[&](int begin, int end)
+		{
+			std::vector<float> dist(pal.NumColours);
+			for (int cr = begin; cr < end; cr++)
+			{
+				std::vector<uint8>& candidates = sliceCandidates[cr];
+				candidates.clear();
+				for (int cg = 0; cg < CellsPerAxis; cg++)
+					for (int cb = 0; cb < CellsPerAxis; cb++)
+					{
+						float r = (float(cr) + 0.5f)*cellSize;
+						float g = (float(cg) + 0.5f)*cellSize;
+						float b = (float(cb) + 0.5f)*cellSize;
+						float nearest = 1.0e30f;
+						for (int c = 0; c < pal.NumColours; c++)
+						{
+							const float* colour = &pal.Colours[c*3];
+							float dr = colour[0] - r;	float dg = colour[1] - g;	float db = colour[2] - b;
+							dist[c] = dr*dr + dg*dg + db*db;
+							nearest = tMin(nearest, dist[c]);
+						}
+
+						float reach = tSqrt(nearest) + 2.0f*halfDiagonal;
+						reach *= reach;
+						int count = 0;
+						for (int c = 0; c < pal.NumColours; c++)
+						{
+							if (dist[c] <= reach)
+							{
+								candidates.push_back(uint8(c));
+								count++;
+							}
+						}
+						counts[(cr*CellsPerAxis + cg)*CellsPerAxis + cb] = count;
+					}
+			}
+		}
+	);
+
+	pal.CellStart.resize(NumCells+1);
+	pal.CellStart[0] = 0;
+	for (int c = 0; c < NumCells; c++)
+		pal.CellStart[c+1] = pal.CellStart[c] + counts[c];
+	pal.Candidates.clear();
+	pal.Candidates.reserve(pal.CellStart[NumCells]);
+	for (const std::vector<uint8>& candidates : sliceCandidates)
+		pal.Candidates.insert(pal.Candidates.end(), candidates.begin(), candidates.end());
+}
+
+
+int Viewer::SpatialQuantizer::FindNearest(const Palette& pal, float r, float g, float b)
+{
+	// Dithering targets may lie outside the RGB cube. They use the cell of the closest point inside it, which may
+	// rarely miss the true nearest colour but never gives an invalid one.
+	int cr = tClamp(int(r), 0, 255) >> CellBits;
+	int cg = tClamp(int(g), 0, 255) >> CellBits;
+	int cb = tClamp(int(b), 0, 255) >> CellBits;
+	int cell = (cr*CellsPerAxis + cg)*CellsPerAxis + cb;
+
+	int best = 0;
+	float bestDist = 1.0e30f;
+	for (int c = pal.CellStart[cell]; c < pal.CellStart[cell+1]; c++)
+	{
+		int index = pal.Candidates[c];
+		const float* colour = &pal.Colours[index*3];
+		float dr = colour[0] - r;	float dg = colour[1] - g;	float db = colour[2] - b;
+		float dist = dr*dr + dg*dg + db*db;
+		if (dist < bestDist)
+		{
+			bestDist = dist;
+			best = index;
+		}
+	}
+	return best;
+}
+
+
+bool Viewer::SpatialQuantizer::InitPalette(Palette& pal, const Level& level, int numColours, int ignoreAlpha)
+{
+	// Wu is fast and gives a good starting palette. It is run on a reduced copy and its colours taken as the start.
+	tPicture picture(level.W, level.H, (tPixel4b*)level.Pixels, true);
+	if (!picture.QuantizeWu(numColours, false))
+		return false;
+
+	std::vector<uint32> colours;
+	colours.reserve(int64(level.W)*level.H);
+	for (int pass = 0; (pass < 2) && colours.empty(); pass++)
+	{
+		// If every pixel is ignored they all count, so there is still a palette.
+		for (int p = 0; p < level.W*level.H; p++)
+		{
+			if ((pass == 0) && IsIgnored(level.Pixels[p], ignoreAlpha))
+				continue;
+			const tPixel4b& pixel = picture.GetPixels()[p];
+			colours.push_back((uint32(pixel.R) << 16) | (uint32(pixel.G) << 8) | uint32(pixel.B));
+		}
+	}
+	std::sort(colours.begin(), colours.end());
+	colours.erase(std::unique(colours.begin(), colours.end()), colours.end());
+	if (colours.empty())
+		return false;
+
+	pal.NumColours = tMin(int(colours.size()), numColours);
+	pal.Colours.resize(pal.NumColours*3);
+	for (int c = 0; c < pal.NumColours; c++)
+	{
+		pal.Colours[c*3 + 0] = float((colours[c] >> 16) & 0xFF);
+		pal.Colours[c*3 + 1] = float((colours[c] >> 8) & 0xFF);
+		pal.Colours[c*3 + 2] = float(colours[c] & 0xFF);
+	}
+	BuildCells(pal);
+	return true;
+}
+
+
+void Viewer::SpatialQuantizer::MapIgnored(Level& level, const Solver& solver)
+{
+	// Ignored pixels take no part in the error so they simply take the nearest colour.
+	WorkPool::ParallelFor
+	(
+		level.H, tMax(64*1024 / level.W, 1),
+		[&](int begin, int end)
+		{
+			for (int y = begin; y < end; y++)
+				for (int x = 0; x < level.W; x++)
+				{
+					int64 p = int64(y)*level.W + x;
+					const tPixel4b& pixel = level.Pixels[p];
+					if (!IsIgnored(pixel, solver.IgnoreAlpha))
+						continue;
+					level.Index[p] = uint8(FindNearest(solver.Pal, float(pixel.R), float(pixel.G), float(pixel.B)));
+				}
+		}
+	);
+}
+
+
+void Viewer::SpatialQuantizer::Diffuse(Level& level, const Solver& solver)
+{
+	// A Floyd-Steinberg pass inside each tile gives a mapping already close to a dithered optimum, far closer than
+	// the upsampled mapping of the level below. The tiles don't pass error between them so they all run at once and
+	// the result doesn't depend on the thread count. The sweeps clean up the seams.
+	const Palette& pal = solver.Pal;
+	int tilesX = (level.W + TileSize - 1) / TileSize;
+	int tilesY = (level.H + TileSize - 1) / TileSize;
+	level.Index.resize(int64(level.W)*level.H);
+
+	WorkPool::ParallelFor
+	(
+		tilesX*tilesY, 1,
+		[&](int begin, int end)
+		{
+			// Two rows of carried error with a spare entry at each end.
+			const int rowFloats = (TileSize+2)*3;
+			std::vector<float> carried(rowFloats*2);
+			for (int t = begin; t < end; t++)
+			{
+				int x0 = (t % tilesX)*TileSize;		int x1 = tMin(x0 + TileSize, level.W);
+				int y0 = (t / tilesX)*TileSize;		int y1 = tMin(y0 + TileSize, level.H);
+				std::fill(carried.begin(), carried.end(), 0.0f);
+				for (int y = y0; y < y1; y++)
+				{
+					float* current = &carried[((y - y0) & 1)*rowFloats];
+					float* next = &carried[((y - y0 + 1) & 1)*rowFloats];
+					std::fill(next, next + rowFloats, 0.0f);
+					for (int x = x0; x < x1; x++)
+					{
+						int64 p = int64(y)*level.W + x;
+						const tPixel4b& pixel = level.Pixels[p];
+						if (IsIgnored(pixel, solver.IgnoreAlpha))
+						{
+							level.Index[p] = uint8(FindNearest(pal, float(pixel.R), float(pixel.G), float(pixel.B)));
+							continue;
+						}
+
+						float* e = &current[(x - x0 + 1)*3];
+						float* f = &next[(x - x0 + 1)*3];
+						float target[3] =
+						{
+							tClamp(float(pixel.R) + e[0], 0.0f, 255.0f),
+							tClamp(float(pixel.G) + e[1], 0.0f, 255.0f),
+							tClamp(float(pixel.B) + e[2], 0.0f, 255.0f)
+						};
+						int index = FindNearest(pal, target[0], target[1], target[2]);
+						level.Index[p] = uint8(index);
+						for (int c = 0; c < 3; c++)
+						{
+							float error = target[c] - pal.Colours[index*3 + c];
+							e[c+3] += error*(7.0f/16.0f);
+							f[c-3] += error*(3.0f/16.0f);
+							f[c]   += error*(5.0f/16.0f);
+							f[c+3] += error*(1.0f/16.0f);
+						}
+					}
+				}
+			}
+		}
+	);
+}
+
+
+int Viewer::SpatialQuantizer::SweepTile(Level& level, const Solver& solver, int tileX, int tileY, std::vector<float>& errors)
+{
+	// Changing pixel q to colour c alters the error by B0*|c - t|^2 plus a constant, where t = pixel(q) - H/B0 and H
+	// is the B weighted error of its neighbours. The best colour is the one nearest t. The errors of the tile and its
+	// border are gathered first, with ignored pixels as zero, so the sums don't look anything up.
+	const Filter& blur = solver.Blur;
+	const Palette& pal = solver.Pal;
+	const int w = level.W;
+	const int h = level.H;
+	const int radius = blur.Radius;
+	int x0 = tileX*TileSize;	int x1 = tMin(x0 + TileSize, w);
+	int y0 = tileY*TileSize;	int y1 = tMin(y0 + TileSize, h);
+	int ex0 = tMax(x0 - radius, 0);		int ex1 = tMin(x1 + radius, w);
+	int ey0 = tMax(y0 - radius, 0);		int ey1 = tMin(y1 + radius, h);
+	int ew = ex1 - ex0;
+	errors.resize(ew*(ey1 - ey0)*3);
+
+	for (int y = ey0; y < ey1; y++)
+		for (int x = ex0; x < ex1; x++)
+		{
+			int64 p = int64(y)*w + x;
+			const tPixel4b& pixel = level.Pixels[p];
+			float* e = &errors[((y - ey0)*ew + (x - ex0))*3];
+			if (IsIgnored(pixel, solver.IgnoreAlpha))
+			{
+				e[0] = e[1] = e[2] = 0.0f;
+				continue;
+			}
+			const float* colour = &pal.Colours[level.Index[p]*3];
+			e[0] = colour[0] - float(pixel.R);
+			e[1] = colour[1] - float(pixel.G);
+			e[2] = colour[2] - float(pixel.B);
+		}
+
+	int changes = 0;
+	float scale = 1.0f / blur.B0;
+	for (int y = y0; y < y1; y++)
+		for (int x = x0; x < x1; x++)
+		{
+			int64 p = int64(y)*w + x;
+			const tPixel4b& pixel = level.Pixels[p];
+			if (IsIgnored(pixel, solver.IgnoreAlpha))
+				continue;
+
+			// The sum includes the pixel itself, which is then taken off.
+			float* self = &errors[((y - ey0)*ew + (x - ex0))*3];
+			float hr = -blur.B0*self[0];	float hg = -blur.B0*self[1];	float hb = -blur.B0*self[2];
+			int ry0 = tMax(-radius, ey0 - y);	int ry1 = tMin(radius, ey1-1 - y);
+			int rx0 = tMax(-radius, ex0 - x);	int rx1 = tMin(radius, ex1-1 - x);
+			for (int ry = ry0; ry <= ry1; ry++)
+			{
+				const float* b = &blur.B[(ry + radius)*blur.Width + radius];
+				const float* e = self + ry*ew*3;
+				for (int rx = rx0; rx <= rx1; rx++)
+				{
+					hr += b[rx]*e[rx*3 + 0];
+					hg += b[rx]*e[rx*3 + 1];
+					hb += b[rx]*e[rx*3 + 2];
+				}
+			}
+
+			int index = FindNearest(pal, float(pixel.R) - hr*scale, float(pixel.G) - hg*scale, float(pixel.B) - hb*scale);
+			if (index != level.Index[p])
+			{
+				level.Index[p] = uint8(index);
+				const float* colour = &pal.Colours[index*3];
+				self[0] = colour[0] - float(pixel.R);
+				self[1] = colour[1] - float(pixel.G);
+				self[2] = colour[2] - float(pixel.B);
+				changes++;
+			}
+		}
+
+	return changes;
+}
+
+
+int Viewer::SpatialQuantizer::Sweep(Level& level, const Solver& solver, std::vector<uint8>& dirtyTiles)
+{
+	// The tiles are visited in four phases of every other tile in each direction. Tiles of one phase are a whole tile
+	// apart so they read and write disjoint pixels and can run at once, and each pixel sees the same neighbours
+	// whichever thread it is on. Only tiles next to a change last time are visited.
+	int tilesX = (level.W + TileSize - 1) / TileSize;
+	int tilesY = (level.H + TileSize - 1) / TileSize;
+	std::vector<int> changes(tilesX*tilesY, 0);
+
+	for (int phase = 0; phase < 4; phase++)
+	{
+		std::vector<int> tiles;
+		for (int ty = phase >> 1; ty < tilesY; ty += 2)
+			for (int tx = phase & 1; tx < tilesX; tx += 2)
+				if (dirtyTiles[ty*tilesX + tx])
+					tiles.push_back(ty*tilesX + tx);
+
+		WorkPool::ParallelFor
+		(
+			int(tiles.size()), 1,
+			[&](int begin, int end)
+			{
+				std::vector<float> errors;
+				for (int t = begin; (t < end) && !IsCancelled(solver); t++)
+					changes[tiles[t]] = SweepTile(level, solver, tiles[t] % tilesX, tiles[t] / tilesX, errors);
+			}
+		);
+	}
+
+	int total = 0;
+	for (int ty = 0; ty < tilesY; ty++)
+		for (int tx = 0; tx < tilesX; tx++)
+		{
+			total += changes[ty*tilesX + tx];
+			bool dirty = false;
+			for (int ny = tMax(ty-1, 0); ny <= tMin(ty+1, tilesY-1); ny++)
+				for (int nx = tMax(tx-1, 0); nx <= tMin(tx+1, tilesX-1); nx++)
+					dirty = dirty || (changes[ny*tilesX + nx] > 0);
+			dirtyTiles[ty*tilesX + tx] = dirty ? 1 : 0;
+		}
+
+	return total;
+}
+
+
+void Viewer::SpatialQuantizer::UpdatePalette(const Level& level, Solver& solver)
+{
+	// With the mapping fixed the error is quadratic in the colours and is least where M c = A for each channel, with
+	// M(k,l) the B weighted count of pixel pairs mapped to k and l, and A(k) the B weighted pixels around those mapped
+	// to k. M is symmetric positive semi-definite so Gauss-Seidel converges, starting from the current colours.
+	const Filter& blur = solver.Blur;
+	Palette& pal = solver.Pal;
+	const int n = pal.NumColours;
+	const int w = level.W;
+	const int h = level.H;
+	std::vector<double> bandM(int64(NumSumBands)*n*n, 0.0);
+	std::vector<double> bandA(int64(NumSumBands)*n*3, 0.0);
+	int bandRows = (h + NumSumBands - 1) / NumSumBands;
+
+	WorkPool::ParallelFor
+	(
+		NumSumBands, 1,
+		[&](int begin, int end)
+		{
+			for (int band = begin; band < end; band++)
+			{
+				double* m = &bandM[int64(band)*n*n];
+				double* a = &bandA[int64(band)*n*3];
+				for (int y = band*bandRows; y < tMin((band+1)*bandRows, h); y++)
+					for (int x = 0; x < w; x++)
+					{
+						int64 p = int64(y)*w + x;
+						if (IsIgnored(level.Pixels[p], solver.IgnoreAlpha))
+							continue;
+
+						int k = level.Index[p];
+						double* mk = &m[k*n];
+						double ar = 0.0;	double ag = 0.0;	double ab = 0.0;
+						int ry0 = tMax(-blur.Radius, -y);	int ry1 = tMin(blur.Radius, h-1-y);
+						int rx0 = tMax(-blur.Radius, -x);	int rx1 = tMin(blur.Radius, w-1-x);
+						for (int ry = ry0; ry <= ry1; ry++)
+						{
+							const float* b = &blur.B[(ry + blur.Radius)*blur.Width + blur.Radius];
+							int64 row = p + int64(ry)*w;
+							for (int rx = rx0; rx <= rx1; rx++)
+							{
+								const tPixel4b& neighbour = level.Pixels[row + rx];
+								if (IsIgnored(neighbour, solver.IgnoreAlpha))
+									continue;
+								mk[level.Index[row + rx]] += b[rx];
+								ar += b[rx]*neighbour.R;
+								ag += b[rx]*neighbour.G;
+								ab += b[rx]*neighbour.B;
+							}
+						}
+						a[k*3 + 0] += ar;
+						a[k*3 + 1] += ag;
+						a[k*3 + 2] += ab;
+					}
+			}
+		}
+	);
+
+	// The bands are added in order.
+	for (int band = 1; band < NumSumBands; band++)
+	{
+		for (int64 i = 0; i < int64(n)*n; i++)
+			bandM[i] += bandM[int64(band)*n*n + i];
+		for (int i = 0; i < n*3; i++)
+			bandA[i] += bandA[int64(band)*n*3 + i];
+	}
+
+	std::vector<double> colours(pal.Colours.begin(), pal.Colours.end());
+	for (int iter = 0; iter < PaletteIterations; iter++)
+	{
+		for (int k = 0; k < n; k++)
+		{
+			// Colours nothing maps to are kept as they are.
+			const double* mk = &bandM[int64(k)*n];
+			if (mk[k] <= 0.0)
+				continue;
+			for (int c = 0; c < 3; c++)
+			{
+				double sum = bandA[k*3 + c];
+				for (int l = 0; l < n; l++)
+					if (l != k)
+						sum -= mk[l]*colours[l*3 + c];
+				colours[k*3 + c] = tClamp(sum / mk[k], 0.0, 255.0);
+			}
+		}
+	}
+
+	for (int i = 0; i < n*3; i++)
+		pal.Colours[i] = float(colours[i]);
+	BuildCells(pal);
+}
+
+
+bool Viewer::SpatialQuantizer::IsOutOfTime(const Solver& solver)
+{
+	if (solver.OutOfBudget)
+		return true;
+	if (solver.TimeBudget <= 0.0f)
+		return false;
+	float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - solver.StartTime).count();
+	return elapsed >= solver.TimeBudget;
+}
+
+
+void Viewer::SpatialQuantizer::AddDone(Solver& solver, int64 work)
+{
+	if (!solver.Prog || (work <= 0))
+		return;
+	solver.Prog->AddDone(work);
+	solver.WorkDone += work;
+}
+
+
+void Viewer::SpatialQuantizer::Refine(Level& level, Solver& solver, int rounds, bool checkTime, int64 workPerRound)
+{
+	// Sweeps to convergence, then updates the palette and sweeps again, for the given number of rounds. Every palette
+	// update is followed by at least one sweep so the mapping suits the palette it ends with. The diffused mapping
+	// the level starts with is already complete, so running out of time before the first sweep is fine.
+	int tilesX = (level.W + TileSize - 1) / TileSize;
+	int tilesY = (level.H + TileSize - 1) / TileSize;
+	int converged = int(int64(level.W)*level.H / ConvergedFraction);
+
+	for (int round = 0; round <= rounds; round++)
+	{
+		if (round > 0)
+		{
+			if ((checkTime && IsOutOfTime(solver)) || IsCancelled(solver))
+				return;
+			UpdatePalette(level, solver);
+		}
+
+		std::vector<uint8> dirtyTiles(tilesX*tilesY, 1);
+		for (int sweep = 0; sweep < MaxSweeps; sweep++)
+		{
+			// After a palette update one sweep is always made so the mapping matches it.
+			if (((round == 0) || (sweep > 0)) && checkTime && IsOutOfTime(solver))
+				return;
+			if (IsCancelled(solver))
+				return;
+			if (Sweep(level, solver, dirtyTiles) <= converged)
+				break;
+		}
+		AddDone(solver, workPerRound);
+	}
+}
+
+
+bool Viewer::SpatialQuantizer::HasFewColours(const tPixel4b* pixels, int64 numPixels, int numColours)
+{
+	std::unordered_set<uint32> colours;
+	for (int64 p = 0; p < numPixels; p++)
+	{
+		colours.insert((uint32(pixels[p].R) << 16) | (uint32(pixels[p].G) << 8) | uint32(pixels[p].B));
+		if (int(colours.size()) > numColours)
+			return false;
+	}
+	return true;
+}
+
+
+bool Viewer::SpatialQuantizer::Quantize
+(
+	tPixel4b* pixels, int w, int h, const Params& params, bool checkExact, WorkPool::Progress* progress
+)
+{
+	if (!pixels || (w <= 0) || (h <= 0))
+		return false;
+
+	// A fixed budget buys whole refinement rounds. If it doesn't cover the start the levels in between and the full
+	// size sweeps are skipped, the same as running out of time.
+	int refinements = tMax(params.Refinements, 0);
+	bool outOfBudget = false;
+	if ((params.TimeBudget > 0.0f) && !params.WallClockBudget)
+	{
+		float start = 0.0f;
+		float perRefinement = 0.0f;
+		GetDurations(start, perRefinement, w, h, params);
+		float spare = params.TimeBudget - start;
+		outOfBudget = (spare < 0.0f);
+		if (perRefinement > 0.0f)
+			refinements = tMin(refinements, tMax(int(spare / perRefinement), 0));
+	}
+
+	// Roughly a third of the time goes on the smaller levels and the full size start, and the rest is shared evenly
+	// by the full size rounds. Work skipped for lack of time is counted at the end.
+	int64 totalWork = int64(h) * (2 + refinements);
+	if (progress)
+		progress->AddWork(totalWork);
+
+	int numColours = tClamp(params.NumColours, 2, 256);
+	if (checkExact && HasFewColours(pixels, int64(w)*h, numColours))
+	{
+		if (progress)
+			progress->AddDone(totalWork);
+		return true;
+	}
+
+	Solver solver;
+	solver.Prog = progress;
+	solver.StartTime = std::chrono::steady_clock::now();
+	solver.TimeBudget = params.WallClockBudget ? params.TimeBudget : 0.0f;
+	solver.OutOfBudget = outOfBudget;
+	solver.IgnoreAlpha = tClamp(params.IgnoreAlpha, -1, 255);
+	double ditherLevel = (params.DitherLevel > 0.0) ? params.DitherLevel : GetAutoDitherLevel(w, h, numColours);
+	ComputeFilter(solver.Blur, params.FilterSize, ditherLevel);
+
+	// Each level is a box halving of the one before. The smallest is solved fully and every larger one starts from
+	// its mapping, so most pixels are settled before the full size picture is touched.
+	std::vector<Level> levels(1);
+	levels[0].W = w;
+	levels[0].H = h;
+	levels[0].Pixels = pixels;
+	while ((tMax(levels.back().W, levels.back().H) > CoarsestSize) && (tMin(levels.back().W, levels.back().H) >= 2))
+	{
+		const Level& prev = levels.back();
+		Level next;
+		next.Pixels = (const tPixel4b*)Mipmap::ReduceBox((const uint8*)prev.Pixels, prev.W, prev.H);
+		next.W = prev.W / 2;
+		next.H = prev.H / 2;
+		levels.push_back(next);
+	}
+
+	int paletteLevel = 0;
+	while ((paletteLevel+1 < int(levels.size())) && (tMax(levels[paletteLevel].W, levels[paletteLevel].H) > PaletteLevelSize))
+		paletteLevel++;
+
+	bool ok = InitPalette(solver.Pal, levels[paletteLevel], numColours, solver.IgnoreAlpha);
+	if (ok)
+	{
+		// The smallest level settles the palette with several rounds. Each larger level starts from a diffused mapping
+		// with the palette so far and refines it once more, and the full size picture gets the requested rounds. Once
+		// out of time the levels in between are skipped and the full size picture keeps its diffused mapping.
+		for (int l = int(levels.size())-1; (l >= 0) && !IsCancelled(solver); l--)
+		{
+			Level& level = levels[l];
+			bool coarsest = (l == int(levels.size())-1);
+			if ((l > 0) && !coarsest && IsOutOfTime(solver))
+				continue;
+
+			if (l == 0)
+				AddDone(solver, h);
+			Diffuse(level, solver);
+			int rounds = coarsest ? CoarsestRounds : ((l > 0) ? 1 : refinements);
+			Refine(level, solver, rounds, !coarsest, (l == 0) ? int64(h) : 0);
+			if (l > 0)
+				level.Index = std::vector<uint8>();
+		}
+		ok = !IsCancelled(solver);
+	}
+
+	if (ok)
+	{
+		Level& full = levels[0];
+		MapIgnored(full, solver);
+		WorkPool::ParallelFor
+		(
+			h, tMax(64*1024 / w, 1),
+			[&](int begin, int end)
+			{
+				for (int64 p = int64(begin)*w; p < int64(end)*w; p++)
+				{
+					const float* colour = &solver.Pal.Colours[full.Index[p]*3];
+					pixels[p].R = uint8(tClamp(int(colour[0] + 0.5f), 0, 255));
+					pixels[p].G = uint8(tClamp(int(colour[1] + 0.5f), 0, 255));
+					pixels[p].B = uint8(tClamp(int(colour[2] + 0.5f), 0, 255));
+				}
+			}
+		);
+		AddDone(solver, totalWork - solver.WorkDone);
+	}
+
+	for (int l = 1; l < int(levels.size()); l++)
+		delete[] (uint8*)levels[l].Pixels;
+	return ok;
+}
+
+
+bool Viewer::SpatialQuantizer::Quantize(tPicture& picture, const Params& params, bool checkExact, WorkPool::Progress* progress)
+{
+	if (!picture.IsValid())
+		return false;
+	return Quantize(picture.GetPixels(), picture.GetWidth(), picture.GetHeight(), params, checkExact, progress);
+}
+
+
+void Viewer::SpatialQuantizer::GetDurations(float& start, float& perRefinement, int w, int h, const Params& params)
+{
+	// Measured on a single core in seconds per megapixel, for the start and for each refinement.
+	switch (tClamp(params.FilterSize, 1, 5) / 2)
+	{
+		case 0:		start = 0.25f;	perRefinement = 0.08f;	break;
+		case 1:		start = 0.8f;	perRefinement = 0.3f;	break;
+		default:	start = 1.7f;	perRefinement = 1.1f;	break;
+	}
+	float megapixels = float(w) * float(h) / (1024.0f*1024.0f);
+	start *= megapixels;
+	perRefinement *= megapixels;
+}
+
+
+float Viewer::SpatialQuantizer::EstimateDuration(int w, int h, const Params& params, int numThreads)
+{
+	// The sweeps and sums split well so the time is shared evenly between the threads.
+	float start = 0.0f;
+	float perRefinement = 0.0f;
+	GetDurations(start, perRefinement, w, h, params);
+	if (numThreads <= 0)
+		numThreads = WorkPool::GetNumThreads();
+	float seconds = (start + perRefinement*float(tMax(params.Refinements, 0))) / float(tMax(numThreads, 1));
+	if (params.TimeBudget > 0.0f)
+		seconds = tMin(seconds, params.TimeBudget);
+	return seconds;
+}
+
+
+void Viewer::SpatialQuantizer::PrepareGIF(tList<tFrame>& frames, tImageGIF::SaveParams& params, float timeBudget)
+{
+	if (params.Method != tQuantize::Method::Spatial)
+		return;
+
+	// The GIF alpha rules: -1 makes pixels at or below 127 transparent if anything isn't opaque, and 255 is opaque.
+	int threshold = params.AlphaThreshold;
+	if (threshold < 0)
+	{
+		bool opaque = true;
+		for (tFrame* frame = frames.First(); frame && opaque; frame = frame->Next())
+			for (int p = 0; (p < frame->Width*frame->Height) && opaque; p++)
+				opaque = (frame->Pixels[p].A == 255);
+		threshold = opaque ? 255 : 127;
+	}
+	bool transparent = (threshold < 255);
+
+	int bits = tClamp(int(params.Format) - int(tPixelFormat::PAL1BIT) + 1, 1, 8);
+	Params quantize;
+	quantize.NumColours		= (1 << bits) - (transparent ? 1 : 0);
+	quantize.DitherLevel	= params.DitherLevel;
+	quantize.FilterSize		= params.FilterSize;
+	quantize.TimeBudget		= timeBudget;
+	quantize.IgnoreAlpha	= transparent ? threshold : -1;
+
+	// A transparent 1-bit GIF has a single colour, which is left to tacent.
+	if (quantize.NumColours < 2)
+		return;
+
+	for (tFrame* frame = frames.First(); frame; frame = frame->Next())
+		Quantize(frame->Pixels, frame->Width, frame->Height, quantize, true);
+	params.Method = tQuantize::Method::Wu;
+}
@@ -0,0 +1,78 @@
+// SpatialQuantizer.h
+//
+// Spatial colour quantization of RGBA8 pictures. Like the tacent (scolorq) quantizer it picks a palette and a pixel
+// to palette mapping that minimize the difference between the picture and the quantized result as seen through a
+// small blur, which is what produces the dithering. Instead of annealing the full size picture, the palette is settled
+// on a box-reduced pyramid from the smallest level up and every level starts from an error-diffused mapping, so the
+// full size picture only needs a few refining sweeps. Sweeps run on the work pool over tiles that are far enough apart
+// not to interact, and the result does not depend on the thread count.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tList.h>
+#include <Image/tPicture.h>
+#include <Image/tFrame.h>
+#include <Image/tImageGIF.h>
+#include "WorkPool.h"
+
+
+namespace Viewer
+{
+	namespace SpatialQuantizer
+	{
+		struct Params
+		{
+			// E [2, 256].
+			int NumColours												= 256;
+
+			// The same meaning as the tacent spatial quantizer. 0 picks a level from the picture size and number of
+			// colours. Larger values give coarser dithering patterns.
+			double DitherLevel											= 0.0;
+
+			// 1, 3, or 5. The width of the blur the error is measured through. 1 gives no dithering.
+			int FilterSize												= 3;
+
+			// How many palette refinements the full size picture gets. More costs time and gives a little more quality.
+			int Refinements												= 3;
+
+			// Seconds. Once used up no more refining sweeps are started and the result so far is kept. It is spent as a
+			// fixed number of refinement rounds at the single core rates EstimateDuration uses, so the result only
+			// depends on the picture and these params. 0 means no limit.
+			float TimeBudget											= 0.0f;
+
+			// Measures the budget on the clock instead. It then fits the machine, which suits interactive use, but the
+			// result depends on machine speed and load.
+			bool WallClockBudget										= false;
+
+			// Pixels with alpha at or below this are left out when choosing the palette and measuring the error, as
+			// they will not be seen. -1 means every pixel counts.
+			int IgnoreAlpha												= -1;
+		};
+
+		// Quantizes the RGB of every pixel to at most NumColours colours. Alpha is not changed. If checkExact is true
+		// and the picture already has NumColours or fewer colours it is left alone. The frame duration is kept. If the
+		// progress is cancelled false is returned and the picture is left unchanged.
+		bool Quantize(tImage::tPicture&, const Params&, bool checkExact = true, WorkPool::Progress* = nullptr);
+
+		// Same as above working directly on w*h pixels.
+		bool Quantize(tPixel4b* pixels, int w, int h, const Params&, bool checkExact = true, WorkPool::Progress* = nullptr);
+
+		// A rough number of seconds Quantize takes for a w by h picture when run on numThreads threads, never more than
+		// the budget. Zero threads means as many as the work pool has.
+		float EstimateDuration(int w, int h, const Params&, int numThreads = 0);
+
+		// Call before saving a GIF. If the params ask for the spatial method the frames are quantized here, to as many
+		// colours as the GIF format holds less one for transparency, and the params are switched to Wu, which finds
+		// the colours already fit and keeps them exactly. Otherwise nothing is changed. The budget is per frame.
+		void PrepareGIF(tList<tImage::tFrame>& frames, tImage::tImageGIF::SaveParams&, float timeBudget = 0.0f);
+	}
+}
@@ -0,0 +1,846 @@
+// StreamTIFF.cpp
+//
+// Out-of-core reading and writing of tiff files too big to load as one picture. The first page is decoded a strip or
+// tile at a time straight into a TileStore, and a TileStore is written out a band of rows at a time, so only a strip's
+// worth of pixels is ever in memory. Reading supports 8-bit chunky grey, grey-alpha, RGB and RGBA pages stored in
+// strips or tiles with no compression, PackBits, or LZW, in classic or BigTIFF files. Files are written uncompressed
+// as RGBA, using BigTIFF only when the pixels don't fit in 4GB.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <vector>
+#ifdef PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <System/tFile.h>
+#include <System/tPrint.h>
+#include "StreamTIFF.h"
+using namespace tMath;
+
+
+namespace Viewer
+{
+	namespace StreamTIFF
+	{
+		// The files are far bigger than a 32-bit seek can reach, so reads are positioned with the platform calls.
+		struct File
+		{
+			#ifdef PLATFORM_WINDOWS
+			HANDLE Handle						= INVALID_HANDLE_VALUE;
+			#else
+			int Descriptor						= -1;
+			#endif
+		};
+		File* OpenFile(const tString& filename, bool write);
+		void CloseFile(File*);
+		bool ReadAt(File*, int64 offset, void* data, int64 numBytes);
+		bool WriteBytes(File*, const void* data, int64 numBytes);
+		const int64 MaxChunkBytes				= 64*1024*1024;
+
+		// A terapixel. Rows are read whole, so this also bounds the row buffers a corrupt header can ask for.
+		const int MaxDim						= 1024*1024;
+
+		enum CompressionScheme
+		{
+			Compression_None					= 1,
+			Compression_LZW						= 5,
+			Compression_PackBits				= 32773
+		};
+
+		// What the loader needs from the first IFD.
+		struct Layout
+		{
+			bool LittleEndian					= true;
+			bool BigTIFF						= false;
+			int Width							= 0;
+			int Height							= 0;
+			int SamplesPerPixel					= 1;
+			int Compression						= Compression_None;
+			int Photometric						= -1;
+			int Predictor						= 1;
+			bool AssociatedAlpha				= false;	// Premultiplied. Converted to straight alpha on load.
+
+			// Strips are full-width chunks of RowsPerStrip rows. Tiles are used instead if TileWidth is non-zero. The
+			// offsets and byte counts are for whichever one the file uses.
+			int RowsPerStrip					= 0;
+			int TileWidth						= 0;
+			int TileHeight						= 0;
+			std::vector<uint64> Offsets;
+			std::vector<uint64> ByteCounts;
+		};
+		bool ReadLayout(File*, Layout&);
+		bool ReadValues(File*, const Layout&, const uint8* entry, std::vector<uint64>& values);
+		uint64 GetValue(const Layout&, const uint8* data, int numBytes);
+
+		// Streams the bytes of one strip or tile, decompressing as it goes. Read fills dst completely and returns false
+		// if the data ran out first or was malformed. Successive reads continue where the last one stopped.
+		class Decoder
+		{
+		public:
+			Decoder(File* file, uint64 offset, uint64 numBytes, int compression)								: Source(file), Offset(offset), Remaining(numBytes), Compression(compression) { }
+			bool Read(uint8* dst, int64 numBytes);
+
+		private:
+			bool Fill();
+			bool NextByte(uint8& byte)																		{ if ((Pos >= Count) && !Fill()) return false; byte = Buffer[Pos++]; return true; }
+			bool ReadNone(uint8* dst, int64 numBytes);
+			bool ReadPackBits(uint8* dst, int64 numBytes);
+			bool ReadLZW(uint8* dst, int64 numBytes);
+			int NextCode();
+			void ResetTable();
+
+			StreamTIFF::File* Source;
+			uint64 Offset;
+			uint64 Remaining;
+			int Compression;
+			std::vector<uint8> Buffer;
+			int Pos								= 0;
+			int Count							= 0;
+
+			// PackBits state. A literal or repeat run may span two reads.
+			int Literal							= 0;
+			int Repeat							= 0;
+			uint8 RepeatByte					= 0;
+
+			// LZW state. Codes are MSB first and the width goes up one code early, as tiff writers do. Decoded strings
+			// are built in Pending and copied out as there is room.
+			static const int ClearCode			= 256;
+			static const int EndCode			= 257;
+			static const int MaxCodes			= 4096;
+			std::vector<uint16> Prefix;
+			std::vector<uint8> Suffix;
+			std::vector<uint16> Length;
+			uint8 Pending[MaxCodes];
+			int PendingPos						= 0;
+			int PendingCount					= 0;
+			int NumCodes						= 0;
+			int CodeWidth						= 9;
+			int OldCode							= -1;
+			uint32 Bits							= 0;
+			int NumBits							= 0;
+			bool Ended							= false;
+		};
+
+		bool LoadStrips(File*, const Layout&, TileStore&);
+		bool LoadTiles(File*, const Layout&, TileStore&);
+
+		// Undoes horizontal differencing (predictor 2) on one row in place.
+		void Unpredict(uint8* row, int width, int samplesPerPixel);
+		void ToRGBA(tPixel4b* dst, const uint8* src, int numPixels, const Layout&);
+
+		// Builds the little-endian IFD for Save.
+		class IFDWriter
+		{
+		public:
+			IFDWriter(bool bigTIFF)																			: BigTIFF(bigTIFF) { }
+			void Put16(uint32 v)																			{ Bytes.push_back(uint8(v)); Bytes.push_back(uint8(v >> 8)); }
+			void Put32(uint32 v)																			{ Put16(v & 0xFFFF); Put16(v >> 16); }
+			void Put64(uint64 v)																			{ Put32(uint32(v)); Put32(uint32(v >> 32)); }
+			void PutOffset(uint64 v)																		{ if (BigTIFF) Put64(v); else Put32(uint32(v)); }
+
+			// The value is left-justified in the field. Little-endian makes that the low bytes.
+			void PutEntry(int tag, int type, uint64 count, uint64 value)									{ Put16(tag); Put16(type); PutOffset(count); PutOffset(value); }
+			std::vector<uint8> Bytes;
+
+		private:
+			bool BigTIFF;
+		};
+	}
+}
+
+
+Viewer::StreamTIFF::File* Viewer::StreamTIFF::OpenFile(const tString& filename, bool write)
+{
+	File* file = new File;
+
+	#ifdef PLATFORM_WINDOWS
+	file->Handle = CreateFileA
+	(
+		filename.Chr(), write ? GENERIC_WRITE : GENERIC_READ, write ? 0 : FILE_SHARE_READ, nullptr,
+		write ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+	);
+	if (file->Handle == INVALID_HANDLE_VALUE)
+	{
+		delete file;
+		return nullptr;
+	}
+	#else
+	file->Descriptor = write ? open(filename.Chr(), O_WRONLY | O_CREAT | O_TRUNC, 0644) : open(filename.Chr(), O_RDONLY);
+	if (file->Descriptor < 0)
+	{
+		delete file;
+		return nullptr;
+	}
+	#endif
+
+	return file;
+}
+
+
+void Viewer::StreamTIFF::CloseFile(File* file)
+{
+	#ifdef PLATFORM_WINDOWS
+	CloseHandle(file->Handle);
+	#else
+	close(file->Descriptor);
+	#endif
+	delete file;
+}
+
+
+bool Viewer::StreamTIFF::ReadAt(File* file, int64 offset, void* data, int64 numBytes)
+{
+	uint8* dst = (uint8*)data;
+	while (numBytes > 0)
+	{
+		int64 chunk = tMin(numBytes, MaxChunkBytes);
+		#ifdef PLATFORM_WINDOWS
+		OVERLAPPED overlapped = { };
+		overlapped.Offset = DWORD(offset & 0xFFFFFFFF);
+		overlapped.OffsetHigh = DWORD(offset >> 32);
+		DWORD read = 0;
+		if (!ReadFile(file->Handle, dst, DWORD(chunk), &read, &overlapped) || (read == 0))
+			return false;
+		#else
+		ssize_t read = pread(file->Descriptor, dst, size_t(chunk), off_t(offset));
+		if (read <= 0)
+			return false;
+		#endif
+		dst += read;
+		offset += read;
+		numBytes -= read;
+	}
+	return true;
+}
+
+
+bool Viewer::StreamTIFF::WriteBytes(File* file, const void* data, int64 numBytes)
+{
+	const uint8* src = (const uint8*)data;
+	while (numBytes > 0)
+	{
+		int64 chunk = tMin(numBytes, MaxChunkBytes);
+		#ifdef PLATFORM_WINDOWS
+		DWORD written = 0;
+		if (!WriteFile(file->Handle, src, DWORD(chunk), &written, nullptr) || (written == 0))
+			return false;
+		#else
+		ssize_t written = write(file->Descriptor, src, size_t(chunk));
+		if (written <= 0)
+			return false;
+		#endif
+		src += written;
+		numBytes -= written;
+	}
+	return true;
+}
+
+
+uint64 Viewer::StreamTIFF::GetValue(const Layout& layout, const uint8* data, int numBytes)
+{
+	uint64 value = 0;
+	for (int b = 0; b < numBytes; b++)
+		value |= uint64(data[layout.LittleEndian ? b : (numBytes-1-b)]) << (8*b);
+	return value;
+}
+
+
+bool Viewer::StreamTIFF::ReadValues(File* file, const Layout& layout, const uint8* entry, std::vector<uint64>& values)
+{
+	int type = int(GetValue(layout, entry+2, 2));
+	int typeBytes = 0;
+	switch (type)
+	{
+		case 1:		typeBytes = 1;	break;		// BYTE
+		case 3:		typeBytes = 2;	break;		// SHORT
+		case 4:		typeBytes = 4;	break;		// LONG
+		case 16:	typeBytes = 8;	break;		// LONG8. BigTIFF only.
+		default:	return false;
+	}
+
+	// The value field holds the data itself if it fits, otherwise the offset to it. The cap stops a corrupt count
+	// from allocating without bound. It still allows one strip per row of a 100K tall image many times over.
+	int fieldBytes = layout.BigTIFF ? 8 : 4;
+	uint64 count = GetValue(layout, entry+4, fieldBytes);
+	const uint8* field = entry + 4 + fieldBytes;
+	if ((count == 0) || (count > 16*1024*1024))
+		return false;
+
+	int64 numBytes = int64(count)*typeBytes;
+	std::vector<uint8> data(numBytes);
+	if (numBytes <= fieldBytes)
+		tStd::tMemcpy(data.data(), field, int(numBytes));
+	else if (!ReadAt(file, int64(GetValue(layout, field, fieldBytes)), data.data(), numBytes))
+		return false;
+
+	values.resize(size_t(count));
+	for (uint64 v = 0; v < count; v++)
+		values[v] = GetValue(layout, data.data() + v*typeBytes, typeBytes);
+	return true;
+}
+
+
+bool Viewer::StreamTIFF::ReadLayout(File* file, Layout& layout)
+{
+	uint8 header[16];
+	if (!ReadAt(file, 0, header, 8))
+		return false;
+
+	if ((header[0] == 'I') && (header[1] == 'I'))
+		layout.LittleEndian = true;
+	else if ((header[0] == 'M') && (header[1] == 'M'))
+		layout.LittleEndian = false;
+	else
+		return false;
+
+	// 42 is a classic tiff and 43 a BigTIFF, which has 8-byte offsets, counts, and IFD entry counts.
+	uint64 ifdOffset = 0;
+	int version = int(GetValue(layout, header+2, 2));
+	if (version == 42)
+	{
+		ifdOffset = GetValue(layout, header+4, 4);
+	}
+	else if (version == 43)
+	{
+		if (!ReadAt(file, 8, header+8, 8) || (GetValue(layout, header+4, 2) != 8))
+			return false;
+		layout.BigTIFF = true;
+		ifdOffset = GetValue(layout, header+8, 8);
+	}
+	else
+	{
+		return false;
+	}
+
+	int countBytes = layout.BigTIFF ? 8 : 2;
+	int entryBytes = layout.BigTIFF ? 20 : 12;
+	uint8 countData[8];
+	if ((ifdOffset == 0) || !ReadAt(file, int64(ifdOffset), countData, countBytes))
+		return false;
+	uint64 numEntries = GetValue(layout, countData, countBytes);
+	if ((numEntries == 0) || (numEntries > 4096))
+		return false;
+	std::vector<uint8> ifd(numEntries*entryBytes);
+	if (!ReadAt(file, int64(ifdOffset) + countBytes, ifd.data(), int64(ifd.size())))
+		return false;
+
+	bool bitsOK = true;
+	int planar = 1;
+	std::vector<uint64> values;
+	for (uint64 e = 0; e < numEntries; e++)
+	{
+		const uint8* entry = ifd.data() + e*entryBytes;
+		int tag = int(GetValue(layout, entry, 2));
+		switch (tag)
+		{
+			case 256: case 257: case 258: case 259: case 262: case 273: case 277: case 278: case 279:
+			case 284: case 317: case 322: case 323: case 324: case 325: case 338:
+				break;
+			default:
+				continue;
+		}
+
+		if (!ReadValues(file, layout, entry, values))
+			return false;
+		uint64 value = values[0];
+		switch (tag)
+		{
+			case 256:	layout.Width = int(tMin(value, uint64(0x7FFFFFFF)));		break;
+			case 257:	layout.Height = int(tMin(value, uint64(0x7FFFFFFF)));		break;
+			case 258:	for (uint64 v : values) bitsOK = bitsOK && (v == 8);		break;
+			case 259:	layout.Compression = int(value);							break;
+			case 262:	layout.Photometric = int(value);							break;
+			case 273:	case 324:	layout.Offsets = values;						break;
+			case 277:	layout.SamplesPerPixel = int(value);						break;
+			case 278:	layout.RowsPerStrip = int(tMin(value, uint64(0x7FFFFFFF)));	break;
+			case 279:	case 325:	layout.ByteCounts = values;						break;
+			case 284:	planar = int(value);										break;
+			case 317:	layout.Predictor = int(value);								break;
+			case 322:	layout.TileWidth = int(tMin(value, uint64(0x7FFFFFFF)));	break;
+			case 323:	layout.TileHeight = int(tMin(value, uint64(0x7FFFFFFF)));	break;
+			case 338:	layout.AssociatedAlpha = (value == 1);						break;
+		}
+	}
+
+	if ((layout.Width <= 0) || (layout.Height <= 0) || (layout.Width > MaxDim) || (layout.Height > MaxDim))
+		return false;
+	if (!bitsOK || ((planar != 1) && (layout.SamplesPerPixel > 1)))
+		return false;
+	if ((layout.Compression != Compression_None) && (layout.Compression != Compression_LZW) && (layout.Compression != Compression_PackBits))
+		return false;
+	if ((layout.Predictor != 1) && (layout.Predictor != 2))
+		return false;
+
+	// Grey is 0 (white is zero) or 1 (black is zero), with an optional alpha. Palette, CMYK, and YCbCr pages need the
+	// full loader.
+	bool grey = ((layout.Photometric == 0) || (layout.Photometric == 1)) && (layout.SamplesPerPixel >= 1) && (layout.SamplesPerPixel <= 2);
+	bool rgb = (layout.Photometric == 2) && (layout.SamplesPerPixel >= 3) && (layout.SamplesPerPixel <= 4);
+	if (!grey && !rgb)
+		return false;
+
+	// Each tile or strip is decoded whole in memory, so a tile is limited to a band's worth of bytes.
+	size_t numChunks = 0;
+	if (layout.TileWidth || layout.TileHeight)
+	{
+		if ((layout.TileWidth <= 0) || (layout.TileHeight <= 0) || (int64(layout.TileWidth)*layout.TileHeight*layout.SamplesPerPixel > BandBytes*4))
+			return false;
+		int64 tilesX = (int64(layout.Width) + layout.TileWidth - 1) / layout.TileWidth;
+		int64 tilesY = (int64(layout.Height) + layout.TileHeight - 1) / layout.TileHeight;
+		numChunks = size_t(tilesX*tilesY);
+	}
+	else
+	{
+		if ((layout.RowsPerStrip <= 0) || (layout.RowsPerStrip > layout.Height))
+			layout.RowsPerStrip = layout.Height;
+		numChunks = size_t((int64(layout.Height) + layout.RowsPerStrip - 1) / layout.RowsPerStrip);
+	}
+
+	return (layout.Offsets.size() == numChunks) && (layout.ByteCounts.size() == numChunks);
+}
+
+
+bool Viewer::StreamTIFF::Decoder::Fill()
+{
+	if (Remaining == 0)
+		return false;
+
+	if (Buffer.empty())
+		Buffer.resize(64*1024);
+	int chunk = int(tMin(Remaining, uint64(Buffer.size())));
+	if (!ReadAt(Source, int64(Offset), Buffer.data(), chunk))
+		return false;
+	Offset += chunk;
+	Remaining -= chunk;
+	Pos = 0;
+	Count = chunk;
+	return true;
+}
+
+
+bool Viewer::StreamTIFF::Decoder::Read(uint8* dst, int64 numBytes)
+{
+	switch (Compression)
+	{
+		case Compression_None:		return ReadNone(dst, numBytes);
+		case Compression_PackBits:	return ReadPackBits(dst, numBytes);
+		case Compression_LZW:		return ReadLZW(dst, numBytes);
+	}
+	return false;
+}
+
+
+bool Viewer::StreamTIFF::Decoder::ReadNone(uint8* dst, int64 numBytes)
+{
+	while (numBytes > 0)
+	{
+		if ((Pos >= Count) && !Fill())
+			return false;
+		int span = int(tMin(numBytes, int64(Count - Pos)));
+		tStd::tMemcpy(dst, Buffer.data() + Pos, span);
+		Pos += span;
+		dst += span;
+		numBytes -= span;
+	}
+	return true;
+}
+
+
+bool Viewer::StreamTIFF::Decoder::ReadPackBits(uint8* dst, int64 numBytes)
+{
+	int64 n = 0;
+	while (n < numBytes)
+	{
+		if (Literal > 0)
+		{
+			if (!NextByte(dst[n++]))
+				return false;
+			Literal--;
+			continue;
+		}
+		if (Repeat > 0)
+		{
+			dst[n++] = RepeatByte;
+			Repeat--;
+			continue;
+		}
+
+		// 0 to 127 is a literal run of that many plus one bytes. -1 to -127 repeats the next byte one minus that
+		// many times. -128 is a no-op.
+		uint8 header = 0;
+		if (!NextByte(header))
+			return false;
+		int count = int(int8(header));
+		if (count >= 0)
+		{
+			Literal = count + 1;
+		}
+		else if (count != -128)
+		{
+			if (!NextByte(RepeatByte))
+				return false;
+			Repeat = 1 - count;
+		}
+	}
+	return true;
+}
+
+
+void Viewer::StreamTIFF::Decoder::ResetTable()
+{
+	NumCodes = EndCode + 1;
+	CodeWidth = 9;
+	OldCode = -1;
+}
+
+
+int Viewer::StreamTIFF::Decoder::NextCode()
+{
+	while (NumBits < CodeWidth)
+	{
+		uint8 byte = 0;
+		if (!NextByte(byte))
+			return EndCode;
+		Bits = (Bits << 8) | byte;
+		NumBits += 8;
+	}
+	NumBits -= CodeWidth;
+	int code = int(Bits >> NumBits) & ((1 << CodeWidth) - 1);
+	Bits &= (1u << NumBits) - 1;
+	return code;
+}
+
+
+bool Viewer::StreamTIFF::Decoder::ReadLZW(uint8* dst, int64 numBytes)
+{
+	if (Prefix.empty())
+	{
+		// The old LZW variant from before tiff 6 is LSB first. It starts with a clear code, which shows up as these
+		// two bytes. It is rare enough that those files are left to the full loader.
+		uint8 first = 0;
+		if (!NextByte(first))
+			return false;
+		if ((first == 0) && (Pos < Count) && (Buffer[Pos] & 0x01))
+			return false;
+		Pos--;
+
+		Prefix.resize(MaxCodes);
+		Suffix.resize(MaxCodes);
+		Length.resize(MaxCodes);
+		for (int c = 0; c < 256; c++)
+		{
+			Prefix[c] = 0;
+			Suffix[c] = uint8(c);
+			Length[c] = 1;
+		}
+		ResetTable();
+	}
+
+	int64 n = 0;
+	while (n < numBytes)
+	{
+		if (PendingPos < PendingCount)
+		{
+			int span = int(tMin(numBytes - n, int64(PendingCount - PendingPos)));
+			tStd::tMemcpy(dst + n, Pending + PendingPos, span);
+			PendingPos += span;
+			n += span;
+			continue;
+		}
+		if (Ended)
+			return false;
+
+		int code = NextCode();
+		if (code == EndCode)
+		{
+			Ended = true;
+			continue;
+		}
+		if (code == ClearCode)
+		{
+			ResetTable();
+			continue;
+		}
+
+		// A code one past the table is the string for the previous code plus its own first byte.
+		int stringCode = code;
+		bool extend = false;
+		if (code == NumCodes)
+		{
+			if (OldCode < 0)
+				return false;
+			stringCode = OldCode;
+			extend = true;
+		}
+		else if ((code > NumCodes) || ((OldCode < 0) && (code > 255)))
+		{
+			return false;
+		}
+
+		int length = Length[stringCode];
+		for (int i = length-1, c = stringCode; i >= 0; i--, c = Prefix[c])
+			Pending[i] = Suffix[c];
+		if (extend)
+		{
+			if (length >= MaxCodes)
+				return false;
+			Pending[length++] = Pending[0];
+		}
+		PendingPos = 0;
+		PendingCount = length;
+
+		if ((OldCode >= 0) && (NumCodes < MaxCodes))
+		{
+			Prefix[NumCodes] = uint16(OldCode);
+			Suffix[NumCodes] = Pending[0];
+			Length[NumCodes] = uint16(Length[OldCode] + 1);
+			NumCodes++;
+			if ((NumCodes >= (1 << CodeWidth) - 1) && (CodeWidth < 12))
+				CodeWidth++;
+		}
+		OldCode = code;
+	}
+	return true;
+}
+
+
+void Viewer::StreamTIFF::Unpredict(uint8* row, int width, int samplesPerPixel)
+{
+	int numBytes = width*samplesPerPixel;
+	for (int b = samplesPerPixel; b < numBytes; b++)
+		row[b] = uint8(row[b] + row[b - samplesPerPixel]);
+}
+
+
+void Viewer::StreamTIFF::ToRGBA(tPixel4b* dst, const uint8* src, int numPixels, const Layout& layout)
+{
+	int samples = layout.SamplesPerPixel;
+	for (int p = 0; p < numPixels; p++, src += samples)
+	{
+		tPixel4b& pixel = dst[p];
+		if (samples <= 2)
+		{
+			uint8 grey = (layout.Photometric == 0) ? uint8(255 - src[0]) : src[0];
+			pixel.R = pixel.G = pixel.B = grey;
+			pixel.A = (samples == 2) ? src[1] : 255;
+		}
+		else
+		{
+			pixel.R = src[0];
+			pixel.G = src[1];
+			pixel.B = src[2];
+			pixel.A = (samples == 4) ? src[3] : 255;
+		}
+
+		if (layout.AssociatedAlpha && (pixel.A > 0) && (pixel.A < 255))
+		{
+			int a = pixel.A;
+			pixel.R = uint8(tMin((pixel.R*255 + a/2) / a, 255));
+			pixel.G = uint8(tMin((pixel.G*255 + a/2) / a, 255));
+			pixel.B = uint8(tMin((pixel.B*255 + a/2) / a, 255));
+		}
+	}
+}
+
+
+bool Viewer::StreamTIFF::LoadStrips(File* file, const Layout& layout, TileStore& store)
+{
+	int64 rowBytes = int64(layout.Width)*layout.SamplesPerPixel;
+	int bandRows = int(tClamp(BandBytes / rowBytes, int64(1), int64(layout.RowsPerStrip)));
+	std::vector<uint8> raw(size_t(rowBytes*bandRows));
+	std::vector<tPixel4b> band(size_t(int64(layout.Width)*bandRows));
+
+	int numStrips = int(layout.Offsets.size());
+	for (int strip = 0; strip < numStrips; strip++)
+	{
+		int stripY = strip*layout.RowsPerStrip;
+		int stripRows = tMin(layout.RowsPerStrip, layout.Height - stripY);
+		Decoder decoder(file, layout.Offsets[strip], layout.ByteCounts[strip], layout.Compression);
+		for (int row = 0; row < stripRows; row += bandRows)
+		{
+			int numRows = tMin(bandRows, stripRows - row);
+			if (!decoder.Read(raw.data(), rowBytes*numRows))
+				return false;
+
+			// Tiff rows go top down. The store is bottom up.
+			for (int r = 0; r < numRows; r++)
+			{
+				uint8* src = raw.data() + rowBytes*r;
+				if (layout.Predictor == 2)
+					Unpredict(src, layout.Width, layout.SamplesPerPixel);
+				ToRGBA(band.data() + int64(layout.Width)*(numRows-1-r), src, layout.Width, layout);
+			}
+			store.WriteRegion(0, layout.Height - (stripY + row) - numRows, layout.Width, numRows, band.data());
+		}
+	}
+	return true;
+}
+
+
+bool Viewer::StreamTIFF::LoadTiles(File* file, const Layout& layout, TileStore& store)
+{
+	// Edge tiles are stored full size. Only the part inside the picture is kept.
+	int64 tileRowBytes = int64(layout.TileWidth)*layout.SamplesPerPixel;
+	std::vector<uint8> raw(size_t(tileRowBytes*layout.TileHeight));
+	std::vector<tPixel4b> pixels(size_t(int64(layout.TileWidth)*layout.TileHeight));
+
+	int tilesX = (layout.Width + layout.TileWidth - 1) / layout.TileWidth;
+	int numTiles = int(layout.Offsets.size());
+	for (int tile = 0; tile < numTiles; tile++)
+	{
+		Decoder decoder(file, layout.Offsets[tile], layout.ByteCounts[tile], layout.Compression);
+		if (!decoder.Read(raw.data(), int64(raw.size())))
+			return false;
+
+		int x = (tile % tilesX) * layout.TileWidth;
+		int y = (tile / tilesX) * layout.TileHeight;
+		int w = tMin(layout.TileWidth, layout.Width - x);
+		int h = tMin(layout.TileHeight, layout.Height - y);
+		for (int r = 0; r < h; r++)
+		{
+			uint8* src = raw.data() + tileRowBytes*r;
+			if (layout.Predictor == 2)
+				Unpredict(src, layout.TileWidth, layout.SamplesPerPixel);
+			ToRGBA(pixels.data() + w*(h-1-r), src, w, layout);
+		}
+		store.WriteRegion(x, layout.Height - y - h, w, h, pixels.data());
+	}
+	return true;
+}
+
+
+Viewer::TileStore* Viewer::StreamTIFF::Load(const tString& filename, const tString& scratchDir)
+{
+	File* file = OpenFile(filename, false);
+	if (!file)
+		return nullptr;
+
+	Layout layout;
+	if (!ReadLayout(file, layout))
+	{
+		tPrintf("StreamTIFF: %s uses a layout or compression that can't be streamed.\n", filename.Chr());
+		CloseFile(file);
+		return nullptr;
+	}
+
+	TileStore* store = new TileStore(layout.Width, layout.Height, TileSize, scratchDir);
+	bool loaded = store->IsValid() && (layout.TileWidth ? LoadTiles(file, layout, *store) : LoadStrips(file, layout, *store));
+	CloseFile(file);
+	if (!loaded)
+	{
+		tPrintf("StreamTIFF: Failed to read the pixels of %s.\n", filename.Chr());
+		delete store;
+		return nullptr;
+	}
+
+	return store;
+}
+
+
+bool Viewer::StreamTIFF::Save(const TileStore& store, const tString& filename)
+{
+	int width = store.GetWidth();
+	int height = store.GetHeight();
+	int64 rowBytes = int64(width)*int64(sizeof(tPixel4b));
+	int rowsPerStrip = int(tClamp(BandBytes / rowBytes, int64(1), int64(height)));
+	int numStrips = (height + rowsPerStrip - 1) / rowsPerStrip;
+	int64 dataBytes = rowBytes*height;
+
+	// The pixels go first so they can be written as they are read from the store. The IFD and the strip tables
+	// follow. Everything must be addressable with 32-bit offsets for a classic tiff.
+	const int numEntries = 11;
+	int64 tableBytes = int64(numStrips)*8*2 + 8;
+	bool bigTIFF = (16 + dataBytes + 256 + tableBytes) > int64(0xFFFFFFFF);
+	int headerBytes = bigTIFF ? 16 : 8;
+	int offsetBytes = bigTIFF ? 8 : 4;
+	int64 ifdOffset = headerBytes + dataBytes;
+	int64 ifdBytes = bigTIFF ? (8 + numEntries*20 + 8) : (2 + numEntries*12 + 4);
+
+	// Arrays that don't fit in an entry's value field follow the IFD. BigTIFF fits the 4 bits-per-sample inline.
+	int64 bitsOffset = ifdOffset + ifdBytes;
+	int64 stripOffsetsOffset = bitsOffset + (bigTIFF ? 0 : 8);
+	int64 byteCountsOffset = stripOffsetsOffset + int64(numStrips)*offsetBytes;
+
+	IFDWriter ifd(bigTIFF);
+	ifd.Bytes.push_back('I');
+	ifd.Bytes.push_back('I');
+	if (bigTIFF)
+	{
+		ifd.Put16(43);
+		ifd.Put16(8);
+		ifd.Put16(0);
+		ifd.Put64(uint64(ifdOffset));
+	}
+	else
+	{
+		ifd.Put16(42);
+		ifd.Put32(uint32(ifdOffset));
+	}
+
+	File* file = OpenFile(filename, true);
+	if (!file)
+		return false;
+
+	bool written = WriteBytes(file, ifd.Bytes.data(), int64(ifd.Bytes.size()));
+	std::vector<tPixel4b> band(size_t(int64(width)*rowsPerStrip));
+	for (int y = 0; (y < height) && written; y += rowsPerStrip)
+	{
+		int numRows = tMin(rowsPerStrip, height - y);
+		store.ReadRegion(0, height - y - numRows, width, numRows, band.data());
+		for (int r = numRows-1; (r >= 0) && written; r--)
+			written = WriteBytes(file, band.data() + int64(width)*r, rowBytes);
+	}
+
+	if (written)
+	{
+		// Types: 3 is SHORT, 4 is LONG, and 16 is LONG8. Tags must be in ascending order.
+		int offsetType = bigTIFF ? 16 : 4;
+		ifd.Bytes.clear();
+		if (bigTIFF)
+			ifd.Put64(numEntries);
+		else
+			ifd.Put16(numEntries);
+		ifd.PutEntry(256, 4, 1, uint64(width));
+		ifd.PutEntry(257, 4, 1, uint64(height));
+		ifd.PutEntry(258, 3, 4, bigTIFF ? 0x0008000800080008ull : uint64(bitsOffset));
+		ifd.PutEntry(259, 3, 1, Compression_None);
+		ifd.PutEntry(262, 3, 1, 2);
+		ifd.PutEntry(273, offsetType, numStrips, (numStrips == 1) ? uint64(headerBytes) : uint64(stripOffsetsOffset));
+		ifd.PutEntry(277, 3, 1, 4);
+		ifd.PutEntry(278, 4, 1, uint64(rowsPerStrip));
+		ifd.PutEntry(279, offsetType, numStrips, (numStrips == 1) ? uint64(dataBytes) : uint64(byteCountsOffset));
+		ifd.PutEntry(284, 3, 1, 1);
+		ifd.PutEntry(338, 3, 1, 2);
+		ifd.PutOffset(0);
+
+		if (!bigTIFF)
+			for (int s = 0; s < 4; s++)
+				ifd.Put16(8);
+		if (numStrips > 1)
+		{
+			for (int s = 0; s < numStrips; s++)
+				ifd.PutOffset(uint64(headerBytes + int64(s)*rowsPerStrip*rowBytes));
+			for (int s = 0; s < numStrips; s++)
+				ifd.PutOffset(uint64(tMin(rowsPerStrip, height - s*rowsPerStrip)*rowBytes));
+		}
+		written = WriteBytes(file, ifd.Bytes.data(), int64(ifd.Bytes.size()));
+	}
+	CloseFile(file);
+
+	if (!written)
+	{
+		tPrintf("StreamTIFF: Failed to write %s.\n", filename.Chr());
+		tSystem::tDeleteFile(filename);
+	}
+	return written;
+}
@@ -0,0 +1,39 @@
+// StreamTIFF.h
+//
+// Out-of-core reading and writing of tiff files too big to load as one picture. The first page is decoded a strip or
+// tile at a time straight into a TileStore, and a TileStore is written out a band of rows at a time, so only a strip's
+// worth of pixels is ever in memory. Reading supports 8-bit chunky grey, grey-alpha, RGB and RGBA pages stored in
+// strips or tiles with no compression, PackBits, or LZW, in classic or BigTIFF files. Files are written uncompressed
+// as RGBA, using BigTIFF only when the pixels don't fit in 4GB.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tString.h>
+#include "TileStore.h"
+
+
+namespace Viewer
+{
+	namespace StreamTIFF
+	{
+		const int TileSize						= 512;
+		const int64 BandBytes					= 4*1024*1024;	// Target size of the strips read or written at a time.
+
+		// Decodes the first page into a new store with its scratch file in scratchDir. Rows are bottom-up in the store,
+		// the same as a tPicture. Returns null if the page uses a layout or compression that isn't supported, the file
+		// is malformed, or the store could not be created.
+		TileStore* Load(const tString& filename, const tString& scratchDir);
+
+		// Writes the store as a single-page RGBA tiff. A partly written file is removed on failure.
+		bool Save(const TileStore&, const tString& filename);
+	}
+}
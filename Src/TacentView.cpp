@@ -47,6 +47,8 @@
 #include "TacentView.h"
 #include "GuiUtil.h"
 #include "Image.h"
+#include "MemoryManager.h"
+#include "MetaIndex.h"
 #include "ColourDialogs.h"
 #include "ImportRaw.h"
 #include "Dialogs.h"
@@ -56,10 +58,17 @@
 #include "ContactSheet.h"
 #include "MultiFrame.h"
 #include "ThumbnailView.h"
+#include "TextureUpload.h"
+#include "Mipmap.h"
+#include "EditJob.h"
+#include "UndoSpill.h"
+#include "WorkPool.h"
+#include "PixelKernels.h"
 #include "Crop.h"
 #include "Quantize.h"
 #include "Resize.h"
 #include "Rotate.h"
+#include "Renderer.h"
 #include "OpenSaveDialogs.h"
 #include "Config.h"
 #include "InputBindings.h"
@@ -199,7 +208,6 @@ namespace Viewer
 	tString ImagesDir;
 	tList<tStringItem> ImagesSubDirs;
 	tList<Image> Images;
-	tItList<Image> ImagesLoadTimeSorted(tListMode::External);		// We don't need static here cuz the list is only used after main().
 	tuint256 ImagesHash												= 0;
 	Image* CurrImage												= nullptr;
 	tString ImageToLoad;
@@ -249,6 +257,14 @@ namespace Viewer
 	bool ReticleVisibleOnSelect						= false;
 	bool WindowIconified							= false;
 
+	// Main loop idle control. See ComputeIdleWait.
+	const double SettleDuration						= 0.5;
+	const double IdleWaitMax						= 1.0;
+	const double MinFramePeriod						= 1.0/60.0;
+	double SettleCountdown							= SettleDuration;	// Keeps rendering for a while after any input. Re-armed by the input callbacks.
+	bool FrameWindowBusy							= false;			// Current image still has frames to compact.
+	bool TilesBusy									= false;			// Visible tiles of a huge image still missing.
+
 	bool Request_OpenFileModal						= false;
 	bool Request_OpenDirModal						= false;
 	bool Request_SaveCurrentModal					= false;
@@ -331,7 +347,6 @@ namespace Viewer
 	bool Compare_AlphabeticalAscending			(const tSystem::tFileInfo& a, const tSystem::tFileInfo& b)					{ return tStricmp(a.FileName.Chars(), b.FileName.Chars()) < 0; }
 	bool Compare_StringItemAlphabeticalAscending(const tStringItem& a, const tStringItem& b)								{ return tStricmp(a.Chars(), b.Chars()) < 0; }
 	bool Compare_FileCreationTimeAscending		(const tSystem::tFileInfo& a, const tSystem::tFileInfo& b)					{ return a.CreationTime < b.CreationTime; }
-	bool Compare_ImageLoadTimeAscending			(const Image& a, const Image& b)											{ return a.GetLoadedTime() < b.GetLoadedTime(); }
 
 	// This is a 'FunctionObject'. Basically an object that acts like a function. This is sorta cool as it allows state
 	// to be stored in the object. In this case we use it as the compare function for a Sort call. Instead of a
@@ -431,10 +446,14 @@ namespace Viewer
 	bool IgnoreNextCursorPosCallback = false;
 
 	void Update(GLFWwindow* window, double dt, bool dopoll = true);
+
+	// Returns how long the main loop may block waiting for events before something on screen needs to change. Zero
+	// means render the next frame immediately.
+	double ComputeIdleWait();
 	int  DoMainMenuBar();																								// Returns height.
 	int  GetNavBarHeight();
 	void DoNavBar(int dispWidth, int dispHeight, int barHeight);
-	void WindowRefreshFun(GLFWwindow* window)																			{ Update(window, 0.0, false); }
+	void WindowRefreshFun(GLFWwindow* window)																			{ SettleCountdown = SettleDuration; Update(window, 0.0, false); }
 	void KeyCallback(GLFWwindow*, int key, int scancode, int action, int modifiers);
 	void MouseButtonCallback(GLFWwindow*, int mouseButton, int x, int y);
 	void CursorPosCallback(GLFWwindow*, double x, double y);
@@ -488,8 +507,8 @@ bool Viewer::ImageCompareFunctionObject::operator() (const Image& a, const Image
 
 		case Config::ProfileData::SortKeyEnum::ImageArea:
 		{
-			int A = a.Cached_PrimaryArea;
-			int B = b.Cached_PrimaryArea;
+			int64 A = a.Cached_PrimaryArea;
+			int64 B = b.Cached_PrimaryArea;
 			return Ascending ? (A < B) : (A > B);
 		}
 
@@ -796,7 +815,6 @@ void Viewer::PopulateImagesSubDirs()
 void Viewer::PopulateImages()
 {
 	Images.Clear();
-	ImagesLoadTimeSorted.Clear();
 
 	tList<tSystem::tFileInfo> foundFiles;
 	ImagesDir = FindImagesInImageToLoadDir(foundFiles);
@@ -811,9 +829,11 @@ void Viewer::PopulateImages()
 		// It is important we don't call Load after newing. We save memory by not having all images loaded.
 		Image* newImg = new Image(*fileInfo);
 		Images.Append(newImg);
-		ImagesLoadTimeSorted.Append(newImg);
 	}
 
+	// Fills in the cached members from the directory meta-index so cached sort keys work right away.
+	MetaIndex::Open(ImagesDir, Images);
+
 	Config::ProfileData& profile = Config::GetProfileData();
 	SortImages(profile.GetSortKey(), profile.SortAscending);
 	CurrImage = nullptr;
@@ -890,19 +910,24 @@ void Viewer::AutoPropertyWindow()
 void Viewer::LoadCurrImage(bool forceReload)
 {
 	tAssert(CurrImage);
-	bool imgJustLoaded = false;
 
+	// Loading (or reloading) makes the image the most recently used. Already loaded images need the same treatment
+	// so they move to the front of the memory manager's LRU list.
 	if (!CurrImage->IsLoaded())
 	{
-		imgJustLoaded = CurrImage->Load();
+		CurrImage->Load();
 	}
 	else if (forceReload)
 	{
 		CurrImage->Unbind();
 		CurrImage->Unload(true);
-		imgJustLoaded = CurrImage->Load();
+		CurrImage->Load();
 		CurrImage->Bind();
 	}
+	else
+	{
+		MemoryManager::Touch(CurrImage);
+	}
 
 	AutoPropertyWindow();
 	Gutil::SetWindowTitle();
@@ -928,39 +953,6 @@ void Viewer::LoadCurrImage(bool forceReload)
 	ResetPan();
 	Request_CropLineConstrain = true;
 
-	// We only need to consider unloading an image when a new one is loaded... in this function.
-	// We currently do not allow unloading when in slideshow and the frame duration is small.
-	bool slideshowSmallDuration = SlideshowPlaying && (profile.SlideshowPeriod < 0.5f);
-	if (imgJustLoaded && !slideshowSmallDuration)
-	{
-		ImagesLoadTimeSorted.Sort(Compare_ImageLoadTimeAscending);
-
-		int64 usedMem = 0;
-		for (tItList<Image>::Iter iter = ImagesLoadTimeSorted.First(); iter; iter++)
-			usedMem += int64((*iter).Info.MemSizeBytes);
-
-		int64 allowedMem = int64(profile.MaxImageMemMB) * 1024 * 1024;
-		if (usedMem > allowedMem)
-		{
-			tPrintf("Used image mem (%|64d) bigger than max (%|64d). Unloading.\n", usedMem, allowedMem);
-			for (tItList<Image>::Iter iter = ImagesLoadTimeSorted.First(); iter; iter++)
-			{
-				Image* i = iter.GetObject();
-
-				// Never unload the current image.
-				if (i->IsLoaded() && (i != CurrImage))
-				{
-					tPrintf("Unloading %s freeing %d Bytes\n", tSystem::tGetFileName(i->Filename).Chr(), i->Info.MemSizeBytes);
-					usedMem -= i->Info.MemSizeBytes;
-					i->Unload();
-					if (usedMem < allowedMem)
-						break;
-				}
-			}
-			tPrintf("Used mem %|64dB out of max %|64dB.\n", usedMem, allowedMem);
-		}
-	}
-
 	ReticleVisibleOnSelect = false;
 }
 
@@ -1175,26 +1167,28 @@ bool Viewer::OnCopyToClipboard()
 	// the R G B or A to the clipboard where R=G=B, A=1). In non-intensity mode individual channels
 	// are copied to RGBA on the clipboard (R->R, G->G, etc) and unselected channels get the fill colour.
 	// Default is RGBA all checked and non-intensity mode.
+	tPixel4b* pixels = pict.GetPixels();
+	int64 numPixels = int64(pict.GetWidth())*pict.GetHeight();
 	if (Viewer::DrawChannel_AsIntensity)
 	{
 		if (Viewer::DrawChannel_R)
-			pict.Spread(tComp::R);
+			PixelKernels::Spread(pixels, numPixels, tComp::R);
 		else if (Viewer::DrawChannel_G)
-			pict.Spread(tComp::G);
+			PixelKernels::Spread(pixels, numPixels, tComp::G);
 		else if (Viewer::DrawChannel_B)
-			pict.Spread(tComp::B);
+			PixelKernels::Spread(pixels, numPixels, tComp::B);
 		else if (Viewer::DrawChannel_A)
-			pict.Spread(tComp::A);
+			PixelKernels::Spread(pixels, numPixels, tComp::A);
 
 		// Set alpha to full. We just want the intensity of the selected R, G, B, or A.
-		pict.SetAll(tColour4b::black, tCompBit_A);
+		PixelKernels::SetChannels(pixels, numPixels, tColour4b::black, tCompBit_A);
 	}
 	else
 	{
 		// This clipboard image has all the channels currently. We simply need to fill the
 		// unselected channels with the corresponding copy-fill-colour channel value.
 		comp_t fillChannels = (!Viewer::DrawChannel_R ? tCompBit_R : 0) | (!Viewer::DrawChannel_G ? tCompBit_G : 0) | (!Viewer::DrawChannel_B ? tCompBit_B : 0) | (!Viewer::DrawChannel_A ? tCompBit_A : 0);
-		pict.SetAll(profile.ClipboardCopyFillColour, fillChannels);
+		PixelKernels::SetChannels(pixels, numPixels, profile.ClipboardCopyFillColour, fillChannels);
 	}
 
 	clip::image_spec spec;
@@ -1435,9 +1429,22 @@ bool Viewer::OnPasteFromClipboard()
 	uint8* srcData = (uint8*)img.data();
 	tPixel4b* dstData = new tPixel4b[width*height];
 
+	// With 8 or 16 bit channels on byte boundaries every channel is a single byte of the source pixel, the most
+	// significant one for 16 bits, so whole rows can be converted at once. That covers all common formats.
+	bool byteAligned = (bpp != 16) && !(rshift % 8) && !(gshift % 8) && !(bshift % 8) && !(ashift % 8);
+	int highByte = (bpp == 64) ? 1 : 0;
+	int srcByte[4] = { rshift/8 + highByte, gshift/8 + highByte, bshift/8 + highByte, amask ? ashift/8 + highByte : -1 };
+
 	for (int y = 0; y < height; y++)
 	{
 		uint8* p = (srcData+bytesPerRow*y);
+		tPixel4b* dstRow = dstData + width*(height-1-y);
+		if (byteAligned)
+		{
+			PixelKernels::ConvertPacked(p, bytesPerPixel, dstRow, width, srcByte);
+			continue;
+		}
+
 		for (int x = 0; x < width; x++, p += bytesPerPixel)
 		{
 			tColour4b col;
@@ -1448,7 +1455,7 @@ bool Viewer::OnPasteFromClipboard()
 				case 32: col = GetClipboard32BPPColour( *((uint32*)p), rmask, rshift, gmask, gshift, bmask, bshift, amask, ashift);		break;
 				case 64: col = GetClipboard64BPPColour( *((uint64*)p), rmask, rshift, gmask, gshift, bmask, bshift, amask, ashift);		break;
 			}
-			dstData[width*(height-1-y) + x] = col;
+			dstRow[x] = col;
 		}
     }
 
@@ -1593,7 +1600,6 @@ bool Viewer::OnPasteFromClipboard()
 		//
 		Image* newImg = new Image(filename);
 		Images.Append(newImg);
-		ImagesLoadTimeSorted.Append(newImg);
 		SortImages(profile.GetSortKey(), profile.SortAscending);
 		SetCurrentImage(filename);
 
@@ -1889,81 +1895,15 @@ void Viewer::DrawBackground(float l, float r, float b, float t, float drawW, flo
 
 		case Config::ProfileData::BackgroundStyleEnum::Checkerboard:
 		{
-			// Semitransparent checkerboard background.
+			// Semitransparent checkerboard background. The checks are computed in the fragment shader so this is a
+			// single quad no matter how small the checks are. We only need to cover the visible part of the image
+			// extent, but the checks stay anchored to its lower-left corner.
 			float checkSize = float(profile.BackgroundCheckerboxSize);
-
-			// This is for efficiency. Why draw checrboxes where we don'e have to (off screen)?
-			// We cull in widths of 2*checkSize so the alternating checherbox colour works out.
-			if (l < 0.0f)
-			{
-				int numXhidden = int((0.0f-l) / (2.0f*checkSize));
-				l += float(numXhidden)*(2.0f*checkSize);
-			}
-			if (r >= drawW)
-			{
-				int numXhidden = int((r-drawW) / (2.0f*checkSize));
-				r -= float(numXhidden)*(2.0f*checkSize);
-			}
-
-			if (b < 0.0f)
-			{
-				int numYhidden = int((0.0f-b) / (2.0f*checkSize));
-				b += float(numYhidden)*(2.0f*checkSize);
-			}
-			if (t >= drawH)
-			{
-				int numYhidden = int((t-drawH) / (2.0f*checkSize));
-				t -= float(numYhidden)*(2.0f*checkSize);
-			}
-
-			int x = 0;
-			int y = 0;
-
-			bool lineStartToggle = false;
-			float bgH = t - b;
-			float bgW = r - l;
-			glBegin(GL_QUADS);
-
-			int numCheckQuads = 0;
-			while (y*checkSize < bgH)
-			{
-				bool colourToggle = lineStartToggle;
-
-				while (x*checkSize < bgW)
-				{
-					if (colourToggle)
-						glColor4f(0.3f, 0.3f, 0.35f, 1.0f);
-					else
-						glColor4f(0.4f, 0.4f, 0.45f, 1.0f);
-
-					colourToggle = !colourToggle;
-
-					float cw = checkSize;
-					if ((x+1)*checkSize > bgW)
-						cw -= (x+1)*checkSize - bgW;
-
-					float ch = checkSize;
-					if ((y+1)*checkSize > bgH)
-						ch -= (y+1)*checkSize - bgH;
-
-					float lc = (l+x*checkSize);
-					float rc = (l+x*checkSize+cw);
-					float bc = (b+y*checkSize);
-					float tc = (b+y*checkSize+ch);
-
-					glVertex2f(lc, bc);
-					glVertex2f(lc, tc);
-					glVertex2f(rc, tc);
-					glVertex2f(rc, bc);
-					numCheckQuads++;
-
-					x++;
-				}
-				x = 0;
-				y++;
-				lineStartToggle = !lineStartToggle;
-			}
-			glEnd();
+			Renderer::DrawCheckerboard
+			(
+				tMax(l, 0.0f), tMax(b, 0.0f), tMin(r, drawW), tMin(t, drawH), l, b, checkSize,
+				tColour4f(0.4f, 0.4f, 0.45f, 1.0f), tColour4f(0.3f, 0.3f, 0.35f, 1.0f)
+			);
 			break;
 		}
 
@@ -1972,13 +1912,7 @@ void Viewer::DrawBackground(float l, float r, float b, float t, float drawW, flo
 			tColour4b bgCol = profile.BackgroundColour;
 			if (overrideBG)
 				bgCol = CurrImage->BackgroundColourOverride;
-			glColor4ubv(bgCol.E);
-			glBegin(GL_QUADS);
-			glVertex2f(l, b);
-			glVertex2f(l, t);
-			glVertex2f(r, t);
-			glVertex2f(r, b);
-			glEnd();
+			Renderer::DrawQuad(l, b, r, t, tColour4f(bgCol));
 			break;
 		}
 	}
@@ -2671,6 +2605,7 @@ int Viewer::DoMainMenuBar()
 	DoLevelsModal					(levelsPressed);
 	DoQuantizeModal					(quantizePressed);
 	DoLosslessTransformModal		(losslessTransformPressed);
+	EditJob::DoProgressModal		();
 
 	return menuBarHeight;
 }
@@ -2929,6 +2864,22 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 		glfwPollEvents();
 
 	Config::ProfileData& profile = Config::GetProfileData();
+
+	// Results from the background header scan may change the order if we're sorting on a cached key.
+	if (MetaIndex::Update() && Config::ProfileData::IsCachedSortKey(profile.GetSortKey()))
+		SortImages(profile.GetSortKey(), profile.SortAscending);
+
+	// A finished background edit replaces the pictures of its image before the memory is accounted. The frame limit
+	// is read every update so a profile switch or preference change applies to the next edit.
+	Image::MaxEditFrames = profile.MaxEditFrames;
+	EditJob::Update();
+
+	// Evicting here rather than when an image is loaded keeps navigation responsive. We currently do not allow
+	// unloading when in slideshow and the frame duration is small.
+	bool slideshowSmallDuration = SlideshowPlaying && (profile.SlideshowPeriod < 0.5f);
+	if (!slideshowSmallDuration)
+		MemoryManager::Update(CurrImage);
+
 	if (Config::Global.TransparentWorkArea)
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 	else
@@ -2978,10 +2929,7 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 	float workAreaAspect = float(workAreaW)/float(workAreaH);
 
 	glViewport(0, bottomUIHeight, workAreaW, workAreaH);
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	glOrtho(0, workAreaW, 0, workAreaH, -1, 1);
-	glMatrixMode(GL_MODELVIEW);
+	Renderer::Begin(workAreaW, workAreaH);
 	float draww		= 1.0f;		float drawh		= 1.0f;
 	float iw		= 1.0f;		float ih		= 1.0f;
 	float left		= 0.0f;
@@ -3005,11 +2953,14 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 	int mouseYi = int(mouseY);
 	Config::ProfileData::ZoomModeEnum zoomMode = GetZoomMode();
 	bool imgAvail = CurrImage && CurrImage->IsLoaded();
+	FrameWindowBusy = false;
+	TilesBusy = false;
 
 	if (imgAvail)
 	{
 		if (!skipUpdatePlaying)
 			CurrImage->UpdatePlaying(float(dt));
+		FrameWindowBusy = CurrImage->UpdateFrameWindow();
 
 		int iwi = CurrImage->GetWidth();
 		int ihi = CurrImage->GetHeight();
@@ -3101,7 +3052,6 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 		}
 
 		// Draw background.
-		glDisable(GL_TEXTURE_2D);
 		if ((profile.BackgroundExtend || profile.Tile) && !CropMode)
 			DrawBackground(0.0f, draww, 0.0f, drawh, draww, drawh);
 
@@ -3109,10 +3059,8 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 		else if (!CurrImage->IsOpaque())
 			DrawBackground(left, right, bottom, top, draww, drawh);
 
-		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-		CurrImage->Bind();
-		glEnable(GL_TEXTURE_2D);
-
+		// Large images are uploaded on the loader thread. Until the texture is ready only the background is drawn.
+		bool texAvail = CurrImage->Bind(true) != 0;
 		if (RotateAnglePreview != 0.0f)
 		{
 			float origX = left + (right-left)/2.0f;
@@ -3121,79 +3069,55 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 			tMatrix4 trnMatA;	tMakeTranslate(trnMatA, tVector3(-origX, -origY, 0.0f));
 			tMatrix4 trnMatB;	tMakeTranslate(trnMatB, tVector3(origX, origY, 0.0f));
 			rotMat = trnMatB * rotMat * trnMatA;
-			glPushMatrix();
-			glMultMatrixf(rotMat.E);
+			Renderer::SetTransform(rotMat);
 		}
 
-		// Decide which colour channels to draw. OpenGL handles all this with swizzling.
-		int swizzle[4] =
+		// Decide which colour channels to draw. The filter is applied in the fragment shader.
+		Renderer::ChannelFilter channelFilter;
+		if (ShutterFXCountdown > 0.0f)
 		{
-			DrawChannel_R ? GL_RED : GL_ZERO,
-			DrawChannel_G ? GL_GREEN : GL_ZERO,
-			DrawChannel_B ? GL_BLUE : GL_ZERO,
-			DrawChannel_A ? GL_ALPHA : GL_ONE
-		};
-
-		if (DrawChannel_AsIntensity)
+			ShutterFXCountdown -= dt;
+			channelFilter.SetWhite();
+		}
+		else
 		{
-			if (DrawChannel_R) { swizzle[0] = GL_RED;	swizzle[1] = GL_RED;	swizzle[2] = GL_RED;	swizzle[3] = GL_ONE; }
-			if (DrawChannel_G) { swizzle[0] = GL_GREEN;	swizzle[1] = GL_GREEN;	swizzle[2] = GL_GREEN;	swizzle[3] = GL_ONE; }
-			if (DrawChannel_B) { swizzle[0] = GL_BLUE;	swizzle[1] = GL_BLUE;	swizzle[2] = GL_BLUE;	swizzle[3] = GL_ONE; }
-			if (DrawChannel_A) { swizzle[0] = GL_ALPHA;	swizzle[1] = GL_ALPHA;	swizzle[2] = GL_ALPHA;	swizzle[3] = GL_ONE; }
+			channelFilter.SetChannels(DrawChannel_R, DrawChannel_G, DrawChannel_B, DrawChannel_A, DrawChannel_AsIntensity);
 		}
 
-		bool swizzleModified = false;
-		if (ShutterFXCountdown > 0.0f)
+		if (CurrImage->IsTiled())
 		{
-			ShutterFXCountdown -= dt;
-			int swizzleWhite[4] = { GL_ONE, GL_ONE, GL_ONE, GL_ONE };
-			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzleWhite);
-			swizzleModified = true;
+			// Too big for one texture. Tiling the display is not supported and the rotate preview only gets the
+			// coarse base level.
+			TilesBusy = CurrImage->DrawTiles(left, right, bottom, top, draww, drawh, channelFilter, RotateAnglePreview != 0.0f);
 		}
-		else if (!DrawChannel_R || !DrawChannel_G || !DrawChannel_B || !DrawChannel_A)
+		else if (!texAvail)
 		{
-			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
-			swizzleModified = true;
+			// Nothing to draw yet. The loader thread wakes the main loop when the texture is ready.
 		}
-
-		if (!profile.Tile)
+		else if (!profile.Tile)
 		{
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-			glBegin(GL_QUADS);
-			glTexCoord2f(0.0f, 0.0f); glVertex2f(left,  bottom);
-			glTexCoord2f(0.0f, 1.0f); glVertex2f(left,  top);
-			glTexCoord2f(1.0f, 1.0f); glVertex2f(right, top);
-			glTexCoord2f(1.0f, 0.0f); glVertex2f(right, bottom);
-			glEnd();
+			Renderer::DrawTexturedQuad(left, bottom, right, top, 0.0f, 0.0f, 1.0f, 1.0f, channelFilter);
 		}
 		else
 		{
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-			glBegin(GL_QUADS);
 			float repU = draww/(right-left);	float offU = (1.0f-repU)/2.0f;
 			float repV = drawh/(top-bottom);	float offV = (1.0f-repV)/2.0f;
 			float uoffp = -panX/w;
 			float voffp = -panY/h;
-			glTexCoord2f(offU + 0.0f + uoffp,	offV + 0.0f + voffp);	glVertex2f(0.0f,	0.0f);
-			glTexCoord2f(offU + 0.0f + uoffp,	offV + repV + voffp);	glVertex2f(0.0f,	drawh);
-			glTexCoord2f(offU + repU + uoffp,	offV + repV + voffp);	glVertex2f(draww,	drawh);
-			glTexCoord2f(offU + repU + uoffp,	offV + 0.0f + voffp);	glVertex2f(draww,	0.0f);
-			glEnd();
-		}
-
-		// Restore swizzle to normal if it was modified.
-		if (swizzleModified)
-		{
-			int defaultSwizzle[] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
-			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, defaultSwizzle);
+			Renderer::DrawTexturedQuad
+			(
+				0.0f, 0.0f, draww, drawh,
+				offU + uoffp, offV + voffp, offU + repU + uoffp, offV + repV + voffp, channelFilter
+			);
 		}
 
 		if (RotateAnglePreview != 0.0f)
-			glPopMatrix();
+			Renderer::ResetTransform();
 
 		// If mouse was cllcked to adjust cursor pos, CursorMouseX/Y will be >= 0.0f;
 		if ((CursorMouseX >= 0.0f) && (CursorMouseX >= 0.0f))
@@ -3239,9 +3163,6 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 		// Get the colour under the reticle.
 		PixelColour = CurrImage->GetPixel(CursorX, CursorY);
 
-		glDisable(GL_TEXTURE_2D);
-		glColor4fv(tColour4f::white.E);
-
 		// Show the cursor either as a square ouline or a reticle.
 		bool reticleVisible = false;
 
@@ -3269,10 +3190,7 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 		if (reticleVisible)
 		{
 			int intensity = (PixelColour.R + PixelColour.G + PixelColour.B) / 3;
-			if ((intensity < 128) || (PixelColour.A < 128))
-				glColor4ubv(tColour4b::white.E);
-			else
-				glColor4ubv(tColour4b::black.E);
+			tColour4f reticleColour = ((intensity < 128) || (PixelColour.A < 128)) ? tColour4f::white : tColour4f::black;
 
 			tVector4 lrtb(left, right, top, bottom);
 			tVector2 uvoffset(uoff, voff);
@@ -3286,19 +3204,10 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 			if (tMath::tDistBetweenSq(scrPosBL, scrPosTR) > scrSizeSquareReticle*scrSizeSquareReticle)
 			{
 				// Draw as square outline.
-				glBegin(GL_LINES);
-				glVertex2f(scrPosBL.x-1,	scrPosBL.y-1);
-				glVertex2f(scrPosTR.x,		scrPosBL.y);
-
-				glVertex2f(scrPosTR.x,		scrPosBL.y);
-				glVertex2f(scrPosTR.x,		scrPosTR.y);
-
-				glVertex2f(scrPosTR.x,		scrPosTR.y);
-				glVertex2f(scrPosBL.x,		scrPosTR.y);
-
-				glVertex2f(scrPosBL.x,		scrPosTR.y);
-				glVertex2f(scrPosBL.x-1,	scrPosBL.y-1);
-				glEnd();
+				Renderer::DrawLine(scrPosBL.x-1,	scrPosBL.y-1,	scrPosTR.x,		scrPosBL.y,		reticleColour);
+				Renderer::DrawLine(scrPosTR.x,		scrPosBL.y,		scrPosTR.x,		scrPosTR.y,		reticleColour);
+				Renderer::DrawLine(scrPosTR.x,		scrPosTR.y,		scrPosBL.x,		scrPosTR.y,		reticleColour);
+				Renderer::DrawLine(scrPosBL.x,		scrPosTR.y,		scrPosBL.x-1,	scrPosBL.y-1,	reticleColour);
 			}
 			else
 			{
@@ -3309,20 +3218,11 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 				float cx = mid.x;
 				float cy = mid.y;
 
-				glEnable(GL_TEXTURE_2D);
 				Image_Reticle.Bind();
-				glBegin(GL_QUADS);
-				glTexCoord2f(0.0f, 0.0f); glVertex2f(cx-cw, cy+ch);
-				glTexCoord2f(0.0f, 1.0f); glVertex2f(cx-cw, cy-ch);
-				glTexCoord2f(1.0f, 1.0f); glVertex2f(cx+cw, cy-ch);
-				glTexCoord2f(1.0f, 0.0f); glVertex2f(cx+cw, cy+ch);
-				glEnd();
-				glDisable(GL_TEXTURE_2D);
+				Renderer::DrawTexturedQuad(cx-cw, cy-ch, cx+cw, cy+ch, 0.0f, 1.0f, 1.0f, 0.0f, Renderer::ChannelFilter(), reticleColour);
 			}
 		}
 
-		glDisable(GL_TEXTURE_2D);
-		glColor4fv(tColour4f::white.E);
 		static bool lastCropMode = false;
 		if (CropMode)
 		{
@@ -3686,6 +3586,9 @@ void Viewer::Update(GLFWwindow* window, double dt, bool dopoll)
 	stackSizes.CompareWithCurrentState();
 	#endif
 
+	// Everything in the work area has been submitted. ImGui draws with its own backend.
+	Renderer::End();
+
 	// This calls ImGui::EndFrame for us.
 	ImGui::Render();
 	glViewport(0, 0, dispw, disph);
@@ -3862,6 +3765,9 @@ void Viewer::ZoomDownscaleOnly()
 
 void Viewer::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int modifiers)
 {
+	// Input arms the settle countdown even if ImGui takes it. See ComputeIdleWait.
+	SettleCountdown = SettleDuration;
+
 	if ((action != GLFW_PRESS) && (action != GLFW_REPEAT))
 		return;
 
@@ -3995,6 +3901,8 @@ void Viewer::KeyCallback(GLFWwindow* window, int key, int scancode, int action,
 
 void Viewer::MouseButtonCallback(GLFWwindow* window, int mouseButton, int press, int mods)
 {
+	SettleCountdown = SettleDuration;
+
 	if (ImGui::GetIO().WantCaptureMouse)
 		return;
 
@@ -4049,6 +3957,8 @@ void Viewer::MouseButtonCallback(GLFWwindow* window, int mouseButton, int press,
 
 void Viewer::CursorPosCallback(GLFWwindow* window, double x, double y)
 {
+	SettleCountdown = SettleDuration;
+
 	if (ImGui::GetIO().WantCaptureMouse)
 		return;
 
@@ -4063,6 +3973,8 @@ void Viewer::CursorPosCallback(GLFWwindow* window, double x, double y)
 
 void Viewer::ScrollWheelCallback(GLFWwindow* window, double x, double y)
 {
+	SettleCountdown = SettleDuration;
+
 	if (ImGui::GetIO().WantCaptureMouse)
 		return;
 
@@ -4080,6 +3992,8 @@ void Viewer::ScrollWheelCallback(GLFWwindow* window, double x, double y)
 
 void Viewer::FileDropCallback(GLFWwindow* window, int count, const char** files)
 {
+	SettleCountdown = SettleDuration;
+
 	if (count < 1)
 		return;
 
@@ -4092,6 +4006,8 @@ void Viewer::FileDropCallback(GLFWwindow* window, int count, const char** files)
 
 void Viewer::FocusCallback(GLFWwindow* window, int gotFocus)
 {
+	SettleCountdown = SettleDuration;
+
 	if (!gotFocus)
 		return;
 
@@ -4133,10 +4049,63 @@ void Viewer::FocusCallback(GLFWwindow* window, int gotFocus)
 
 void Viewer::IconifyCallback(GLFWwindow* window, int iconified)
 {
+	SettleCountdown = SettleDuration;
+
 	WindowIconified = iconified ? true : false;;
 }
 
 
+void Viewer::WakeMainLoop()
+{
+	if (Window)
+		glfwPostEmptyEvent();
+}
+
+
+double Viewer::ComputeIdleWait()
+{
+	// ImGui needs a few frames after any input for hover states, popups, and tooltips to settle. Held mouse buttons
+	// drive sliders and repeat buttons every frame.
+	if ((SettleCountdown > 0.0) || (ShutterFXCountdown > 0.0f) || ImGui::IsAnyMouseDown())
+		return 0.0;
+
+	// Compacting the frames of a long animation and uploading the tiles of a huge image are spread over many updates.
+	if (FrameWindowBusy || TilesBusy)
+		return 0.0;
+
+	Config::ProfileData& profile = Config::GetProfileData();
+	double wait = IdleWaitMax;
+
+	// The text cursor blinks.
+	if (ImGui::GetIO().WantTextInput)
+		wait = tMath::tMin(wait, 0.1);
+
+	if (CurrImage && CurrImage->FramePlaying)
+		wait = tMath::tMin(wait, double(CurrImage->FrameCurrCountdown));
+
+	// Workers wake us as frames finish. The elapsed time in the progress modal still needs to tick for single frames.
+	if (EditJob::IsRunning())
+		wait = tMath::tMin(wait, 0.1);
+
+	if (SlideshowPlaying)
+	{
+		bool progressArc = (profile.SlideshowPeriod >= 1.0f) && profile.SlideshowProgressArc;
+		wait = tMath::tMin(wait, progressArc ? 1.0/30.0 : SlideshowCountdown);
+	}
+
+	// The nav buttons fade out when this reaches zero.
+	if (DisappearCountdown > 0.0)
+		wait = tMath::tMin(wait, DisappearCountdown);
+
+	// Thumbnail generation and the metadata scan wake us when they have results, so they do not need a deadline.
+	// Nothing is visible while iconified so there is no need to be responsive.
+	if (WindowIconified)
+		wait = tMath::tMax(wait, 0.1);
+
+	return tMath::tMax(wait, 0.0);
+}
+
+
 int Viewer::RemoveOldCacheFiles(const tString& cacheDir)
 {
 	Config::ProfileData& profile = Config::GetProfileData();
@@ -4550,6 +4519,20 @@ int main(int argc, char** argv)
 	}
 	tPrintf("GLAD V %s\n", glGetString(GL_VERSION));
 
+	if (!Viewer::Renderer::Init())
+	{
+		tPrintf("Failed to initialize renderer\n");
+		glfwDestroyWindow(Viewer::Window);
+		glfwTerminate();
+		return Viewer::ErrorCode_GUI_FailRendererInit;
+	}
+
+	// Not fatal. Without the loader thread every texture is uploaded on the main thread.
+	Viewer::TextureUpload::Init(Viewer::Window);
+	Viewer::Mipmap::Init();
+	Viewer::UndoSpill::Init(Viewer::Image::ThumbCacheDir);
+	Viewer::WorkPool::Init();
+
 	glfwSwapInterval(1); // Enable vsync
 	glfwSetWindowRefreshCallback(Viewer::Window, Viewer::WindowRefreshFun);
 	glfwSetKeyCallback(Viewer::Window, Viewer::KeyCallback);
@@ -4633,12 +4616,18 @@ int main(int argc, char** argv)
 	else
 		tPrintf("Framebuffer BPC (RGB): (%d,%d,%d)\n", redBits, blueBits, greenBits);
 
-	// Main loop.
+	// Main loop. Rather than rendering continuously we block in glfwWaitEventsTimeout until there is input, a worker
+	// thread posts a wake, or a timer (slideshow, frame playback, nav-button fade) is due.
 	static double lastUpdateTime = glfwGetTime();
+	double lastWait = 0.0;
 	while (!glfwWindowShouldClose(Viewer::Window) && !Viewer::Request_Quit)
 	{
 		double currUpdateTime = glfwGetTime();
-		double elapsed = tMath::tMin(currUpdateTime - lastUpdateTime, 1.0/30.0);
+
+		// Clamp so a long stall (like loading a big image) does not jump animations, but allow for the time we
+		// deliberately waited so countdowns stay accurate.
+		double elapsed = tMath::tMin(currUpdateTime - lastUpdateTime, lastWait + 1.0/30.0);
+		Viewer::SettleCountdown -= elapsed;
 
 		Viewer::Update(Viewer::Window, elapsed);
 
@@ -4649,18 +4638,24 @@ int main(int argc, char** argv)
 			requestSnapMessageNoTrans = false;
 		}
 
-		int sleepms = 0;
+		double wait = Viewer::ComputeIdleWait();
+		double waitStart = glfwGetTime();
+		if (wait > 0.0)
+			glfwWaitEventsTimeout(wait);
 
-		// I don't seem to be able to get Linux to v-sync. This stops it using all the CPU.
+		// I don't seem to be able to get Linux to v-sync. Any event ends the wait above early, so while the mouse is
+		// moving we hold each frame to the minimum period here. This stops it using all the CPU when we do need to
+		// render every frame. Waiting on events rather than sleeping means their callbacks still run right away.
 		#ifdef PLATFORM_LINUX
-		sleepms = 16;
+		double remaining = Viewer::MinFramePeriod - (glfwGetTime() - currUpdateTime);
+		while (remaining > 0.0)
+		{
+			glfwWaitEventsTimeout(remaining);
+			remaining = Viewer::MinFramePeriod - (glfwGetTime() - currUpdateTime);
+		}
 		#endif
 
-		if (Viewer::WindowIconified)
-			sleepms = 100;
-		if (sleepms)
-			tSystem::tSleep(sleepms);
-
+		lastWait = glfwGetTime() - waitStart;
 		lastUpdateTime = currUpdateTime;
 	}
 
@@ -4671,8 +4666,15 @@ int main(int argc, char** argv)
 
 	// This is important. We need the destructors to run BEFORE we shutdown GLFW. Deconstructing the images may block for a bit while shutting
 	// down worker threads. We could show a 'shutting down' popup here if we wanted -- if Image::ThumbnailNumThreadsRunning is > 0.
+	Viewer::EditJob::Shutdown();
 	Viewer::Images.Clear();
+	Viewer::MetaIndex::Close();
 	Viewer::UnloadAppImages();
+	Viewer::Renderer::Shutdown();
+	Viewer::TextureUpload::Shutdown();
+	Viewer::Mipmap::Shutdown();
+	Viewer::UndoSpill::Shutdown();
+	Viewer::WorkPool::Shutdown();
 
 	// Get current window geometry and set in config file if we're not in fullscreen mode and not iconified.
 	if (!profile.FullscreenMode && !Viewer::WindowIconified)
@@ -33,12 +33,14 @@ namespace Viewer
 		ErrorCode_GUI_FailAssetDirMissing	= 40,
 		ErrorCode_GUI_FailConfigDirMissing	= 50,
 		ErrorCode_GUI_FailCacheDirMissing	= 60,
+		ErrorCode_GUI_FailRendererInit		= 70,
 
 		ErrorCode_CLI_FailUnknown			= 100,
 		ErrorCode_CLI_FailImageLoad			= 110,
 		ErrorCode_CLI_FailImageProcess		= 120,
 		ErrorCode_CLI_FailEarlyExit			= 130,
 		ErrorCode_CLI_FailImageSave			= 140,
+		ErrorCode_CLI_FailSelfTest			= 150,
 	};
 
 	enum class Anchor
@@ -80,7 +82,6 @@ namespace Viewer
 	extern tString ImagesDir;
 	extern tList<tStringItem> ImagesSubDirs;
 	extern tList<Viewer::Image> Images;
-	extern tItList<Viewer::Image> ImagesLoadTimeSorted;
 	extern tColour4b PixelColour;
 	extern Viewer::Image Image_DefaultThumbnail;
 	extern Viewer::Image Image_File;
@@ -157,6 +158,10 @@ namespace Viewer
 	void OnUndo();
 	void OnRedo();
 
+	// Wakes the main loop if it is blocked waiting for events. Thread safe. Worker threads call this when they
+	// finish something the UI should show. Does nothing when running from the command line.
+	void WakeMainLoop();
+
 	// Returns true if clamping was necessary.
 	bool ConvertScreenPosToImagePos
 	(
@@ -0,0 +1,434 @@
+// TextureUpload.cpp
+//
+// Uploads large pictures to VRAM on a loader thread so the UI thread never stalls in glTexImage2D. The loader thread
+// owns a hidden window whose GL context shares objects with the main one. Pixel data is staged through a pair of
+// pixel buffer objects. When GL_ARB_buffer_storage is available they are persistently mapped and reuse is guarded
+// with fences, otherwise they are orphaned and mapped per chunk, which only needs OpenGL 2.1. A finished texture is
+// only handed to the UI thread once a fence (or glFinish if GL_ARB_sync is missing) confirms the GPU has it.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <cstdio>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>				// Include glfw3.h after our OpenGL declarations.
+#include <Foundation/tList.h>
+#include <System/tPrint.h>
+#include "TextureUpload.h"
+#include "TacentView.h"
+#include "Mipmap.h"
+using namespace tImage;
+
+
+namespace Viewer
+{
+	namespace TextureUpload
+	{
+		// The loaded GL 2.1 bindings do not include sync objects or buffer storage. These are fetched at runtime and
+		// only used if the driver reports them.
+		const GLenum GL_SYNC_GPU_COMMANDS_COMPLETE_					= 0x9117;
+		const GLbitfield GL_SYNC_FLUSH_COMMANDS_BIT_				= 0x00000001;
+		const GLenum GL_TIMEOUT_EXPIRED_							= 0x911B;
+		const GLenum GL_WAIT_FAILED_								= 0x911D;
+		const GLbitfield GL_MAP_WRITE_BIT_							= 0x0002;
+		const GLbitfield GL_MAP_PERSISTENT_BIT_						= 0x0040;
+		const GLbitfield GL_MAP_COHERENT_BIT_						= 0x0080;
+		const GLuint64 WaitTimeoutNS								= 1000000000;
+
+		typedef GLsync (APIENTRYP FenceSyncProc)(GLenum condition, GLbitfield flags);
+		typedef GLenum (APIENTRYP ClientWaitSyncProc)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+		typedef void (APIENTRYP DeleteSyncProc)(GLsync sync);
+		typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+		typedef void* (APIENTRYP MapBufferRangeProc)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+
+		FenceSyncProc FenceSync										= nullptr;
+		ClientWaitSyncProc ClientWaitSync							= nullptr;
+		DeleteSyncProc DeleteSync									= nullptr;
+		BufferStorageProc BufferStorage								= nullptr;
+		MapBufferRangeProc MapBufferRange							= nullptr;
+
+		struct Job : public tLink<Job>
+		{
+			tPicture* Picture										= nullptr;
+			bool Mipmaps											= true;
+
+			// Written by the loader thread. Only read by the UI thread once Done is set.
+			GLuint TexID											= 0;
+			int64 NumBytes											= 0;
+			std::atomic<bool> Cancelled								= false;
+			bool Done												= false;	// Mutex must be held.
+		};
+
+		// Two slots so the CPU can fill one while the GPU is still reading from the other.
+		struct StagingSlot
+		{
+			GLuint Buffer											= 0;
+			uint8* Mapped											= nullptr;	// Only for persistent mapping.
+			GLsync Fence											= nullptr;
+		};
+		const int NumStagingSlots									= 2;
+		const int64 StagingSlotSize									= 16*1024*1024;
+
+		// The mutex protects Pending, Active, Quit, and the Done member of every job.
+		std::mutex Mutex;
+		std::condition_variable WorkAvailable;
+		std::condition_variable JobFinished;
+		tList<Job> Pending;
+		Job* Active													= nullptr;
+		bool Quit													= false;
+
+		GLFWwindow* LoaderWindow									= nullptr;
+		std::thread LoaderThread;
+		bool HasSync												= false;
+		bool HasPersistent											= false;
+		StagingSlot Staging[NumStagingSlots];
+		int NextSlot												= 0;
+
+		void LoadExtensions();
+		void CreateStaging();
+		void DestroyStaging();
+		uint8* AcquireSlot(StagingSlot&);
+		void ReleaseSlot(StagingSlot&);
+		void WaitFence(GLsync&);
+		bool UploadLayer(Job&, const tLayer&, int mipmapLevel);
+		void ProcessJob(Job&);
+		void LoaderFunction();
+	}
+}
+
+
+void Viewer::TextureUpload::LoadExtensions()
+{
+	int major = 0;
+	int minor = 0;
+	const char* version = (const char*)glGetString(GL_VERSION);
+	if (version)
+		sscanf(version, "%d.%d", &major, &minor);
+	int glVersion = major*10 + minor;
+
+	if ((glVersion >= 32) || glfwExtensionSupported("GL_ARB_sync"))
+	{
+		FenceSync		= (FenceSyncProc)glfwGetProcAddress("glFenceSync");
+		ClientWaitSync	= (ClientWaitSyncProc)glfwGetProcAddress("glClientWaitSync");
+		DeleteSync		= (DeleteSyncProc)glfwGetProcAddress("glDeleteSync");
+		HasSync			= FenceSync && ClientWaitSync && DeleteSync;
+	}
+
+	// Persistent mapping is useless without fences to know when a slot may be overwritten.
+	if (HasSync && ((glVersion >= 44) || glfwExtensionSupported("GL_ARB_buffer_storage")))
+	{
+		BufferStorage	= (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+		MapBufferRange	= (MapBufferRangeProc)glfwGetProcAddress("glMapBufferRange");
+		HasPersistent	= BufferStorage && MapBufferRange;
+	}
+}
+
+
+bool Viewer::TextureUpload::Init(GLFWwindow* mainWindow)
+{
+	LoadExtensions();
+
+	// Window creation must happen on the main thread. The loader thread only makes the context current.
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	LoaderWindow = glfwCreateWindow(1, 1, "tacentview loader", nullptr, mainWindow);
+	glfwDefaultWindowHints();
+	if (!LoaderWindow)
+	{
+		tPrintf("Texture loader context unavailable. Uploading on the main thread.\n");
+		return false;
+	}
+
+	tPrintf("Texture loader using %s PBOs and %s\n", HasPersistent ? "persistent" : "mapped", HasSync ? "fences" : "glFinish");
+	Quit = false;
+	LoaderThread = std::thread(LoaderFunction);
+	return true;
+}
+
+
+void Viewer::TextureUpload::Shutdown()
+{
+	if (!LoaderWindow)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Quit = true;
+	}
+	WorkAvailable.notify_all();
+	LoaderThread.join();
+
+	// Every image cancels its job when it is unbound so nothing should be left. Anything that is gets dropped.
+	while (Job* job = Pending.Remove())
+		delete job;
+
+	glfwDestroyWindow(LoaderWindow);
+	LoaderWindow = nullptr;
+}
+
+
+bool Viewer::TextureUpload::IsAvailable()
+{
+	return LoaderWindow != nullptr;
+}
+
+
+Viewer::TextureUpload::Job* Viewer::TextureUpload::Submit(tPicture* picture)
+{
+	tAssert(LoaderWindow && picture);
+	Job* job		= new Job;
+	job->Picture	= picture;
+	job->Mipmaps	= Mipmap::IsEnabled();
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Pending.Append(job);
+	}
+	WorkAvailable.notify_one();
+	return job;
+}
+
+
+bool Viewer::TextureUpload::Collect(Job* job, uint& texID, int64& numBytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		if (!job->Done)
+			return false;
+	}
+
+	texID		= job->TexID;
+	numBytes	= job->NumBytes;
+	delete job;
+	return true;
+}
+
+
+void Viewer::TextureUpload::Cancel(Job* job)
+{
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		if (!job->Done && (job != Active))
+		{
+			Pending.Remove(job);
+		}
+		else
+		{
+			job->Cancelled = true;
+			JobFinished.wait(lock, [job] { return job->Done; });
+		}
+	}
+
+	// Textures are shared between the contexts so the UI thread can delete one the loader thread created.
+	if (job->TexID != 0)
+		glDeleteTextures(1, &job->TexID);
+	delete job;
+}
+
+
+void Viewer::TextureUpload::CreateStaging()
+{
+	for (int s = 0; s < NumStagingSlots; s++)
+	{
+		StagingSlot& slot = Staging[s];
+		glGenBuffers(1, &slot.Buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.Buffer);
+		if (HasPersistent)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT_ | GL_MAP_PERSISTENT_BIT_ | GL_MAP_COHERENT_BIT_;
+			BufferStorage(GL_PIXEL_UNPACK_BUFFER, StagingSlotSize, nullptr, flags);
+			slot.Mapped = (uint8*)MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, StagingSlotSize, flags);
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// Fall back to per-chunk mapping if the persistent map failed for any slot.
+	for (int s = 0; s < NumStagingSlots; s++)
+	{
+		if (HasPersistent && !Staging[s].Mapped)
+		{
+			tPrintf("Texture loader could not persistently map staging buffers.\n");
+			DestroyStaging();
+			HasPersistent = false;
+			CreateStaging();
+			return;
+		}
+	}
+}
+
+
+void Viewer::TextureUpload::DestroyStaging()
+{
+	for (int s = 0; s < NumStagingSlots; s++)
+	{
+		StagingSlot& slot = Staging[s];
+		WaitFence(slot.Fence);
+		if (slot.Mapped)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.Buffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			slot.Mapped = nullptr;
+		}
+		if (slot.Buffer)
+			glDeleteBuffers(1, &slot.Buffer);
+		slot.Buffer = 0;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+
+void Viewer::TextureUpload::WaitFence(GLsync& fence)
+{
+	if (!fence)
+		return;
+
+	GLenum result = GL_TIMEOUT_EXPIRED_;
+	while (result == GL_TIMEOUT_EXPIRED_)
+		result = ClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT_, WaitTimeoutNS);
+
+	if (result == GL_WAIT_FAILED_)
+		tPrintf("Texture loader fence wait failed.\n");
+	DeleteSync(fence);
+	fence = nullptr;
+}
+
+
+uint8* Viewer::TextureUpload::AcquireSlot(StagingSlot& slot)
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.Buffer);
+	if (HasPersistent)
+	{
+		// The GPU may still be reading the last chunk written to this slot.
+		WaitFence(slot.Fence);
+		return slot.Mapped;
+	}
+
+	// Orphaning gives us fresh storage so we never wait on the previous upload from this slot.
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, StagingSlotSize, nullptr, GL_STREAM_DRAW);
+	return (uint8*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+}
+
+
+void Viewer::TextureUpload::ReleaseSlot(StagingSlot& slot)
+{
+	if (HasPersistent)
+		slot.Fence = FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE_, 0);
+}
+
+
+bool Viewer::TextureUpload::UploadLayer(Job& job, const tLayer& layer, int mipmapLevel)
+{
+	glTexImage2D(GL_TEXTURE_2D, mipmapLevel, GL_RGBA8, layer.Width, layer.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	// A row is at most MaxDim*4 bytes so a chunk always holds at least one.
+	int64 rowBytes = int64(layer.Width) * 4;
+	int rowsPerChunk = int(StagingSlotSize / rowBytes);
+	for (int y = 0; y < layer.Height; y += rowsPerChunk)
+	{
+		if (job.Cancelled)
+			return false;
+
+		int numRows = tMath::tMin(rowsPerChunk, layer.Height - y);
+		StagingSlot& slot = Staging[NextSlot];
+		NextSlot = (NextSlot + 1) % NumStagingSlots;
+
+		uint8* dst = AcquireSlot(slot);
+		if (!dst)
+			return false;
+		std::memcpy(dst, layer.Data + y*rowBytes, numRows*rowBytes);
+		if (!HasPersistent)
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// With a pixel unpack buffer bound the data pointer is an offset into it.
+		glTexSubImage2D(GL_TEXTURE_2D, mipmapLevel, 0, y, layer.Width, numRows, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		ReleaseSlot(slot);
+	}
+	return true;
+}
+
+
+void Viewer::TextureUpload::ProcessJob(Job& job)
+{
+	// The fast box chain is built here too. Any higher quality chain is swapped in later by the caller.
+	tList<tLayer> layers;
+	Mipmap::GenerateFastLayers(layers, *job.Picture, job.Mipmaps);
+	if (layers.IsEmpty() || job.Cancelled)
+		return;
+
+	glGenTextures(1, &job.TexID);
+	glBindTexture(GL_TEXTURE_2D, job.TexID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	bool mipmapped = layers.GetNumItems() > 1;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
+
+	int mipmapLevel = 0;
+	bool ok = true;
+	for (tLayer* layer = layers.First(); layer && ok; layer = layer->Next(), mipmapLevel++)
+	{
+		ok = UploadLayer(job, *layer, mipmapLevel);
+		job.NumBytes += int64(layer->GetDataSize());
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// The texture must be complete on the GPU before the main context may sample it.
+	if (HasSync)
+	{
+		GLsync fence = FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE_, 0);
+		WaitFence(fence);
+	}
+	else
+	{
+		glFinish();
+	}
+
+	if (!ok)
+	{
+		glDeleteTextures(1, &job.TexID);
+		job.TexID = 0;
+		job.NumBytes = 0;
+	}
+}
+
+
+void Viewer::TextureUpload::LoaderFunction()
+{
+	glfwMakeContextCurrent(LoaderWindow);
+	CreateStaging();
+
+	while (true)
+	{
+		Job* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			WorkAvailable.wait(lock, [] { return Quit || !Pending.IsEmpty(); });
+			if (Quit)
+				break;
+			job = Pending.Remove();
+			Active = job;
+		}
+
+		ProcessJob(*job);
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			job->Done = true;
+			Active = nullptr;
+		}
+		JobFinished.notify_all();
+		WakeMainLoop();
+	}
+
+	DestroyStaging();
+	glfwMakeContextCurrent(nullptr);
+}
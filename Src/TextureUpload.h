@@ -0,0 +1,53 @@
+// TextureUpload.h
+//
+// Uploads large pictures to VRAM on a loader thread so the UI thread never stalls in glTexImage2D. The loader thread
+// owns a hidden window whose GL context shares objects with the main one. Pixel data is staged through a pair of
+// pixel buffer objects. When GL_ARB_buffer_storage is available they are persistently mapped and reuse is guarded
+// with fences, otherwise they are orphaned and mapped per chunk, which only needs OpenGL 2.1. A finished texture is
+// only handed to the UI thread once a fence (or glFinish if GL_ARB_sync is missing) confirms the GPU has it.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tStandard.h>
+#include <Image/tPicture.h>
+struct GLFWwindow;
+
+
+namespace Viewer
+{
+	namespace TextureUpload
+	{
+		struct Job;
+
+		// Pictures with at least this many pixels are worth uploading on the loader thread. Smaller ones are quicker
+		// to upload directly than to wait a frame for.
+		const int64 MinAsyncArea									= 2048*2048;
+
+		// Call once from the main thread after the GL functions are loaded with the main context current. Returns
+		// false if a shared context could not be created. Submit must not be called in that case.
+		bool Init(GLFWwindow* mainWindow);
+		void Shutdown();
+		bool IsAvailable();
+
+		// Queues an upload of the picture and, if the profile enables mipmaps, its fast box-filtered mip chain. The
+		// picture must not be modified or freed until the job is collected or cancelled.
+		Job* Submit(tImage::tPicture*);
+
+		// Never blocks. Returns true and frees the job once the texture is complete on the GPU. The texture ID is 0
+		// if the upload failed. Returns false if the job is still queued or in progress.
+		bool Collect(Job*, uint& texID, int64& numBytes);
+
+		// Frees the job and any texture it created. Only blocks if the loader thread is partway through this job,
+		// and then only until it reaches the next chunk.
+		void Cancel(Job*);
+	}
+}
@@ -37,7 +37,7 @@ tString Viewer::MakeImageTooltipString(Viewer::Image* image, const tString& file
 	if (image->Cached_PrimaryWidth && image->Cached_PrimaryHeight)
 		tsPrintf
 		(
-			tooltip, "%s\n%s\n%'d Bytes\nW:%'d\nH:%'d\nArea:%'d",
+			tooltip, "%s\n%s\n%'|64d Bytes\nW:%'d\nH:%'d\nArea:%'|64d",
 			filename.Chr(),
 			tSystem::tConvertTimeToString(tSystem::tConvertTimeToLocal(image->FileModTime)).Chr(),
 			image->FileSizeB,
@@ -48,7 +48,7 @@ tString Viewer::MakeImageTooltipString(Viewer::Image* image, const tString& file
 	else
 		tsPrintf
 		(
-			tooltip, "%s\n%s\n%'d Bytes",
+			tooltip, "%s\n%s\n%'|64d Bytes",
 			filename.Chr(),
 			tSystem::tConvertTimeToString(tSystem::tConvertTimeToLocal(image->FileModTime)).Chr(),
 			image->FileSizeB
@@ -0,0 +1,191 @@
+// TileStore.cpp
+//
+// Disk-backed RGBA pixel storage for pictures too big to comfortably keep in memory. Pixels are laid out tile by
+// tile in a scratch file that is memory-mapped, so the OS pages tiles in as they are touched and can write them back
+// and drop them under memory pressure. Each tile is stored contiguously and can be uploaded to a texture as is.
+// Region reads and writes convert to and from row-major pixels for code that works a band of rows at a time.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <cstring>
+#ifdef PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include <System/tPrint.h>
+#include "TileStore.h"
+
+
+int Viewer::TileStore::ScratchCounter = 0;
+
+
+Viewer::TileStore::TileStore(int width, int height, int tileSize, const tString& scratchDir) :
+	Width(width),
+	Height(height),
+	TileSize(tileSize),
+	NumTilesX((width + tileSize - 1) / tileSize),
+	NumTilesY((height + tileSize - 1) / tileSize)
+{
+	// Every tile gets a full-size slot so a tile's offset is a simple multiply. Only the edge tiles waste any space.
+	FileSize = int64(NumTilesX) * int64(NumTilesY) * int64(TileSize) * int64(TileSize) * int64(sizeof(tPixel4b));
+
+	// Another instance may be using the same scratch directory, so keep trying names until one is free.
+	const int maxAttempts = 64;
+	for (int attempt = 0; (attempt < maxAttempts) && !IsValid(); attempt++)
+	{
+		tsPrintf(Filename, "%sTileStore%04d.scratch", scratchDir.Chr(), ScratchCounter++);
+
+		#ifdef PLATFORM_WINDOWS
+		HANDLE file = CreateFileA
+		(
+			Filename.Chr(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+			FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr
+		);
+		if (file == INVALID_HANDLE_VALUE)
+			continue;
+
+		LARGE_INTEGER size;
+		size.QuadPart = FileSize;
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, size.HighPart, size.LowPart, nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			break;
+		}
+
+		Mapped = (uint8*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		if (!Mapped)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			break;
+		}
+		FileHandle = file;
+		MappingHandle = mapping;
+
+		#else
+		int fd = open(Filename.Chr(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0)
+			continue;
+
+		// The name is not needed once the file is open. Unlinking now means nothing is left behind after a crash.
+		unlink(Filename.Chr());
+		if (ftruncate(fd, off_t(FileSize)) != 0)
+		{
+			close(fd);
+			break;
+		}
+
+		void* mapped = mmap(nullptr, size_t(FileSize), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			close(fd);
+			break;
+		}
+		Mapped = (uint8*)mapped;
+		FileDescriptor = fd;
+		#endif
+	}
+
+	if (!IsValid())
+		tPrintf("Failed to create tile store scratch file in %s\n", scratchDir.Chr());
+}
+
+
+Viewer::TileStore::~TileStore()
+{
+	if (!Mapped)
+		return;
+
+	#ifdef PLATFORM_WINDOWS
+	UnmapViewOfFile(Mapped);
+	CloseHandle(HANDLE(MappingHandle));
+	CloseHandle(HANDLE(FileHandle));
+	#else
+	munmap(Mapped, size_t(FileSize));
+	close(FileDescriptor);
+	#endif
+	Mapped = nullptr;
+}
+
+
+int Viewer::TileStore::GetTileWidth(int tileX) const
+{
+	return tMath::tMin(TileSize, Width - tileX*TileSize);
+}
+
+
+int Viewer::TileStore::GetTileHeight(int tileY) const
+{
+	return tMath::tMin(TileSize, Height - tileY*TileSize);
+}
+
+
+tPixel4b* Viewer::TileStore::GetTile(int tileX, int tileY) const
+{
+	tAssert(Mapped && (tileX >= 0) && (tileX < NumTilesX) && (tileY >= 0) && (tileY < NumTilesY));
+	int64 slot = int64(tileY)*NumTilesX + tileX;
+	return (tPixel4b*)(Mapped + slot*TileSize*TileSize*int64(sizeof(tPixel4b)));
+}
+
+
+void Viewer::TileStore::WriteRegion(int x, int y, int w, int h, const tPixel4b* src)
+{
+	// Copies one tile-row span at a time so each memcpy stays within a single tile.
+	for (int row = 0; row < h; row++)
+	{
+		int py = y + row;
+		int tileY = py / TileSize;
+		int inTileY = py - tileY*TileSize;
+		int tileH = GetTileHeight(tileY);
+		tAssert(inTileY < tileH);
+
+		int px = x;
+		while (px < x + w)
+		{
+			int tileX = px / TileSize;
+			int inTileX = px - tileX*TileSize;
+			int tileW = GetTileWidth(tileX);
+			int span = tMath::tMin(tileW - inTileX, x + w - px);
+			tPixel4b* dst = GetTile(tileX, tileY) + inTileY*tileW + inTileX;
+			std::memcpy(dst, src + int64(row)*w + (px - x), span*sizeof(tPixel4b));
+			px += span;
+		}
+	}
+}
+
+
+void Viewer::TileStore::ReadRegion(int x, int y, int w, int h, tPixel4b* dst) const
+{
+	for (int row = 0; row < h; row++)
+	{
+		int py = y + row;
+		int tileY = py / TileSize;
+		int inTileY = py - tileY*TileSize;
+		int tileH = GetTileHeight(tileY);
+		tAssert(inTileY < tileH);
+
+		int px = x;
+		while (px < x + w)
+		{
+			int tileX = px / TileSize;
+			int inTileX = px - tileX*TileSize;
+			int tileW = GetTileWidth(tileX);
+			int span = tMath::tMin(tileW - inTileX, x + w - px);
+			const tPixel4b* src = GetTile(tileX, tileY) + inTileY*tileW + inTileX;
+			std::memcpy(dst + int64(row)*w + (px - x), src, span*sizeof(tPixel4b));
+			px += span;
+		}
+	}
+}
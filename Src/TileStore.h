@@ -0,0 +1,70 @@
+// TileStore.h
+//
+// Disk-backed RGBA pixel storage for pictures too big to comfortably keep in memory. Pixels are laid out tile by
+// tile in a scratch file that is memory-mapped, so the OS pages tiles in as they are touched and can write them back
+// and drop them under memory pressure. Each tile is stored contiguously and can be uploaded to a texture as is.
+// Region reads and writes convert to and from row-major pixels for code that works a band of rows at a time.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tStandard.h>
+#include <Foundation/tString.h>
+#include <Math/tColour.h>
+
+
+namespace Viewer
+{
+	class TileStore
+	{
+	public:
+		// Creates and maps a scratch file in scratchDir. The file is removed when the store is destroyed, or right
+		// away on platforms that allow unlinking an open file. Check IsValid afterwards.
+		TileStore(int width, int height, int tileSize, const tString& scratchDir);
+		~TileStore();
+		bool IsValid() const																							{ return Mapped != nullptr; }
+
+		int GetWidth() const																							{ return Width; }
+		int GetHeight() const																							{ return Height; }
+		int GetTileSize() const																							{ return TileSize; }
+		int GetNumTilesX() const																						{ return NumTilesX; }
+		int GetNumTilesY() const																						{ return NumTilesY; }
+		int64 GetFileSizeBytes() const																					{ return FileSize; }
+
+		// Edge tiles are smaller than the tile size. Their rows are packed with no padding.
+		int GetTileWidth(int tileX) const;
+		int GetTileHeight(int tileY) const;
+		tPixel4b* GetTile(int tileX, int tileY) const;
+
+		// Copy a row-major rectangle in or out. The buffer stride is w pixels.
+		void WriteRegion(int x, int y, int w, int h, const tPixel4b* src);
+		void ReadRegion(int x, int y, int w, int h, tPixel4b* dst) const;
+
+	private:
+		int Width							= 0;
+		int Height							= 0;
+		int TileSize						= 0;
+		int NumTilesX						= 0;
+		int NumTilesY						= 0;
+		int64 FileSize						= 0;
+		tString Filename;
+		uint8* Mapped						= nullptr;
+
+		#ifdef PLATFORM_WINDOWS
+		void* FileHandle					= nullptr;
+		void* MappingHandle					= nullptr;
+		#else
+		int FileDescriptor					= -1;
+		#endif
+
+		static int ScratchCounter;
+	};
+}
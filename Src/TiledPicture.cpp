@@ -0,0 +1,338 @@
+// TiledPicture.cpp
+//
+// Displays pictures too big for a single texture. The picture is split into square tiles and a box-filtered pyramid
+// of reduced copies is built on a background thread, so zoomed-out views draw tiles from the matching level rather
+// than the full resolution ones. Only tiles intersecting the work area are uploaded, a few per draw, and an LRU
+// bounds how many tile textures are resident. A small base level is always drawn first so there are never holes.
+// Levels too big to want in memory are written to a TileStore and reduced a band of rows at a time.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <cmath>
+#include <cstring>
+#include "TiledPicture.h"
+#include "Mipmap.h"
+#include "TacentView.h"
+using namespace tImage;
+
+
+namespace Viewer
+{
+	// Zero until first queried. Many drivers report 16384 even though Image::MaxDim is much bigger.
+	static GLint MaxTextureSize = 0;
+}
+
+
+bool Viewer::TiledPicture::IsNeeded(int width, int height)
+{
+	if (MaxTextureSize == 0)
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &MaxTextureSize);
+
+	return (width > MaxTextureSize) || (height > MaxTextureSize);
+}
+
+
+Viewer::TiledPicture::TiledPicture(tPicture* picture, const tString& scratchDir) :
+	ScratchDir(scratchDir)
+{
+	tAssert(picture && picture->IsValid());
+	Level top;
+	top.Width	= picture->GetWidth();
+	top.Height	= picture->GetHeight();
+	top.Pixels	= (uint8*)picture->GetPixels();
+	Levels.push_back(top);
+
+	// Each level halves the one above until the whole picture fits in a few tiles.
+	while ((Levels.back().Width > BaseMaxDim) || (Levels.back().Height > BaseMaxDim))
+	{
+		Level reduced;
+		reduced.Width	= tMath::tMax(Levels.back().Width/2, 1);
+		reduced.Height	= tMath::tMax(Levels.back().Height/2, 1);
+		Levels.push_back(reduced);
+	}
+	BaseLevel = int(Levels.size()) - 1;
+
+	PyramidThread = std::thread(&TiledPicture::BuildPyramid, this);
+}
+
+
+Viewer::TiledPicture::~TiledPicture()
+{
+	PyramidCancel = true;
+	if (PyramidThread.joinable())
+		PyramidThread.join();
+
+	for (auto& entry : Tiles)
+		glDeleteTextures(1, &entry.second.TexID);
+
+	for (int level = 1; level < int(Levels.size()); level++)
+	{
+		delete[] Levels[level].Pixels;
+		delete Levels[level].Store;
+	}
+}
+
+
+void Viewer::TiledPicture::BuildPyramid()
+{
+	// Checked between levels, and between bands for stored levels. The first in-memory reduction reads the whole
+	// picture so it is the longest a cancel can wait.
+	for (int level = 1; level <= BaseLevel; level++)
+	{
+		if (PyramidCancel)
+			return;
+
+		Level& dst = Levels[level];
+		int64 numBytes = int64(dst.Width) * int64(dst.Height) * 4;
+		if ((numBytes >= StoreLevelBytes) && ScratchDir.IsValid())
+		{
+			dst.Store = new TileStore(dst.Width, dst.Height, TileSize, ScratchDir);
+			if (!dst.Store->IsValid())
+			{
+				delete dst.Store;
+				dst.Store = nullptr;
+			}
+		}
+
+		const Level& src = Levels[level-1];
+		if (!src.Store && !dst.Store)
+		{
+			dst.Pixels = Mipmap::ReduceBox(src.Pixels, src.Width, src.Height);
+			continue;
+		}
+
+		if (!dst.Store)
+			dst.Pixels = new uint8[numBytes];
+		if (!ReduceLevel(src, dst))
+			return;
+	}
+
+	PyramidReady = true;
+	WakeMainLoop();
+}
+
+
+bool Viewer::TiledPicture::ReduceLevel(const Level& src, Level& dst)
+{
+	// Each band of destination rows needs exactly twice as many source rows since dst.Height is src.Height/2. Only
+	// a band's worth of a stored level is ever resident in memory here.
+	tPixel4b* srcBand = src.Store ? new tPixel4b[int64(src.Width)*StoreBandRows*2] : nullptr;
+	bool completed = true;
+	for (int y0 = 0; y0 < dst.Height; y0 += StoreBandRows)
+	{
+		if (PyramidCancel)
+		{
+			completed = false;
+			break;
+		}
+
+		int rows = tMath::tMin(StoreBandRows, dst.Height - y0);
+		int srcRows = tMath::tMin(rows*2, src.Height - y0*2);
+		const uint8* bandPixels = src.Pixels + int64(y0)*2*src.Width*4;
+		if (src.Store)
+		{
+			src.Store->ReadRegion(0, y0*2, src.Width, srcRows, srcBand);
+			bandPixels = (const uint8*)srcBand;
+		}
+
+		uint8* reduced = Mipmap::ReduceBox(bandPixels, src.Width, srcRows);
+		if (dst.Store)
+			dst.Store->WriteRegion(0, y0, dst.Width, rows, (const tPixel4b*)reduced);
+		else
+			std::memcpy(dst.Pixels + int64(y0)*dst.Width*4, reduced, int64(dst.Width)*rows*4);
+		delete[] reduced;
+	}
+
+	delete[] srcBand;
+	return completed;
+}
+
+
+int64 Viewer::TiledPicture::GetPyramidBytes() const
+{
+	if (!PyramidReady)
+		return 0;
+
+	int64 numBytes = 0;
+	for (int level = 1; level < int(Levels.size()); level++)
+		if (!Levels[level].Store)
+			numBytes += int64(Levels[level].Width) * int64(Levels[level].Height) * 4;
+	return numBytes;
+}
+
+
+bool Viewer::TiledPicture::Draw
+(
+	float left, float right, float bottom, float top, float viewW, float viewH,
+	const Renderer::ChannelFilter& filter, bool coarseOnly
+)
+{
+	DrawCount++;
+	int uploadBudget = UploadsPerDraw;
+
+	// The finest level with at most one texel per screen pixel. Magnified views use the full resolution picture.
+	float zoom = (right - left) / float(Levels[0].Width);
+	int target = 0;
+	while ((target < BaseLevel) && (zoom * float(1 << (target+1)) <= 1.0f))
+		target++;
+	if (coarseOnly)
+		target = BaseLevel;
+
+	// Until the pyramid is ready only full resolution tiles can be drawn. That is only sensible when zoomed in.
+	bool ready = PyramidReady;
+	bool missing = !ready;
+	if (ready)
+		missing |= DrawLevel(BaseLevel, left, right, bottom, top, viewW, viewH, filter, true, uploadBudget);
+
+	if ((target != BaseLevel) && (ready || (target == 0)))
+		missing |= DrawLevel(target, left, right, bottom, top, viewW, viewH, filter, false, uploadBudget);
+
+	EvictTiles();
+	return missing;
+}
+
+
+bool Viewer::TiledPicture::DrawLevel
+(
+	int level, float left, float right, float bottom, float top, float viewW, float viewH,
+	const Renderer::ChannelFilter& filter, bool allTiles, int& uploadBudget
+)
+{
+	const Level& lev = Levels[level];
+	int numTilesX = (lev.Width  + TileSize - 1) / TileSize;
+	int numTilesY = (lev.Height + TileSize - 1) / TileSize;
+
+	// Every level is stretched over the same screen rectangle so there are no gaps from the rounding down of odd
+	// dimensions as the levels are reduced.
+	float scaleX = (right - left) / float(lev.Width);
+	float scaleY = (top - bottom) / float(lev.Height);
+
+	int tileX0 = 0;		int tileX1 = numTilesX-1;
+	int tileY0 = 0;		int tileY1 = numTilesY-1;
+	if (!allTiles)
+	{
+		if ((right <= 0.0f) || (left >= viewW) || (top <= 0.0f) || (bottom >= viewH))
+			return false;
+
+		float tileW = scaleX * float(TileSize);
+		float tileH = scaleY * float(TileSize);
+		tileX0 = tMath::tClamp(int(std::floor((0.0f  - left)   / tileW)), 0, numTilesX-1);
+		tileX1 = tMath::tClamp(int(std::floor((viewW - left)   / tileW)), 0, numTilesX-1);
+		tileY0 = tMath::tClamp(int(std::floor((0.0f  - bottom) / tileH)), 0, numTilesY-1);
+		tileY1 = tMath::tClamp(int(std::floor((viewH - bottom) / tileH)), 0, numTilesY-1);
+	}
+
+	bool missing = false;
+	for (int tileY = tileY0; tileY <= tileY1; tileY++)
+	{
+		for (int tileX = tileX0; tileX <= tileX1; tileX++)
+		{
+			GLuint texID = GetTile(level, tileX, tileY, allTiles, uploadBudget);
+			if (!texID)
+			{
+				missing = true;
+				continue;
+			}
+
+			int x0 = tileX*TileSize;
+			int y0 = tileY*TileSize;
+			int x1 = tMath::tMin(x0 + TileSize, lev.Width);
+			int y1 = tMath::tMin(y0 + TileSize, lev.Height);
+			glBindTexture(GL_TEXTURE_2D, texID);
+			Renderer::DrawTexturedQuad
+			(
+				left + float(x0)*scaleX, bottom + float(y0)*scaleY, left + float(x1)*scaleX, bottom + float(y1)*scaleY,
+				0.0f, 0.0f, 1.0f, 1.0f, filter
+			);
+		}
+	}
+
+	return missing;
+}
+
+
+GLuint Viewer::TiledPicture::GetTile(int level, int tileX, int tileY, bool pinned, int& uploadBudget)
+{
+	uint64 key = MakeKey(level, tileX, tileY);
+	auto found = Tiles.find(key);
+	if (found != Tiles.end())
+	{
+		Tile& tile = found->second;
+		tile.LastDrawn = DrawCount;
+		if (!tile.Pinned)
+			LRU.splice(LRU.begin(), LRU, tile.LRUPos);
+		return tile.TexID;
+	}
+
+	if (uploadBudget <= 0)
+		return 0;
+	uploadBudget--;
+
+	const Level& lev = Levels[level];
+	int x0 = tileX*TileSize;
+	int y0 = tileY*TileSize;
+	int w = tMath::tMin(TileSize, lev.Width - x0);
+	int h = tMath::tMin(TileSize, lev.Height - y0);
+
+	Tile tile;
+	tile.Bytes		= int64(w)*h*4;
+	tile.LastDrawn	= DrawCount;
+	tile.Pinned		= pinned;
+	glGenTextures(1, &tile.TexID);
+	glBindTexture(GL_TEXTURE_2D, tile.TexID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// The tile is read straight out of the level. The row length tells GL how far apart the rows are. Stored tiles
+	// are already contiguous.
+	if (lev.Store)
+	{
+		const tPixel4b* src = lev.Store->GetTile(tileX, tileY);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, src);
+	}
+	else
+	{
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, lev.Width);
+		const uint8* src = lev.Pixels + (int64(y0)*lev.Width + x0)*4;
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, src);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+
+	if (!pinned)
+	{
+		LRU.push_front(key);
+		tile.LRUPos = LRU.begin();
+	}
+	Tiles[key] = tile;
+	TextureBytes += tile.Bytes;
+	return tile.TexID;
+}
+
+
+void Viewer::TiledPicture::EvictTiles()
+{
+	// Tiles drawn this time are never evicted, so a view needing more than the limit still draws completely.
+	while (int(LRU.size()) > MaxResidentTiles)
+	{
+		uint64 key = LRU.back();
+		auto found = Tiles.find(key);
+		tAssert(found != Tiles.end());
+		if (found->second.LastDrawn == DrawCount)
+			break;
+
+		glDeleteTextures(1, &found->second.TexID);
+		TextureBytes -= found->second.Bytes;
+		Tiles.erase(found);
+		LRU.pop_back();
+	}
+}
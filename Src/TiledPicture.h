@@ -0,0 +1,105 @@
+// TiledPicture.h
+//
+// Displays pictures too big for a single texture. The picture is split into square tiles and a box-filtered pyramid
+// of reduced copies is built on a background thread, so zoomed-out views draw tiles from the matching level rather
+// than the full resolution ones. Only tiles intersecting the work area are uploaded, a few per draw, and an LRU
+// bounds how many tile textures are resident. A small base level is always drawn first so there are never holes.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <list>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <glad/glad.h>
+#include <Image/tPicture.h>
+#include "Renderer.h"
+#include "TileStore.h"
+
+
+namespace Viewer
+{
+	class TiledPicture
+	{
+	public:
+		// The picture must not be modified or freed while this object exists. Large pyramid levels are kept in a
+		// memory-mapped scratch file in scratchDir. With an empty scratchDir every level is kept in memory.
+		TiledPicture(tImage::tPicture*, const tString& scratchDir);
+		~TiledPicture();
+
+		// True if a picture of this size cannot be uploaded as one texture. Only call from the main thread.
+		static bool IsNeeded(int width, int height);
+
+		// Draws the picture into the screen rectangle with the work area being viewW by viewH. With coarseOnly only
+		// the base level is drawn. Use it when a transform is active since the visible tiles are then unknown.
+		// Returns true if tiles that should be visible are still missing.
+		bool Draw
+		(
+			float left, float right, float bottom, float top, float viewW, float viewH,
+			const Renderer::ChannelFilter&, bool coarseOnly
+		);
+
+		// Pyramid bytes only counts levels held in memory, not those in the scratch file.
+		int64 GetTextureBytes() const																					{ return TextureBytes; }
+		int64 GetPyramidBytes() const;
+
+		static const int TileSize				= 512;
+		static const int BaseMaxDim				= 2048;		// The base level is no bigger than this in either dimension.
+		static const int MaxResidentTiles		= 192;		// Not counting the base level.
+		static const int UploadsPerDraw			= 8;
+		static const int64 StoreLevelBytes		= 256*1024*1024;	// Levels at least this big go to a scratch file.
+		static const int StoreBandRows			= 256;		// Destination rows reduced at a time for stored levels.
+
+	private:
+		struct Level
+		{
+			int Width							= 0;
+			int Height							= 0;
+			uint8* Pixels						= nullptr;	// Level 0 points at the picture. The rest are owned.
+			TileStore* Store					= nullptr;	// If set, Pixels is null and the level lives on disk.
+		};
+
+		struct Tile
+		{
+			GLuint TexID						= 0;
+			int64 Bytes							= 0;
+			uint64 LastDrawn					= 0;
+			bool Pinned							= false;	// Base level tiles are never evicted.
+			std::list<uint64>::iterator LRUPos;
+		};
+
+		void BuildPyramid();
+		bool ReduceLevel(const Level& src, Level& dst);
+		bool DrawLevel
+		(
+			int level, float left, float right, float bottom, float top, float viewW, float viewH,
+			const Renderer::ChannelFilter&, bool allTiles, int& uploadBudget
+		);
+		GLuint GetTile(int level, int tileX, int tileY, bool pinned, int& uploadBudget);
+		void EvictTiles();
+		static uint64 MakeKey(int level, int tileX, int tileY)														{ return (uint64(level) << 48) | (uint64(tileY) << 24) | uint64(tileX); }
+
+		// Levels is sized up front. The pyramid thread fills in the pixels and only then sets PyramidReady.
+		std::vector<Level> Levels;
+		tString ScratchDir;
+		int BaseLevel							= 0;
+		std::thread PyramidThread;
+		std::atomic<bool> PyramidReady			= false;
+		std::atomic<bool> PyramidCancel			= false;
+
+		std::unordered_map<uint64, Tile> Tiles;
+		std::list<uint64> LRU;								// Front is most recently drawn. Pinned tiles are not in it.
+		uint64 DrawCount						= 0;
+		int64 TextureBytes						= 0;
+	};
+}
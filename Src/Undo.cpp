@@ -13,6 +13,7 @@
 // AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 // PERFORMANCE OF THIS SOFTWARE.
 
+#include <System/tPrint.h>
 #include "Undo.h"
 #include "Image.h"
 #include "Config.h"
@@ -26,29 +27,291 @@ Undo::Step_PictureList::Step_PictureList(const tString& desc, bool dirty, const
 	Step(desc, dirty)
 {
 	for (tPicture* pic = pics.First(); pic; pic = pic->Next())
+	{
 		Pictures.Append(new tPicture(*pic));
+		MemSizeBytes += Viewer::Image::ComputePictureMemSizeBytes(pic->GetWidth(), pic->GetHeight());
+	}
+}
+
+
+Undo::Step_PictureList::~Step_PictureList()
+{
+	if (SpillJob)
+		Viewer::UndoSpill::Cancel(SpillJob);
+	Viewer::UndoSpill::Discard(SpillFile);
+	Pictures.Empty();
+}
+
+
+Undo::Step_PictureList* Undo::Step_PictureList::Steal(const tString& desc, bool dirty, tList<tImage::tPicture>& pics)
+{
+	Step_PictureList* step = new Step_PictureList(desc, dirty);
+	while (!pics.IsEmpty())
+	{
+		tPicture* pic = pics.Remove();
+		step->MemSizeBytes += Viewer::Image::ComputePictureMemSizeBytes(pic->GetWidth(), pic->GetHeight());
+		step->Pictures.Append(pic);
+	}
+	return step;
+}
+
+
+Undo::Step* Undo::Step_PictureList::CreateInverse(tList<tImage::tPicture>& currPics, bool dirty)
+{
+	// The current pictures are about to be replaced by Restore so the inverse can take them rather than a copy.
+	return Steal(Description, dirty, currPics);
 }
 
 
 void Undo::Step_PictureList::Restore(tList<tImage::tPicture>& pics)
 {
+	// The step is deleted after restoring so its pictures are handed over.
+	if (!Unspill())
+		return;
 	pics.Clear();
-	for (tPicture* restorePic = Pictures.First(); restorePic; restorePic = restorePic->Next())
-		pics.Append(new tPicture(*restorePic));
+	while (!Pictures.IsEmpty())
+		pics.Append(Pictures.Remove());
+}
+
+
+bool Undo::Step_PictureList::StartSpill()
+{
+	if (SpillJob || SpillFile || SpillFailed || (MemSizeBytes == 0))
+		return false;
+
+	SpillJob = Viewer::UndoSpill::Submit(Pictures);
+	return SpillJob != nullptr;
+}
+
+
+bool Undo::Step_PictureList::UpdateSpill()
+{
+	Viewer::UndoSpill::File* file = nullptr;
+	if (!SpillJob || !Viewer::UndoSpill::Collect(SpillJob, file))
+		return false;
+
+	SpillJob = nullptr;
+	if (!file)
+	{
+		SpillFailed = true;
+		return false;
+	}
+
+	// The pictures keep their durations. Only the pixels are released.
+	for (tPicture* pic = Pictures.First(); pic; pic = pic->Next())
+		delete[] pic->StealPixels();
+	SpillFile = file;
+	return true;
+}
+
+
+bool Undo::Step_PictureList::Unspill()
+{
+	if (SpillJob)
+	{
+		Viewer::UndoSpill::Cancel(SpillJob);
+		SpillJob = nullptr;
+	}
+
+	if (!SpillFile)
+		return true;
+
+	// Load closes the file either way. On failure the pictures may be missing pixels so the step is unusable.
+	bool loaded = Viewer::UndoSpill::Load(SpillFile, Pictures);
+	SpillFile = nullptr;
+	if (!loaded)
+	{
+		Pictures.Empty();
+		MemSizeBytes = 0;
+		SpillFailed = true;
+	}
+	return loaded;
+}
+
+
+Undo::Step_Region::Step_Region(const tString& desc, bool dirty, const tList<tImage::tPicture>& pics, const std::vector<Rect>& rects) :
+	Step(desc, dirty)
+{
+	tAssert(int(rects.size()) == pics.Count());
+	int index = 0;
+	for (tPicture* pic = pics.First(); pic; pic = pic->Next(), index++)
+	{
+		Patch patch;
+		patch.PicWidth = pic->GetWidth();
+		patch.PicHeight = pic->GetHeight();
+		const Rect& rect = rects[index];
+		int x0 = tMax(rect.X, 0);
+		int y0 = tMax(rect.Y, 0);
+		int x1 = tMin(rect.X + rect.W, pic->GetWidth());
+		int y1 = tMin(rect.Y + rect.H, pic->GetHeight());
+		if ((x1 > x0) && (y1 > y0) && pic->IsValid())
+		{
+			patch.Area.X = x0;
+			patch.Area.Y = y0;
+			patch.Area.W = x1 - x0;
+			patch.Area.H = y1 - y0;
+			patch.Pixels = new tPixel4b[patch.Area.W * patch.Area.H];
+			const tPixel4b* src = pic->GetPixels();
+			for (int y = 0; y < patch.Area.H; y++)
+				tStd::tMemcpy(patch.Pixels + y*patch.Area.W, src + int64(y0 + y)*pic->GetWidth() + x0, patch.Area.W*sizeof(tPixel4b));
+			MemSizeBytes += int64(patch.Area.W) * int64(patch.Area.H) * int64(sizeof(tPixel4b));
+		}
+		Patches.push_back(patch);
+	}
+}
+
+
+Undo::Step_Region::~Step_Region()
+{
+	for (Patch& patch : Patches)
+		delete[] patch.Pixels;
+}
+
+
+Undo::Step* Undo::Step_Region::CreateInverse(tList<tImage::tPicture>& currPics, bool dirty)
+{
+	// The same rects of the current pictures are what a redo needs to put back.
+	std::vector<Rect> rects;
+	for (const Patch& patch : Patches)
+		rects.push_back(patch.Area);
+	return new Step_Region(Description, dirty, currPics, rects);
+}
+
+
+bool Undo::Step_Region::CanRestore(const tList<tImage::tPicture>& pics) const
+{
+	if (pics.Count() != int(Patches.size()))
+		return false;
+
+	int index = 0;
+	for (const tPicture* pic = pics.First(); pic; pic = pic->Next(), index++)
+	{
+		const Patch& patch = Patches[index];
+		if ((pic->GetWidth() != patch.PicWidth) || (pic->GetHeight() != patch.PicHeight))
+			return false;
+		if (patch.Pixels && !pic->IsValid())
+			return false;
+	}
+	return true;
+}
+
+
+void Undo::Step_Region::Restore(tList<tImage::tPicture>& pics)
+{
+	// Patches are written at their recorded offsets so a picture of a different size would be overrun.
+	if (!CanRestore(pics))
+		return;
+
+	int index = 0;
+	for (tPicture* pic = pics.First(); pic && (index < int(Patches.size())); pic = pic->Next(), index++)
+	{
+		const Patch& patch = Patches[index];
+		if (!patch.Pixels)
+			continue;
+
+		tPixel4b* dst = pic->GetPixels();
+		for (int y = 0; y < patch.Area.H; y++)
+			tStd::tMemcpy(dst + int64(patch.Area.Y + y)*pic->GetWidth() + patch.Area.X, patch.Pixels + y*patch.Area.W, patch.Area.W*sizeof(tPixel4b));
+	}
+}
+
+
+Undo::Step_Operation* Undo::Step_Operation::CreateSwizzle(const tString& desc, bool dirty, tComp R, tComp G, tComp B, tComp A)
+{
+	// Auto leaves a channel as it is. Constant channels lose information so need a full copy to undo.
+	tComp comps[4] = { R, G, B, A };
+	const tComp channels[4] = { tComp::R, tComp::G, tComp::B, tComp::A };
+	bool used[4] = { false, false, false, false };
+	for (int c = 0; c < 4; c++)
+	{
+		if (comps[c] == tComp::Auto)
+			comps[c] = channels[c];
+
+		int src = -1;
+		for (int s = 0; s < 4; s++)
+			if (comps[c] == channels[s])
+				src = s;
+		if ((src == -1) || used[src])
+			return nullptr;
+		used[src] = true;
+	}
+
+	Step_Operation* step = new Step_Operation(desc, dirty, Operation::Swizzle);
+	for (int c = 0; c < 4; c++)
+		step->SwizzleComps[c] = comps[c];
+	return step;
+}
+
+
+void Undo::Step_Operation::GetInverse(Operation& op, tComp comps[4]) const
+{
+	// Flips are their own inverse. A permutation swizzle is inverted by sending each channel back where it came from.
+	op = Op;
+	switch (Op)
+	{
+		case Operation::Rotate90CW:		op = Operation::Rotate90ACW;	break;
+		case Operation::Rotate90ACW:	op = Operation::Rotate90CW;		break;
+		case Operation::Swizzle:
+		{
+			const tComp channels[4] = { tComp::R, tComp::G, tComp::B, tComp::A };
+			for (int c = 0; c < 4; c++)
+				for (int s = 0; s < 4; s++)
+					if (SwizzleComps[c] == channels[s])
+						comps[s] = channels[c];
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+
+Undo::Step* Undo::Step_Operation::CreateInverse(tList<tImage::tPicture>& currPics, bool dirty)
+{
+	Step_Operation* inverse = new Step_Operation(Description, dirty, Op);
+	GetInverse(inverse->Op, inverse->SwizzleComps);
+	return inverse;
+}
+
+
+void Undo::Step_Operation::Restore(tList<tImage::tPicture>& pics)
+{
+	Operation op;
+	tComp comps[4] = { tComp::R, tComp::G, tComp::B, tComp::A };
+	GetInverse(op, comps);
+	for (tPicture* pic = pics.First(); pic; pic = pic->Next())
+	{
+		switch (op)
+		{
+			case Operation::FlipHorizontal:	pic->Flip(true);					break;
+			case Operation::FlipVertical:	pic->Flip(false);					break;
+			case Operation::Rotate90CW:		pic->Rotate90(false);				break;
+			case Operation::Rotate90ACW:	pic->Rotate90(true);				break;
+			case Operation::Swizzle:		pic->Swizzle(comps[0], comps[1], comps[2], comps[3]);	break;
+		}
+	}
 }
 
 
 void Undo::Stack::Push(tList<tImage::tPicture>& preOpState, const tString& desc, bool dirty)
 {
-	// Create the undo step.
-	Undo::Step_PictureList* step = new Undo::Step_PictureList(desc, dirty, preOpState);
-	UndoSteps.Insert(step);
+	Push(new Undo::Step_PictureList(desc, dirty, preOpState));
+}
+
+
+void Undo::Stack::Push(Step* step)
+{
+	// A new edit starts a new branch. The redo steps were made against pictures that no longer exist.
+	while (!RedoSteps.IsEmpty())
+		DeleteStep(RedoSteps.Remove());
+
+	AddStep(UndoSteps, step);
 
 	// Drop one from the end if we've reached the limit.
 	Viewer::Config::ProfileData& profile = *Viewer::Config::Current;
 	int numUndoSteps = UndoSteps.Count();
 	if (numUndoSteps > profile.MaxUndoSteps)
-		delete UndoSteps.Drop();
+		DeleteStep(UndoSteps.Drop());
 }
 
 
@@ -57,7 +320,77 @@ void Undo::Stack::Pop()
 	if (UndoSteps.IsEmpty())
 		return;
 
-	delete UndoSteps.Remove();
+	DeleteStep(UndoSteps.Remove());
+}
+
+
+int64 Undo::Stack::Spill(int64 bytesWanted)
+{
+	// Oldest first in each list. Redo steps are only needed if the user goes back to them so they go before undo.
+	int64 inFlight = 0;
+	tList<Step>* lists[2] = { &RedoSteps, &UndoSteps };
+	for (tList<Step>* steps : lists)
+	{
+		for (Step* step = steps->Tail(); step && (inFlight < bytesWanted); step = step->Prev())
+		{
+			if ((steps == &UndoSteps) && (step == UndoSteps.Head()))
+				break;
+
+			if (step->IsSpilling() || step->StartSpill())
+				inFlight += step->GetMemSizeBytes();
+		}
+	}
+
+	return inFlight;
+}
+
+
+bool Undo::Stack::UpdateSpill()
+{
+	bool changed = false;
+	tList<Step>* lists[2] = { &RedoSteps, &UndoSteps };
+	for (tList<Step>* steps : lists)
+	{
+		for (Step* step = steps->First(); step; step = step->Next())
+		{
+			if (!step->IsSpilling())
+				continue;
+
+			int64 before = step->GetMemSizeBytes();
+			if (step->UpdateSpill())
+			{
+				MemSizeBytes += step->GetMemSizeBytes() - before;
+				changed = true;
+			}
+		}
+	}
+
+	return changed;
+}
+
+
+bool Undo::Stack::IsSpilling() const
+{
+	const tList<Step>* lists[2] = { &RedoSteps, &UndoSteps };
+	for (const tList<Step>* steps : lists)
+		for (const Step* step = steps->First(); step; step = step->Next())
+			if (step->IsSpilling())
+				return true;
+
+	return false;
+}
+
+
+int64 Undo::Stack::DropOldest()
+{
+	tList<Step>& steps = RedoSteps.IsEmpty() ? UndoSteps : RedoSteps;
+	if (steps.IsEmpty())
+		return 0;
+
+	Step* step = steps.Drop();
+	int64 numBytes = step->GetMemSizeBytes();
+	DeleteStep(step);
+	return numBytes;
 }
 
 
@@ -66,16 +399,26 @@ void Undo::Stack::Undo(tList<tImage::tPicture>& currPics, bool& dirty)
 	if (UndoSteps.IsEmpty())
 		return;
 
+	// The step is accounted before restoring because reading back a spilled step changes its size.
 	Step* undoStep = UndoSteps.Remove();
+	MemSizeBytes -= undoStep->GetMemSizeBytes();
+
+	// A step that can not be read back or no longer fits the pictures is dropped rather than restored.
+	if (!undoStep->Unspill() || !undoStep->CanRestore(currPics))
+	{
+		tPrintf("Undo step %s could not be restored and was dropped.\n", undoStep->Description.Chr());
+		delete undoStep;
+		return;
+	}
 
 	// We're going to need a redo step to get to current state. Prepare it first.
-	Step* redoStep = new Step_PictureList(undoStep->Description, dirty, currPics);
+	Step* redoStep = undoStep->CreateInverse(currPics, dirty);
 
-	((Step_PictureList*)undoStep)->Restore(currPics);
+	undoStep->Restore(currPics);
 	dirty = undoStep->Dirty;
 	delete undoStep;
 
-	RedoSteps.Insert(redoStep);
+	AddStep(RedoSteps, redoStep);
 }
 
 
@@ -85,13 +428,22 @@ void Undo::Stack::Redo(tList<tImage::tPicture>& currPics, bool& dirty)
 		return;
 
 	Step* redoStep = RedoSteps.Remove();
+	MemSizeBytes -= redoStep->GetMemSizeBytes();
+
+	// A step that can not be read back or no longer fits the pictures is dropped rather than restored.
+	if (!redoStep->Unspill() || !redoStep->CanRestore(currPics))
+	{
+		tPrintf("Redo step %s could not be restored and was dropped.\n", redoStep->Description.Chr());
+		delete redoStep;
+		return;
+	}
 
 	// We're going to need an undo step to get to current state. Prepare it first.
-	Step* undoStep = new Step_PictureList(redoStep->Description, dirty, currPics);
+	Step* undoStep = redoStep->CreateInverse(currPics, dirty);
 
-	((Step_PictureList*)redoStep)->Restore(currPics);
+	redoStep->Restore(currPics);
 	dirty = redoStep->Dirty;
 	delete redoStep;
 
-	UndoSteps.Insert(undoStep);
+	AddStep(UndoSteps, undoStep);
 }
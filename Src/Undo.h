@@ -14,9 +14,11 @@
 // PERFORMANCE OF THIS SOFTWARE.
 
 #pragma once
+#include <vector>
 #include <Foundation/tList.h>
 #include <Foundation/tString.h>
 #include <Image/tPicture.h>
+#include "UndoSpill.h"
 namespace Undo
 {
 
@@ -27,29 +29,132 @@ class Step : public tLink<Step>
 public:
 	Step(const tString& desc, bool dirty)																				: Description(desc), Dirty(dirty) { }
 	virtual ~Step()																										{ }
+	virtual int64 GetMemSizeBytes() const																				{ return 0; }
+
+	// Creates the step that reverses this one. It is called with the pictures in their current state, just before
+	// Restore, and may take ownership of them. Restore then returns the pictures to the state this step recorded.
+	virtual Step* CreateInverse(tList<tImage::tPicture>& currPics, bool dirty) = 0;
+	virtual void Restore(tList<tImage::tPicture>& pics) = 0;
+
+	// Returns false if the step no longer fits the pictures, for example because they were resized since it was made.
+	// The stack then drops the step without restoring it.
+	virtual bool CanRestore(const tList<tImage::tPicture>& pics) const													{ return true; }
+
+	// Steps that hold a lot of memory may move it to a scratch file on a background thread. StartSpill queues that
+	// and returns false if there is nothing to spill. UpdateSpill is polled afterwards and returns true once the
+	// spill has finished and the memory was freed. Restore reads the memory back as needed.
+	virtual bool StartSpill()																							{ return false; }
+	virtual bool IsSpilling() const																						{ return false; }
+	virtual bool UpdateSpill()																							{ return false; }
+
+	// Makes sure a spilled step has its memory back. Returns false if it could not be read, in which case the step can
+	// not be restored and the stack drops it.
+	virtual bool Unspill()																								{ return true; }
 
 	tString Description;					// A biref description of the operation that this step undoes.
 	bool Dirty;								// The dirty state prior to the operation.
 };
 
 
-// A particular type of restore step. This one is simple but takes quite a lot of memory.
+// A particular type of restore step. This one is simple but takes quite a lot of memory. It is the fallback for
+// operations that change every pixel or the picture sizes. The copy is only made when the step is pushed. Undo and
+// redo hand the pictures between the image and the steps without copying them again. Old steps can be spilled to
+// a compressed scratch file. The pictures stay in the list without their pixels until they are restored.
 class Step_PictureList : public Step
 {
 public:
 	Step_PictureList(const tString& desc, bool dirty, const tList<tImage::tPicture>& pics);
-	virtual ~Step_PictureList()																							{ Pictures.Empty(); }
-	void Restore(tList<tImage::tPicture>& pics);
+
+	// For edits that build new pictures rather than changing the current ones. The step takes the pictures, leaving
+	// the list empty, instead of copying them.
+	static Step_PictureList* Steal(const tString& desc, bool dirty, tList<tImage::tPicture>& pics);
+	virtual ~Step_PictureList();
+	int64 GetMemSizeBytes() const override																				{ return SpillFile ? 0 : MemSizeBytes; }
+	Step* CreateInverse(tList<tImage::tPicture>& currPics, bool dirty) override;
+	void Restore(tList<tImage::tPicture>& pics) override;
+
+	bool StartSpill() override;
+	bool IsSpilling() const override																					{ return SpillJob != nullptr; }
+	bool UpdateSpill() override;
+
+	// Cancels a pending spill or reads a finished one back.
+	bool Unspill() override;
 
 	tList<tImage::tPicture> Pictures;
+
+private:
+	Step_PictureList(const tString& desc, bool dirty)																	: Step(desc, dirty) { }
+
+	int64 MemSizeBytes = 0;
+	Viewer::UndoSpill::Job* SpillJob = nullptr;
+	Viewer::UndoSpill::File* SpillFile = nullptr;	// Non-null while the pixels are on disk.
+	bool SpillFailed = false;				// Not retried. The scratch directory is probably full or unwritable.
+};
+
+
+// Saves only a rectangle of each picture. Use it for operations that write to a bounded region. Rects are clipped
+// to the pictures and there must be one for each picture in the list.
+class Step_Region : public Step
+{
+public:
+	struct Rect { int X = 0; int Y = 0; int W = 0; int H = 0; };
+	Step_Region(const tString& desc, bool dirty, const tList<tImage::tPicture>& pics, const std::vector<Rect>& rects);
+	virtual ~Step_Region();
+	int64 GetMemSizeBytes() const override																				{ return MemSizeBytes; }
+	Step* CreateInverse(tList<tImage::tPicture>& currPics, bool dirty) override;
+	void Restore(tList<tImage::tPicture>& pics) override;
+
+	// The pictures must have the same count and sizes as when the step was made.
+	bool CanRestore(const tList<tImage::tPicture>& pics) const override;
+
+private:
+	struct Patch
+	{
+		Rect Area;
+		int PicWidth						= 0;		// The size of the picture the patch was taken from.
+		int PicHeight						= 0;
+		tPixel4b* Pixels					= nullptr;	// Row-major. Null if the rect missed the picture.
+	};
+	std::vector<Patch> Patches;
+	int64 MemSizeBytes = 0;
+};
+
+
+// Exactly invertible operations only record what was done. Restore applies the inverse to every picture.
+enum class Operation
+{
+	FlipHorizontal,
+	FlipVertical,
+	Rotate90CW,
+	Rotate90ACW,
+	Swizzle
+};
+
+
+class Step_Operation : public Step
+{
+public:
+	Step_Operation(const tString& desc, bool dirty, Operation op)														: Step(desc, dirty), Op(op) { }
+
+	// Returns null if the swizzle is not a permutation of RGBA, so can't be undone this way.
+	static Step_Operation* CreateSwizzle(const tString& desc, bool dirty, tComp R, tComp G, tComp B, tComp A);
+	Step* CreateInverse(tList<tImage::tPicture>& currPics, bool dirty) override;
+	void Restore(tList<tImage::tPicture>& pics) override;
+
+private:
+	void GetInverse(Operation&, tComp comps[4]) const;
+	Operation Op;
+	tComp SwizzleComps[4]					= { tComp::R, tComp::G, tComp::B, tComp::A };
 };
 
 
 class Stack
 {
 public:
-	// Call push before doing whatever op you are doing.
+	// Call push before doing whatever op you are doing. The first form pushes a full copy of the pictures. The
+	// second pushes a step the caller made and takes ownership of it.
 	void Push(tList<tImage::tPicture>& preOpState, const tString& desc, bool dirty);
+	void Push(Step*);
 
 	// If you want to undo the last push you can call Pop.
 	void Pop();
@@ -62,9 +167,31 @@ public:
 	tString GetUndoDesc() const;
 	tString GetRedoDesc() const;
 
+	// Total memory held by all undo and redo steps. Kept up to date as steps are added, removed, and spilled.
+	int64 GetMemSizeBytes() const { return MemSizeBytes; }
+
+	// Starts spilling the oldest steps to scratch files until at least bytesWanted are being spilled. Redo steps go
+	// first and the most recent undo step is kept in memory so a single undo is always instant. Returns the number of
+	// bytes in flight, which may be less than asked for.
+	int64 Spill(int64 bytesWanted);
+
+	// Collects finished spills. Returns true if the memory size changed.
+	bool UpdateSpill();
+
+	// True if any step is still being written to a scratch file.
+	bool IsSpilling() const;
+
+	// Deletes the oldest redo step, or the oldest undo step if there are no redo steps. Returns the number of bytes
+	// freed. Zero means the stack was empty or the step was spilled.
+	int64 DropOldest();
+
 private:
+	void AddStep(tList<Step>& steps, Step* step)		{ MemSizeBytes += step->GetMemSizeBytes(); steps.Insert(step); }
+	void DeleteStep(Step* step)							{ MemSizeBytes -= step->GetMemSizeBytes(); delete step; }
+
 	tList<Step> UndoSteps;
 	tList<Step> RedoSteps;
+	int64 MemSizeBytes = 0;
 };
 
 
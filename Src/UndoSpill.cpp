@@ -0,0 +1,566 @@
+// UndoSpill.cpp
+//
+// Moves the pixels of old undo steps out of memory. A background thread compresses the pictures of a step with a
+// fast lossless run/delta codec and writes them to a scratch file. Once that finishes the step can free its pixels.
+// Undo and redo read them back on demand, so a long editing session on big images only keeps recent history in RAM.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#ifdef PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <System/tPrint.h>
+#include "UndoSpill.h"
+#include "TacentView.h"
+using namespace tImage;
+
+
+namespace Viewer
+{
+	namespace UndoSpill
+	{
+		struct File
+		{
+			#ifdef PLATFORM_WINDOWS
+			HANDLE Handle											= INVALID_HANDLE_VALUE;
+			#else
+			int Descriptor											= -1;
+			#endif
+		};
+
+		struct Job : public tLink<Job>
+		{
+			std::vector<const tPicture*> Pictures;
+			tString Filename;
+
+			// Written by the worker. Only read by the main thread once Done is set.
+			File* Result											= nullptr;	// Null unless the write succeeded.
+			std::atomic<bool> Cancelled								= false;
+			bool Done												= false;	// Mutex must be held.
+		};
+
+		// File layout is the magic, the picture count, and then for each picture its width, height, encoded size in
+		// bytes, and the encoded pixels.
+		const uint32 FileMagic										= 0x53555654;	// "TVUS"
+
+		// The OS read and write calls take 32-bit sizes so big pictures are read and written in chunks.
+		const int64 MaxChunkBytes									= 64*1024*1024;
+
+		// The codec is QOI-style. Each pixel is a run of the previous pixel, a hit in a 64 entry table of recently
+		// seen colours, a small delta from the previous pixel, or a literal. Edited images are mostly smooth or flat
+		// so this is usually several times smaller than the raw pixels and costs a few ns per pixel either way.
+		enum Op : uint8
+		{
+			Op_Index												= 0x00,
+			Op_Diff													= 0x40,
+			Op_Luma													= 0x80,
+			Op_Run													= 0xC0,
+			Op_RGB													= 0xFE,
+			Op_RGBA													= 0xFF,
+			Op_Mask													= 0xC0
+		};
+		const int MaxRun											= 62;		// 63 and 64 would collide with RGB and RGBA.
+
+		// The mutex protects Pending, Active, Quit, and the Done member of every job.
+		std::mutex Mutex;
+		std::condition_variable WorkAvailable;
+		std::condition_variable JobFinished;
+		tList<Job> Pending;
+		Job* Active													= nullptr;
+		bool Quit													= false;
+		std::thread Worker;
+
+		// Main thread only.
+		tString ScratchDir;
+		uint32 SessionID											= 0;
+		int FileCounter												= 0;
+
+		int Hash(const tPixel4b& c)									{ return (c.R*3 + c.G*5 + c.B*7 + c.A*11) % 64; }
+		File* OpenFile(const tString& filename);
+		void CloseFile(File*);
+		bool Rewind(File*);
+		bool WriteBytes(File*, const void* data, int64 numBytes);
+		bool ReadBytes(File*, void* data, int64 numBytes);
+		void ProcessJob(Job&);
+		void WorkerFunction();
+	}
+}
+
+
+void Viewer::UndoSpill::Encode(const tPixel4b* pixels, int64 numPixels, std::vector<uint8>& encoded)
+{
+	encoded.clear();
+	tPixel4b table[64];
+	for (int i = 0; i < 64; i++)
+		table[i].BP = 0;
+
+	tPixel4b prev;
+	prev.R = 0; prev.G = 0; prev.B = 0; prev.A = 255;
+	int run = 0;
+	for (int64 p = 0; p < numPixels; p++)
+	{
+		const tPixel4b& c = pixels[p];
+		if (c.BP == prev.BP)
+		{
+			run++;
+			if ((run == MaxRun) || (p == numPixels-1))
+			{
+				encoded.push_back(uint8(Op_Run | (run-1)));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0)
+		{
+			encoded.push_back(uint8(Op_Run | (run-1)));
+			run = 0;
+		}
+
+		int h = Hash(c);
+		if (table[h].BP == c.BP)
+		{
+			encoded.push_back(uint8(Op_Index | h));
+			prev = c;
+			continue;
+		}
+		table[h] = c;
+
+		if (c.A == prev.A)
+		{
+			int dr = int8(c.R - prev.R);
+			int dg = int8(c.G - prev.G);
+			int db = int8(c.B - prev.B);
+			int drg = dr - dg;
+			int dbg = db - dg;
+			if ((dr >= -2) && (dr <= 1) && (dg >= -2) && (dg <= 1) && (db >= -2) && (db <= 1))
+			{
+				encoded.push_back(uint8(Op_Diff | ((dr+2) << 4) | ((dg+2) << 2) | (db+2)));
+			}
+			else if ((dg >= -32) && (dg <= 31) && (drg >= -8) && (drg <= 7) && (dbg >= -8) && (dbg <= 7))
+			{
+				encoded.push_back(uint8(Op_Luma | (dg+32)));
+				encoded.push_back(uint8(((drg+8) << 4) | (dbg+8)));
+			}
+			else
+			{
+				encoded.push_back(Op_RGB);
+				encoded.push_back(c.R);
+				encoded.push_back(c.G);
+				encoded.push_back(c.B);
+			}
+		}
+		else
+		{
+			encoded.push_back(Op_RGBA);
+			encoded.push_back(c.R);
+			encoded.push_back(c.G);
+			encoded.push_back(c.B);
+			encoded.push_back(c.A);
+		}
+		prev = c;
+	}
+}
+
+
+bool Viewer::UndoSpill::Decode(const uint8* encoded, int64 numBytes, tPixel4b* pixels, int64 numPixels)
+{
+	// The table is only written where the encoder writes it, on colours that were not already in it.
+	tPixel4b table[64];
+	for (int i = 0; i < 64; i++)
+		table[i].BP = 0;
+
+	tPixel4b prev;
+	prev.R = 0; prev.G = 0; prev.B = 0; prev.A = 255;
+	int64 b = 0;
+	int64 p = 0;
+	while ((p < numPixels) && (b < numBytes))
+	{
+		uint8 op = encoded[b++];
+		if (op == Op_RGB)
+		{
+			if (b + 3 > numBytes)
+				return false;
+			prev.R = encoded[b++];
+			prev.G = encoded[b++];
+			prev.B = encoded[b++];
+			table[Hash(prev)] = prev;
+		}
+		else if (op == Op_RGBA)
+		{
+			if (b + 4 > numBytes)
+				return false;
+			prev.R = encoded[b++];
+			prev.G = encoded[b++];
+			prev.B = encoded[b++];
+			prev.A = encoded[b++];
+			table[Hash(prev)] = prev;
+		}
+		else
+		{
+			switch (op & Op_Mask)
+			{
+				case Op_Index:
+					prev = table[op & 0x3F];
+					break;
+
+				case Op_Diff:
+					prev.R += ((op >> 4) & 0x03) - 2;
+					prev.G += ((op >> 2) & 0x03) - 2;
+					prev.B += ( op       & 0x03) - 2;
+					table[Hash(prev)] = prev;
+					break;
+
+				case Op_Luma:
+				{
+					if (b + 1 > numBytes)
+						return false;
+					uint8 next = encoded[b++];
+					int dg = (op & 0x3F) - 32;
+					prev.R += dg - 8 + ((next >> 4) & 0x0F);
+					prev.G += dg;
+					prev.B += dg - 8 + (next & 0x0F);
+					table[Hash(prev)] = prev;
+					break;
+				}
+
+				case Op_Run:
+				{
+					int run = (op & 0x3F) + 1;
+					if (p + run > numPixels)
+						return false;
+					for (int r = 0; r < run; r++)
+						pixels[p++] = prev;
+					continue;
+				}
+			}
+		}
+		pixels[p++] = prev;
+	}
+
+	return (p == numPixels) && (b == numBytes);
+}
+
+
+Viewer::UndoSpill::File* Viewer::UndoSpill::OpenFile(const tString& filename)
+{
+	File* file = new File;
+
+	#ifdef PLATFORM_WINDOWS
+	file->Handle = CreateFileA
+	(
+		filename.Chr(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr
+	);
+	if (file->Handle == INVALID_HANDLE_VALUE)
+	{
+		delete file;
+		return nullptr;
+	}
+	#else
+	file->Descriptor = open(filename.Chr(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (file->Descriptor < 0)
+	{
+		delete file;
+		return nullptr;
+	}
+
+	// The name is not needed once the file is open. Unlinking now means nothing is left behind after a crash.
+	unlink(filename.Chr());
+	#endif
+
+	return file;
+}
+
+
+void Viewer::UndoSpill::CloseFile(File* file)
+{
+	#ifdef PLATFORM_WINDOWS
+	CloseHandle(file->Handle);
+	#else
+	close(file->Descriptor);
+	#endif
+	delete file;
+}
+
+
+bool Viewer::UndoSpill::Rewind(File* file)
+{
+	#ifdef PLATFORM_WINDOWS
+	return SetFilePointer(file->Handle, 0, nullptr, FILE_BEGIN) != INVALID_SET_FILE_POINTER;
+	#else
+	return lseek(file->Descriptor, 0, SEEK_SET) == 0;
+	#endif
+}
+
+
+bool Viewer::UndoSpill::WriteBytes(File* file, const void* data, int64 numBytes)
+{
+	const uint8* src = (const uint8*)data;
+	while (numBytes > 0)
+	{
+		int64 chunk = tMath::tMin(numBytes, MaxChunkBytes);
+		#ifdef PLATFORM_WINDOWS
+		DWORD written = 0;
+		if (!WriteFile(file->Handle, src, DWORD(chunk), &written, nullptr) || (written == 0))
+			return false;
+		#else
+		ssize_t written = write(file->Descriptor, src, size_t(chunk));
+		if (written <= 0)
+			return false;
+		#endif
+		src += written;
+		numBytes -= written;
+	}
+	return true;
+}
+
+
+bool Viewer::UndoSpill::ReadBytes(File* file, void* data, int64 numBytes)
+{
+	uint8* dst = (uint8*)data;
+	while (numBytes > 0)
+	{
+		int64 chunk = tMath::tMin(numBytes, MaxChunkBytes);
+		#ifdef PLATFORM_WINDOWS
+		DWORD read = 0;
+		if (!ReadFile(file->Handle, dst, DWORD(chunk), &read, nullptr) || (read == 0))
+			return false;
+		#else
+		ssize_t read = ::read(file->Descriptor, dst, size_t(chunk));
+		if (read <= 0)
+			return false;
+		#endif
+		dst += read;
+		numBytes -= read;
+	}
+	return true;
+}
+
+
+void Viewer::UndoSpill::Init(const tString& scratchDir)
+{
+	// Other running instances may share the scratch directory. The session ID keeps their filenames apart.
+	ScratchDir = scratchDir;
+	SessionID = uint32(std::chrono::system_clock::now().time_since_epoch().count());
+	FileCounter = 0;
+	if (ScratchDir.IsEmpty())
+		return;
+
+	Quit = false;
+	Worker = std::thread(WorkerFunction);
+}
+
+
+void Viewer::UndoSpill::Shutdown()
+{
+	if (!Worker.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Quit = true;
+	}
+	WorkAvailable.notify_all();
+	Worker.join();
+
+	// Images cancel their jobs when their undo steps are deleted so nothing should be left. Anything that is gets
+	// dropped. Pending jobs have not created their files yet.
+	while (Job* job = Pending.Remove())
+		delete job;
+}
+
+
+bool Viewer::UndoSpill::IsAvailable()
+{
+	return Worker.joinable();
+}
+
+
+Viewer::UndoSpill::Job* Viewer::UndoSpill::Submit(const tList<tPicture>& pictures)
+{
+	if (!IsAvailable())
+		return nullptr;
+
+	Job* job = new Job;
+	for (const tPicture* pic = pictures.First(); pic; pic = pic->Next())
+		job->Pictures.push_back(pic);
+
+	tsPrintf(job->Filename, "%sUndoSpill_%08X_%04d.scratch", ScratchDir.Chr(), SessionID, FileCounter++);
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Pending.Append(job);
+	}
+	WorkAvailable.notify_one();
+	return job;
+}
+
+
+bool Viewer::UndoSpill::Collect(Job* job, File*& file)
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		if (!job->Done)
+			return false;
+	}
+
+	file = job->Result;
+	delete job;
+	return true;
+}
+
+
+void Viewer::UndoSpill::Cancel(Job* job)
+{
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		if (!job->Done && (job != Active))
+		{
+			Pending.Remove(job);
+		}
+		else
+		{
+			job->Cancelled = true;
+			JobFinished.wait(lock, [job] { return job->Done; });
+		}
+	}
+
+	// A job that finished before the cancel still wrote its file.
+	Discard(job->Result);
+	delete job;
+}
+
+
+bool Viewer::UndoSpill::Load(File* file, tList<tPicture>& pictures)
+{
+	if (!file)
+		return false;
+
+	uint32 magic = 0;
+	int32 numPictures = 0;
+	bool ok = Rewind(file) && ReadBytes(file, &magic, sizeof(magic)) && ReadBytes(file, &numPictures, sizeof(numPictures));
+	ok = ok && (magic == FileMagic) && (numPictures == pictures.Count());
+
+	std::vector<uint8> encoded;
+	for (tPicture* pic = pictures.First(); pic && ok; pic = pic->Next())
+	{
+		int32 width = 0;
+		int32 height = 0;
+		int64 numBytes = 0;
+		ok = ReadBytes(file, &width, sizeof(width)) && ReadBytes(file, &height, sizeof(height)) && ReadBytes(file, &numBytes, sizeof(numBytes));
+		if (!ok || (width <= 0) || (height <= 0) || (numBytes < 0))
+		{
+			ok = false;
+			break;
+		}
+
+		encoded.resize(numBytes);
+		int64 numPixels = int64(width)*height;
+		tPixel4b* pixels = new tPixel4b[numPixels];
+		ok = ReadBytes(file, encoded.data(), numBytes) && Decode(encoded.data(), numBytes, pixels, numPixels);
+		if (!ok)
+		{
+			delete[] pixels;
+			break;
+		}
+
+		// Set may reset the other members so we preserve the ones we care about.
+		float duration = pic->Duration;
+		uint textureID = pic->TextureID;
+		pic->Set(width, height, pixels, false);
+		pic->Duration = duration;
+		pic->TextureID = textureID;
+	}
+
+	if (!ok)
+		tPrintf("Failed to read undo scratch file\n");
+
+	CloseFile(file);
+	return ok;
+}
+
+
+void Viewer::UndoSpill::Discard(File* file)
+{
+	if (file)
+		CloseFile(file);
+}
+
+
+void Viewer::UndoSpill::ProcessJob(Job& job)
+{
+	File* file = OpenFile(job.Filename);
+	if (!file)
+		return;
+
+	uint32 magic = FileMagic;
+	int32 numPictures = int32(job.Pictures.size());
+	bool ok = WriteBytes(file, &magic, sizeof(magic)) && WriteBytes(file, &numPictures, sizeof(numPictures));
+
+	std::vector<uint8> encoded;
+	for (const tPicture* pic : job.Pictures)
+	{
+		// Checked between pictures. A single picture is the longest a cancel can wait.
+		if (!ok || job.Cancelled)
+		{
+			ok = false;
+			break;
+		}
+
+		int32 width = pic->GetWidth();
+		int32 height = pic->GetHeight();
+		Encode(pic->GetPixels(), int64(width)*height, encoded);
+		int64 numBytes = int64(encoded.size());
+		ok = WriteBytes(file, &width, sizeof(width)) && WriteBytes(file, &height, sizeof(height)) && WriteBytes(file, &numBytes, sizeof(numBytes));
+		ok = ok && WriteBytes(file, encoded.data(), numBytes);
+	}
+
+	if (ok)
+		job.Result = file;
+	else
+		CloseFile(file);
+}
+
+
+void Viewer::UndoSpill::WorkerFunction()
+{
+	while (true)
+	{
+		Job* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			WorkAvailable.wait(lock, [] { return Quit || !Pending.IsEmpty(); });
+			if (Quit)
+				break;
+			job = Pending.Remove();
+			Active = job;
+		}
+
+		ProcessJob(*job);
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			job->Done = true;
+			Active = nullptr;
+		}
+		JobFinished.notify_all();
+		WakeMainLoop();
+	}
+}
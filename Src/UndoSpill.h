@@ -0,0 +1,65 @@
+// UndoSpill.h
+//
+// Moves the pixels of old undo steps out of memory. A background thread compresses the pictures of a step with a
+// fast lossless run/delta codec and writes them to a scratch file. Once that finishes the step can free its pixels.
+// Undo and redo read them back on demand, so a long editing session on big images only keeps recent history in RAM.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <vector>
+#include <Foundation/tList.h>
+#include <Foundation/tString.h>
+#include <Image/tPicture.h>
+
+
+namespace Viewer
+{
+	namespace UndoSpill
+	{
+		struct Job;
+
+		// An open scratch file holding the pixels of one step. It has no name on disk once opened, so it goes away
+		// when it is closed or the process exits, even after a crash.
+		struct File;
+
+		// Call once from the main thread at startup and shutdown. Spilling is unavailable if the scratch directory is
+		// empty or Init was never called.
+		void Init(const tString& scratchDir);
+		void Shutdown();
+		bool IsAvailable();
+
+		// Queues the pictures to be written to a new scratch file. The pictures must not be modified or freed until
+		// the job is collected or cancelled.
+		Job* Submit(const tList<tImage::tPicture>&);
+
+		// Never blocks. Once the job is finished it is freed and true is returned. The file is null if writing failed,
+		// in which case the caller should keep its pixels.
+		bool Collect(Job*, File*&);
+
+		// Frees the job and closes any partly written file. If the worker is busy with it this waits until it
+		// finishes the picture it is on.
+		void Cancel(Job*);
+
+		// Reads a scratch file back into the same pictures that were submitted, in the same order, and closes it. The
+		// pictures keep their other members. Blocks until done. Returns false if the file could not be read, in which
+		// case some of the pictures may be left without pixels.
+		bool Load(File*, tList<tImage::tPicture>&);
+
+		// Closes a scratch file that is no longer needed. Null is ignored.
+		void Discard(File*);
+
+		// The lossless codec the scratch files use. Decode returns false unless the bytes decode to exactly numPixels
+		// pixels with none left over.
+		void Encode(const tPixel4b* pixels, int64 numPixels, std::vector<uint8>& encoded);
+		bool Decode(const uint8* encoded, int64 numBytes, tPixel4b* pixels, int64 numPixels);
+	}
+}
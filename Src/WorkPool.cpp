@@ -0,0 +1,276 @@
+// WorkPool.cpp
+//
+// A shared pool of worker threads for splitting one big piece of work, like the rows of a single large picture,
+// between all the cores. Both the viewer and the command line use it. Results never depend on how the work was split
+// or how many threads ran it, so the output is the same as running it on one thread.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <condition_variable>
+#include <cstring>
+#include <Foundation/tList.h>
+#include <System/tMachine.h>
+#include "WorkPool.h"
+using namespace tImage;
+
+
+namespace Viewer
+{
+	namespace WorkPool
+	{
+		struct Batch : public tLink<Batch>
+		{
+			const std::function<void(int, int)>* Func				= nullptr;
+			int Count												= 0;
+			int Grain												= 1;
+			int NumRanges											= 0;
+			int MaxHelpers											= 0;
+			Progress* Prog											= nullptr;
+			std::atomic<int> NextRange								= 0;
+
+			// Mutex must be held. The batch may only be freed once every range is done and no worker is using it.
+			int RangesDone											= 0;
+			int Helpers												= 0;
+		};
+
+		// Bands smaller than this cost more to copy and hand out than they save.
+		const int MinBandPixels										= 256*256;
+
+		// More bands than threads so a thread that finishes early can take another.
+		const int BandsPerThread									= 2;
+
+		// The mutex protects Batches, Quit, and the RangesDone and Helpers members of every batch.
+		std::mutex Mutex;
+		std::condition_variable WorkAvailable;
+		std::condition_variable BatchFinished;
+		tList<Batch> Batches;
+		bool Quit													= false;
+		std::vector<std::thread> Workers;
+		thread_local bool IsPoolThread								= false;
+
+		Batch* FindOpenBatch();										// Mutex must be held.
+		int RunRanges(Batch&);										// Returns the number of ranges taken.
+		void WorkerFunction();
+	}
+}
+
+
+Viewer::WorkPool::Batch* Viewer::WorkPool::FindOpenBatch()
+{
+	for (Batch* batch = Batches.First(); batch; batch = batch->Next())
+		if ((batch->NextRange < batch->NumRanges) && (batch->Helpers < batch->MaxHelpers))
+			return batch;
+
+	return nullptr;
+}
+
+
+int Viewer::WorkPool::RunRanges(Batch& batch)
+{
+	// Cancelled ranges are still taken so the batch finishes.
+	int numRun = 0;
+	for (int r = batch.NextRange++; r < batch.NumRanges; r = batch.NextRange++)
+	{
+		numRun++;
+		if (batch.Prog && batch.Prog->IsCancelled())
+			continue;
+
+		int begin = r*batch.Grain;
+		int end = tMath::tMin(begin + batch.Grain, batch.Count);
+		(*batch.Func)(begin, end);
+		if (batch.Prog)
+			batch.Prog->AddDone(end - begin);
+	}
+	return numRun;
+}
+
+
+void Viewer::WorkPool::WorkerFunction()
+{
+	IsPoolThread = true;
+	std::unique_lock<std::mutex> lock(Mutex);
+	while (true)
+	{
+		WorkAvailable.wait(lock, [] { return Quit || FindOpenBatch(); });
+		if (Quit)
+			break;
+
+		Batch* batch = FindOpenBatch();
+		batch->Helpers++;
+		lock.unlock();
+		int numRun = RunRanges(*batch);
+		lock.lock();
+
+		batch->RangesDone += numRun;
+		batch->Helpers--;
+		if ((batch->RangesDone == batch->NumRanges) && (batch->Helpers == 0))
+			BatchFinished.notify_all();
+	}
+}
+
+
+float Viewer::WorkPool::Progress::GetFraction() const
+{
+	int64 total = Total;
+	if (total <= 0)
+		return 0.0f;
+	return tMath::tMin(float(double(Done) / double(total)), 1.0f);
+}
+
+
+void Viewer::WorkPool::Init(int numThreads)
+{
+	if (!Workers.empty())
+		return;
+
+	if (numThreads <= 0)
+		numThreads = tSystem::tGetNumCores();
+
+	// The calling thread always works too so one fewer thread is needed.
+	Quit = false;
+	for (int t = 1; t < numThreads; t++)
+		Workers.emplace_back(WorkerFunction);
+}
+
+
+void Viewer::WorkPool::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Quit = true;
+	}
+	WorkAvailable.notify_all();
+	for (std::thread& worker : Workers)
+		worker.join();
+	Workers.clear();
+}
+
+
+int Viewer::WorkPool::GetNumThreads()
+{
+	return int(Workers.size()) + 1;
+}
+
+
+void Viewer::WorkPool::ParallelFor
+(
+	int count, int grain, const std::function<void(int begin, int end)>& func,
+	int maxThreads, Progress* progress
+)
+{
+	if (count <= 0)
+		return;
+
+	if (progress)
+		progress->AddWork(count);
+
+	grain = tMath::tMax(grain, 1);
+	int numRanges = (count + grain - 1) / grain;
+	if (maxThreads <= 0)
+		maxThreads = GetNumThreads();
+	if ((numRanges == 1) || (maxThreads == 1) || Workers.empty() || IsPoolThread)
+	{
+		for (int begin = 0; (begin < count) && !(progress && progress->IsCancelled()); begin += grain)
+		{
+			int end = tMath::tMin(begin + grain, count);
+			func(begin, end);
+			if (progress)
+				progress->AddDone(end - begin);
+		}
+		return;
+	}
+
+	Batch batch;
+	batch.Func = &func;
+	batch.Count = count;
+	batch.Grain = grain;
+	batch.NumRanges = numRanges;
+	batch.MaxHelpers = tMath::tMin(maxThreads, numRanges) - 1;
+	batch.Prog = progress;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Batches.Append(&batch);
+	}
+	WorkAvailable.notify_all();
+
+	int numRun = RunRanges(batch);
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	batch.RangesDone += numRun;
+	BatchFinished.wait(lock, [&batch] { return (batch.RangesDone == batch.NumRanges) && (batch.Helpers == 0); });
+	Batches.Remove(&batch);
+}
+
+
+void Viewer::WorkPool::ForBands(tPicture& picture, const std::function<void(tPicture& band)>& op, Progress* progress)
+{
+	if (!picture.IsValid())
+		return;
+
+	int width = picture.GetWidth();
+	int height = picture.GetHeight();
+	int64 area = int64(width)*height;
+	int numBands = int(tMath::tMin(int64(GetNumThreads()*BandsPerThread), area/MinBandPixels));
+	if (numBands <= 1)
+	{
+		if (progress)
+			progress->AddWork(height);
+		if (progress && progress->IsCancelled())
+			return;
+		op(picture);
+		if (progress)
+			progress->AddDone(height);
+		return;
+	}
+
+	int rowsPerBand = (height + numBands - 1) / numBands;
+	ParallelFor
+	(
+		height, rowsPerBand,
+		[&](int rowBegin, int rowEnd)
+		{
+			tPixel4b* rows = picture.GetPixelPointer(0, rowBegin);
+			int numRows = rowEnd - rowBegin;
+			tPicture band(width, numRows, rows, true);
+			op(band);
+
+			tAssert((band.GetWidth() == width) && (band.GetHeight() == numRows));
+			std::memcpy(rows, band.GetPixels(), int64(width)*numRows*sizeof(tPixel4b));
+		},
+		0, progress
+	);
+}
+
+
+void Viewer::WorkPool::ForPixels(tPicture& picture, const std::function<void(tPixel4b* pixels, int64 count)>& op, Progress* progress)
+{
+	if (!picture.IsValid())
+		return;
+
+	int width = picture.GetWidth();
+	int height = picture.GetHeight();
+	int64 area = int64(width)*height;
+	int numBands = int(tMath::tMax(tMath::tMin(int64(GetNumThreads()*BandsPerThread), area/MinBandPixels), int64(1)));
+	int rowsPerBand = (height + numBands - 1) / numBands;
+	ParallelFor
+	(
+		height, rowsPerBand,
+		[&](int rowBegin, int rowEnd)
+		{
+			op(picture.GetPixelPointer(0, rowBegin), int64(width)*(rowEnd - rowBegin));
+		},
+		0, progress
+	);
+}
@@ -0,0 +1,73 @@
+// WorkPool.h
+//
+// A shared pool of worker threads for splitting one big piece of work, like the rows of a single large picture,
+// between all the cores. Both the viewer and the command line use it. Results never depend on how the work was split
+// or how many threads ran it, so the output is the same as running it on one thread.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <functional>
+#include <Image/tPicture.h>
+
+
+namespace Viewer
+{
+	namespace WorkPool
+	{
+		// Lets long work say how far it has got and be stopped part way. Every member may be used from any thread.
+		// Work that finds it cancelled returns as soon as it can and leaves its output unfinished, to be thrown away.
+		class Progress
+		{
+		public:
+			void AddWork(int64 amount)																					{ Total += amount; }
+			void AddDone(int64 amount)																					{ Done += amount; }
+			void Cancel()																								{ Cancelled = true; }
+			bool IsCancelled() const																					{ return Cancelled; }
+
+			// E [0.0, 1.0]. Zero until some work was added.
+			float GetFraction() const;
+
+		private:
+			std::atomic<int64> Total								= 0;
+			std::atomic<int64> Done									= 0;
+			std::atomic<bool> Cancelled								= false;
+		};
+
+		// Call once from the main thread at startup and shutdown. Zero threads means one per core. Until Init is
+		// called, or after Shutdown, all work runs on the calling thread.
+		void Init(int numThreads = 0);
+		void Shutdown();
+
+		// The number of threads that may share a piece of work, including the calling thread. At least 1.
+		int GetNumThreads();
+
+		// Calls func(begin, end) for consecutive ranges covering [0, count), each no longer than grain. The calling
+		// thread takes ranges too and this returns once all of them are done. No more than maxThreads ranges run at
+		// the same time. Zero means no limit. May be called from any thread. When called from a pool thread the
+		// ranges are run on that thread. With a progress the count is added as work, each range adds its length as
+		// it finishes, and ranges not yet started are skipped once it is cancelled.
+		void ParallelFor
+		(
+			int count, int grain, const std::function<void(int begin, int end)>& func,
+			int maxThreads = 0, Progress* = nullptr
+		);
+
+		// Runs op on horizontal bands of the picture at the same time and copies the bands back. Only use this for
+		// operations where each pixel depends on nothing but its own value, and that keep the band the same size.
+		// Small pictures are passed to op whole. The progress counts rows.
+		void ForBands(tImage::tPicture&, const std::function<void(tImage::tPicture& band)>& op, Progress* = nullptr);
+
+		// Like ForBands but for loops that can work directly on a run of pixels in place. No copies are made.
+		void ForPixels(tImage::tPicture&, const std::function<void(tPixel4b* pixels, int64 count)>& op, Progress* = nullptr);
+	}
+}